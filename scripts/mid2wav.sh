@@ -43,12 +43,7 @@ fi
 # Set up fast fail
 set -euo pipefail
 
-# Render the .mid(s) to .wav(s)
-for midFilePath in "${mid_files[@]}"; do
-  midFileName="${midFilePath##*/}"
-  wavFileName="${midFileName%.*}.wav"
-  wavFilePath="$output_dir/$wavFileName"
-  echo "rendering '$wavFilePath' from '$midFilePath'"
-  $RENDER_CMD -r gs "$midFilePath" -o "$wavFilePath" || fatal "rendering error"
-done
+# Render the .mid(s) to .wav(s) in a single batch
+echo "rendering ${#mid_files[@]} file(s) into '$output_dir'"
+$RENDER_CMD -r gs -o "$output_dir/{name}.wav" "${mid_files[@]}" || fatal "rendering error"
 
@@ -3,6 +3,7 @@
 #include "math_util.h"
 #include <cstddef>
 #include <cstdint>
+#include <span>
 
 enum class AudioFormat
 {
@@ -70,3 +71,24 @@ inline void Scale(AudioFrame<float>& frame, float scalar_gain)
     frame.left  = frame.left * scalar_gain;
     frame.right = frame.right * scalar_gain;
 }
+
+// Block versions of Normalize and Scale. These are plain loops over whole blocks so that the compiler can vectorize
+// them; per-frame calls through the sample callback cannot be.
+// precondition: out.size() >= in.size()
+template <typename SampleT>
+void NormalizeBlock(std::span<const AudioFrame<int32_t>> in, std::span<AudioFrame<SampleT>> out)
+{
+    for (size_t i = 0; i < in.size(); ++i)
+    {
+        Normalize(in[i], out[i]);
+    }
+}
+
+template <typename SampleT>
+void ScaleBlock(std::span<AudioFrame<SampleT>> frames, float scalar_gain)
+{
+    for (AudioFrame<SampleT>& frame : frames)
+    {
+        Scale(frame, scalar_gain);
+    }
+}
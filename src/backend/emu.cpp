@@ -39,8 +39,10 @@
 #include "pcm.h"
 #include "submcu.h"
 #include <bit>
+#include <cstring>
 #include <fstream>
 #include <span>
+#include <type_traits>
 #include <vector>
 
 Emulator::~Emulator()
@@ -76,6 +78,20 @@ bool Emulator::Init(const EMU_Options& options)
     TIMER_Init(*m_timer, *m_mcu);
     LCD_Init(*m_lcd, *m_mcu);
     m_lcd->backend = options.lcd_backend;
+    MCU_SetBackend(*m_mcu, options.mcu_backend);
+    m_pcm->engine  = options.pcm_engine;
+
+    if (options.mcu_lockstep)
+    {
+        EMU_Options reference_options;
+        reference_options.mcu_backend = MCU_Backend::Interpreter;
+
+        m_lockstep = std::make_unique<Emulator>();
+        if (!m_lockstep->Init(reference_options))
+        {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -84,6 +100,11 @@ void Emulator::Reset()
 {
     MCU_Reset(*m_mcu);
     SM_Reset(*m_sm);
+
+    if (m_lockstep)
+    {
+        m_lockstep->Reset();
+    }
 }
 
 bool Emulator::StartLCD()
@@ -96,45 +117,132 @@ void Emulator::StopLCD()
     LCD_Stop(*m_lcd);
 }
 
-void Emulator::SetSampleCallback(mcu_sample_callback callback, void* userdata)
+void Emulator::SetSampleSink(std::span<AudioFrame<int32_t>> buffer, mcu_sample_callback callback, void* userdata)
 {
-    m_mcu->callback_userdata = userdata;
-    m_mcu->sample_callback = callback;
+    MCU_SetSampleSink(*m_mcu, buffer, callback, userdata);
 }
 
-bool Emulator::LoadRoms(Romset romset, const AllRomsetInfo& all_info, RomLocationSet* loaded)
+void Emulator::FlushSamples()
+{
+    MCU_FlushSamples(*m_mcu);
+}
+
+// Size of the buffer the emulator reads each rom location through. Roms smaller than this are padded with zeroes.
+static size_t EMU_RomLocationSize(RomLocation location)
+{
+    switch (location)
+    {
+    case RomLocation::ROM1:
+        return ROM1_SIZE;
+    case RomLocation::ROM2:
+        return ROM2_SIZE;
+    case RomLocation::SMROM:
+        return 0x1000;
+    case RomLocation::WAVEROM1:
+    case RomLocation::WAVEROM2:
+    case RomLocation::WAVEROM_CARD:
+        return 0x200000;
+    case RomLocation::WAVEROM3:
+        return 0x100000;
+    case RomLocation::WAVEROM_EXP:
+        return 0x800000;
+    }
+    Diag_Printf(Diag_Category::Error, "EMU_RomLocationSize called with invalid location %d\n", (int)location);
+    std::abort();
+}
+
+std::shared_ptr<const EMU_RomImage> EMU_CreateRomImage(Romset               romset,
+                                                       const AllRomsetInfo& all_info,
+                                                       RomLocationSet*      loaded)
 {
     if (loaded)
     {
         loaded->fill(false);
     }
 
-    MCU_SetRomset(GetMCU(), romset);
+    auto image    = std::make_shared<EMU_RomImage>();
+    image->romset = romset;
 
     const RomsetInfo& info = all_info.romsets[(size_t)romset];
 
     for (size_t i = 0; i < ROMLOCATION_COUNT; ++i)
     {
         const RomLocation location = (RomLocation)i;
+        const auto&       source   = info.rom_data[i];
 
         // rom_data should be populated at this point
         // if it isn't, then there isn't a rom for this location
-        if (info.rom_data[i].empty())
+        if (source.empty())
         {
             continue;
         }
 
-        if (!LoadRom(location, info.rom_data[i]))
+        const size_t size = EMU_RomLocationSize(location);
+        if (size < source.size())
         {
-            return false;
+            Diag_Printf(Diag_Category::Error,
+                        "rom for %s is too large; max size is %d bytes\n",
+                        ToCString(location),
+                        (int)size);
+            return nullptr;
+        }
+
+        if (location == RomLocation::ROM2)
+        {
+            if (!std::has_single_bit(source.size()))
+            {
+                Diag_Printf(Diag_Category::Error, "%s requires a power-of-2 size\n", ToCString(location));
+                return nullptr;
+            }
+            image->rom2_mask = (uint32_t)source.size() - 1;
         }
 
+        image->data[i].assign(size, 0);
+        std::copy(source.begin(), source.end(), image->data[i].begin());
+
         if (loaded)
         {
             (*loaded)[i] = true;
         }
     }
 
+    return image;
+}
+
+bool Emulator::LoadRoms(Romset romset, const AllRomsetInfo& all_info, RomLocationSet* loaded)
+{
+    return LoadRoms(EMU_CreateRomImage(romset, all_info, loaded));
+}
+
+bool Emulator::LoadRoms(std::shared_ptr<const EMU_RomImage> image)
+{
+    if (!image)
+    {
+        return false;
+    }
+
+    m_roms = std::move(image);
+
+    MCU_SetRomset(GetMCU(), m_roms->romset);
+
+    auto map = [this](RomLocation location) -> const uint8_t* {
+        const std::vector<uint8_t>& data = m_roms->data[(size_t)location];
+        return data.empty() ? ROM_EMPTY : data.data();
+    };
+
+    m_mcu->rom1         = map(RomLocation::ROM1);
+    m_mcu->rom2         = map(RomLocation::ROM2);
+    m_mcu->rom2_mask    = m_roms->rom2_mask;
+    m_sm->rom           = map(RomLocation::SMROM);
+    m_pcm->waverom1     = map(RomLocation::WAVEROM1);
+    m_pcm->waverom2     = map(RomLocation::WAVEROM2);
+    m_pcm->waverom3     = map(RomLocation::WAVEROM3);
+    m_pcm->waverom_card = map(RomLocation::WAVEROM_CARD);
+    m_pcm->waverom_exp  = map(RomLocation::WAVEROM_EXP);
+
+    // also invalidates the decode cache, which may hold instructions from the previous roms
+    MCU_BuildPageTable(*m_mcu);
+
     if (m_mcu->is_jv880)
     {
         LoadNVRAM();
@@ -142,20 +250,32 @@ bool Emulator::LoadRoms(Romset romset, const AllRomsetInfo& all_info, RomLocatio
 
     MCU_PatchROM(*m_mcu);
 
+    if (m_lockstep && !m_lockstep->LoadRoms(m_roms))
+    {
+        return false;
+    }
+
     return true;
 }
 
-void Emulator::PostMIDI(uint8_t byte)
+bool Emulator::PostMIDI(uint8_t byte)
 {
-    MCU_PostUART(*m_mcu, byte);
+    return PostMIDI(std::span(&byte, 1));
 }
 
-void Emulator::PostMIDI(std::span<const uint8_t> data)
+bool Emulator::PostMIDI(std::span<const uint8_t> data)
 {
-    for (uint8_t byte : data)
+    if (m_lockstep)
     {
-        PostMIDI(byte);
+        m_lockstep->PostMIDI(data);
     }
+
+    return MCU_PostUART(*m_mcu, data);
+}
+
+uint64_t Emulator::GetDroppedMIDIBytes() const
+{
+    return m_mcu->uart_dropped_bytes.load(std::memory_order_relaxed);
 }
 
 constexpr uint8_t GM_RESET_SEQ[] = { 0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7 };
@@ -179,82 +299,365 @@ void Emulator::PostSystemReset(EMU_SystemReset reset)
 
 void Emulator::Step()
 {
-    MCU_Step(*m_mcu);
+    if (m_lockstep)
+    {
+        StepLockstep(m_mcu->cycles + 1, UINT64_MAX);
+    }
+    else
+    {
+        MCU_Step(*m_mcu);
+    }
 }
 
-void Emulator::SaveNVRAM()
+uint64_t Emulator::RunFor(uint64_t cycles)
 {
-    // emulator was constructed, but never init
-    if (!m_mcu)
+    const uint64_t start = m_mcu->cycles;
+    const uint64_t end   = start + cycles;
+
+    while (m_lockstep && m_mcu->cycles < end)
     {
-        return;
+        StepLockstep(end, UINT64_MAX);
     }
 
-    if (!m_options.nvram_filename.empty() && m_mcu->is_jv880)
+    if (m_mcu->cycles < end)
     {
-        std::ofstream file(m_options.nvram_filename, std::ios::binary);
-        file.write((const char*)m_mcu->nvram, NVRAM_SIZE);
+        MCU_RunFor(*m_mcu, end - m_mcu->cycles);
     }
+
+    return m_mcu->cycles - start;
 }
 
-void Emulator::LoadNVRAM()
+uint64_t Emulator::RunUntilFrames(uint64_t frames)
 {
-    if (!m_options.nvram_filename.empty() && m_mcu->is_jv880)
+    const uint64_t start = m_mcu->frames_produced;
+    const uint64_t end   = start + frames;
+
+    while (m_lockstep && m_mcu->frames_produced < end)
     {
-        std::ifstream file(m_options.nvram_filename, std::ios::binary);
-        file.read((char*)m_mcu->nvram, NVRAM_SIZE);
+        StepLockstep(UINT64_MAX, end);
     }
+
+    if (m_mcu->frames_produced < end)
+    {
+        MCU_RunUntilFrames(*m_mcu, end - m_mcu->frames_produced);
+    }
+
+    return m_mcu->frames_produced - start;
 }
 
-std::span<uint8_t> Emulator::MapBuffer(RomLocation location)
+static bool EMU_SameRegisters(const mcu_t& a, const mcu_t& b)
 {
-    switch (location)
+    return memcmp(a.r, b.r, sizeof(a.r)) == 0 && a.pc == b.pc && a.sr == b.sr && a.cp == b.cp && a.dp == b.dp &&
+           a.ep == b.ep && a.tp == b.tp && a.br == b.br && a.sleep == b.sleep && a.cycles == b.cycles;
+}
+
+void Emulator::StepLockstep(uint64_t end_cycles, uint64_t end_frames)
+{
+    mcu_t& ref = m_lockstep->GetMCU();
+
+    // Frontends poke these directly, so keep the reference in sync.
+    m_lockstep->GetPCM().enable_oversampling = m_pcm->enable_oversampling;
+    ref.button_pressed                       = m_mcu->button_pressed.load();
+
+    const uint8_t  cp = m_mcu->cp;
+    const uint16_t pc = m_mcu->pc;
+
+    // The JIT runs whole blocks, so the reference catches up one step at a time. Other backends take a single step.
+    MCU_StepBlock(*m_mcu, end_cycles, end_frames);
+    while (ref.cycles < m_mcu->cycles)
     {
-    case RomLocation::ROM1:
-        return GetMCU().rom1;
-    case RomLocation::ROM2:
-        return GetMCU().rom2;
-    case RomLocation::WAVEROM1:
-        return GetPCM().waverom1;
-    case RomLocation::WAVEROM2:
-        return GetPCM().waverom2;
-    case RomLocation::WAVEROM3:
-        return GetPCM().waverom3;
-    case RomLocation::WAVEROM_CARD:
-        return GetPCM().waverom_card;
-    case RomLocation::WAVEROM_EXP:
-        return GetPCM().waverom_exp;
-    case RomLocation::SMROM:
-        return m_sm->rom;
+        MCU_Step(ref);
+    }
+
+    if (!EMU_SameRegisters(*m_mcu, ref))
+    {
+        Diag_Printf(Diag_Category::Error,
+                    "lockstep: MCU state diverged after the block starting at %.2x:%.4x (cycle %llu)\n",
+                    cp,
+                    pc,
+                    (unsigned long long)ref.cycles);
+        Diag_Printf(Diag_Category::Error,
+                    "lockstep:   got pc=%.2x:%.4x sr=%.4x r=%.4x %.4x %.4x %.4x %.4x %.4x %.4x %.4x\n",
+                    m_mcu->cp, m_mcu->pc, m_mcu->sr,
+                    m_mcu->r[0], m_mcu->r[1], m_mcu->r[2], m_mcu->r[3],
+                    m_mcu->r[4], m_mcu->r[5], m_mcu->r[6], m_mcu->r[7]);
+        Diag_Printf(Diag_Category::Error,
+                    "lockstep:  want pc=%.2x:%.4x sr=%.4x r=%.4x %.4x %.4x %.4x %.4x %.4x %.4x %.4x\n",
+                    ref.cp, ref.pc, ref.sr,
+                    ref.r[0], ref.r[1], ref.r[2], ref.r[3],
+                    ref.r[4], ref.r[5], ref.r[6], ref.r[7]);
+        m_lockstep.reset();
+        m_lockstep_failed = true;
     }
-    Diag_Printf(Diag_Category::Error, "MapBuffer called with invalid location %d\n", (int)location);
-    std::abort();
 }
 
-bool Emulator::LoadRom(RomLocation location, std::span<const uint8_t> source)
+// Bump this whenever the set of fields visited by EMU_VisitState changes.
+constexpr uint32_t EMU_STATE_VERSION = 2;
+constexpr char     EMU_STATE_MAGIC[8] = {'N', 'S', 'C', '5', '5', 'S', 'T', 'A'};
+
+struct EMU_StateHeader
 {
-    auto buffer = MapBuffer(location);
+    char     magic[8];
+    uint32_t version;
+    uint32_t romset;
+};
 
-    if (buffer.size() < source.size())
+class EMU_StateWriter
+{
+public:
+    explicit EMU_StateWriter(std::vector<uint8_t>& out)
+        : m_out(out)
+    {
+    }
+
+    template <typename T>
+    void Field(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const size_t offset = m_out.size();
+        m_out.resize(offset + sizeof(T));
+        memcpy(m_out.data() + offset, &value, sizeof(T));
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+};
+
+// Counts the number of bytes a state will occupy so that it can be validated before anything is overwritten.
+class EMU_StateSizer
+{
+public:
+    template <typename T>
+    void Field(const T&)
+    {
+        m_size += sizeof(T);
+    }
+
+    size_t GetSize() const
+    {
+        return m_size;
+    }
+
+private:
+    size_t m_size = 0;
+};
+
+// Precondition: the input contains exactly as many bytes as EMU_StateSizer reports.
+class EMU_StateReader
+{
+public:
+    explicit EMU_StateReader(std::span<const uint8_t> in)
+        : m_in(in)
+    {
+    }
+
+    template <typename T>
+    void Field(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        memcpy(&value, m_in.data(), sizeof(T));
+        m_in = m_in.subspan(sizeof(T));
+    }
+
+private:
+    std::span<const uint8_t> m_in;
+};
+
+// Visits every piece of emulator state that is not derived from the loaded roms or from frontend configuration. Roms,
+// romset flags, the selected core, inter-component pointers and callbacks are intentionally skipped.
+template <typename Visitor>
+void EMU_VisitState(Visitor& v, mcu_t& mcu, submcu_t& sm, mcu_timer_t& timer, pcm_t& pcm, lcd_t& lcd)
+{
+    v.Field(mcu.r);
+    v.Field(mcu.pc);
+    v.Field(mcu.sr);
+    v.Field(mcu.cp);
+    v.Field(mcu.dp);
+    v.Field(mcu.ep);
+    v.Field(mcu.tp);
+    v.Field(mcu.br);
+    v.Field(mcu.sleep);
+    v.Field(mcu.ex_ignore);
+    v.Field(mcu.exception_pending);
+    v.Field(mcu.interrupt_pending);
+    v.Field(mcu.trapa_pending);
+    v.Field(mcu.cycles);
+    v.Field(mcu.ram);
+    v.Field(mcu.sram);
+    v.Field(mcu.nvram);
+    v.Field(mcu.cardram);
+    v.Field(mcu.dev_register);
+    v.Field(mcu.ad_val);
+    v.Field(mcu.ad_nibble);
+    v.Field(mcu.sw_pos);
+    v.Field(mcu.io_sd);
+    uint32_t uart_write_ptr = mcu.uart_write_ptr;
+    uint32_t uart_read_ptr  = mcu.uart_read_ptr;
+    v.Field(uart_write_ptr);
+    v.Field(uart_read_ptr);
+    mcu.uart_write_ptr = uart_write_ptr;
+    mcu.uart_read_ptr  = uart_read_ptr;
+    v.Field(mcu.uart_buffer);
+    v.Field(mcu.uart_rx_byte);
+    v.Field(mcu.uart_rx_delay);
+    v.Field(mcu.uart_tx_delay);
+    v.Field(mcu.ga_int);
+    v.Field(mcu.ga_int_enable);
+    v.Field(mcu.ga_int_trigger);
+    v.Field(mcu.ga_lcd_counter);
+    v.Field(mcu.p0_data);
+    v.Field(mcu.p1_data);
+    v.Field(mcu.adf_rd);
+    v.Field(mcu.analog_end_time);
+    v.Field(mcu.ssr_rd);
+    v.Field(mcu.operand_type);
+    v.Field(mcu.operand_ea);
+    v.Field(mcu.operand_ep);
+    v.Field(mcu.operand_size);
+    v.Field(mcu.operand_reg);
+    v.Field(mcu.operand_status);
+    v.Field(mcu.operand_data);
+    v.Field(mcu.opcode_extended);
+
+    v.Field(sm.pc);
+    v.Field(sm.a);
+    v.Field(sm.x);
+    v.Field(sm.y);
+    v.Field(sm.s);
+    v.Field(sm.sr);
+    v.Field(sm.cycles);
+    v.Field(sm.sleep);
+    v.Field(sm.ram);
+    v.Field(sm.shared_ram);
+    v.Field(sm.access);
+    v.Field(sm.p0_dir);
+    v.Field(sm.p1_dir);
+    v.Field(sm.device_mode);
+    v.Field(sm.cts);
+    v.Field(sm.timer_cycles);
+    v.Field(sm.timer_prescaler);
+    v.Field(sm.timer_counter);
+    v.Field(sm.uart_rx_gotbyte);
+
+    v.Field(timer.cycles);
+    v.Field(timer.frt);
+    v.Field(timer.tmr);
+    v.Field(timer.tempreg);
+
+    v.Field(pcm.ram1);
+    v.Field(pcm.ram2);
+    v.Field(pcm.cycles);
+    v.Field(pcm.voice_mask);
+    v.Field(pcm.voice_mask_pending);
+    v.Field(pcm.write_latch);
+    v.Field(pcm.read_latch);
+    v.Field(pcm.wave_read_address);
+    v.Field(pcm.tv_counter);
+    v.Field(pcm.wave_byte_latch);
+    v.Field(pcm.select_channel);
+    v.Field(pcm.config_reg_3c);
+    v.Field(pcm.config_reg_3d);
+    v.Field(pcm.irq_channel);
+    v.Field(pcm.irq_assert);
+    v.Field(pcm.voice_mask_updating);
+    v.Field(pcm.nfs);
+    v.Field(pcm.accum_l);
+    v.Field(pcm.accum_r);
+    v.Field(pcm.rcsum);
+    v.Field(pcm.config);
+    v.Field(pcm.eram);
+
+    v.Field(lcd.LCD_DL);
+    v.Field(lcd.LCD_N);
+    v.Field(lcd.LCD_F);
+    v.Field(lcd.LCD_D);
+    v.Field(lcd.LCD_C);
+    v.Field(lcd.LCD_B);
+    v.Field(lcd.LCD_ID);
+    v.Field(lcd.LCD_S);
+    v.Field(lcd.LCD_DD_RAM);
+    v.Field(lcd.LCD_AC);
+    v.Field(lcd.LCD_CG_RAM);
+    v.Field(lcd.LCD_RAM_MODE);
+    v.Field(lcd.LCD_Data);
+    v.Field(lcd.LCD_CG);
+    bool lcd_enable = lcd.enable;
+    v.Field(lcd_enable);
+    lcd.enable = lcd_enable;
+}
+
+void Emulator::SaveState(std::vector<uint8_t>& out)
+{
+    EMU_StateSizer sizer;
+    sizer.Field(EMU_StateHeader{});
+    EMU_VisitState(sizer, *m_mcu, *m_sm, *m_timer, *m_pcm, *m_lcd);
+
+    out.clear();
+    out.reserve(sizer.GetSize());
+
+    EMU_StateHeader header{};
+    memcpy(header.magic, EMU_STATE_MAGIC, sizeof(header.magic));
+    header.version = EMU_STATE_VERSION;
+    header.romset  = (uint32_t)m_mcu->romset;
+
+    EMU_StateWriter writer(out);
+    writer.Field(header);
+    EMU_VisitState(writer, *m_mcu, *m_sm, *m_timer, *m_pcm, *m_lcd);
+}
+
+bool Emulator::LoadState(std::span<const uint8_t> state)
+{
+    EMU_StateSizer sizer;
+    sizer.Field(EMU_StateHeader{});
+    EMU_VisitState(sizer, *m_mcu, *m_sm, *m_timer, *m_pcm, *m_lcd);
+
+    if (state.size() != sizer.GetSize())
     {
-        Diag_Printf(Diag_Category::Error,
-                    "rom for %s is too large; max size is %d bytes\n",
-                    ToCString(location),
-                    (int)buffer.size());
         return false;
     }
 
-    if (location == RomLocation::ROM2)
+    EMU_StateHeader header;
+    EMU_StateReader reader(state);
+    reader.Field(header);
+
+    if (memcmp(header.magic, EMU_STATE_MAGIC, sizeof(header.magic)) != 0 || header.version != EMU_STATE_VERSION ||
+        header.romset != (uint32_t)m_mcu->romset)
     {
-        if (!std::has_single_bit(source.size()))
-        {
-            Diag_Printf(Diag_Category::Error, "%s requires a power-of-2 size\n", ToCString(location));
-            return false;
-        }
-        GetMCU().rom2_mask = (uint32_t)source.size() - 1;
+        return false;
     }
 
-    std::copy(source.begin(), source.end(), buffer.begin());
+    EMU_VisitState(reader, *m_mcu, *m_sm, *m_timer, *m_pcm, *m_lcd);
+    MCU_Interrupt_UpdateArbitration(*m_mcu);
+    TIMER_InvalidateSchedule(*m_timer);
+
+    if (m_lockstep)
+    {
+        m_lockstep->LoadState(state);
+    }
 
     return true;
 }
+
+void Emulator::SaveNVRAM()
+{
+    // emulator was constructed, but never init
+    if (!m_mcu)
+    {
+        return;
+    }
+
+    if (!m_options.nvram_filename.empty() && m_mcu->is_jv880)
+    {
+        std::ofstream file(m_options.nvram_filename, std::ios::binary);
+        file.write((const char*)m_mcu->nvram, NVRAM_SIZE);
+    }
+}
+
+void Emulator::LoadNVRAM()
+{
+    if (!m_options.nvram_filename.empty() && m_mcu->is_jv880)
+    {
+        std::ifstream file(m_options.nvram_filename, std::ios::binary);
+        file.read((char*)m_mcu->nvram, NVRAM_SIZE);
+    }
+}
@@ -43,6 +43,7 @@
 #include <filesystem>
 #include <memory>
 #include <span>
+#include <vector>
 
 struct EMU_Options
 {
@@ -52,8 +53,43 @@ struct EMU_Options
 
     // If not empty, nvram will be saved to and loaded from here. JV-880 only.
     std::filesystem::path nvram_filename;
+
+    // Selects how the MCU executes instructions.
+    MCU_Backend mcu_backend = MCU_Backend::Cached;
+
+    // If true, a second emulator using `MCU_Backend::Interpreter` is run alongside this one and MCU registers are
+    // compared after every instruction, or after every compiled block with `MCU_Backend::Jit`. The first mismatch is
+    // reported and stops the comparison. This is very slow and only meant for verifying `mcu_backend`.
+    bool mcu_lockstep = false;
+
+    // Selects how the PCM chip processes voices. Both engines produce identical output.
+    PCM_Engine pcm_engine = PCM_Engine::Vector;
+};
+
+// Rom contents for one romset, each padded to the size of its location. Emulators only read from an image, so one can
+// be shared by any number of them instead of each holding a copy.
+struct EMU_RomImage
+{
+    Romset romset = Romset::MK2;
+
+    // Indexed by RomLocation. Empty for locations without a rom.
+    std::vector<uint8_t> data[ROMLOCATION_COUNT];
+
+    uint32_t rom2_mask = ROM2_SIZE - 1;
 };
 
+// Copies the roms for `romset` out of `all_info` into a new image. Any location with a non-empty `rom_data` is copied,
+// even if the romset doesn't require it. Returns null if a rom doesn't fit its location.
+//
+// Emulators map the image with `Emulator::LoadRoms` instead of copying it, so any number of them can share one image.
+// The image doesn't refer back to `all_info`, which can be purged once this returns.
+//
+// For roms that were copied, this function will set their corresponding index in `loaded` to true if `loaded` is
+// non-null.
+std::shared_ptr<const EMU_RomImage> EMU_CreateRomImage(Romset               romset,
+                                                       const AllRomsetInfo& all_info,
+                                                       RomLocationSet*      loaded = nullptr);
+
 enum class EMU_SystemReset {
     NONE,
     GS_RESET,
@@ -82,13 +118,19 @@ public:
 
     void StopLCD();
 
-    void SetSampleCallback(mcu_sample_callback callback, void* userdata);
+    // The emulator writes raw output frames into `buffer` and passes it to `callback` each time it fills up, after
+    // which writing starts over from the beginning. `buffer` must outlive the emulator or be replaced by another call.
+    // If `buffer` is empty, frames are written to a small internal buffer instead.
+    void SetSampleSink(std::span<AudioFrame<int32_t>> buffer, mcu_sample_callback callback, void* userdata);
+
+    // Passes any frames that haven't been seen by the sample callback yet, even if the buffer isn't full.
+    void FlushSamples();
 
     // Loads roms from buffers referenced by `all_info`. If the slot for a rom in `all_info` has a non-empty `rom_data`,
     // it will be loaded even if the romset doesn't require it.
     //
-    // It is unspecified whether or not the emulator will copy `rom_data`. `all_info` should outlive the emulator
-    // instance.
+    // This creates a rom image used only by this emulator. When creating several emulators with the same roms, call
+    // `EMU_CreateRomImage` once and pass the image to each of them instead.
     //
     // For roms that were successfully loaded, this function will set their corresponding index in `loaded` to true if
     // `loaded` is non-null.
@@ -97,13 +139,42 @@ public:
     // `IsCompleteRomset(all_info, romset)`.
     bool LoadRoms(Romset romset, const AllRomsetInfo& all_info, RomLocationSet* loaded = nullptr);
 
-    void PostMIDI(uint8_t data_byte);
-    void PostMIDI(std::span<const uint8_t> data);
+    // Maps the roms in `image` without copying them. The emulator keeps a reference to `image`.
+    bool LoadRoms(std::shared_ptr<const EMU_RomImage> image);
+
+    // Queues MIDI input for the emulated UART. `data` is queued as a whole or not at all, so a complete message should
+    // be posted in one call. Returns false if the queue was full and the data was dropped. These may be called from
+    // one thread other than the one running the emulator.
+    bool PostMIDI(uint8_t data_byte);
+    bool PostMIDI(std::span<const uint8_t> data);
+
+    // Returns the number of MIDI bytes dropped by PostMIDI because the queue was full.
+    uint64_t GetDroppedMIDIBytes() const;
 
     void PostSystemReset(EMU_SystemReset reset);
 
     void Step();
 
+    // Runs the emulator for at least `cycles` MCU cycles. This is equivalent to calling `Step` in a loop but avoids
+    // per-step call overhead. Returns the number of cycles actually run, a multiple of `MCU_CYCLES_PER_STEP`.
+    uint64_t RunFor(uint64_t cycles);
+
+    // Runs the emulator until at least `frames` frames have been passed to the sample callback. Returns the number of
+    // frames actually produced.
+    uint64_t RunUntilFrames(uint64_t frames);
+
+    // Serializes the emulator state into `out`, replacing its contents. Roms are not included, so a state can only be
+    // restored into an emulator with the same romset loaded. The format is native-endian and versioned; it is meant
+    // for caching, not for long-term storage or exchange between machines.
+    void SaveState(std::vector<uint8_t>& out);
+
+    // Restores a state produced by `SaveState`. Returns false if `state` is malformed, was written by a different
+    // version, or was saved with a different romset. The emulator is left untouched on failure.
+    bool LoadState(std::span<const uint8_t> state);
+
+    // Returns true if `mcu_lockstep` was enabled and the two emulators diverged.
+    bool LockstepFailed() const { return m_lockstep_failed; }
+
     mcu_t& GetMCU() { return *m_mcu; }
     pcm_t& GetPCM() { return *m_pcm; }
     lcd_t& GetLCD() { return *m_lcd; }
@@ -112,9 +183,7 @@ private:
     void SaveNVRAM();
     void LoadNVRAM();
 
-    std::span<uint8_t> MapBuffer(RomLocation location);
-
-    bool LoadRom(RomLocation location, std::span<const uint8_t> source);
+    void StepLockstep(uint64_t end_cycles, uint64_t end_frames);
 
 private:
     std::unique_ptr<mcu_t>       m_mcu;
@@ -123,5 +192,11 @@ private:
     std::unique_ptr<lcd_t>       m_lcd;
     std::unique_ptr<pcm_t>       m_pcm;
     EMU_Options                  m_options;
+
+    std::shared_ptr<const EMU_RomImage> m_roms;
+
+    // Reference emulator for `mcu_lockstep`, null when disabled or after a mismatch.
+    std::unique_ptr<Emulator> m_lockstep;
+    bool                      m_lockstep_failed = false;
 };
 
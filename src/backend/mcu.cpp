@@ -40,6 +40,10 @@
 #include "pcm.h"
 #include "submcu.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
 void MCU_ErrorTrap(mcu_t& mcu)
 {
     Diag_Printf(Diag_Category::Debug, "%.2x %.4x\n", mcu.cp, mcu.pc);
@@ -194,7 +198,9 @@ void MCU_DeviceWrite(mcu_t& mcu, uint32_t address, uint8_t data)
     case DEV_RAMCR:
         break;
     case DEV_P1CR: // P1CR
-        break;
+        mcu.dev_register[address] = data;
+        MCU_Interrupt_UpdateArbitration(mcu);
+        return;
     case DEV_DTEA:
         break;
     case DEV_DTEB:
@@ -208,13 +214,12 @@ void MCU_DeviceWrite(mcu_t& mcu, uint32_t address, uint8_t data)
     case DEV_BRR:
         break;
     case DEV_IPRA:
-        break;
     case DEV_IPRB:
-        break;
     case DEV_IPRC:
-        break;
     case DEV_IPRD:
-        break;
+        mcu.dev_register[address] = data;
+        MCU_Interrupt_UpdateArbitration(mcu);
+        return;
     case DEV_PWM1_DTR:
         break;
     case DEV_PWM1_TCR:
@@ -418,6 +423,8 @@ void MCU_DeviceReset(mcu_t& mcu)
     mcu.dev_register[DEV_WCR] = 0xF3;
 
     mcu.dev_register[DEV_RAMCR] = 0x80;
+
+    MCU_Interrupt_UpdateArbitration(mcu);
 }
 
 void MCU_UpdateAnalog(mcu_t& mcu, uint64_t cycles)
@@ -453,186 +460,367 @@ void MCU_UpdateAnalog(mcu_t& mcu, uint64_t cycles)
         mcu.analog_end_time = 0;
 }
 
-uint8_t MCU_Read(mcu_t& mcu, uint32_t address)
+// Reads and writes in the 0x8000-0xffff window of page 0 are dispatched through a table of 1 KiB sub-page handlers.
+typedef uint8_t(*MCU_IOReadHandler)(mcu_t& mcu, uint16_t address);
+typedef void(*MCU_IOWriteHandler)(mcu_t& mcu, uint16_t address, uint8_t value);
+
+using MCU_IOReadTable  = std::array<MCU_IOReadHandler, 32>;
+using MCU_IOWriteTable = std::array<MCU_IOWriteHandler, 32>;
+
+constexpr size_t MCU_IOSubPage(uint16_t address)
+{
+    return (address >> 10) & 0x1f;
+}
+
+// Gate array registers live right after the PCM registers.
+template <typename Traits>
+constexpr uint16_t MCU_GA_BASE = Traits::is_jv880 ? 0xf000 : 0xe000;
+
+uint8_t MCU_IOReadUnknown(mcu_t& mcu, uint16_t address)
+{
+    (void)mcu;
+    Diag_Printf(Diag_Category::Debug, "Unknown read %x\n", address);
+    return 0xff;
+}
+
+void MCU_IOWriteUnknown(mcu_t& mcu, uint16_t address, uint8_t value)
+{
+    (void)mcu;
+    Diag_Printf(Diag_Category::Debug, "Unknown write %x %x\n", address, value);
+}
+
+uint8_t MCU_IOReadSRAM(mcu_t& mcu, uint16_t address)
+{
+    return mcu.sram[address & 0x7fff];
+}
+
+void MCU_IOWriteSRAM(mcu_t& mcu, uint16_t address, uint8_t value)
 {
-    uint32_t address_rom = address & 0x3ffff;
-    if (address & 0x80000 && !mcu.is_jv880)
-        address_rom |= 0x40000;
-    uint8_t page = (address >> 16) & 0xf;
-    address &= 0xffff;
-    uint8_t ret = 0xff;
-    switch (page)
+    mcu.sram[address & 0x7fff] = value;
+}
+
+template <typename Traits>
+uint8_t MCU_IOReadPCM(mcu_t& mcu, uint16_t address)
+{
+    // mk1 only decodes the first 0x40 bytes
+    if (Traits::is_mk1 && (address & 0x3ff) >= 0x40)
+        return MCU_IOReadUnknown(mcu, address);
+    return PCM_Read(*mcu.pcm, address & 0x3f);
+}
+
+template <typename Traits>
+void MCU_IOWritePCM(mcu_t& mcu, uint16_t address, uint8_t value)
+{
+    if (Traits::is_mk1 && (address & 0x3ff) >= 0x40)
+        return MCU_IOWriteUnknown(mcu, address, value);
+    PCM_Write(*mcu.pcm, address & 0x3f, value);
+}
+
+uint8_t MCU_IOReadSM(mcu_t& mcu, uint16_t address)
+{
+    return SM_SysRead(*mcu.sm, address & 0xff);
+}
+
+void MCU_IOWriteSM(mcu_t& mcu, uint16_t address, uint8_t value)
+{
+    SM_SysWrite(*mcu.sm, address & 0xff, value);
+}
+
+template <typename Traits>
+uint8_t MCU_IOReadGA(mcu_t& mcu, uint16_t address)
+{
+    //
+    // e402:2-0 irq source
+    //
+    if (address == (MCU_GA_BASE<Traits> | 0x402u))
     {
-    case 0:
-        if (!(address & 0x8000))
-            ret = mcu.rom1[address & 0x7fff];
-        else
-        {
-            if (!mcu.is_mk1)
-            {
-                uint16_t base = mcu.is_jv880 ? 0xf000 : 0xe000;
-                if (address >= base && address < (base | 0x400u))
-                {
-                    ret = PCM_Read(*mcu.pcm, address & 0x3f);
-                }
-                else if (!mcu.is_scb55 && address >= 0xec00u && address < 0xf000u)
-                {
-                    ret = SM_SysRead(*mcu.sm, address & 0xff);
-                }
-                else if (address >= 0xff80)
-                {
-                    ret = MCU_DeviceRead(mcu, address & 0x7f);
-                }
-                else if (address >= 0xfb80u && address < 0xff80u
-                    && (mcu.dev_register[DEV_RAMCR] & 0x80) != 0)
-                    ret = mcu.ram[(address - 0xfb80) & 0x3ff];
-                else if (address >= 0x8000u && address < 0xe000u)
-                {
-                    ret = mcu.sram[address & 0x7fff];
-                }
-                else if (address == (base | 0x402u))
-                {
-                    ret = (uint8_t)mcu.ga_int_trigger;
-                    mcu.ga_int_trigger = 0;
-                    MCU_Interrupt_SetRequest(mcu, mcu.is_jv880 ? INTERRUPT_SOURCE_IRQ0 : INTERRUPT_SOURCE_IRQ1, 0);
-                }
-                else
-                {
-                    Diag_Printf(Diag_Category::Debug, "Unknown read %x\n", address);
-                    ret = 0xff;
-                }
-                //
-                // e402:2-0 irq source
-                //
-            }
-            else
-            {
-                if (address >= 0xe000 && address < 0xe040)
-                {
-                    ret = PCM_Read(*mcu.pcm, address & 0x3f);
-                }
-                else if (address >= 0xff80)
-                {
-                    ret = MCU_DeviceRead(mcu, address & 0x7f);
-                }
-                else if (address >= 0xfb80 && address < 0xff80
-                    && (mcu.dev_register[DEV_RAMCR] & 0x80) != 0)
-                {
-                    ret = mcu.ram[(address - 0xfb80) & 0x3ff];
-                }
-                else if (address >= 0x8000 && address < 0xe000)
-                {
-                    ret = mcu.sram[address & 0x7fff];
-                }
-                else if (address >= 0xf000 && address < 0xf100)
-                {
-                    mcu.io_sd = address & 0xff;
+        uint8_t ret = (uint8_t)mcu.ga_int_trigger;
+        mcu.ga_int_trigger = 0;
+        MCU_Interrupt_SetRequest(mcu, Traits::is_jv880 ? INTERRUPT_SOURCE_IRQ0 : INTERRUPT_SOURCE_IRQ1, 0);
+        return ret;
+    }
+    return MCU_IOReadUnknown(mcu, address);
+}
 
-                    if (mcu.is_cm300)
-                        return 0xff;
+template <typename Traits>
+void MCU_IOWriteGA(mcu_t& mcu, uint16_t address, uint8_t value)
+{
+    //
+    // e400: always 4?
+    // e401: SC0-6?
+    // e402: enable/disable IRQ?
+    // e403: always 1?
+    // e404: LCD
+    // e405: LCD
+    // e406: 0 or 40
+    // e407: 0, e406 continuation?
+    //
+    constexpr uint16_t base = MCU_GA_BASE<Traits>;
+    if (address == (base | 0x404u) || address == (base | 0x405u))
+        LCD_Write(*mcu.lcd, address & 1, value);
+    else if (address == (base | 0x401u))
+    {
+        mcu.io_sd = value;
+        LCD_Enable(*mcu.lcd, (value & 1) == 0);
+    }
+    else if (address == (base | 0x402u))
+        mcu.ga_int_enable = (uint8_t)(value << 1);
+    else
+        MCU_IOWriteUnknown(mcu, address, value);
+}
 
-                    LCD_Enable(*mcu.lcd, (mcu.io_sd & 8) != 0);
+// mk1 gate array: button matrix, LCD and irq source at 0xf000-0xf107.
+template <typename Traits>
+uint8_t MCU_IOReadGA_MK1(mcu_t& mcu, uint16_t address)
+{
+    //
+    // f106:2-0 irq source
+    //
+    if (address < 0xf100)
+    {
+        mcu.io_sd = (uint8_t)(address & 0xff);
 
-                    uint8_t data = 0xff;
-                    uint32_t button_pressed = mcu.button_pressed;
+        if (Traits::is_cm300)
+            return 0xff;
 
-                    if ((mcu.io_sd & 1) == 0)
-                        data &= ((button_pressed >> 0) & 255) ^ 255;
-                    if ((mcu.io_sd & 2) == 0)
-                        data &= ((button_pressed >> 8) & 255) ^ 255;
-                    if ((mcu.io_sd & 4) == 0)
-                        data &= ((button_pressed >> 16) & 255) ^ 255;
-                    if ((mcu.io_sd & 8) == 0)
-                        data &= (uint8_t)(((button_pressed >> 24) & 255) ^ 255);
-                    return data;
-                }
-                else if (address == 0xf106)
-                {
-                    ret = (uint8_t)mcu.ga_int_trigger;
-                    mcu.ga_int_trigger = 0;
-                    MCU_Interrupt_SetRequest(mcu, INTERRUPT_SOURCE_IRQ1, 0);
-                }
-                else
-                {
-                    Diag_Printf(Diag_Category::Debug, "Unknown read %x\n", address);
-                    ret = 0xff;
-                }
-                //
-                // f106:2-0 irq source
-                //
-            }
-        }
-        break;
-#if 0
-    case 3:
-        ret = rom2[address | 0x30000];
-        break;
-    case 4:
-        ret = rom2[address];
-        break;
-    case 10:
-        ret = rom2[address | 0x60000]; // FIXME
-        break;
-    case 1:
-        ret = rom2[address | 0x10000];
-        break;
-#endif
-    case 1:
-        ret = mcu.rom2[address_rom & mcu.rom2_mask];
-        break;
-    case 2:
-        ret = mcu.rom2[address_rom & mcu.rom2_mask];
-        break;
-    case 3:
-        ret = mcu.rom2[address_rom & mcu.rom2_mask];
-        break;
-    case 4:
-        ret = mcu.rom2[address_rom & mcu.rom2_mask];
-        break;
-    case 8:
-        if (!mcu.is_jv880)
-            ret = mcu.rom2[address_rom & mcu.rom2_mask];
-        else
-            ret = 0xff;
-        break;
-    case 9:
-        if (!mcu.is_jv880)
-            ret = mcu.rom2[address_rom & mcu.rom2_mask];
-        else
-            ret = 0xff;
-        break;
-    case 14:
-    case 15:
-        if (!mcu.is_jv880)
-            ret = mcu.rom2[address_rom & mcu.rom2_mask];
-        else
-            ret = mcu.cardram[address & 0x7fff]; // FIXME
-        break;
-    case 10:
-    case 11:
-        if (!mcu.is_mk1)
-            ret = mcu.sram[address & 0x7fff]; // FIXME
-        else
-            ret = 0xff;
-        break;
-    case 12:
-    case 13:
-        if (mcu.is_jv880)
-            ret = mcu.nvram[address & 0x7fff]; // FIXME
-        else
-            ret = 0xff;
-        break;
-    case 5:
-        if (mcu.is_mk1)
-            ret = mcu.sram[address & 0x7fff]; // FIXME
-        else
-            ret = 0xff;
-        break;
-    default:
-        ret = 0x00;
-        break;
+        LCD_Enable(*mcu.lcd, (mcu.io_sd & 8) != 0);
+
+        uint8_t data = 0xff;
+        uint32_t button_pressed = mcu.button_pressed;
+
+        if ((mcu.io_sd & 1) == 0)
+            data &= ((button_pressed >> 0) & 255) ^ 255;
+        if ((mcu.io_sd & 2) == 0)
+            data &= ((button_pressed >> 8) & 255) ^ 255;
+        if ((mcu.io_sd & 4) == 0)
+            data &= ((button_pressed >> 16) & 255) ^ 255;
+        if ((mcu.io_sd & 8) == 0)
+            data &= (uint8_t)(((button_pressed >> 24) & 255) ^ 255);
+        return data;
+    }
+    else if (address == 0xf106)
+    {
+        uint8_t ret = (uint8_t)mcu.ga_int_trigger;
+        mcu.ga_int_trigger = 0;
+        MCU_Interrupt_SetRequest(mcu, INTERRUPT_SOURCE_IRQ1, 0);
+        return ret;
+    }
+    return MCU_IOReadUnknown(mcu, address);
+}
+
+void MCU_IOWriteGA_MK1(mcu_t& mcu, uint16_t address, uint8_t value)
+{
+    if (address < 0xf100)
+    {
+        mcu.io_sd = (uint8_t)(address & 0xff);
+        LCD_Enable(*mcu.lcd, (mcu.io_sd & 8) != 0);
+    }
+    else if (address == 0xf105)
+    {
+        LCD_Write(*mcu.lcd, 0, value);
+        mcu.ga_lcd_counter = 500;
+    }
+    else if (address == 0xf104)
+    {
+        LCD_Write(*mcu.lcd, 1, value);
+        mcu.ga_lcd_counter = 500;
+    }
+    else if (address == 0xf107)
+    {
+        mcu.io_sd = value;
+    }
+    else
+    {
+        MCU_IOWriteUnknown(mcu, address, value);
+    }
+}
+
+// On-chip RAM (0xfb80-0xff7f, when enabled by RAMCR) and device registers (0xff80-0xffff).
+uint8_t MCU_IOReadInternal(mcu_t& mcu, uint16_t address)
+{
+    if (address >= 0xff80)
+        return MCU_DeviceRead(mcu, address & 0x7f);
+    else if (address >= 0xfb80 && (mcu.dev_register[DEV_RAMCR] & 0x80) != 0)
+        return mcu.ram[(address - 0xfb80) & 0x3ff];
+    return MCU_IOReadUnknown(mcu, address);
+}
+
+void MCU_IOWriteInternal(mcu_t& mcu, uint16_t address, uint8_t value)
+{
+    if (address >= 0xff80)
+        MCU_DeviceWrite(mcu, address & 0x7f, value);
+    else if (address >= 0xfb80 && (mcu.dev_register[DEV_RAMCR] & 0x80) != 0)
+        mcu.ram[(address - 0xfb80) & 0x3ff] = value;
+    else
+        MCU_IOWriteUnknown(mcu, address, value);
+}
+
+template <typename Traits>
+constexpr MCU_IOReadTable MCU_BuildIOReadTable()
+{
+    MCU_IOReadTable table{};
+    table.fill(MCU_IOReadUnknown);
+    for (uint16_t address = 0x8000; address < 0xe000; address += 0x400)
+        table[MCU_IOSubPage(address)] = MCU_IOReadSRAM;
+
+    table[MCU_IOSubPage(MCU_GA_BASE<Traits>)] = MCU_IOReadPCM<Traits>;
+    if constexpr (Traits::is_mk1)
+    {
+        table[MCU_IOSubPage(0xf000)] = MCU_IOReadGA_MK1<Traits>;
+    }
+    else
+    {
+        table[MCU_IOSubPage(MCU_GA_BASE<Traits> | 0x400)] = MCU_IOReadGA<Traits>;
+        if (!Traits::is_scb55)
+            table[MCU_IOSubPage(0xec00)] = MCU_IOReadSM;
+    }
+
+    table[MCU_IOSubPage(0xf800)] = MCU_IOReadInternal;
+    table[MCU_IOSubPage(0xfc00)] = MCU_IOReadInternal;
+    return table;
+}
+
+template <typename Traits>
+constexpr MCU_IOWriteTable MCU_BuildIOWriteTable()
+{
+    MCU_IOWriteTable table{};
+    table.fill(MCU_IOWriteUnknown);
+    for (uint16_t address = 0x8000; address < 0xe000; address += 0x400)
+        table[MCU_IOSubPage(address)] = MCU_IOWriteSRAM;
+
+    table[MCU_IOSubPage(MCU_GA_BASE<Traits>)] = MCU_IOWritePCM<Traits>;
+    if constexpr (Traits::is_mk1)
+    {
+        table[MCU_IOSubPage(0xf000)] = MCU_IOWriteGA_MK1;
+    }
+    else
+    {
+        table[MCU_IOSubPage(MCU_GA_BASE<Traits> | 0x400)] = MCU_IOWriteGA<Traits>;
+        if (!Traits::is_scb55)
+            table[MCU_IOSubPage(0xec00)] = MCU_IOWriteSM;
+    }
+
+    table[MCU_IOSubPage(0xf800)] = MCU_IOWriteInternal;
+    table[MCU_IOSubPage(0xfc00)] = MCU_IOWriteInternal;
+    return table;
+}
+
+template <typename Traits>
+constexpr MCU_IOReadTable MCU_IO_READ_TABLE = MCU_BuildIOReadTable<Traits>();
+
+template <typename Traits>
+constexpr MCU_IOWriteTable MCU_IO_WRITE_TABLE = MCU_BuildIOWriteTable<Traits>();
+
+// Backing bytes for pages with nothing mapped. These pages use a mask of 0 so that reads stay a single load.
+static const uint8_t MCU_UNMAPPED_FF = 0xff;
+static const uint8_t MCU_UNMAPPED_00 = 0x00;
+
+template <typename Traits>
+void MCU_BuildPageTableImpl(mcu_t& mcu)
+{
+    for (MCU_Page& page : mcu.pages)
+    {
+        page = MCU_Page{.read = &MCU_UNMAPPED_00, .write = nullptr, .mask = 0, .is_rom = true};
+    }
+    mcu.code_page = MCU_CodePage{};
+    MCU_InvalidateDecodeCache(mcu);
+
+    auto map_rom2 = [&](uint8_t page) {
+        uint32_t offset = (uint32_t)(page << 16) & 0x3ffff;
+        if ((page & 8) && !Traits::is_jv880)
+            offset |= 0x40000;
+        mcu.pages[page] = MCU_Page{
+            .read   = &mcu.rom2[offset & mcu.rom2_mask],
+            .write  = nullptr,
+            .mask   = (uint16_t)(mcu.rom2_mask & 0xffff),
+            .is_rom = true,
+        };
+    };
+    auto map_ram = [&](uint8_t page, uint8_t* ram, bool writable) {
+        mcu.pages[page] = MCU_Page{.read = ram, .write = writable ? ram : nullptr, .mask = 0x7fff};
+    };
+    auto map_unmapped_ff = [&](uint8_t page) {
+        mcu.pages[page] = MCU_Page{.read = &MCU_UNMAPPED_FF, .write = nullptr, .mask = 0, .is_rom = true};
+    };
+
+    // 0x8000-0xffff of page 0 is handled by the I/O tables
+    mcu.pages[0] = MCU_Page{.read = mcu.rom1, .write = nullptr, .mask = 0x7fff, .is_rom = true};
+
+    for (uint8_t page = 1; page <= 4; ++page)
+        map_rom2(page);
+
+    if (Traits::is_mk1)
+        map_ram(5, mcu.sram, true); // FIXME
+    else
+        map_unmapped_ff(5);
+
+    if (Traits::is_jv880)
+    {
+        map_unmapped_ff(8);
+        map_unmapped_ff(9);
+    }
+    else
+    {
+        map_rom2(8);
+        map_rom2(9);
+    }
+
+    if (Traits::is_mk1)
+    {
+        map_unmapped_ff(10);
+        map_unmapped_ff(11);
+    }
+    else
+    {
+        map_ram(10, mcu.sram, true); // FIXME
+        map_ram(11, mcu.sram, false);
+    }
+
+    if (Traits::is_jv880)
+    {
+        map_ram(12, mcu.nvram, true); // FIXME
+        map_ram(13, mcu.nvram, false);
+        map_ram(14, mcu.cardram, true); // FIXME
+        map_ram(15, mcu.cardram, false);
+    }
+    else
+    {
+        map_unmapped_ff(12);
+        map_unmapped_ff(13);
+        map_rom2(14);
+        map_rom2(15);
+    }
+}
+
+template <typename Traits>
+uint8_t MCU_ReadImpl(mcu_t& mcu, uint32_t address)
+{
+    const uint8_t  page   = (address >> 16) & 0xf;
+    const uint16_t offset = address & 0xffff;
+    if (page == 0 && (offset & 0x8000))
+        return MCU_IO_READ_TABLE<Traits>[MCU_IOSubPage(offset)](mcu, offset);
+    const MCU_Page& desc = mcu.pages[page];
+    return desc.read[offset & desc.mask];
+}
+
+uint8_t MCU_ReadCodeSlow(mcu_t& mcu)
+{
+    if (mcu.cp != mcu.code_page.cp)
+    {
+        // Every page in the table reads without side effects, so code can be fetched from it directly. Only the I/O
+        // window in the upper half of page 0 has to go through MCU_Read.
+        const MCU_Page& desc = mcu.pages[mcu.cp & 0xf];
+        mcu.code_page = MCU_CodePage{
+            .base   = desc.read,
+            .limit  = (mcu.cp & 0xf) == 0 ? 0x8000u : 0x10000u,
+            .mask   = desc.mask,
+            .cp     = mcu.cp,
+            .is_rom = desc.is_rom,
+        };
+        if (mcu.pc < mcu.code_page.limit)
+            return mcu.code_page.base[mcu.pc & mcu.code_page.mask];
     }
-    return ret;
+    return MCU_Read(mcu, MCU_GetAddress(mcu.cp, mcu.pc));
 }
 
 uint16_t MCU_Read16(mcu_t& mcu, uint32_t address)
@@ -655,139 +843,29 @@ uint32_t MCU_Read32(mcu_t& mcu, uint32_t address)
     return (uint32_t)((b0 << 24) + (b1 << 16) + (b2 << 8) + b3);
 }
 
-void MCU_Write(mcu_t& mcu, uint32_t address, uint8_t value)
+template <typename Traits>
+void MCU_WriteImpl(mcu_t& mcu, uint32_t address, uint8_t value)
 {
-    uint8_t page = (address >> 16) & 0xf;
-    address &= 0xffff;
-    if (page == 0)
+    const uint8_t  page   = (address >> 16) & 0xf;
+    const uint16_t offset = address & 0xffff;
+    if (page == 0 && (offset & 0x8000))
     {
-        if (address & 0x8000)
-        {
-            if (!mcu.is_mk1)
-            {
-                uint16_t base = mcu.is_jv880 ? 0xf000u : 0xe000u;
-                if (address >= (base | 0x400u) && address < (base | 0x800u))
-                {
-                    if (address == (base | 0x404u) || address == (base | 0x405u))
-                        LCD_Write(*mcu.lcd, address & 1, value);
-                    else if (address == (base | 0x401u))
-                    {
-                        mcu.io_sd = value;
-                        LCD_Enable(*mcu.lcd, (value & 1) == 0);
-                    }
-                    else if (address == (base | 0x402u))
-                        mcu.ga_int_enable = (uint8_t)(value << 1);
-                    else
-                        Diag_Printf(Diag_Category::Debug, "Unknown write %x %x\n", address, value);
-                    //
-                    // e400: always 4?
-                    // e401: SC0-6?
-                    // e402: enable/disable IRQ?
-                    // e403: always 1?
-                    // e404: LCD
-                    // e405: LCD
-                    // e406: 0 or 40
-                    // e407: 0, e406 continuation?
-                    //
-                }
-                else if (address >= (base | 0x000u) && address < (base | 0x400u))
-                {
-                    PCM_Write(*mcu.pcm, address & 0x3f, value);
-                }
-                else if (!mcu.is_scb55 && address >= 0xec00 && address < 0xf000)
-                {
-                    SM_SysWrite(*mcu.sm, address & 0xff, value);
-                }
-                else if (address >= 0xff80)
-                {
-                    MCU_DeviceWrite(mcu, address & 0x7f, value);
-                }
-                else if (address >= 0xfb80 && address < 0xff80
-                    && (mcu.dev_register[DEV_RAMCR] & 0x80) != 0)
-                {
-                    mcu.ram[(address - 0xfb80) & 0x3ff] = value;
-                }
-                else if (address >= 0x8000 && address < 0xe000)
-                {
-                    mcu.sram[address & 0x7fff] = value;
-                }
-                else
-                {
-                    Diag_Printf(Diag_Category::Debug, "Unknown write %x %x\n", address, value);
-                }
-            }
-            else
-            {
-                if (address >= 0xe000 && address < 0xe040)
-                {
-                    PCM_Write(*mcu.pcm, address & 0x3f, value);
-                }
-                else if (address >= 0xff80)
-                {
-                    MCU_DeviceWrite(mcu, address & 0x7f, value);
-                }
-                else if (address >= 0xfb80 && address < 0xff80
-                    && (mcu.dev_register[DEV_RAMCR] & 0x80) != 0)
-                {
-                    mcu.ram[(address - 0xfb80) & 0x3ff] = value;
-                }
-                else if (address >= 0x8000 && address < 0xe000)
-                {
-                    mcu.sram[address & 0x7fff] = value;
-                }
-                else if (address >= 0xf000 && address < 0xf100)
-                {
-                    mcu.io_sd = address & 0xff;
-                    LCD_Enable(*mcu.lcd, (mcu.io_sd & 8) != 0);
-                }
-                else if (address == 0xf105)
-                {
-                    LCD_Write(*mcu.lcd, 0, value);
-                    mcu.ga_lcd_counter = 500;
-                }
-                else if (address == 0xf104)
-                {
-                    LCD_Write(*mcu.lcd, 1, value);
-                    mcu.ga_lcd_counter = 500;
-                }
-                else if (address == 0xf107)
-                {
-                    mcu.io_sd = value;
-                }
-                else
-                {
-                    Diag_Printf(Diag_Category::Debug, "Unknown write %x %x\n", address, value);
-                }
-            }
-        }
-        else if (mcu.is_jv880 && address >= 0x6196 && address <= 0x6199)
-        {
-            // nop: the jv880 rom writes into the rom at 002E77-002E7D
-        }
-        else
-        {
-            Diag_Printf(Diag_Category::Debug, "Unknown write %x %x\n", address, value);
-        }
-    }
-    else if (page == 5 && mcu.is_mk1)
-    {
-        mcu.sram[address & 0x7fff] = value; // FIXME
-    }
-    else if (page == 10 && !mcu.is_mk1)
-    {
-        mcu.sram[address & 0x7fff] = value; // FIXME
+        MCU_IO_WRITE_TABLE<Traits>[MCU_IOSubPage(offset)](mcu, offset, value);
+        return;
     }
-    else if (page == 12 && mcu.is_jv880)
+
+    const MCU_Page& desc = mcu.pages[page];
+    if (desc.write)
     {
-        mcu.nvram[address & 0x7fff] = value; // FIXME
+        desc.write[offset & desc.mask] = value;
     }
-    else if (page == 14 && mcu.is_jv880)
+    else if (Traits::is_jv880 && page == 0 && offset >= 0x6196 && offset <= 0x6199)
     {
-        mcu.cardram[address & 0x7fff] = value; // FIXME
+        // nop: the jv880 rom writes into the rom at 002E77-002E7D
     }
     else
     {
-        Diag_Printf(Diag_Category::Debug, "Unknown write %x %x\n", (uint32_t)(page << 16) | address, value);
+        Diag_Printf(Diag_Category::Debug, "Unknown write %x %x\n", address & 0xfffff, value);
     }
 }
 
@@ -798,11 +876,63 @@ void MCU_Write16(mcu_t& mcu, uint32_t address, uint16_t value)
     MCU_Write(mcu, address + 1, (uint8_t)(value & 0xff));
 }
 
+void MCU_InvalidateDecodeCache(mcu_t& mcu)
+{
+    for (MCU_DecodedInstruction& insn : mcu.decode_cache)
+    {
+        insn.tag = UINT32_MAX;
+    }
+    if (mcu.jit)
+    {
+        MCU_JitFlush(*mcu.jit);
+    }
+}
+
+static inline uint32_t MCU_DecodeCacheIndex(uint8_t cp, uint16_t pc)
+{
+    return (pc ^ ((uint32_t)cp << 9)) & (MCU_DECODE_CACHE_SIZE - 1);
+}
+
 void MCU_ReadInstruction(mcu_t& mcu)
 {
-    uint8_t operand = MCU_ReadCodeAdvance(mcu);
+    const uint32_t tag = MCU_GetAddress(mcu.cp, mcu.pc);
+    MCU_DecodedInstruction& cached = mcu.decode_cache[MCU_DecodeCacheIndex(mcu.cp, mcu.pc)];
 
-    MCU_Operand_Table[operand](mcu, operand);
+    if (mcu.backend == MCU_Backend::Interpreter)
+    {
+        uint8_t operand = MCU_ReadCodeAdvance(mcu);
+        MCU_Operand_Table[operand](mcu, operand);
+    }
+    else if (cached.tag == tag)
+    {
+        mcu.pc = (uint16_t)(mcu.pc + cached.length);
+        MCU_Operand_ExecuteGeneral(mcu, cached);
+    }
+    else
+    {
+        const uint16_t start = mcu.pc;
+        uint8_t operand = MCU_ReadCodeAdvance(mcu);
+
+        if (MCU_Operand_Table[operand] == MCU_Operand_General)
+        {
+            MCU_DecodedInstruction insn;
+            MCU_Operand_DecodeGeneral(mcu, operand, insn);
+            insn.length = (uint8_t)(mcu.pc - start);
+
+            // The fetches above refreshed code_page for the current cp.
+            if (mcu.code_page.is_rom && (uint32_t)start + insn.length <= mcu.code_page.limit)
+            {
+                insn.tag = tag;
+                cached   = insn;
+            }
+
+            MCU_Operand_ExecuteGeneral(mcu, insn);
+        }
+        else
+        {
+            MCU_Operand_Table[operand](mcu, operand);
+        }
+    }
 
     if (mcu.sr & STATUS_T)
     {
@@ -810,18 +940,22 @@ void MCU_ReadInstruction(mcu_t& mcu)
     }
 }
 
-void MCU_DefaultSampleCallback(void* userdata, const AudioFrame<int32_t>& frame)
+void MCU_DefaultSampleCallback(void* userdata, std::span<const AudioFrame<int32_t>> frames)
 {
     (void)userdata;
-    (void)frame;
+    (void)frames;
 }
 
+static void MCU_SelectCore(mcu_t& mcu);
+
 void MCU_Init(mcu_t& mcu, submcu_t& sm, pcm_t& pcm, mcu_timer_t& timer, lcd_t& lcd)
 {
     mcu.sm = &sm;
     mcu.pcm = &pcm;
     mcu.timer = &timer;
     mcu.lcd = &lcd;
+    MCU_SetSampleSink(mcu, {}, MCU_DefaultSampleCallback, nullptr);
+    MCU_SelectCore(mcu);
 }
 
 void MCU_Deinit(mcu_t& mcu)
@@ -864,17 +998,37 @@ void MCU_Reset(mcu_t& mcu)
     }
 }
 
-void MCU_PostUART(mcu_t& mcu, uint8_t data)
+bool MCU_PostUART(mcu_t& mcu, std::span<const uint8_t> data)
 {
-    mcu.uart_buffer[mcu.uart_write_ptr] = data;
-    mcu.uart_write_ptr = (mcu.uart_write_ptr + 1) % uart_buffer_size;
+    static_assert((uart_buffer_size & (uart_buffer_size - 1)) == 0);
+
+    const uint32_t write_ptr = mcu.uart_write_ptr.load(std::memory_order_relaxed);
+    const uint32_t read_ptr  = mcu.uart_read_ptr.load(std::memory_order_acquire);
+    if (data.size() > uart_buffer_size - (write_ptr - read_ptr))
+    {
+        mcu.uart_dropped_bytes.fetch_add(data.size(), std::memory_order_relaxed);
+        return false;
+    }
+
+    // copy in up to two parts around the end of the buffer, then publish everything at once
+    const uint32_t offset = write_ptr & (uart_buffer_size - 1);
+    const size_t   first  = std::min<size_t>(data.size(), uart_buffer_size - offset);
+    memcpy(mcu.uart_buffer + offset, data.data(), first);
+    memcpy(mcu.uart_buffer, data.data() + first, data.size() - first);
+    mcu.uart_write_ptr.store(write_ptr + (uint32_t)data.size(), std::memory_order_release);
+    return true;
+}
+
+bool MCU_PostUART(mcu_t& mcu, uint8_t data)
+{
+    return MCU_PostUART(mcu, std::span(&data, 1));
 }
 
 void MCU_UpdateUART_RX(mcu_t& mcu)
 {
     if ((mcu.dev_register[DEV_SCR] & 16) == 0) // RX disabled
         return;
-    if (mcu.uart_write_ptr == mcu.uart_read_ptr) // no byte
+    if (!MCU_HasUARTByte(mcu)) // no byte
         return;
 
     if (mcu.dev_register[DEV_SSR] & 0x40)
@@ -883,8 +1037,7 @@ void MCU_UpdateUART_RX(mcu_t& mcu)
     if (mcu.cycles < mcu.uart_rx_delay)
         return;
 
-    mcu.uart_rx_byte = mcu.uart_buffer[mcu.uart_read_ptr];
-    mcu.uart_read_ptr = (mcu.uart_read_ptr + 1) % uart_buffer_size;
+    mcu.uart_rx_byte = MCU_ReadUARTByte(mcu);
     mcu.dev_register[DEV_SSR] |= 0x40;
     MCU_Interrupt_SetRequest(mcu, INTERRUPT_SOURCE_UART_RX, (mcu.dev_register[DEV_SCR] & 0x40) != 0);
 }
@@ -907,26 +1060,20 @@ void MCU_UpdateUART_TX(mcu_t& mcu)
     // fprintf(stderr, "tx:%x\n", mcu.dev_register[DEV_TDR]);
 }
 
-void MCU_Step(mcu_t& mcu)
+// Everything a step does after executing its instruction.
+template <typename Traits>
+inline void MCU_StepPeripherals(mcu_t& mcu)
 {
-    if (!mcu.ex_ignore)
-        MCU_Interrupt_Handle(mcu);
-    else
-        mcu.ex_ignore = 0;
-
-    if (!mcu.sleep)
-        MCU_ReadInstruction(mcu);
-
-    mcu.cycles += 12; // FIXME: assume 12 cycles per instruction
+    mcu.cycles += MCU_CYCLES_PER_STEP; // FIXME: assume 12 cycles per instruction
 
     // if (mcu.cycles % 24000000 == 0)
     //     fprintf(stderr, "seconds: %i\n", (int)(mcu.cycles / 24000000));
 
-    PCM_Update(*mcu.pcm, mcu.cycles);
+    PCM_Update<Traits>(*mcu.pcm, mcu.cycles);
 
-    TIMER_Clock(*mcu.timer, mcu.cycles);
+    TIMER_Clock<Traits>(*mcu.timer, mcu.cycles);
 
-    if (!mcu.is_mk1 && !mcu.is_jv880 && !mcu.is_scb55)
+    if (!Traits::is_mk1 && !Traits::is_jv880 && !Traits::is_scb55)
         SM_Update(*mcu.sm, mcu.cycles);
     else
     {
@@ -936,7 +1083,7 @@ void MCU_Step(mcu_t& mcu)
 
     MCU_UpdateAnalog(mcu, mcu.cycles);
 
-    if (mcu.is_mk1)
+    if (Traits::is_mk1)
     {
         if (mcu.ga_lcd_counter)
         {
@@ -950,6 +1097,259 @@ void MCU_Step(mcu_t& mcu)
     }
 }
 
+// Kept inline so that the batch entry points below run as a single loop.
+template <typename Traits>
+inline void MCU_StepInline(mcu_t& mcu)
+{
+    if (!mcu.ex_ignore)
+        MCU_Interrupt_Handle(mcu);
+    else
+        mcu.ex_ignore = 0;
+
+    if (!mcu.sleep)
+        MCU_ReadInstruction(mcu);
+
+    MCU_StepPeripherals<Traits>(mcu);
+}
+
+// Runs after every instruction of a compiled block. Returns nonzero when the block has to hand control back to
+// MCU_StepJit: the budget is used up, or the next step would start an interrupt or exception. Everything else that
+// needs the dispatcher (sleep, ex_ignore, trace, a change of cp) can only follow instructions that end a block anyway.
+template <typename Traits>
+uint32_t MCU_JitTick(mcu_t& mcu)
+{
+    MCU_StepPeripherals<Traits>(mcu);
+    return mcu.cycles >= mcu.jit_end_cycles || mcu.frames_produced >= mcu.jit_end_frames ||
+           MCU_Interrupt_WouldStart(mcu);
+}
+
+// Same as MCU_StepInline, but runs a compiled block when there is one. The caller sets the budget in
+// `jit_end_cycles` and `jit_end_frames`.
+template <typename Traits>
+inline void MCU_StepJit(mcu_t& mcu)
+{
+    if (!mcu.ex_ignore)
+        MCU_Interrupt_Handle(mcu);
+    else
+        mcu.ex_ignore = 0;
+
+    if (!mcu.sleep && (mcu.sr & STATUS_T) == 0)
+    {
+        if (const MCU_JitBlock block = MCU_JitLookup(*mcu.jit, mcu))
+        {
+            block(mcu);
+            return;
+        }
+    }
+
+    if (!mcu.sleep)
+        MCU_ReadInstruction(mcu);
+
+    MCU_StepPeripherals<Traits>(mcu);
+}
+
+template <typename Traits>
+inline void MCU_StepAny(mcu_t& mcu)
+{
+    if (mcu.jit)
+        MCU_StepJit<Traits>(mcu);
+    else
+        MCU_StepInline<Traits>(mcu);
+}
+
+// Returns the number of steps with cycle counts in (now, now + steps * MCU_CYCLES_PER_STEP] that are at or before
+// `last`, i.e. the steps a component that next acts after `last` can sleep through.
+inline uint64_t MCU_StepsUntil(uint64_t now, uint64_t last)
+{
+    return last > now ? (last - now) / MCU_CYCLES_PER_STEP : 0;
+}
+
+// Same as MCU_StepsUntil, but for a component that acts at `first`.
+inline uint64_t MCU_StepsBefore(uint64_t now, uint64_t first)
+{
+    return first > now ? (first - now - 1) / MCU_CYCLES_PER_STEP : 0;
+}
+
+// While the MCU is sleeping most steps only advance the cycle counter. This skips ahead in one go to the step before
+// the first one where a peripheral can change state: a PCM sample, a timer event, a UART byte, an A/D conversion, the
+// mk1 LCD interrupt or sub-MCU activity. Skipped steps are indistinguishable from running them one by one.
+template <typename Traits>
+void MCU_SkipIdleSteps(mcu_t& mcu, uint64_t end_cycles)
+{
+    if (!mcu.sleep || mcu.ex_ignore || mcu.backend == MCU_Backend::Interpreter || MCU_Interrupt_WouldStart(mcu))
+    {
+        return;
+    }
+
+    uint64_t steps = MCU_StepsUntil(mcu.cycles, end_cycles);
+    steps = std::min(steps, MCU_StepsUntil(mcu.cycles, mcu.pcm->cycles));
+    steps = std::min(steps, MCU_StepsUntil(mcu.cycles, TIMER_GetIdleUntil(*mcu.timer)));
+
+    constexpr bool has_submcu = !Traits::is_mk1 && !Traits::is_jv880 && !Traits::is_scb55;
+    if constexpr (has_submcu)
+    {
+        if (!SM_IsIdle(*mcu.sm))
+        {
+            return;
+        }
+    }
+    else
+    {
+        if ((mcu.dev_register[DEV_SCR] & 16) != 0 && MCU_HasUARTByte(mcu) &&
+            (mcu.dev_register[DEV_SSR] & 0x40) == 0)
+        {
+            steps = std::min(steps, MCU_StepsBefore(mcu.cycles, mcu.uart_rx_delay));
+        }
+        if ((mcu.dev_register[DEV_SCR] & 32) != 0 && (mcu.dev_register[DEV_SSR] & 0x80) == 0)
+        {
+            steps = std::min(steps, MCU_StepsBefore(mcu.cycles, mcu.uart_tx_delay));
+        }
+    }
+
+    if (mcu.dev_register[DEV_ADCSR] & 0x20)
+    {
+        steps = std::min(steps, MCU_StepsUntil(mcu.cycles, mcu.analog_end_time));
+    }
+
+    if constexpr (Traits::is_mk1)
+    {
+        if (mcu.ga_lcd_counter)
+        {
+            steps = std::min(steps, (uint64_t)(mcu.ga_lcd_counter - 1));
+        }
+    }
+
+    if (steps == 0)
+    {
+        return;
+    }
+
+    mcu.cycles += steps * MCU_CYCLES_PER_STEP;
+
+    if constexpr (has_submcu)
+    {
+        SM_Update(*mcu.sm, mcu.cycles);
+    }
+
+    if constexpr (Traits::is_mk1)
+    {
+        if (mcu.ga_lcd_counter)
+        {
+            mcu.ga_lcd_counter -= (int)steps;
+        }
+    }
+}
+
+template <typename Traits>
+void MCU_StepImpl(mcu_t& mcu)
+{
+    mcu.jit_end_cycles = mcu.cycles + 1;
+    mcu.jit_end_frames = UINT64_MAX;
+    MCU_StepAny<Traits>(mcu);
+}
+
+template <typename Traits>
+void MCU_StepBlockImpl(mcu_t& mcu, uint64_t end_cycles, uint64_t end_frames)
+{
+    mcu.jit_end_cycles = end_cycles;
+    mcu.jit_end_frames = end_frames;
+    MCU_StepAny<Traits>(mcu);
+}
+
+template <typename Traits>
+uint64_t MCU_RunForImpl(mcu_t& mcu, uint64_t cycles)
+{
+    const uint64_t start = mcu.cycles;
+    const uint64_t end   = start + cycles;
+    mcu.jit_end_cycles   = end;
+    mcu.jit_end_frames   = UINT64_MAX;
+    while (mcu.cycles < end)
+    {
+        MCU_StepAny<Traits>(mcu);
+        MCU_SkipIdleSteps<Traits>(mcu, end);
+    }
+    return mcu.cycles - start;
+}
+
+template <typename Traits>
+uint64_t MCU_RunUntilFramesImpl(mcu_t& mcu, uint64_t frames)
+{
+    const uint64_t start = mcu.frames_produced;
+    const uint64_t end   = start + frames;
+    mcu.jit_end_cycles   = UINT64_MAX;
+    mcu.jit_end_frames   = end;
+    while (mcu.frames_produced < end)
+    {
+        MCU_StepAny<Traits>(mcu);
+        if (mcu.frames_produced < end)
+        {
+            MCU_SkipIdleSteps<Traits>(mcu, UINT64_MAX);
+        }
+    }
+    return mcu.frames_produced - start;
+}
+
+template <typename Traits>
+constexpr MCU_Core MCU_CORE = {
+    .read             = MCU_ReadImpl<Traits>,
+    .write            = MCU_WriteImpl<Traits>,
+    .step             = MCU_StepImpl<Traits>,
+    .run_for          = MCU_RunForImpl<Traits>,
+    .run_until_frames = MCU_RunUntilFramesImpl<Traits>,
+    .step_block       = MCU_StepBlockImpl<Traits>,
+    .jit_tick         = MCU_JitTick<Traits>,
+};
+
+static void MCU_SelectCore(mcu_t& mcu)
+{
+    mcu.core = MCU_DispatchRomsetFamily(MCU_GetRomsetFamily(mcu.romset), []<typename Traits>() {
+        return &MCU_CORE<Traits>;
+    });
+    MCU_BuildPageTable(mcu);
+}
+
+void MCU_BuildPageTable(mcu_t& mcu)
+{
+    MCU_DispatchRomsetFamily(MCU_GetRomsetFamily(mcu.romset), [&]<typename Traits>() {
+        MCU_BuildPageTableImpl<Traits>(mcu);
+    });
+}
+
+void MCU_Step(mcu_t& mcu)
+{
+    mcu.core->step(mcu);
+}
+
+void MCU_StepBlock(mcu_t& mcu, uint64_t end_cycles, uint64_t end_frames)
+{
+    mcu.core->step_block(mcu, end_cycles, end_frames);
+}
+
+void MCU_SetBackend(mcu_t& mcu, MCU_Backend backend)
+{
+    mcu.jit.reset();
+    if (backend == MCU_Backend::Jit)
+    {
+        mcu.jit.reset(MCU_JitCreate());
+        if (!mcu.jit)
+        {
+            Diag_Printf(Diag_Category::Warning, "MCU JIT unavailable, falling back to the cached interpreter\n");
+            backend = MCU_Backend::Cached;
+        }
+    }
+    mcu.backend = backend;
+}
+
+uint64_t MCU_RunFor(mcu_t& mcu, uint64_t cycles)
+{
+    return mcu.core->run_for(mcu, cycles);
+}
+
+uint64_t MCU_RunUntilFrames(mcu_t& mcu, uint64_t frames)
+{
+    return mcu.core->run_until_frames(mcu, frames);
+}
+
 void MCU_PatchROM(mcu_t& mcu)
 {
     (void)mcu;
@@ -993,7 +1393,34 @@ void MCU_WriteP1(mcu_t& mcu, uint8_t data)
 
 void MCU_PostSample(mcu_t& mcu, const AudioFrame<int32_t>& frame)
 {
-    mcu.sample_callback(mcu.callback_userdata, frame);
+    *mcu.sample_write_ptr++ = frame;
+    ++mcu.frames_produced;
+    if (mcu.sample_write_ptr == mcu.sample_buffer_last)
+    {
+        MCU_FlushSamples(mcu);
+    }
+}
+
+void MCU_SetSampleSink(mcu_t& mcu, std::span<AudioFrame<int32_t>> buffer, mcu_sample_callback callback, void* userdata)
+{
+    if (buffer.empty())
+    {
+        buffer = mcu.default_sample_buffer;
+    }
+    mcu.sample_buffer_first = buffer.data();
+    mcu.sample_buffer_last = buffer.data() + buffer.size();
+    mcu.sample_write_ptr = buffer.data();
+    mcu.sample_callback = callback;
+    mcu.callback_userdata = userdata;
+}
+
+void MCU_FlushSamples(mcu_t& mcu)
+{
+    if (mcu.sample_write_ptr != mcu.sample_buffer_first)
+    {
+        mcu.sample_callback(mcu.callback_userdata, {mcu.sample_buffer_first, mcu.sample_write_ptr});
+        mcu.sample_write_ptr = mcu.sample_buffer_first;
+    }
 }
 
 void MCU_GA_SetGAInt(mcu_t& mcu, uint8_t line, bool value)
@@ -1056,5 +1483,11 @@ void MCU_SetRomset(mcu_t& mcu, Romset romset)
         break;
     }
 
-    TIMER_NotifyRomsetChange(*mcu.timer);
+    MCU_SelectCore(mcu);
+
+    // The timer step rates depend on the romset.
+    if (mcu.timer)
+    {
+        TIMER_InvalidateSchedule(*mcu.timer);
+    }
 }
@@ -37,9 +37,13 @@
 #include "bounded_ordered_bitset.h"
 #include "mcu_interrupt.h"
 #include "rom.h"
+#include "romset_traits.h"
+#include "mcu_jit.h"
 #include "mcu_opcodes.h"
 #include <atomic>
 #include <cstdint>
+#include <memory>
+#include <span>
 
 struct submcu_t;
 struct pcm_t;
@@ -220,11 +224,70 @@ static const int NVRAM_SIZE = 0x8000; // JV880 only
 static const int CARDRAM_SIZE = 0x8000; // JV880 only
 static const int ROMSM_SIZE = 0x1000;
 
+// Must be a power of two.
 static const uint32_t uart_buffer_size = 8192;
 
-typedef void(*mcu_sample_callback)(void* userdata, const AudioFrame<int32_t>& frame);
+// Number of cycles MCU_Step advances the emulator by.
+static const uint64_t MCU_CYCLES_PER_STEP = 12;
 
-void MCU_DefaultSampleCallback(void* userdata, const AudioFrame<int32_t>& frame);
+// Receives a block of raw frames produced by the emulator. `frames` is only valid for the duration of the call.
+typedef void(*mcu_sample_callback)(void* userdata, std::span<const AudioFrame<int32_t>> frames);
+
+void MCU_DefaultSampleCallback(void* userdata, std::span<const AudioFrame<int32_t>> frames);
+
+struct mcu_t;
+
+// Entry points specialized for one romset family. MCU_SetRomset picks the matching core, so the romset checks inside
+// these functions are resolved at compile time.
+struct MCU_Core
+{
+    uint8_t (*read)(mcu_t& mcu, uint32_t address);
+    void (*write)(mcu_t& mcu, uint32_t address, uint8_t value);
+    void (*step)(mcu_t& mcu);
+    uint64_t (*run_for)(mcu_t& mcu, uint64_t cycles);
+    uint64_t (*run_until_frames)(mcu_t& mcu, uint64_t frames);
+    void (*step_block)(mcu_t& mcu, uint64_t end_cycles, uint64_t end_frames);
+    // Called by compiled code after every instruction, see MCU_Backend::Jit.
+    uint32_t (*jit_tick)(mcu_t& mcu);
+};
+
+// Describes one 64 KiB page of the MCU address space. Reads are served from `read[offset & mask]`; writes go to
+// `write[offset & mask]`, or are reported as unknown when `write` is null. The 0x8000-0xffff half of page 0 holds the
+// I/O window and is not described by this table.
+struct MCU_Page
+{
+    const uint8_t* read   = nullptr;
+    uint8_t*       write  = nullptr;
+    uint16_t       mask   = 0;
+    bool           is_rom = false; // contents only change when roms are loaded
+};
+
+// Cached view of the page `cp` points at. Instruction fetches with `pc < limit` read `base[pc & mask]` directly instead
+// of going through MCU_Read. Refreshed lazily whenever `cp` no longer matches.
+struct MCU_CodePage
+{
+    const uint8_t* base   = nullptr;
+    uint32_t       limit  = 0;
+    uint16_t       mask   = 0;
+    uint16_t       cp     = 0xffff; // never matches a real cp
+    bool           is_rom = false;
+};
+
+// Selects how the MCU executes instructions.
+enum class MCU_Backend : uint8_t
+{
+    // Interpreter backed by the decoded instruction cache below.
+    Cached,
+    // Interpreter that decodes every instruction as it is executed. Used as the reference for lockstep checking.
+    Interpreter,
+    // Compiles runs of rom code into native code, see mcu_jit.h. Falls back to Cached on platforms without a code
+    // generator.
+    Jit,
+};
+
+// Direct mapped cache of decoded general format instructions, keyed by (cp, pc). Only instructions fetched entirely
+// from rom are cached, so writes to ram never have to invalidate it.
+static const uint32_t MCU_DECODE_CACHE_SIZE = 8192;
 
 struct mcu_t {
     uint16_t r[8]{};
@@ -235,11 +298,15 @@ struct mcu_t {
     uint8_t ex_ignore = 0;
     MCU_Exception_Source exception_pending{};
     BoundedOrderedBitSet<INTERRUPT_SOURCE_MAX, MCU_Interrupt_Source> interrupt_pending;
+    // Highest priority level among `interrupt_pending`, or 8 if an NMI is pending. An interrupt can only be taken when
+    // this is above the SR interrupt mask. See MCU_Interrupt_UpdateArbitration.
+    uint8_t interrupt_max_level = 0;
     BoundedOrderedBitSet<16> trapa_pending;
     uint64_t cycles = 0;
 
-    uint8_t rom1[ROM1_SIZE]{};
-    uint8_t rom2[ROM2_SIZE]{};
+    // Shared with other emulators, see EMU_RomImage.
+    const uint8_t* rom1 = ROM_EMPTY;
+    const uint8_t* rom2 = ROM_EMPTY;
     uint8_t ram[RAM_SIZE]{};
     uint8_t sram[SRAM_SIZE]{};
     uint8_t nvram[NVRAM_SIZE]{};
@@ -257,15 +324,30 @@ struct mcu_t {
     mcu_timer_t* timer = nullptr;
     lcd_t* lcd = nullptr;
 
-    uint32_t uart_write_ptr = 0;
-    uint32_t uart_read_ptr = 0;
+    // Single producer, single consumer queue of incoming MIDI bytes. MCU_PostUART may run on another thread than the
+    // emulator. Both pointers count bytes ever written/read and are masked on access; each side publishes its own
+    // pointer with release ordering and reads the other side's with acquire ordering.
+    std::atomic<uint32_t> uart_write_ptr = 0;
+    std::atomic<uint32_t> uart_read_ptr = 0;
     uint8_t uart_buffer[uart_buffer_size]{};
+    // Bytes dropped by MCU_PostUART because the queue was full. Only written by the producer.
+    std::atomic<uint64_t> uart_dropped_bytes = 0;
 
     uint8_t uart_rx_byte = 0;
     uint64_t uart_rx_delay = 0;
     uint64_t uart_tx_delay = 0;
 
     Romset romset = Romset::MK2;
+    const MCU_Core* core = nullptr;
+    MCU_Page pages[16]{};
+    MCU_CodePage code_page{};
+    MCU_Backend backend = MCU_Backend::Cached;
+    MCU_DecodedInstruction decode_cache[MCU_DECODE_CACHE_SIZE]{};
+    // Only set for MCU_Backend::Jit. Compiled blocks return early once `cycles` reaches `jit_end_cycles` or
+    // `frames_produced` reaches `jit_end_frames`.
+    std::unique_ptr<MCU_Jit, MCU_JitDeleter> jit;
+    uint64_t jit_end_cycles = 0;
+    uint64_t jit_end_frames = 0;
 
     bool is_mk1 = false; // 0 - SC-55mkII, SC-55ST. 1 - SC-55, CM-300/SCC-1
     bool is_cm300 = false; // 0 - SC-55, 1 - CM-300/SCC-1
@@ -301,8 +383,18 @@ struct mcu_t {
     uint16_t operand_data = 0;
     uint8_t opcode_extended = 0;
 
+    // Frames are written to sample_buffer_first..sample_buffer_last by MCU_PostSample. When the buffer fills up it is
+    // passed to sample_callback and writing starts over from the beginning.
+    AudioFrame<int32_t>* sample_buffer_first = nullptr;
+    AudioFrame<int32_t>* sample_buffer_last = nullptr;
+    AudioFrame<int32_t>* sample_write_ptr = nullptr;
+    AudioFrame<int32_t> default_sample_buffer[64]{};
+
     void* callback_userdata = nullptr;
     mcu_sample_callback sample_callback = MCU_DefaultSampleCallback;
+
+    // Total number of frames passed to sample_callback. Not part of the emulated hardware.
+    uint64_t frames_produced = 0;
 };
 
 void MCU_Init(mcu_t& mcu, submcu_t& sm, pcm_t& pcm, mcu_timer_t& timer, lcd_t& lcd);
@@ -310,20 +402,51 @@ void MCU_Reset(mcu_t& mcu);
 void MCU_PatchROM(mcu_t& mcu);
 void MCU_Step(mcu_t& mcu);
 
+// Selects `mcu.backend`. Falls back to MCU_Backend::Cached if the JIT is requested but not available.
+void MCU_SetBackend(mcu_t& mcu, MCU_Backend backend);
+
+// Like MCU_Step, but with MCU_Backend::Jit runs a whole compiled block. Stops early once `cycles` reaches `end_cycles`
+// or `frames_produced` reaches `end_frames`, and always executes at least one step.
+void MCU_StepBlock(mcu_t& mcu, uint64_t end_cycles, uint64_t end_frames);
+
+// Executes the instruction at cp:pc without handling interrupts or stepping the peripherals.
+void MCU_ReadInstruction(mcu_t& mcu);
+
+// Steps the emulator until at least `cycles` cycles have elapsed. Returns the number of cycles actually run, which is
+// always a multiple of MCU_CYCLES_PER_STEP.
+uint64_t MCU_RunFor(mcu_t& mcu, uint64_t cycles);
+
+// Steps the emulator until at least `frames` frames have been passed to the sample callback. Returns the number of
+// frames actually produced, which can exceed `frames` by one when oversampling is enabled.
+uint64_t MCU_RunUntilFrames(mcu_t& mcu, uint64_t frames);
+
 void MCU_ErrorTrap(mcu_t& mcu);
 
-uint8_t MCU_Read(mcu_t& mcu, uint32_t address);
+inline uint8_t MCU_Read(mcu_t& mcu, uint32_t address)
+{
+    return mcu.core->read(mcu, address);
+}
+
 uint16_t MCU_Read16(mcu_t& mcu, uint32_t address);
 uint32_t MCU_Read32(mcu_t& mcu, uint32_t address);
-void MCU_Write(mcu_t& mcu, uint32_t address, uint8_t value);
+
+inline void MCU_Write(mcu_t& mcu, uint32_t address, uint8_t value)
+{
+    mcu.core->write(mcu, address, value);
+}
+
 void MCU_Write16(mcu_t& mcu, uint32_t address, uint16_t value);
 
 inline uint32_t MCU_GetAddress(uint8_t page, uint16_t address) {
     return ((uint32_t)page << 16) + address;
 }
 
+uint8_t MCU_ReadCodeSlow(mcu_t& mcu);
+
 inline uint8_t MCU_ReadCode(mcu_t& mcu) {
-    return MCU_Read(mcu, MCU_GetAddress(mcu.cp, mcu.pc));
+    if (mcu.cp == mcu.code_page.cp && mcu.pc < mcu.code_page.limit)
+        return mcu.code_page.base[mcu.pc & mcu.code_page.mask];
+    return MCU_ReadCodeSlow(mcu);
 }
 
 inline uint8_t MCU_ReadCodeAdvance(mcu_t& mcu) {
@@ -560,6 +683,38 @@ void MCU_GA_SetGAInt(mcu_t& mcu, uint8_t line, bool value);
 void MCU_EncoderTrigger(mcu_t& mcu, int dir);
 
 void MCU_PostSample(mcu_t& mcu, const AudioFrame<int32_t>& frame);
-void MCU_PostUART(mcu_t& mcu, uint8_t data);
+
+// Directs output frames into `buffer`, calling `callback` each time it fills up. If `buffer` is empty, an internal
+// buffer is used instead. Frames that have not been passed to the previous callback are discarded.
+void MCU_SetSampleSink(mcu_t& mcu, std::span<AudioFrame<int32_t>> buffer, mcu_sample_callback callback, void* userdata);
+
+// Passes any frames written since the last callback to the sample callback, even if the buffer isn't full.
+void MCU_FlushSamples(mcu_t& mcu);
+// Queues `data` for the UART as a single unit: either all of it is queued or, if there isn't enough room, none of it
+// is and the bytes are counted in `uart_dropped_bytes`. Returns false in the latter case. Safe to call from one thread
+// other than the one running the emulator.
+bool MCU_PostUART(mcu_t& mcu, std::span<const uint8_t> data);
+bool MCU_PostUART(mcu_t& mcu, uint8_t data);
+
+// Consumer side of the UART queue, called by the emulator thread only.
+inline bool MCU_HasUARTByte(const mcu_t& mcu)
+{
+    return mcu.uart_write_ptr.load(std::memory_order_acquire) != mcu.uart_read_ptr.load(std::memory_order_relaxed);
+}
+
+// Precondition: MCU_HasUARTByte(mcu)
+inline uint8_t MCU_ReadUARTByte(mcu_t& mcu)
+{
+    const uint32_t read_ptr = mcu.uart_read_ptr.load(std::memory_order_relaxed);
+    const uint8_t  byte     = mcu.uart_buffer[read_ptr & (uart_buffer_size - 1)];
+    mcu.uart_read_ptr.store(read_ptr + 1, std::memory_order_release);
+    return byte;
+}
 
 void MCU_SetRomset(mcu_t& mcu, Romset romset);
+
+// Rebuilds `mcu.pages` for the current romset. Must be called after changing `rom2_mask`.
+void MCU_BuildPageTable(mcu_t& mcu);
+
+// Drops all cached decoded instructions. Must be called after changing rom contents.
+void MCU_InvalidateDecodeCache(mcu_t& mcu);
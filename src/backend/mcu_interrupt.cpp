@@ -50,6 +50,11 @@ void MCU_Interrupt_Start(mcu_t& mcu, int32_t mask)
 
 void MCU_Interrupt_SetRequest(mcu_t& mcu, MCU_Interrupt_Source interrupt, bool value)
 {
+    if (mcu.interrupt_pending.Contains(interrupt) == value)
+    {
+        return;
+    }
+
     if (value)
     {
         mcu.interrupt_pending.Include(interrupt);
@@ -58,6 +63,8 @@ void MCU_Interrupt_SetRequest(mcu_t& mcu, MCU_Interrupt_Source interrupt, bool v
     {
         mcu.interrupt_pending.Exclude(interrupt);
     }
+
+    MCU_Interrupt_UpdateArbitration(mcu);
 }
 
 void MCU_Interrupt_Exception(mcu_t& mcu, MCU_Exception_Source exception)
@@ -208,13 +215,18 @@ void MCU_Interrupt_Handle(mcu_t& mcu)
         mcu.exception_pending = (MCU_Exception_Source)-1;
         return;
     }
+    uint32_t mask = (mcu.sr >> 8) & 7;
+    // Nothing pending can be delivered; the interpreter always rescans so it can be used as a reference.
+    if (mcu.interrupt_max_level <= mask && mcu.backend != MCU_Backend::Interpreter)
+    {
+        return;
+    }
     if (mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_NMI))
     {
         // mcu.interrupt_pending[INTERRUPT_SOURCE_NMI] = 0;
         MCU_Interrupt_StartVector(mcu, VECTOR_NMI, 7);
         return;
     }
-    uint32_t mask = (mcu.sr >> 8) & 7;
     for (MCU_Interrupt_Source source : mcu.interrupt_pending)
     {
         int32_t vector = -1;
@@ -228,3 +240,29 @@ void MCU_Interrupt_Handle(mcu_t& mcu)
         }
     }
 }
+
+bool MCU_Interrupt_WouldStart(const mcu_t& mcu)
+{
+    if (mcu.trapa_pending.begin() != mcu.trapa_pending.end())
+        return true;
+    if (mcu.exception_pending >= 0)
+        return true;
+    uint32_t mask = (mcu.sr >> 8) & 7;
+    return mcu.interrupt_max_level > mask;
+}
+
+void MCU_Interrupt_UpdateArbitration(mcu_t& mcu)
+{
+    int32_t max_level = 0;
+    if (mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_NMI))
+        max_level = 8; // above any interrupt mask
+    for (MCU_Interrupt_Source source : mcu.interrupt_pending)
+    {
+        int32_t vector = -1;
+        int32_t level = 0;
+        MCU_Interrupt_GetVL(mcu, source, vector, level);
+        if (level > max_level)
+            max_level = level;
+    }
+    mcu.interrupt_max_level = (uint8_t)max_level;
+}
@@ -72,3 +72,8 @@ void MCU_Interrupt_SetRequest(mcu_t& mcu, MCU_Interrupt_Source interrupt, bool v
 void MCU_Interrupt_Exception(mcu_t& mcu, MCU_Exception_Source exception);
 void MCU_Interrupt_TRAPA(mcu_t& mcu, uint8_t vector);
 void MCU_Interrupt_Handle(mcu_t& mcu);
+// Returns true if MCU_Interrupt_Handle would start an exception or interrupt in the current state.
+bool MCU_Interrupt_WouldStart(const mcu_t& mcu);
+// Recomputes `mcu.interrupt_max_level`. Must be called whenever `interrupt_pending`, the IPR registers or P1CR change
+// without going through MCU_Interrupt_SetRequest or MCU_DeviceWrite.
+void MCU_Interrupt_UpdateArbitration(mcu_t& mcu);
@@ -0,0 +1,1636 @@
+#include "mcu_jit.h"
+
+#include "mcu.h"
+#include "mcu_interrupt.h"
+#include "mcu_opcodes.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MCU_JIT_X64
+#endif
+
+#if defined(MCU_JIT_X64)
+
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Size of the executable buffer per emulator. Everything is dropped and recompiled when it fills up.
+static const size_t MCU_JIT_CODE_SIZE = 4 * 1024 * 1024;
+
+// Granularity of MCU_JitProtectCode. 4 KiB on every x86-64 system.
+static const size_t MCU_JIT_PAGE_SIZE = 4096;
+
+// Direct mapped table of compiled blocks, keyed by (cp, pc) like the decode cache.
+static const uint32_t MCU_JIT_BLOCK_TABLE_BITS = 14;
+static const uint32_t MCU_JIT_BLOCK_TABLE_SIZE = 1u << MCU_JIT_BLOCK_TABLE_BITS;
+
+// A block ends after this many instructions even without a branch, so that every compiled block has a small upper
+// bound on its size.
+static const int MCU_JIT_MAX_BLOCK_INSTRUCTIONS = 32;
+
+// No instruction is longer than this. A block only contains instructions that start at least this far from the end of
+// the code page, so decoding never reaches into the I/O window.
+static const uint32_t MCU_JIT_MAX_INSTRUCTION_LENGTH = 8;
+
+struct MCU_JitEntry
+{
+    uint32_t     tag   = UINT32_MAX;
+    MCU_JitBlock block = nullptr;
+};
+
+struct MCU_Jit
+{
+    uint8_t* code      = nullptr;
+    size_t   code_used = 0;
+
+    MCU_JitEntry blocks[MCU_JIT_BLOCK_TABLE_SIZE];
+
+    // Instructions handed to MCU_Operand_ExecuteGeneral by compiled code. A deque so that they never move.
+    std::deque<MCU_DecodedInstruction> decoded;
+
+    // Code for the block being compiled, copied to `code` once complete.
+    std::vector<uint8_t> scratch;
+};
+
+//
+// Executable memory
+//
+
+static uint8_t* MCU_JitAllocCode(size_t size)
+{
+#if defined(_WIN32)
+    return (uint8_t*)VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : (uint8_t*)ptr;
+#endif
+}
+
+static void MCU_JitFreeCode(uint8_t* code, size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(code, 0, MEM_RELEASE);
+#else
+    munmap(code, size);
+#endif
+}
+
+// Code is never writable and executable at the same time, which some systems enforce.
+static bool MCU_JitProtectCode(uint8_t* code, size_t size, bool executable)
+{
+#if defined(_WIN32)
+    DWORD old_protect;
+    return VirtualProtect(code, size, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old_protect) != 0;
+#else
+    return mprotect(code, size, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+//
+// x86-64 encoder
+//
+
+enum MCU_JitReg : uint8_t
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    REG_NONE = 0xff,
+};
+
+// Integer argument registers of the native calling convention.
+#if defined(_WIN32)
+static const MCU_JitReg ARG0 = RCX, ARG1 = RDX, ARG2 = R8;
+// Callers reserve this much stack space for the callee.
+static const uint8_t SHADOW_SPACE = 32;
+#else
+static const MCU_JitReg ARG0 = RDI, ARG1 = RSI, ARG2 = RDX;
+static const uint8_t SHADOW_SPACE = 0;
+#endif
+
+enum MCU_JitAlu : uint8_t
+{
+    ALU_ADD = 0,
+    ALU_OR  = 1,
+    ALU_AND = 4,
+    ALU_SUB = 5,
+    ALU_XOR = 6,
+    ALU_CMP = 7,
+};
+
+enum MCU_JitShift : uint8_t
+{
+    SHIFT_ROL = 0,
+    SHIFT_ROR = 1,
+    SHIFT_RCL = 2,
+    SHIFT_SHL = 4,
+    SHIFT_SHR = 5,
+    SHIFT_SAR = 7,
+};
+
+enum MCU_JitBitOp : uint8_t
+{
+    BIT_BT  = 0xa3,
+    BIT_BTS = 0xab,
+    BIT_BTR = 0xb3,
+};
+
+enum MCU_JitCond : uint8_t
+{
+    COND_O  = 0x0,
+    COND_C  = 0x2,
+    COND_NC = 0x3,
+    COND_Z  = 0x4,
+    COND_NZ = 0x5,
+    COND_S  = 0x8,
+};
+
+// Emits the handful of x86-64 instructions the compiler needs. Operands are 8, 16 or 32 bits wide; memory operands are
+// always [rbx + disp32] since rbx holds the mcu_t pointer.
+class MCU_JitEmitter
+{
+public:
+    explicit MCU_JitEmitter(std::vector<uint8_t>& out)
+        : m_out(out)
+    {
+    }
+
+    size_t Size() const { return m_out.size(); }
+
+    void Byte(uint8_t value) { m_out.push_back(value); }
+
+    void Imm16(uint16_t value)
+    {
+        Byte((uint8_t)value);
+        Byte((uint8_t)(value >> 8));
+    }
+
+    void Imm32(uint32_t value)
+    {
+        Imm16((uint16_t)value);
+        Imm16((uint16_t)(value >> 16));
+    }
+
+    void Imm64(uint64_t value)
+    {
+        Imm32((uint32_t)value);
+        Imm32((uint32_t)(value >> 32));
+    }
+
+    // movzx reg32, byte/word [rbx + disp]
+    void Load(int width, MCU_JitReg reg, int32_t disp)
+    {
+        Rex(false, reg, RBX);
+        Byte(0x0f);
+        Byte(width == 8 ? 0xb6 : 0xb7);
+        Mem(reg, disp);
+    }
+
+    // mov byte/word [rbx + disp], reg
+    void Store(int width, int32_t disp, MCU_JitReg reg)
+    {
+        if (width == 16)
+        {
+            Byte(0x66);
+        }
+        Rex(false, reg, RBX);
+        Byte(width == 8 ? 0x88 : 0x89);
+        Mem(reg, disp);
+    }
+
+    // mov byte/word [rbx + disp], imm
+    void StoreImm(int width, int32_t disp, uint16_t imm)
+    {
+        if (width == 16)
+        {
+            Byte(0x66);
+        }
+        Byte(width == 8 ? 0xc6 : 0xc7);
+        Mem(0, disp);
+        if (width == 8)
+        {
+            Byte((uint8_t)imm);
+        }
+        else
+        {
+            Imm16(imm);
+        }
+    }
+
+    // op word [rbx + disp], reg
+    void AluMem16(MCU_JitAlu op, int32_t disp, MCU_JitReg reg)
+    {
+        Byte(0x66);
+        Rex(false, reg, RBX);
+        Byte((uint8_t)(op * 8 + 1));
+        Mem(reg, disp);
+    }
+
+    // op word [rbx + disp], imm
+    void AluMemImm16(MCU_JitAlu op, int32_t disp, uint16_t imm)
+    {
+        Byte(0x66);
+        Byte(0x81);
+        Mem(op, disp);
+        Imm16(imm);
+    }
+
+    // mov reg32, imm
+    void MovImm(MCU_JitReg reg, uint32_t imm)
+    {
+        Rex(false, 0, reg);
+        Byte((uint8_t)(0xb8 + (reg & 7)));
+        Imm32(imm);
+    }
+
+    // mov reg64, imm
+    void MovImm64(MCU_JitReg reg, uint64_t imm)
+    {
+        Rex(true, 0, reg);
+        Byte((uint8_t)(0xb8 + (reg & 7)));
+        Imm64(imm);
+    }
+
+    // mov dst32, src32
+    void Mov(MCU_JitReg dst, MCU_JitReg src)
+    {
+        Rex(false, src, dst);
+        Byte(0x89);
+        RegReg(src, dst);
+    }
+
+    // mov dst64, src64
+    void Mov64(MCU_JitReg dst, MCU_JitReg src)
+    {
+        Rex(true, src, dst);
+        Byte(0x89);
+        RegReg(src, dst);
+    }
+
+    // op dst, src
+    void Alu(MCU_JitAlu op, int width, MCU_JitReg dst, MCU_JitReg src)
+    {
+        if (width == 16)
+        {
+            Byte(0x66);
+        }
+        Rex(false, src, dst);
+        Byte((uint8_t)(op * 8 + (width == 8 ? 0 : 1)));
+        RegReg(src, dst);
+    }
+
+    // op dst, imm
+    void AluImm(MCU_JitAlu op, int width, MCU_JitReg dst, uint32_t imm)
+    {
+        if (width == 16)
+        {
+            Byte(0x66);
+        }
+        Rex(false, 0, dst);
+        Byte(width == 8 ? 0x80 : 0x81);
+        RegReg(op, dst);
+        if (width == 8)
+        {
+            Byte((uint8_t)imm);
+        }
+        else if (width == 16)
+        {
+            Imm16((uint16_t)imm);
+        }
+        else
+        {
+            Imm32(imm);
+        }
+    }
+
+    // test a, b
+    void Test(int width, MCU_JitReg a, MCU_JitReg b)
+    {
+        if (width == 16)
+        {
+            Byte(0x66);
+        }
+        Rex(false, b, a);
+        Byte(width == 8 ? 0x84 : 0x85);
+        RegReg(b, a);
+    }
+
+    // test reg32, imm
+    void TestImm(MCU_JitReg reg, uint32_t imm)
+    {
+        Rex(false, 0, reg);
+        Byte(0xf7);
+        RegReg(0, reg);
+        Imm32(imm);
+    }
+
+    // op reg, 1
+    void Shift(MCU_JitShift op, int width, MCU_JitReg reg)
+    {
+        if (width == 16)
+        {
+            Byte(0x66);
+        }
+        Rex(false, 0, reg);
+        Byte(width == 8 ? 0xd0 : 0xd1);
+        RegReg(op, reg);
+    }
+
+    // op reg, imm
+    void ShiftImm(MCU_JitShift op, int width, MCU_JitReg reg, uint8_t imm)
+    {
+        if (width == 16)
+        {
+            Byte(0x66);
+        }
+        Rex(false, 0, reg);
+        Byte(width == 8 ? 0xc0 : 0xc1);
+        RegReg(op, reg);
+        Byte(imm);
+    }
+
+    // not reg32
+    void Not(MCU_JitReg reg)
+    {
+        Rex(false, 0, reg);
+        Byte(0xf7);
+        RegReg(2, reg);
+    }
+
+    // setcc reg8
+    void Setcc(MCU_JitCond cond, MCU_JitReg reg)
+    {
+        Rex(false, 0, reg);
+        Byte(0x0f);
+        Byte((uint8_t)(0x90 + cond));
+        RegReg(0, reg);
+    }
+
+    // movzx dst32, src8
+    void Movzx8(MCU_JitReg dst, MCU_JitReg src)
+    {
+        Rex(false, dst, src);
+        Byte(0x0f);
+        Byte(0xb6);
+        RegReg(dst, src);
+    }
+
+    // movsx dst32, src8
+    void Movsx8(MCU_JitReg dst, MCU_JitReg src)
+    {
+        Rex(false, dst, src);
+        Byte(0x0f);
+        Byte(0xbe);
+        RegReg(dst, src);
+    }
+
+    // cmovcc dst32, src32
+    void Cmov(MCU_JitCond cond, MCU_JitReg dst, MCU_JitReg src)
+    {
+        Rex(false, dst, src);
+        Byte(0x0f);
+        Byte((uint8_t)(0x40 + cond));
+        RegReg(dst, src);
+    }
+
+    // bt/bts/btr value32, bit32
+    void BitOp(MCU_JitBitOp op, MCU_JitReg value, MCU_JitReg bit)
+    {
+        Rex(false, bit, value);
+        Byte(0x0f);
+        Byte(op);
+        RegReg(bit, value);
+    }
+
+    // imul dst32, src32
+    void Imul(MCU_JitReg dst, MCU_JitReg src)
+    {
+        Rex(false, dst, src);
+        Byte(0x0f);
+        Byte(0xaf);
+        RegReg(dst, src);
+    }
+
+    void Call(const void* function)
+    {
+        MovImm64(RAX, (uint64_t)(uintptr_t)function);
+        Byte(0xff);
+        Byte(0xd0); // call rax
+    }
+
+    void Push(MCU_JitReg reg)
+    {
+        Rex(false, 0, reg);
+        Byte((uint8_t)(0x50 + (reg & 7)));
+    }
+
+    void Pop(MCU_JitReg reg)
+    {
+        Rex(false, 0, reg);
+        Byte((uint8_t)(0x58 + (reg & 7)));
+    }
+
+    // sub/add rsp, imm8
+    void AdjustStack(int8_t amount)
+    {
+        Byte(0x48);
+        Byte(0x83);
+        Byte(amount < 0 ? 0xec : 0xc4);
+        Byte((uint8_t)(amount < 0 ? -amount : amount));
+    }
+
+    void Ret() { Byte(0xc3); }
+
+    // Emits a jump with an unresolved target and returns a handle for Bind.
+    size_t Jcc(MCU_JitCond cond)
+    {
+        Byte(0x0f);
+        Byte((uint8_t)(0x80 + cond));
+        Imm32(0);
+        return m_out.size();
+    }
+
+    size_t Jmp()
+    {
+        Byte(0xe9);
+        Imm32(0);
+        return m_out.size();
+    }
+
+    // Points the jump returned by Jcc or Jmp at the current position.
+    void Bind(size_t jump)
+    {
+        const uint32_t rel = (uint32_t)(m_out.size() - jump);
+        memcpy(m_out.data() + jump - 4, &rel, sizeof(rel));
+    }
+
+private:
+    void Rex(bool wide, int reg, int rm)
+    {
+        const uint8_t rex = (uint8_t)(0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0));
+        if (rex != 0x40)
+        {
+            Byte(rex);
+        }
+    }
+
+    void RegReg(int reg, int rm) { Byte((uint8_t)(0xc0 | ((reg & 7) << 3) | (rm & 7))); }
+
+    void Mem(int reg, int32_t disp)
+    {
+        Byte((uint8_t)(0x80 | ((reg & 7) << 3) | RBX));
+        Imm32((uint32_t)disp);
+    }
+
+    std::vector<uint8_t>& m_out;
+};
+
+//
+// Runtime helpers called from compiled code. Values cross the boundary as uint32_t so that no side relies on the other
+// extending narrow integers.
+//
+
+static uint32_t MCU_JitRead8(mcu_t& mcu, uint32_t address)
+{
+    return MCU_Read(mcu, address);
+}
+
+// Word accesses through an operand raise an address error on odd addresses, see MCU_Operand_Read.
+static uint32_t MCU_JitRead16(mcu_t& mcu, uint32_t address)
+{
+    if (address & 1)
+    {
+        MCU_Interrupt_Exception(mcu, EXCEPTION_SOURCE_ADDRESS_ERROR);
+    }
+    return MCU_Read16(mcu, address);
+}
+
+static uint32_t MCU_JitRead16Unchecked(mcu_t& mcu, uint32_t address)
+{
+    return MCU_Read16(mcu, address);
+}
+
+static void MCU_JitWrite8(mcu_t& mcu, uint32_t address, uint32_t value)
+{
+    MCU_Write(mcu, address, (uint8_t)value);
+}
+
+static void MCU_JitWrite16(mcu_t& mcu, uint32_t address, uint32_t value)
+{
+    if (address & 1)
+    {
+        MCU_Interrupt_Exception(mcu, EXCEPTION_SOURCE_ADDRESS_ERROR);
+    }
+    MCU_Write16(mcu, address, (uint16_t)value);
+}
+
+static void MCU_JitWrite16Unchecked(mcu_t& mcu, uint32_t address, uint32_t value)
+{
+    MCU_Write16(mcu, address, (uint16_t)value);
+}
+
+static void MCU_JitPushStack(mcu_t& mcu, uint32_t value)
+{
+    MCU_PushStack(mcu, (uint16_t)value);
+}
+
+static uint32_t MCU_JitPopStack(mcu_t& mcu)
+{
+    return MCU_PopStack(mcu);
+}
+
+static void MCU_JitOperandHandler(mcu_t& mcu, uint32_t operand)
+{
+    MCU_Operand_Table[operand](mcu, (uint8_t)operand);
+}
+
+//
+// Compiler
+//
+
+// Byte offsets of the mcu_t fields compiled code touches, measured on an actual instance since mcu_t is not
+// standard-layout.
+struct MCU_JitLayout
+{
+    int32_t r, pc, sr, dp, ep, tp, br;
+
+    explicit MCU_JitLayout(const mcu_t& mcu)
+        : r(Offset(mcu, &mcu.r[0]))
+        , pc(Offset(mcu, &mcu.pc))
+        , sr(Offset(mcu, &mcu.sr))
+        , dp(Offset(mcu, &mcu.dp))
+        , ep(Offset(mcu, &mcu.ep))
+        , tp(Offset(mcu, &mcu.tp))
+        , br(Offset(mcu, &mcu.br))
+    {
+    }
+
+    // The low byte of a register is at the same offset since x86 is little-endian.
+    int32_t Reg(uint8_t index) const { return r + 2 * index; }
+
+    // Page register used by indirect addressing through `index`, see MCU_GetPageForRegister.
+    int32_t Page(uint8_t index) const { return index >= 6 ? tp : index >= 4 ? ep : dp; }
+
+private:
+    static int32_t Offset(const mcu_t& mcu, const void* field)
+    {
+        return (int32_t)((const uint8_t*)field - (const uint8_t*)&mcu);
+    }
+};
+
+// How compilation continues after an instruction.
+enum class MCU_JitFlow
+{
+    // Execution falls through to the next instruction, which can be part of this block.
+    Next,
+    // The instruction set pc itself (branch, call, or an interpreted instruction that may have changed control
+    // state). The block ends after it.
+    End,
+};
+
+class MCU_JitCompiler
+{
+public:
+    MCU_JitCompiler(MCU_Jit& jit, mcu_t& mcu)
+        : m_jit(jit)
+        , m_mcu(mcu)
+        , m_layout(mcu)
+        , m_as(jit.scratch)
+    {
+    }
+
+    // Compiles the block at mcu.cp:mcu.pc into jit.scratch. mcu.pc is used as the decode position and restored
+    // afterwards. The caller has checked that at least the first instruction lies inside rom.
+    void CompileBlock(uint32_t limit)
+    {
+        const uint16_t block_pc = m_mcu.pc;
+
+        // rbx and r12 are callee-saved in both calling conventions. Two pushes plus the return address leave the
+        // stack 8 bytes off 16 byte alignment.
+        m_as.Push(RBX);
+        m_as.Push(R12);
+        m_as.AdjustStack((int8_t)-(SHADOW_SPACE + 8));
+        m_as.Mov64(RBX, ARG0);
+
+        for (int count = 0;; count++)
+        {
+            const uint16_t start = m_mcu.pc;
+            const MCU_JitFlow flow = CompileInstruction(start);
+
+            if (flow == MCU_JitFlow::Next)
+            {
+                m_as.StoreImm(16, m_layout.pc, m_mcu.pc);
+            }
+
+            // Same per-step work as MCU_StepInline after the instruction. Returns nonzero when the next step could
+            // start an interrupt or the caller's budget is used up.
+            m_as.Mov64(ARG0, RBX);
+            m_as.Call((const void*)m_mcu.core->jit_tick);
+
+            const bool last = flow == MCU_JitFlow::End || count + 1 == MCU_JIT_MAX_BLOCK_INSTRUCTIONS ||
+                              (uint32_t)m_mcu.pc + MCU_JIT_MAX_INSTRUCTION_LENGTH > limit;
+            if (last)
+            {
+                break;
+            }
+
+            m_as.Test(32, RAX, RAX);
+            m_exits.push_back(m_as.Jcc(COND_NZ));
+        }
+
+        for (size_t exit : m_exits)
+        {
+            m_as.Bind(exit);
+        }
+        m_as.AdjustStack((int8_t)(SHADOW_SPACE + 8));
+        m_as.Pop(R12);
+        m_as.Pop(RBX);
+        m_as.Ret();
+
+        m_mcu.pc = block_pc;
+    }
+
+private:
+    uint8_t Fetch() { return MCU_ReadCodeAdvance(m_mcu); }
+
+    uint16_t Fetch16()
+    {
+        const uint16_t hi = Fetch();
+        return (uint16_t)((hi << 8) | Fetch());
+    }
+
+    MCU_JitFlow CompileInstruction(uint16_t start)
+    {
+        const uint8_t operand = Fetch();
+
+        if (MCU_Operand_Table[operand] == MCU_Operand_General)
+        {
+            MCU_DecodedInstruction insn;
+            MCU_Operand_DecodeGeneral(m_mcu, operand, insn);
+            insn.length = (uint8_t)(m_mcu.pc - start);
+            return CompileGeneral(start, insn);
+        }
+
+        if (operand == 0x00) // NOP
+        {
+            return MCU_JitFlow::Next;
+        }
+        if (operand >= 0x20 && operand <= 0x3f)
+        {
+            return CompileBcc(operand);
+        }
+        if (operand >= 0x40 && operand <= 0x5f)
+        {
+            CompileShortImmediate(operand);
+            return MCU_JitFlow::Next;
+        }
+        if (operand >= 0x60 && operand <= 0x7f)
+        {
+            CompileShortAbsolute(operand);
+            return MCU_JitFlow::Next;
+        }
+        if (operand >= 0x80 && operand <= 0x9f)
+        {
+            CompileShortFrame(operand);
+            return MCU_JitFlow::Next;
+        }
+
+        switch (operand)
+        {
+        case 0x10: // JMP @aa:16
+            m_as.StoreImm(16, m_layout.pc, Fetch16());
+            return MCU_JitFlow::End;
+        case 0x18: { // JSR @aa:16
+            const uint16_t target = Fetch16();
+            EmitPush(m_mcu.pc);
+            m_as.StoreImm(16, m_layout.pc, target);
+            return MCU_JitFlow::End;
+        }
+        case 0x0e:   // BSR d:8
+        case 0x1e: { // BSR d:16
+            const uint16_t disp = operand == 0x0e ? (uint16_t)(int8_t)Fetch() : Fetch16();
+            EmitPush(m_mcu.pc);
+            m_as.StoreImm(16, m_layout.pc, (uint16_t)(m_mcu.pc + disp));
+            return MCU_JitFlow::End;
+        }
+        case 0x19: // RTS
+            m_as.Mov64(ARG0, RBX);
+            m_as.Call((const void*)MCU_JitPopStack);
+            m_as.Store(16, m_layout.pc, RAX);
+            return MCU_JitFlow::End;
+        case 0x11:
+            return CompileJumpRegister(start);
+        case 0x01: // SCB/F
+        case 0x06: // SCB/NE
+        case 0x07: // SCB/EQ
+            return CompileSCB(start, operand);
+        case 0x02: // LDM
+        case 0x12: // STM
+            // Neither touches pc, cp or sr, so the interpreter's handler can run in the middle of a block.
+            m_as.StoreImm(16, m_layout.pc, m_mcu.pc);
+            m_as.MovImm(ARG1, operand);
+            m_as.Mov64(ARG0, RBX);
+            m_as.Call((const void*)MCU_JitOperandHandler);
+            Fetch(); // register list
+            return MCU_JitFlow::Next;
+        default:
+            return EmitInterpret(start);
+        }
+    }
+
+    // Runs the instruction at `start` through the interpreter, including the trace check, and ends the block.
+    MCU_JitFlow EmitInterpret(uint16_t start)
+    {
+        m_as.StoreImm(16, m_layout.pc, start);
+        m_as.Mov64(ARG0, RBX);
+        m_as.Call((const void*)MCU_ReadInstruction);
+        return MCU_JitFlow::End;
+    }
+
+    // Runs a decoded general format instruction through its interpreter handler. Only used for handlers that don't
+    // read further code bytes and leave pc, cp, sr.T and ex_ignore alone, so the block can continue after it.
+    MCU_JitFlow EmitExecuteGeneral(uint16_t start, const MCU_DecodedInstruction& insn)
+    {
+        const MCU_DecodedInstruction& stored = m_jit.decoded.emplace_back(insn);
+        m_as.StoreImm(16, m_layout.pc, (uint16_t)(start + insn.length));
+        m_as.MovImm64(ARG1, (uint64_t)(uintptr_t)&stored);
+        m_as.Mov64(ARG0, RBX);
+        m_as.Call((const void*)MCU_Operand_ExecuteGeneral);
+        return MCU_JitFlow::Next;
+    }
+
+    void EmitPush(uint16_t value)
+    {
+        m_as.MovImm(ARG1, value);
+        m_as.Mov64(ARG0, RBX);
+        m_as.Call((const void*)MCU_JitPushStack);
+    }
+
+    // Calls `function(mcu, r12)` and leaves the result in eax.
+    void EmitRead(const void* function)
+    {
+        m_as.Mov(ARG1, R12);
+        m_as.Mov64(ARG0, RBX);
+        m_as.Call(function);
+    }
+
+    // Calls `function(mcu, r12, eax)`.
+    void EmitWrite(const void* function)
+    {
+        m_as.Mov(ARG2, RAX);
+        m_as.Mov(ARG1, R12);
+        m_as.Mov64(ARG0, RBX);
+        m_as.Call(function);
+    }
+
+    //
+    // Status flags. Each flag is either captured into a byte register by setcc or cleared; sr bits outside `mask`
+    // are left alone. Only r8-r11 are used so the value being computed can stay in eax and ecx.
+    //
+
+    void EmitFlags(uint16_t mask, MCU_JitReg n, MCU_JitReg z, MCU_JitReg v, MCU_JitReg c)
+    {
+        MCU_JitReg acc = REG_NONE;
+        auto add = [&](MCU_JitReg reg, uint8_t shift) {
+            if (reg == REG_NONE)
+            {
+                return;
+            }
+            m_as.Movzx8(reg, reg);
+            if (shift)
+            {
+                m_as.ShiftImm(SHIFT_SHL, 32, reg, shift);
+            }
+            if (acc == REG_NONE)
+            {
+                acc = reg;
+            }
+            else
+            {
+                m_as.Alu(ALU_OR, 32, acc, reg);
+            }
+        };
+        add(c, 0);
+        add(v, 1);
+        add(z, 2);
+        add(n, 3);
+
+        m_as.AluMemImm16(ALU_AND, m_layout.sr, (uint16_t)~mask);
+        if (acc != REG_NONE)
+        {
+            m_as.AluMem16(ALU_OR, m_layout.sr, acc);
+        }
+    }
+
+    // MCU_ADD_Common and MCU_SUB_Common: N, Z, V and C straight from the x86 flags of the add/sub/cmp just emitted.
+    void EmitFlagsNZVC()
+    {
+        m_as.Setcc(COND_S, R8);
+        m_as.Setcc(COND_Z, R9);
+        m_as.Setcc(COND_O, R10);
+        m_as.Setcc(COND_C, R11);
+        EmitFlags(STATUS_N | STATUS_Z | STATUS_V | STATUS_C, R8, R9, R10, R11);
+    }
+
+    // MCU_SetStatusCommon on the low `width` bits of `reg`: N and Z from the value, V cleared, C unchanged. With
+    // `clear_c` C is cleared as well, and with `c` it is taken from a register captured earlier.
+    void EmitFlagsNZ(int width, MCU_JitReg reg, bool clear_c = false, MCU_JitReg c = REG_NONE)
+    {
+        m_as.Test(width, reg, reg);
+        m_as.Setcc(COND_S, R8);
+        m_as.Setcc(COND_Z, R9);
+        const bool set_c = clear_c || c != REG_NONE;
+        EmitFlags(STATUS_N | STATUS_Z | STATUS_V | (set_c ? STATUS_C : 0), R8, R9, REG_NONE, c);
+    }
+
+    // Flags that are known at compile time.
+    void EmitFlagsConstant(uint16_t mask, uint16_t value)
+    {
+        m_as.AluMemImm16(ALU_AND, m_layout.sr, (uint16_t)~mask);
+        if (value)
+        {
+            m_as.AluMemImm16(ALU_OR, m_layout.sr, value);
+        }
+    }
+
+    //
+    // General format
+    //
+
+    static bool IsMemory(const MCU_DecodedInstruction& insn)
+    {
+        return insn.type == GENERAL_INDIRECT || insn.type == GENERAL_ABSOLUTE;
+    }
+
+    static int Width(const MCU_DecodedInstruction& insn) { return insn.size == MCU_Operand_Size::WORD ? 16 : 8; }
+
+    // Mirrors the effective address calculation in MCU_Operand_ExecuteGeneral and leaves the full address in r12,
+    // which survives the helper calls that read and write the operand.
+    void EmitEffectiveAddress(const MCU_DecodedInstruction& insn)
+    {
+        if (insn.type == GENERAL_INDIRECT)
+        {
+            const int32_t  reg  = m_layout.Reg(insn.reg);
+            const uint32_t step = insn.size == MCU_Operand_Size::WORD || insn.reg == 7 ? 2 : 1;
+
+            m_as.Load(16, RAX, reg);
+            if (insn.increase == INCREASE_DECREASE)
+            {
+                m_as.AluImm(ALU_SUB, 32, RAX, step);
+                m_as.Store(16, reg, RAX);
+            }
+            if (insn.extension)
+            {
+                m_as.AluImm(ALU_ADD, 32, RAX, insn.extension);
+            }
+            m_as.AluImm(ALU_AND, 32, RAX, 0xffff);
+            if (insn.increase == INCREASE_INCREASE)
+            {
+                m_as.Load(16, RCX, reg);
+                m_as.AluImm(ALU_ADD, 32, RCX, step);
+                m_as.Store(16, reg, RCX);
+            }
+            m_as.Load(8, RCX, m_layout.Page(insn.reg));
+            m_as.ShiftImm(SHIFT_SHL, 32, RCX, 16);
+            m_as.Alu(ALU_OR, 32, RAX, RCX);
+        }
+        else if (insn.short_absolute)
+        {
+            m_as.Load(8, RAX, m_layout.br);
+            m_as.ShiftImm(SHIFT_SHL, 32, RAX, 8);
+            m_as.AluImm(ALU_OR, 32, RAX, insn.extension);
+        }
+        else
+        {
+            m_as.Load(8, RAX, m_layout.dp);
+            m_as.ShiftImm(SHIFT_SHL, 32, RAX, 16);
+            m_as.AluImm(ALU_OR, 32, RAX, insn.extension);
+        }
+        m_as.Mov(R12, RAX);
+    }
+
+    // MCU_Operand_Read into eax, zero extended.
+    void EmitReadOperand(const MCU_DecodedInstruction& insn)
+    {
+        switch (insn.type)
+        {
+        case GENERAL_DIRECT:
+            m_as.Load(Width(insn), RAX, m_layout.Reg(insn.reg));
+            break;
+        case GENERAL_IMMEDIATE:
+            m_as.MovImm(RAX, insn.extension);
+            break;
+        default:
+            EmitRead(insn.size == MCU_Operand_Size::WORD ? (const void*)MCU_JitRead16 : (const void*)MCU_JitRead8);
+            break;
+        }
+    }
+
+    // MCU_Operand_Write of eax. Never called for immediate operands.
+    void EmitWriteOperand(const MCU_DecodedInstruction& insn)
+    {
+        if (insn.type == GENERAL_DIRECT)
+        {
+            m_as.Store(Width(insn), m_layout.Reg(insn.reg), RAX);
+        }
+        else
+        {
+            EmitWrite(insn.size == MCU_Operand_Size::WORD ? (const void*)MCU_JitWrite16 : (const void*)MCU_JitWrite8);
+        }
+    }
+
+    MCU_JitFlow CompileGeneral(uint16_t start, const MCU_DecodedInstruction& insn)
+    {
+        // LDC, ORC and ANDC write control registers and set ex_ignore, which the next step has to see.
+        const bool control = insn.opcode == 0x11 ||
+                             ((insn.opcode == 0x09 || insn.opcode == 0x0b) && insn.type == GENERAL_IMMEDIATE);
+        if (control)
+        {
+            return EmitInterpret(start);
+        }
+
+        if (!CanCompileGeneral(insn))
+        {
+            // MOVG_Immediate reads more code bytes on its valid paths, all of which CanCompileGeneral accepts.
+            return EmitExecuteGeneral(start, insn);
+        }
+
+        if (IsMemory(insn))
+        {
+            EmitEffectiveAddress(insn);
+        }
+
+        const int32_t reg   = m_layout.Reg(insn.opcode_reg);
+        const int     width = Width(insn);
+
+        switch (insn.opcode)
+        {
+        case 0x00: // MOV:G #xx, <EA> and CMP:G #xx, <EA>
+            CompileGeneralImmediate(insn);
+            break;
+        case 0x01: { // ADDQ
+            static const int8_t amounts[8] = {1, 2, 0, 0, -1, -2, 0, 0};
+            EmitReadOperand(insn);
+            m_as.AluImm(ALU_ADD, width, RAX, (uint32_t)(int32_t)amounts[insn.opcode_reg]);
+            EmitFlagsNZVC();
+            EmitWriteOperand(insn);
+            break;
+        }
+        case 0x02:
+            CompileUnary(insn);
+            break;
+        case 0x03:
+            CompileShift(insn);
+            break;
+        case 0x04: // ADD
+        case 0x06: // SUB
+        case 0x0e: // CMP
+            EmitReadOperand(insn);
+            m_as.Mov(RCX, RAX);
+            m_as.Load(16, RAX, reg);
+            m_as.Alu(insn.opcode == 0x04 ? ALU_ADD : insn.opcode == 0x06 ? ALU_SUB : ALU_CMP, width, RAX, RCX);
+            EmitFlagsNZVC();
+            if (insn.opcode != 0x0e)
+            {
+                m_as.Store(width, reg, RAX);
+            }
+            break;
+        case 0x05: // ADDS
+        case 0x07: // SUBS
+            EmitReadOperand(insn);
+            if (width == 8)
+            {
+                m_as.Movsx8(RAX, RAX);
+            }
+            m_as.Load(16, RCX, reg);
+            m_as.Alu(insn.opcode == 0x05 ? ALU_ADD : ALU_SUB, 32, RCX, RAX);
+            m_as.Store(16, reg, RCX);
+            break;
+        case 0x08: // OR
+        case 0x0a: // AND
+        case 0x0c: // XOR
+            EmitReadOperand(insn);
+            m_as.Load(16, RCX, reg);
+            m_as.Alu(insn.opcode == 0x08 ? ALU_OR : insn.opcode == 0x0a ? ALU_AND : ALU_XOR, 32, RCX, RAX);
+            // AND only replaces the low byte for byte operands; OR and XOR with a zero extended byte leave the high
+            // byte unchanged anyway.
+            m_as.Store(insn.opcode == 0x0a ? width : 16, reg, RCX);
+            EmitFlagsNZ(width, RCX);
+            break;
+        case 0x09: // BSET Rn, <EA>
+        case 0x0b: // BCLR Rn, <EA>
+        case 0x0f: // BTST Rn, <EA>
+            EmitReadOperand(insn);
+            m_as.Load(16, RCX, reg);
+            m_as.AluImm(ALU_AND, 32, RCX, 0x0f);
+            m_as.BitOp(insn.opcode == 0x09 ? BIT_BTS : insn.opcode == 0x0b ? BIT_BTR : BIT_BT, RAX, RCX);
+            m_as.Setcc(COND_NC, R9);
+            EmitFlags(STATUS_Z, REG_NONE, R9, REG_NONE, REG_NONE);
+            if (insn.opcode != 0x0f)
+            {
+                EmitWriteOperand(insn);
+            }
+            break;
+        case 0x10: // MOV:G <EA>, Rn
+            EmitReadOperand(insn);
+            m_as.Store(width, reg, RAX);
+            EmitFlagsNZ(width, RAX);
+            break;
+        case 0x12: // MOV:G Rn, <EA> and XCH
+            if (insn.type == GENERAL_DIRECT)
+            {
+                m_as.Load(16, RAX, reg);
+                m_as.Load(16, RCX, m_layout.Reg(insn.reg));
+                m_as.Store(16, reg, RCX);
+                m_as.Store(16, m_layout.Reg(insn.reg), RAX);
+            }
+            else
+            {
+                m_as.Load(16, RAX, reg);
+                EmitFlagsNZ(width, RAX);
+                EmitWriteOperand(insn);
+            }
+            break;
+        case 0x15: // MULXU
+            EmitReadOperand(insn);
+            m_as.Load(16, RCX, reg);
+            if (width == 8)
+            {
+                m_as.Movzx8(RCX, RCX);
+            }
+            m_as.Imul(RAX, RCX);
+            if (width == 16)
+            {
+                const uint8_t pair = insn.opcode_reg & ~1;
+                m_as.Mov(RCX, RAX);
+                m_as.ShiftImm(SHIFT_SHR, 32, RCX, 16);
+                m_as.Store(16, m_layout.Reg(pair), RCX);
+                m_as.Store(16, m_layout.Reg(pair | 1), RAX);
+                EmitFlagsNZ(32, RAX, true);
+            }
+            else
+            {
+                m_as.Store(16, reg, RAX);
+                EmitFlagsNZ(16, RAX, true);
+            }
+            break;
+        default: { // 0x18-0x1f: BSET, BCLR, BNOT and BTST #xx, <EA>
+            const uint32_t mask = 1u << (insn.opcode_reg | ((insn.opcode & 1) << 3));
+            EmitReadOperand(insn);
+            m_as.TestImm(RAX, mask);
+            m_as.Setcc(COND_Z, R9);
+            EmitFlags(STATUS_Z, REG_NONE, R9, REG_NONE, REG_NONE);
+            if (insn.opcode < 0x1e)
+            {
+                if (insn.opcode < 0x1a)
+                {
+                    m_as.AluImm(ALU_OR, 32, RAX, mask);
+                }
+                else if (insn.opcode < 0x1c)
+                {
+                    m_as.AluImm(ALU_AND, 32, RAX, ~mask);
+                }
+                else
+                {
+                    m_as.AluImm(ALU_XOR, 32, RAX, mask);
+                }
+                EmitWriteOperand(insn);
+            }
+            break;
+        }
+        }
+        return MCU_JitFlow::Next;
+    }
+
+    // Returns true for the encodings compiled natively. Everything else, including the ones the interpreter treats
+    // as errors, goes through MCU_Operand_ExecuteGeneral.
+    bool CanCompileGeneral(const MCU_DecodedInstruction& insn) const
+    {
+        const bool immediate = insn.type == GENERAL_IMMEDIATE;
+        const bool direct    = insn.type == GENERAL_DIRECT;
+        const bool byte      = insn.size == MCU_Operand_Size::BYTE;
+        const uint8_t r      = insn.opcode_reg;
+        switch (insn.opcode)
+        {
+        case 0x00:
+            return IsMemory(insn) && r >= 4;
+        case 0x01:
+            return !immediate && (r == 0 || r == 1 || r == 4 || r == 5);
+        case 0x02:
+            return ((r == 3 || r == 4 || r == 5 || r == 6) && !immediate) ||
+                   ((r == 0 || r == 1 || r == 2) && direct && byte);
+        case 0x03:
+            return !immediate && r != 7;
+        case 0x04:
+        case 0x05:
+        case 0x06:
+        case 0x07:
+        case 0x08:
+        case 0x0a:
+        case 0x0c:
+        case 0x0e:
+        case 0x15:
+            return true;
+        case 0x09:
+        case 0x0b:
+        case 0x0f:
+            return !immediate;
+        case 0x10:
+            return !insn.opcode_extended;
+        case 0x12:
+            return !insn.opcode_extended && !immediate && !(direct && byte);
+        case 0x18:
+        case 0x19:
+        case 0x1a:
+        case 0x1b:
+        case 0x1c:
+        case 0x1d:
+        case 0x1e:
+        case 0x1f:
+            return !immediate;
+        default:
+            return false;
+        }
+    }
+
+    // MCU_Opcode_MOVG_Immediate. The immediate follows the opcode byte.
+    void CompileGeneralImmediate(const MCU_DecodedInstruction& insn)
+    {
+        const int width = Width(insn);
+        switch (insn.opcode_reg)
+        {
+        case 4: // CMP:G.B #xx:8 and CMP:G.W #xx:8 (sign extended)
+            EmitReadOperand(insn);
+            m_as.AluImm(ALU_CMP, width, RAX, (uint32_t)(int32_t)(int8_t)Fetch());
+            EmitFlagsNZVC();
+            break;
+        case 5: // CMP:G #xx:16, only the low byte is compared for byte operands
+            EmitReadOperand(insn);
+            m_as.AluImm(ALU_CMP, width, RAX, Fetch16());
+            EmitFlagsNZVC();
+            break;
+        case 6: // MOV:G #xx:8 (sign extended)
+            m_as.MovImm(RAX, (uint32_t)(int32_t)(int8_t)Fetch());
+            EmitFlagsNZ(width, RAX);
+            EmitWriteOperand(insn);
+            break;
+        default: // MOV:G #xx:16
+            m_as.MovImm(RAX, Fetch16());
+            EmitFlagsNZ(width, RAX);
+            EmitWriteOperand(insn);
+            break;
+        }
+    }
+
+    // MCU_Opcode_CLR and friends
+    void CompileUnary(const MCU_DecodedInstruction& insn)
+    {
+        const int     width = Width(insn);
+        const int32_t reg   = m_layout.Reg(insn.reg);
+        switch (insn.opcode_reg)
+        {
+        case 0: // SWAP
+            m_as.Load(16, RAX, reg);
+            m_as.ShiftImm(SHIFT_ROL, 16, RAX, 8);
+            m_as.Store(16, reg, RAX);
+            EmitFlagsNZ(16, RAX);
+            break;
+        case 1: // EXTS, flags come from the value before extension
+            m_as.Load(16, RAX, reg);
+            m_as.Movsx8(RCX, RAX);
+            m_as.Store(16, reg, RCX);
+            EmitFlagsNZ(16, RAX);
+            break;
+        case 2: // EXTU, the zero extended value is never negative
+            m_as.Load(8, RAX, reg);
+            m_as.Store(16, reg, RAX);
+            EmitFlagsNZ(16, RAX, true);
+            break;
+        case 3: // CLR
+            EmitFlagsConstant(STATUS_N | STATUS_Z | STATUS_V | STATUS_C, STATUS_Z);
+            m_as.MovImm(RAX, 0);
+            EmitWriteOperand(insn);
+            break;
+        case 4: // NEG
+            EmitReadOperand(insn);
+            m_as.Mov(RCX, RAX);
+            m_as.MovImm(RAX, 0);
+            m_as.Alu(ALU_SUB, width, RAX, RCX);
+            EmitFlagsNZVC();
+            EmitWriteOperand(insn);
+            break;
+        case 5: // NOT
+            EmitReadOperand(insn);
+            m_as.Not(RAX);
+            EmitFlagsNZ(width, RAX);
+            EmitWriteOperand(insn);
+            break;
+        default: // TST
+            EmitReadOperand(insn);
+            EmitFlagsNZ(width, RAX, true);
+            break;
+        }
+    }
+
+    // MCU_Opcode_SHLR. The x86 shift or rotate by one leaves the bit shifted out in CF, which is exactly C.
+    void CompileShift(const MCU_DecodedInstruction& insn)
+    {
+        const int width = Width(insn);
+        EmitReadOperand(insn);
+        switch (insn.opcode_reg)
+        {
+        case 0: // SHAL
+        case 2: // SHLL
+            m_as.Shift(SHIFT_SHL, width, RAX);
+            break;
+        case 1: // SHAR
+            m_as.Shift(SHIFT_SAR, width, RAX);
+            break;
+        case 3: // SHLR
+            m_as.Shift(SHIFT_SHR, width, RAX);
+            break;
+        case 4: // ROTL
+            m_as.Shift(SHIFT_ROL, width, RAX);
+            break;
+        case 5: // ROTR
+            m_as.Shift(SHIFT_ROR, width, RAX);
+            break;
+        default: // ROTXL
+            m_as.Load(16, RCX, m_layout.sr);
+            m_as.Shift(SHIFT_SHR, 32, RCX); // C -> CF
+            m_as.Shift(SHIFT_RCL, width, RAX);
+            break;
+        }
+        m_as.Setcc(COND_C, R11);
+        EmitFlagsNZ(width, RAX, false, R11);
+        EmitWriteOperand(insn);
+    }
+
+    //
+    // Other formats
+    //
+
+    // Short format CMP:E, CMP:I, MOV:E and MOV:I
+    void CompileShortImmediate(uint8_t operand)
+    {
+        const int32_t reg = m_layout.Reg(operand & 0x07);
+        if (operand < 0x50)
+        {
+            const int      width = (operand & 0x08) ? 16 : 8;
+            const uint16_t imm   = width == 16 ? Fetch16() : Fetch();
+            m_as.Load(16, RAX, reg);
+            m_as.AluImm(ALU_CMP, width, RAX, imm);
+            EmitFlagsNZVC();
+        }
+        else if (operand < 0x58)
+        {
+            const uint8_t imm = Fetch();
+            m_as.StoreImm(8, reg, imm);
+            EmitFlagsConstant(STATUS_N | STATUS_Z | STATUS_V,
+                              (uint16_t)(((imm & 0x80) ? STATUS_N : 0) | (imm == 0 ? STATUS_Z : 0)));
+        }
+        else
+        {
+            const uint16_t imm = Fetch16();
+            m_as.StoreImm(16, reg, imm);
+            EmitFlagsConstant(STATUS_N | STATUS_Z | STATUS_V,
+                              (uint16_t)(((imm & 0x8000) ? STATUS_N : 0) | (imm == 0 ? STATUS_Z : 0)));
+        }
+    }
+
+    // MOV:L and MOV:S, which address br:aa:8
+    void CompileShortAbsolute(uint8_t operand)
+    {
+        const int32_t reg   = m_layout.Reg(operand & 0x07);
+        const int     width = (operand & 0x08) ? 16 : 8;
+        m_as.Load(8, RAX, m_layout.br);
+        m_as.ShiftImm(SHIFT_SHL, 32, RAX, 8);
+        m_as.AluImm(ALU_OR, 32, RAX, Fetch());
+        m_as.Mov(R12, RAX);
+        if (operand < 0x70)
+        {
+            EmitRead(width == 16 ? (const void*)MCU_JitRead16 : (const void*)MCU_JitRead8);
+            m_as.Store(width, reg, RAX);
+            EmitFlagsNZ(width, RAX);
+        }
+        else
+        {
+            m_as.Load(width, RAX, reg);
+            EmitFlagsNZ(width, RAX);
+            EmitWrite(width == 16 ? (const void*)MCU_JitWrite16 : (const void*)MCU_JitWrite8);
+        }
+    }
+
+    // MOV:F, which addresses tp:(r6 + d:8). Follows MCU_Opcode_Short_MOVF exactly, including its size handling.
+    void CompileShortFrame(uint8_t operand)
+    {
+        const int32_t reg = m_layout.Reg(operand & 0x07);
+        const bool    siz = (operand & 0x08) != 0;
+        m_as.Load(16, RAX, m_layout.Reg(6));
+        m_as.AluImm(ALU_ADD, 32, RAX, (uint32_t)(int32_t)(int8_t)Fetch());
+        m_as.AluImm(ALU_AND, 32, RAX, 0xffff);
+        m_as.Load(8, RCX, m_layout.tp);
+        m_as.ShiftImm(SHIFT_SHL, 32, RCX, 16);
+        m_as.Alu(ALU_OR, 32, RAX, RCX);
+        m_as.Mov(R12, RAX);
+        if ((operand & 0x10) == 0)
+        {
+            if (siz)
+            {
+                EmitRead((const void*)MCU_JitRead16Unchecked);
+                m_as.Load(16, RCX, reg);
+                m_as.AluImm(ALU_AND, 32, RCX, 0xff00);
+                m_as.Alu(ALU_OR, 32, RCX, RAX);
+                m_as.Store(16, reg, RCX);
+                EmitFlagsNZ(8, RAX);
+            }
+            else
+            {
+                EmitRead((const void*)MCU_JitRead8);
+                m_as.Store(16, reg, RAX);
+                EmitFlagsNZ(16, RAX);
+            }
+        }
+        else
+        {
+            if (siz)
+            {
+                m_as.Load(8, RAX, reg);
+                EmitFlagsNZ(8, RAX);
+                EmitWrite((const void*)MCU_JitWrite8);
+            }
+            else
+            {
+                m_as.Load(16, RAX, reg);
+                EmitFlagsNZ(16, RAX);
+                EmitWrite((const void*)MCU_JitWrite16Unchecked);
+            }
+        }
+    }
+
+    // Bit k of the result is set if the branch is taken when the low bits of sr are k, see MCU_Jump_Bcc.
+    static uint16_t BranchMask(uint8_t cond)
+    {
+        uint16_t mask = 0;
+        for (uint32_t flags = 0; flags < 16; flags++)
+        {
+            const bool N = (flags & STATUS_N) != 0;
+            const bool Z = (flags & STATUS_Z) != 0;
+            const bool V = (flags & STATUS_V) != 0;
+            const bool C = (flags & STATUS_C) != 0;
+            bool branch = false;
+            switch (cond)
+            {
+            case 0x0: branch = true; break;
+            case 0x1: branch = false; break;
+            case 0x2: branch = !(C || Z); break;
+            case 0x3: branch = C || Z; break;
+            case 0x4: branch = !C; break;
+            case 0x5: branch = C; break;
+            case 0x6: branch = !Z; break;
+            case 0x7: branch = Z; break;
+            case 0x8: branch = !V; break;
+            case 0x9: branch = V; break;
+            case 0xa: branch = !N; break;
+            case 0xb: branch = N; break;
+            case 0xc: branch = N == V; break;
+            case 0xd: branch = N != V; break;
+            case 0xe: branch = !Z && N == V; break;
+            default: branch = Z || N != V; break;
+            }
+            if (branch)
+            {
+                mask |= (uint16_t)(1 << flags);
+            }
+        }
+        return mask;
+    }
+
+    MCU_JitFlow CompileBcc(uint8_t operand)
+    {
+        const uint16_t disp   = (operand & 0x10) ? Fetch16() : (uint16_t)(int8_t)Fetch();
+        const uint16_t next   = m_mcu.pc;
+        const uint16_t target = (uint16_t)(next + disp);
+        const uint16_t mask   = BranchMask(operand & 0x0f);
+
+        if (mask == 0) // BRN
+        {
+            return MCU_JitFlow::Next;
+        }
+        if (mask == 0xffff) // BRA
+        {
+            m_as.StoreImm(16, m_layout.pc, target);
+            return MCU_JitFlow::End;
+        }
+
+        m_as.Load(16, RCX, m_layout.sr);
+        m_as.AluImm(ALU_AND, 32, RCX, 0x0f);
+        m_as.MovImm(RDX, mask);
+        m_as.BitOp(BIT_BT, RDX, RCX);
+        m_as.MovImm(RAX, next);
+        m_as.MovImm(RDX, target);
+        m_as.Cmov(COND_C, RAX, RDX);
+        m_as.Store(16, m_layout.pc, RAX);
+        return MCU_JitFlow::End;
+    }
+
+    // JMP @Rn and JSR @Rn. The paged forms go through the interpreter.
+    MCU_JitFlow CompileJumpRegister(uint16_t start)
+    {
+        const uint8_t opcode = Fetch();
+        const uint8_t reg    = opcode & 0x07;
+        if ((opcode >> 3) == 0x1a)
+        {
+            m_as.Load(16, RAX, m_layout.Reg(reg));
+            m_as.Store(16, m_layout.pc, RAX);
+            return MCU_JitFlow::End;
+        }
+        if ((opcode >> 3) == 0x1b)
+        {
+            // The push happens first, so JSR @R7 jumps to the decremented stack pointer like the interpreter does.
+            EmitPush(m_mcu.pc);
+            m_as.Load(16, RAX, m_layout.Reg(reg));
+            m_as.Store(16, m_layout.pc, RAX);
+            return MCU_JitFlow::End;
+        }
+        return EmitInterpret(start);
+    }
+
+    // SCB/F, SCB/NE and SCB/EQ: decrement and branch unless the register wrapped to -1. The conditional forms only
+    // count while Z is clear or set, respectively.
+    MCU_JitFlow CompileSCB(uint16_t start, uint8_t operand)
+    {
+        const uint8_t opcode = Fetch();
+        if ((opcode >> 3) != 0x17)
+        {
+            return EmitInterpret(start);
+        }
+        const int32_t  reg    = m_layout.Reg(opcode & 0x07);
+        const uint16_t disp   = (uint16_t)(int8_t)Fetch();
+        const uint16_t next   = m_mcu.pc;
+        const uint16_t target = (uint16_t)(next + disp);
+
+        m_as.StoreImm(16, m_layout.pc, next);
+        size_t skip = 0;
+        if (operand != 0x01)
+        {
+            m_as.Load(16, RAX, m_layout.sr);
+            m_as.TestImm(RAX, STATUS_Z);
+            skip = m_as.Jcc(operand == 0x06 ? COND_Z : COND_NZ);
+        }
+        m_as.Load(16, RAX, reg);
+        m_as.AluImm(ALU_SUB, 16, RAX, 1);
+        m_as.Store(16, reg, RAX);
+        m_as.AluImm(ALU_CMP, 16, RAX, 0xffff);
+        m_as.MovImm(RCX, next);
+        m_as.MovImm(RDX, target);
+        m_as.Cmov(COND_NZ, RCX, RDX);
+        m_as.Store(16, m_layout.pc, RCX);
+        if (operand != 0x01)
+        {
+            m_as.Bind(skip);
+        }
+        return MCU_JitFlow::End;
+    }
+
+    MCU_Jit&            m_jit;
+    mcu_t&              m_mcu;
+    const MCU_JitLayout m_layout;
+    MCU_JitEmitter      m_as;
+    std::vector<size_t> m_exits;
+};
+
+// Block starts are sparse and a code page is larger than the table, so the address is hashed rather than masked.
+// Masking would make e.g. 00:0000 and 00:4000 evict each other on every pass through a loop covering both.
+static inline uint32_t MCU_JitBlockIndex(uint32_t address)
+{
+    return (address * 0x9e3779b1u) >> (32 - MCU_JIT_BLOCK_TABLE_BITS);
+}
+
+MCU_Jit* MCU_JitCreate()
+{
+    uint8_t* code = MCU_JitAllocCode(MCU_JIT_CODE_SIZE);
+    if (!code)
+    {
+        return nullptr;
+    }
+    if (!MCU_JitProtectCode(code, MCU_JIT_CODE_SIZE, true))
+    {
+        MCU_JitFreeCode(code, MCU_JIT_CODE_SIZE);
+        return nullptr;
+    }
+    MCU_Jit* jit = new MCU_Jit;
+    jit->code    = code;
+    return jit;
+}
+
+void MCU_JitDeleter::operator()(MCU_Jit* jit) const
+{
+    MCU_JitFreeCode(jit->code, MCU_JIT_CODE_SIZE);
+    delete jit;
+}
+
+void MCU_JitFlush(MCU_Jit& jit)
+{
+    for (MCU_JitEntry& entry : jit.blocks)
+    {
+        entry = MCU_JitEntry{};
+    }
+    jit.decoded.clear();
+    jit.code_used = 0;
+}
+
+static MCU_JitBlock MCU_JitCompile(MCU_Jit& jit, mcu_t& mcu)
+{
+    const MCU_Page& page  = mcu.pages[mcu.cp & 0xf];
+    const uint32_t  limit = (mcu.cp & 0xf) == 0 ? 0x8000u : 0x10000u;
+    if (!page.is_rom || (uint32_t)mcu.pc + MCU_JIT_MAX_INSTRUCTION_LENGTH > limit)
+    {
+        return nullptr;
+    }
+
+    jit.scratch.clear();
+    MCU_JitCompiler(jit, mcu).CompileBlock(limit);
+
+    if (jit.code_used + jit.scratch.size() > MCU_JIT_CODE_SIZE)
+    {
+        // Instructions decoded for this block are dropped as well, so compile it again.
+        MCU_JitFlush(jit);
+        jit.scratch.clear();
+        MCU_JitCompiler(jit, mcu).CompileBlock(limit);
+    }
+
+    // Only the pages the block lands on change protection.
+    uint8_t*     block = jit.code + jit.code_used;
+    const size_t first = jit.code_used & ~(MCU_JIT_PAGE_SIZE - 1);
+    const size_t last  = (jit.code_used + jit.scratch.size() + MCU_JIT_PAGE_SIZE - 1) & ~(MCU_JIT_PAGE_SIZE - 1);
+    if (!MCU_JitProtectCode(jit.code + first, last - first, false))
+    {
+        return nullptr;
+    }
+    memcpy(block, jit.scratch.data(), jit.scratch.size());
+    if (!MCU_JitProtectCode(jit.code + first, last - first, true))
+    {
+        return nullptr;
+    }
+    // Keep blocks 16 byte aligned.
+    jit.code_used += (jit.scratch.size() + 15) & ~(size_t)15;
+
+    return (MCU_JitBlock)(void*)block;
+}
+
+MCU_JitBlock MCU_JitLookup(MCU_Jit& jit, mcu_t& mcu)
+{
+    const uint32_t tag   = MCU_GetAddress(mcu.cp, mcu.pc);
+    MCU_JitEntry&  entry = jit.blocks[MCU_JitBlockIndex(tag)];
+    if (entry.tag == tag)
+    {
+        return entry.block;
+    }
+
+    MCU_JitBlock block = MCU_JitCompile(jit, mcu);
+    if (block)
+    {
+        entry.tag   = tag;
+        entry.block = block;
+    }
+    return block;
+}
+
+#else
+
+struct MCU_Jit
+{
+};
+
+MCU_Jit* MCU_JitCreate()
+{
+    return nullptr;
+}
+
+void MCU_JitDeleter::operator()(MCU_Jit* jit) const
+{
+    delete jit;
+}
+
+MCU_JitBlock MCU_JitLookup(MCU_Jit& jit, mcu_t& mcu)
+{
+    (void)jit;
+    (void)mcu;
+    return nullptr;
+}
+
+void MCU_JitFlush(MCU_Jit& jit)
+{
+    (void)jit;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+struct mcu_t;
+
+// Block compiler for MCU_Backend::Jit. Runs of instructions from rom are translated into x86-64 code once and then
+// called directly, which removes decoding and handler dispatch from the step loop. Every compiled instruction is still
+// followed by the same peripheral update the interpreter does after each step, so the emulation stays cycle exact.
+// Instructions that have no native translation call back into the interpreter.
+
+// Compiled code for a run of instructions. Executes at least one of them, stepping the peripherals after each, and
+// returns with `mcu.pc` pointing at the next instruction to execute.
+typedef void (*MCU_JitBlock)(mcu_t& mcu);
+
+struct MCU_Jit;
+
+struct MCU_JitDeleter
+{
+    void operator()(MCU_Jit* jit) const;
+};
+
+// Returns null if native code can't be generated on this platform.
+MCU_Jit* MCU_JitCreate();
+
+// Returns the block starting at `mcu.cp:mcu.pc`, compiling it if needed. Returns null if there is no code to compile
+// there, e.g. because the MCU is executing from ram; the caller should interpret the instruction instead.
+MCU_JitBlock MCU_JitLookup(MCU_Jit& jit, mcu_t& mcu);
+
+// Drops all compiled code. Must be called after changing rom contents or the romset.
+void MCU_JitFlush(MCU_Jit& jit);
@@ -163,19 +163,6 @@ void MCU_Operand_NotImplemented(mcu_t& mcu, uint8_t operand)
     MCU_ErrorTrap(mcu);
 }
 
-enum {
-    GENERAL_DIRECT = 0,
-    GENERAL_INDIRECT,
-    GENERAL_ABSOLUTE,
-    GENERAL_IMMEDIATE
-};
-
-enum {
-    INCREASE_NONE = 0,
-    INCREASE_DECREASE,
-    INCREASE_INCREASE
-};
-
 void MCU_LDM(mcu_t& mcu, uint8_t operand)
 {
     (void)operand;
@@ -580,22 +567,15 @@ void MCU_Operand_Write(mcu_t& mcu, uint32_t data)
     }
 }
 
-void MCU_Operand_General(mcu_t& mcu, uint8_t operand)
+void MCU_Operand_DecodeGeneral(mcu_t& mcu, uint8_t operand, MCU_DecodedInstruction& insn)
 {
     uint32_t type = GENERAL_DIRECT;
-    uint32_t disp = 0;
     uint32_t increase = INCREASE_NONE;
-    uint32_t absolute = 0;
-    (void)absolute; // unused
+    uint16_t extension = 0;
+    bool short_absolute = false;
     uint8_t reg = 0;
     MCU_Operand_Size siz = MCU_Operand_Size::BYTE;
-    uint16_t data = 0;
-    uint32_t addr = 0;
-    uint8_t addrpage = 0;
-    uint16_t ea = 0;
-    uint8_t ep = 0;
     uint8_t opcode;
-    uint8_t opcode_reg;
     if (operand & 0x08)
         siz = MCU_Operand_Size::WORD;
     else
@@ -611,13 +591,12 @@ void MCU_Operand_General(mcu_t& mcu, uint8_t operand)
         break;
     case 0xe0:
         type = GENERAL_INDIRECT;
-        disp = (uint32_t)(int8_t)MCU_ReadCodeAdvance(mcu);
+        extension = (uint16_t)(int8_t)MCU_ReadCodeAdvance(mcu);
         break;
     case 0xf0:
         type = GENERAL_INDIRECT;
-        disp = MCU_ReadCodeAdvance(mcu);
-        disp <<= 8;
-        disp |= MCU_ReadCodeAdvance(mcu);
+        extension = (uint16_t)(MCU_ReadCodeAdvance(mcu) << 8);
+        extension |= MCU_ReadCodeAdvance(mcu);
         break;
     case 0xb0:
         type = GENERAL_INDIRECT;
@@ -631,18 +610,17 @@ void MCU_Operand_General(mcu_t& mcu, uint8_t operand)
         if (reg == 5)
         {
             type = GENERAL_ABSOLUTE;
-            addr = (uint32_t)mcu.br << 8;
-            addr |= MCU_ReadCodeAdvance(mcu);
-            addrpage = 0;
+            extension = MCU_ReadCodeAdvance(mcu);
+            short_absolute = true;
         }
         else if (reg == 4)
         {
             type = GENERAL_IMMEDIATE;
-            data = MCU_ReadCodeAdvance(mcu);
+            extension = MCU_ReadCodeAdvance(mcu);
             if (siz == MCU_Operand_Size::WORD)
             {
-                data <<= 8;
-                data |= MCU_ReadCodeAdvance(mcu);
+                extension = (uint16_t)(extension << 8);
+                extension |= MCU_ReadCodeAdvance(mcu);
             }
         }
         break;
@@ -650,15 +628,39 @@ void MCU_Operand_General(mcu_t& mcu, uint8_t operand)
         if (reg == 5)
         {
             type = GENERAL_ABSOLUTE;
-            addr = (uint32_t)MCU_ReadCodeAdvance(mcu) << 8;
-            addr |= MCU_ReadCodeAdvance(mcu);
-            addrpage = mcu.dp;
+            extension = (uint16_t)(MCU_ReadCodeAdvance(mcu) << 8);
+            extension |= MCU_ReadCodeAdvance(mcu);
         }
         break;
     }
-    if (type == GENERAL_INDIRECT)
+
+    opcode = MCU_ReadCodeAdvance(mcu);
+    insn.opcode_extended = opcode == 0x00;
+    if (insn.opcode_extended)
     {
-        if (increase == INCREASE_DECREASE)
+        opcode = MCU_ReadCodeAdvance(mcu);
+    }
+
+    insn.handler = MCU_Opcode_Table[opcode >> 3];
+    insn.extension = extension;
+    insn.type = (uint8_t)type;
+    insn.increase = (uint8_t)increase;
+    insn.reg = reg;
+    insn.size = siz;
+    insn.opcode = opcode >> 3;
+    insn.opcode_reg = opcode & 0x07;
+    insn.short_absolute = short_absolute;
+}
+
+void MCU_Operand_ExecuteGeneral(mcu_t& mcu, const MCU_DecodedInstruction& insn)
+{
+    const uint8_t reg = insn.reg;
+    const MCU_Operand_Size siz = insn.size;
+    uint16_t ea = 0;
+    uint8_t ep = 0;
+    if (insn.type == GENERAL_INDIRECT)
+    {
+        if (insn.increase == INCREASE_DECREASE)
         {
             if (siz == MCU_Operand_Size::WORD || reg == 7)
             {
@@ -669,8 +671,8 @@ void MCU_Operand_General(mcu_t& mcu, uint8_t operand)
                 mcu.r[reg] -= 1;
             }
         }
-        ea = (uint16_t)(mcu.r[reg] + disp);
-        if (increase == INCREASE_INCREASE)
+        ea = (uint16_t)(mcu.r[reg] + insn.extension);
+        if (insn.increase == INCREASE_INCREASE)
         {
             if (siz == MCU_Operand_Size::WORD || reg == 7)
             {
@@ -684,31 +686,37 @@ void MCU_Operand_General(mcu_t& mcu, uint8_t operand)
 
         ep = MCU_GetPageForRegister(mcu, reg);
     }
-    else if (type == GENERAL_ABSOLUTE)
+    else if (insn.type == GENERAL_ABSOLUTE)
     {
-        ea = (uint16_t)addr;
-
-        ep = addrpage;
-    }
-
-    opcode = MCU_ReadCodeAdvance(mcu);
-    mcu.opcode_extended = opcode == 0x00;
-    if (mcu.opcode_extended)
-    {
-        opcode = MCU_ReadCodeAdvance(mcu);
+        if (insn.short_absolute)
+        {
+            ea = (uint16_t)((mcu.br << 8) | insn.extension);
+            ep = 0;
+        }
+        else
+        {
+            ea = insn.extension;
+            ep = mcu.dp;
+        }
     }
-    opcode_reg = opcode & 0x07;
-    opcode >>= 3;
 
-    mcu.operand_type = type;
+    mcu.opcode_extended = insn.opcode_extended;
+    mcu.operand_type = insn.type;
     mcu.operand_ea = ea;
     mcu.operand_ep = ep;
     mcu.operand_size = siz;
     mcu.operand_reg = reg;
-    mcu.operand_data = data;
+    mcu.operand_data = insn.type == GENERAL_IMMEDIATE ? insn.extension : 0;
     mcu.operand_status = 0;
 
-    MCU_Opcode_Table[opcode](mcu, opcode, opcode_reg);
+    insn.handler(mcu, insn.opcode, insn.opcode_reg);
+}
+
+void MCU_Operand_General(mcu_t& mcu, uint8_t operand)
+{
+    MCU_DecodedInstruction insn;
+    MCU_Operand_DecodeGeneral(mcu, operand, insn);
+    MCU_Operand_ExecuteGeneral(mcu, insn);
 }
 
 void MCU_SetStatusCommon(mcu_t& mcu, uint32_t val, MCU_Operand_Size siz)
@@ -45,3 +45,43 @@ enum class MCU_Operand_Size : uint8_t
 
 extern void (*MCU_Operand_Table[256])(mcu_t& mcu, uint8_t operand);
 extern void (*MCU_Opcode_Table[32])(mcu_t& mcu, uint8_t opcode, uint8_t opcode_reg);
+
+// Addressing modes of a general format instruction, see MCU_DecodedInstruction::type.
+enum {
+    GENERAL_DIRECT = 0,
+    GENERAL_INDIRECT,
+    GENERAL_ABSOLUTE,
+    GENERAL_IMMEDIATE
+};
+
+// Register update of an indirect operand, see MCU_DecodedInstruction::increase.
+enum {
+    INCREASE_NONE = 0,
+    INCREASE_DECREASE,
+    INCREASE_INCREASE
+};
+
+// A general format instruction with its operand and opcode bytes already decoded. Nothing in here depends on register
+// contents, so a decoded instruction can be reused for as long as the code bytes it came from do not change.
+struct MCU_DecodedInstruction
+{
+    uint32_t tag = UINT32_MAX; // (cp << 16) | pc of the operand byte, UINT32_MAX if unused
+    void (*handler)(mcu_t& mcu, uint8_t opcode, uint8_t opcode_reg) = nullptr;
+    uint16_t extension = 0; // displacement, absolute address or immediate data
+    uint8_t length = 0; // bytes from the operand byte up to and including the opcode byte
+    uint8_t type = 0;
+    uint8_t increase = 0;
+    uint8_t reg = 0;
+    MCU_Operand_Size size{};
+    uint8_t opcode = 0;
+    uint8_t opcode_reg = 0;
+    bool opcode_extended = false;
+    bool short_absolute = false; // address is br:extension instead of dp:extension
+};
+
+void MCU_Operand_General(mcu_t& mcu, uint8_t operand);
+
+// Reads the bytes following `operand` at pc into `insn`. Does not touch anything but pc.
+void MCU_Operand_DecodeGeneral(mcu_t& mcu, uint8_t operand, MCU_DecodedInstruction& insn);
+// Resolves the effective address of `insn` against the current registers and runs its opcode handler.
+void MCU_Operand_ExecuteGeneral(mcu_t& mcu, const MCU_DecodedInstruction& insn);
@@ -33,6 +33,7 @@
  */
 #include "mcu_timer.h"
 #include "mcu.h"
+#include <algorithm>
 #include <cstdint>
 
 enum TMR_TCR_Bits : uint8_t
@@ -125,6 +126,7 @@ void TIMER_Reset(mcu_timer_t& timer)
         .tcnt      = 0,
         .status_rd = 0,
     };
+    TIMER_InvalidateSchedule(timer);
 }
 
 void TIMER_Write(mcu_timer_t& timer, uint32_t address, uint8_t data)
@@ -134,6 +136,9 @@ void TIMER_Write(mcu_timer_t& timer, uint32_t address, uint8_t data)
         return;
     frt_t& frt = timer.frt[t];
 
+    TIMER_Sync(timer);
+    TIMER_InvalidateSchedule(timer);
+
     address &= 0x0f;
     switch (address)
     {
@@ -190,6 +195,8 @@ uint8_t TIMER_Read(mcu_timer_t& timer, uint32_t address)
         return 0xff;
     frt_t& frt = timer.frt[t];
 
+    TIMER_Sync(timer);
+
     address &= 0x0f;
     switch (address)
     {
@@ -226,6 +233,9 @@ void TIMER2_Write(mcu_timer_t& timer, uint32_t address, uint8_t data)
 {
     tmr_t& tmr = timer.tmr;
 
+    TIMER_Sync(timer);
+    TIMER_InvalidateSchedule(timer);
+
     switch (address)
     {
     case DEV_TMR_TCR:
@@ -269,6 +279,8 @@ uint8_t TIMER_Read2(mcu_timer_t& timer, uint32_t address)
 {
     tmr_t& tmr = timer.tmr;
 
+    TIMER_Sync(timer);
+
     switch (address)
     {
     case DEV_TMR_TCR:
@@ -288,12 +300,26 @@ uint8_t TIMER_Read2(mcu_timer_t& timer, uint32_t address)
     return 0xff;
 }
 
+// These tables are indexed by the low CKSn bits of the TCR.
+constexpr FRT_Step_Table FRT_STEP_TABLE_GENERIC = {3, 7, 31, 1};
+constexpr FRT_Step_Table FRT_STEP_TABLE_MK1     = {3, 7, 31, 3};
 
+// A value of 0 means do not step.
+constexpr TMR_Step_Table TMR_STEP_TABLE_GENERIC = {0, 7, 63, 1023, 0, 1, 1, 1};
+constexpr TMR_Step_Table TMR_STEP_TABLE_MK1     = {0, 7, 63, 1023, 0, 3, 3, 3};
+
+template <typename Traits>
+constexpr FRT_Step_Table FRT_STEP_TABLE = Traits::is_mk1 ? FRT_STEP_TABLE_MK1 : FRT_STEP_TABLE_GENERIC;
+
+template <typename Traits>
+constexpr TMR_Step_Table TMR_STEP_TABLE = Traits::is_mk1 ? TMR_STEP_TABLE_MK1 : TMR_STEP_TABLE_GENERIC;
+
+template <typename Traits>
 inline void TIMER_ClockFrt(mcu_timer_t& timer, int frt_id)
 {
     frt_t& frt = timer.frt[frt_id];
 
-    if (timer.cycles & timer.frt_step_table[frt.tcr & (FRT_TCR_CKS0 | FRT_TCR_CKS1)])
+    if (timer.cycles & FRT_STEP_TABLE<Traits>[frt.tcr & (FRT_TCR_CKS0 | FRT_TCR_CKS1)])
     {
         return;
     }
@@ -327,11 +353,12 @@ inline void TIMER_ClockFrt(mcu_timer_t& timer, int frt_id)
         MCU_Interrupt_SetRequest(*timer.mcu, (MCU_Interrupt_Source)(INTERRUPT_SOURCE_FRT0_OCIB + frt_id * 4), 1);
 }
 
+template <typename Traits>
 inline void TIMER_ClockTmr(mcu_timer_t& timer)
 {
     tmr_t& tmr = timer.tmr;
 
-    const uint16_t step_mask = timer.tmr_step_table[tmr.tcr & (TMR_TCR_CKS0 | TMR_TCR_CKS1 | TMR_TCR_CKS2)];
+    const uint16_t step_mask = TMR_STEP_TABLE<Traits>[tmr.tcr & (TMR_TCR_CKS0 | TMR_TCR_CKS1 | TMR_TCR_CKS2)];
 
     if (step_mask == 0)
     {
@@ -376,32 +403,152 @@ inline void TIMER_ClockTmr(mcu_timer_t& timer)
         MCU_Interrupt_SetRequest(*timer.mcu, INTERRUPT_SOURCE_TIMER_CMIB, 1);
 }
 
-void TIMER_Clock(mcu_timer_t& timer, uint64_t cycles)
+// Processes the tick at `timer.cycles` exactly.
+template <typename Traits>
+void TIMER_Tick(mcu_timer_t& timer)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        TIMER_ClockFrt<Traits>(timer, i);
+    }
+
+    TIMER_ClockTmr<Traits>(timer);
+
+    ++timer.cycles;
+}
+
+// Number of ticks in [from, to) that a counter with `step_mask` steps on.
+inline uint64_t TIMER_CountSteps(uint64_t from, uint64_t to, uint64_t step_mask)
+{
+    return ((to + step_mask) / (step_mask + 1)) - ((from + step_mask) / (step_mask + 1));
+}
+
+// First tick at or after `from` that a counter with `step_mask` steps on, plus `steps` more steps.
+inline uint64_t TIMER_StepTick(uint64_t from, uint64_t step_mask, uint64_t steps)
 {
-    while (timer.cycles * 2 < cycles) // FIXME
+    return ((from + step_mask) & ~step_mask) + steps * (step_mask + 1);
+}
+
+// Brings the counters up to tick `to` without processing any events. Only valid while `to <= timer.next_event`.
+template <typename Traits>
+void TIMER_Advance(mcu_timer_t& timer, uint64_t to)
+{
+    if (to <= timer.cycles)
     {
-        for (int i = 0; i < 3; i++)
+        return;
+    }
+
+    for (frt_t& frt : timer.frt)
+    {
+        const uint64_t step_mask = FRT_STEP_TABLE<Traits>[frt.tcr & (FRT_TCR_CKS0 | FRT_TCR_CKS1)];
+        frt.frc = (uint16_t)(frt.frc + TIMER_CountSteps(timer.cycles, to, step_mask));
+    }
+
+    tmr_t& tmr = timer.tmr;
+    const uint64_t step_mask = TMR_STEP_TABLE<Traits>[tmr.tcr & (TMR_TCR_CKS0 | TMR_TCR_CKS1 | TMR_TCR_CKS2)];
+    if (step_mask != 0)
+    {
+        tmr.tcnt = (uint8_t)(tmr.tcnt + TIMER_CountSteps(timer.cycles, to, step_mask));
+    }
+
+    timer.cycles = to;
+}
+
+// Returns true if a tick would raise an interrupt that isn't already pending.
+inline bool TIMER_WouldRequest(const mcu_t& mcu, bool enabled, bool flag, MCU_Interrupt_Source source)
+{
+    return enabled && flag && !mcu.interrupt_pending.Contains(source);
+}
+
+// Computes the first tick at or after `timer.cycles` where any counter can match, overflow or raise an interrupt.
+// Every tick before that only increments counters.
+template <typename Traits>
+void TIMER_Schedule(mcu_timer_t& timer)
+{
+    const mcu_t& mcu = *timer.mcu;
+    uint64_t next = UINT64_MAX;
+
+    for (int i = 0; i < 3; i++)
+    {
+        const frt_t& frt = timer.frt[i];
+        const uint64_t step_mask = FRT_STEP_TABLE<Traits>[frt.tcr & (FRT_TCR_CKS0 | FRT_TCR_CKS1)];
+
+        uint16_t steps = (uint16_t)(frt.ocra - frt.frc);
+        steps = std::min(steps, (uint16_t)(frt.ocrb - frt.frc));
+        steps = std::min(steps, (uint16_t)(0xffff - frt.frc));
+
+        const auto source = [i](MCU_Interrupt_Source base) { return (MCU_Interrupt_Source)(base + i * 4); };
+        if (TIMER_WouldRequest(mcu, frt.tcr & FRT_TCR_OVIE, frt.tcsr & FRT_TCSR_OVF, source(INTERRUPT_SOURCE_FRT0_FOVI)) ||
+            TIMER_WouldRequest(mcu, frt.tcr & FRT_TCR_OCIEA, frt.tcsr & FRT_TCSR_OCFA, source(INTERRUPT_SOURCE_FRT0_OCIA)) ||
+            TIMER_WouldRequest(mcu, frt.tcr & FRT_TCR_OCIEB, frt.tcsr & FRT_TCSR_OCFB, source(INTERRUPT_SOURCE_FRT0_OCIB)))
         {
-            TIMER_ClockFrt(timer, i);
+            steps = 0;
         }
 
-        TIMER_ClockTmr(timer);
+        next = std::min(next, TIMER_StepTick(timer.cycles, step_mask, steps));
+    }
 
-        ++timer.cycles;
+    const tmr_t& tmr = timer.tmr;
+    const uint64_t step_mask = TMR_STEP_TABLE<Traits>[tmr.tcr & (TMR_TCR_CKS0 | TMR_TCR_CKS1 | TMR_TCR_CKS2)];
+    if (step_mask != 0)
+    {
+        uint8_t steps = (uint8_t)(tmr.tcora - tmr.tcnt);
+        steps = std::min(steps, (uint8_t)(tmr.tcorb - tmr.tcnt));
+        steps = std::min(steps, (uint8_t)(0xff - tmr.tcnt));
+
+        if (TIMER_WouldRequest(mcu, tmr.tcr & TMR_TCR_OVIE, tmr.tcsr & TMR_TCSR_OVF, INTERRUPT_SOURCE_TIMER_OVI) ||
+            TIMER_WouldRequest(mcu, tmr.tcr & TMR_TCR_CMIEA, tmr.tcsr & TMR_TCSR_CMFA, INTERRUPT_SOURCE_TIMER_CMIA) ||
+            TIMER_WouldRequest(mcu, tmr.tcr & TMR_TCR_CMIEB, tmr.tcsr & TMR_TCSR_CMFB, INTERRUPT_SOURCE_TIMER_CMIB))
+        {
+            steps = 0;
+        }
+
+        next = std::min(next, TIMER_StepTick(timer.cycles, step_mask, steps));
     }
+
+    timer.next_event = next;
 }
 
-// These tables are indexed by the low CKSn bits of the TCR.
-constexpr FRT_Step_Table FRT_STEP_TABLE_GENERIC = {3, 7, 31, 1};
-constexpr FRT_Step_Table FRT_STEP_TABLE_MK1     = {3, 7, 31, 3};
+template <typename Traits>
+void TIMER_Clock(mcu_timer_t& timer, uint64_t cycles)
+{
+    // Ticks with `tick * 2 < cycles` are due. FIXME: the timer runs at half the MCU clock
+    const uint64_t end = (cycles + 1) / 2;
 
-// A value of 0 means do not step.
-constexpr TMR_Step_Table TMR_STEP_TABLE_GENERIC = {0, 7, 63, 1023, 0, 1, 1, 1};
-constexpr TMR_Step_Table TMR_STEP_TABLE_MK1     = {0, 7, 63, 1023, 0, 3, 3, 3};
+    // Counters are only brought up to date lazily; see TIMER_Sync.
+    while (true)
+    {
+        if (timer.next_event < timer.cycles)
+        {
+            TIMER_Schedule<Traits>(timer);
+        }
+
+        if (timer.next_event >= end)
+        {
+            break;
+        }
+
+        TIMER_Advance<Traits>(timer, timer.next_event);
+        TIMER_Tick<Traits>(timer);
+        TIMER_Schedule<Traits>(timer);
+    }
+}
 
-void TIMER_NotifyRomsetChange(mcu_timer_t& timer)
+void TIMER_Sync(mcu_timer_t& timer)
 {
-    const bool is_mk1    = timer.mcu->is_mk1;
-    timer.frt_step_table = is_mk1 ? FRT_STEP_TABLE_MK1 : FRT_STEP_TABLE_GENERIC;
-    timer.tmr_step_table = is_mk1 ? TMR_STEP_TABLE_MK1 : TMR_STEP_TABLE_GENERIC;
+    MCU_DispatchRomsetFamily(MCU_GetRomsetFamily(timer.mcu->romset), [&]<typename Traits>() {
+        TIMER_Clock<Traits>(timer, timer.mcu->cycles);
+        TIMER_Advance<Traits>(timer, (timer.mcu->cycles + 1) / 2);
+    });
 }
+
+void TIMER_InvalidateSchedule(mcu_timer_t& timer)
+{
+    timer.next_event = 0;
+}
+
+template void TIMER_Clock<MCU_Traits_MK2>(mcu_timer_t& timer, uint64_t cycles);
+template void TIMER_Clock<MCU_Traits_MK1>(mcu_timer_t& timer, uint64_t cycles);
+template void TIMER_Clock<MCU_Traits_CM300>(mcu_timer_t& timer, uint64_t cycles);
+template void TIMER_Clock<MCU_Traits_JV880>(mcu_timer_t& timer, uint64_t cycles);
+template void TIMER_Clock<MCU_Traits_SCB55>(mcu_timer_t& timer, uint64_t cycles);
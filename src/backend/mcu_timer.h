@@ -35,6 +35,7 @@
 
 #include <array>
 #include <cstdint>
+#include "romset_traits.h"
 
 struct mcu_t;
 
@@ -67,8 +68,9 @@ struct tmr_t
 struct mcu_timer_t
 {
     uint64_t cycles = 0;
-    FRT_Step_Table frt_step_table;
-    TMR_Step_Table tmr_step_table;
+    // First tick at which a counter may match, overflow or raise an interrupt. Counters are only stepped one tick at a
+    // time from here on; earlier ticks are applied in bulk. A value before `cycles` forces a reschedule.
+    uint64_t next_event = 0;
 
     mcu_t* mcu = nullptr;
     frt_t   frt[3]{};
@@ -87,7 +89,20 @@ uint8_t TIMER_Read(mcu_timer_t& timer, uint32_t address);
 void TIMER2_Write(mcu_timer_t& timer, uint32_t address, uint8_t data);
 uint8_t TIMER_Read2(mcu_timer_t& timer, uint32_t address);
 
-// Update all timers and trigger interrupts
+// Update all timers and trigger interrupts. Instantiated in mcu_timer.cpp for each MCU_RomsetTraits specialization.
+// Counters that have no pending event are not updated until TIMER_Sync or a register access.
+template <typename Traits>
 void TIMER_Clock(mcu_timer_t& timer, uint64_t cycles);
 
-void TIMER_NotifyRomsetChange(mcu_timer_t& timer);
+// Returns the largest MCU cycle count that TIMER_Clock can run up to without processing an event. This may be earlier
+// than the actual next event if the schedule is stale.
+inline uint64_t TIMER_GetIdleUntil(const mcu_timer_t& timer)
+{
+    return timer.next_event > UINT64_MAX / 2 ? UINT64_MAX : timer.next_event * 2;
+}
+
+// Brings all counters up to date with the MCU's current cycle count.
+void TIMER_Sync(mcu_timer_t& timer);
+
+// Must be called after modifying timer registers or interrupt state directly, e.g. when loading a state.
+void TIMER_InvalidateSchedule(mcu_timer_t& timer);
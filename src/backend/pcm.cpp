@@ -37,6 +37,7 @@
 #include <cstdint>
 #include <cstring>
 
+template <typename Traits>
 uint8_t PCM_ReadROM(pcm_t& pcm, uint32_t address)
 {
     int bank;
@@ -47,17 +48,17 @@ uint8_t PCM_ReadROM(pcm_t& pcm, uint32_t address)
     switch (bank)
     {
         case 0:
-            if (pcm.mcu->is_mk1)
+            if (Traits::is_mk1)
                 return pcm.waverom1[address & 0xfffff];
             else
                 return pcm.waverom1[address & 0x1fffff];
         case 1:
-            if (!pcm.mcu->is_jv880)
+            if (!Traits::is_jv880)
                 return pcm.waverom2[address & 0xfffff];
             else
                 return pcm.waverom2[address & 0x1fffff];
         case 2:
-            if (pcm.mcu->is_jv880)
+            if (Traits::is_jv880)
                 return pcm.waverom_card[address & 0x1fffff];
             else
                 return pcm.waverom3[address & 0xfffff];
@@ -65,7 +66,7 @@ uint8_t PCM_ReadROM(pcm_t& pcm, uint32_t address)
         case 4:
         case 5:
         case 6:
-            if (pcm.mcu->is_jv880)
+            if (Traits::is_jv880)
                 return pcm.waverom_exp[(address & 0x1fffff) + (uint32_t)((bank - 3) * 0x200000)];
         default:
             break;
@@ -114,7 +115,9 @@ void PCM_Write(pcm_t& pcm, uint32_t address, uint8_t data)
             case 3:
                 pcm.wave_read_address &= ~0xffu;
                 pcm.wave_read_address |= (uint32_t)(data & 0xff) << 0;
-                pcm.wave_byte_latch = PCM_ReadROM(pcm, pcm.wave_read_address);
+                pcm.wave_byte_latch = MCU_DispatchRomsetFamily(MCU_GetRomsetFamily(pcm.mcu->romset), [&]<typename Traits>() {
+                    return PCM_ReadROM<Traits>(pcm, pcm.wave_read_address);
+                });
                 break;
         }
     }
@@ -582,6 +585,999 @@ void PCM_GetConfig(PCM_Config& config, uint8_t config_byte)
     }
 }
 
+template <typename Traits>
+inline void PCM_CheckVoiceIrq(pcm_t& pcm, int slot, bool active, bool irq_flag)
+{
+    uint16_t* ram2 = pcm.ram2[slot];
+    if (active && (ram2[6] & 1) != 0 && (ram2[8] & 0x4000) == 0 && !pcm.irq_assert && irq_flag)
+    {
+        if (pcm.nfs)
+            ram2[8] |= 0x4000;
+        pcm.irq_assert = true;
+        pcm.irq_channel = (uint8_t)slot;
+        if (Traits::is_jv880)
+            MCU_GA_SetGAInt(*pcm.mcu, 5, 1);
+        else
+            MCU_Interrupt_SetRequest(*pcm.mcu, INTERRUPT_SOURCE_IRQ0, 1);
+    }
+}
+
+// Adds a voice's output to the mix and reverb/chorus sends. The reverb/chorus returns are mixed in when reaching
+// certain slots, so this must be called in slot order.
+inline void PCM_MixSlot(pcm_t& pcm, int slot, int sampl, int sampr, int rc0, int rc1, const int* rcadd,
+                        const int* rcadd2)
+{
+    // mix reverb/chorus?
+    int slot2 = (slot == pcm.config.reg_slots - 1) ? 31 : slot + 1;
+    switch (slot2)
+    {
+        // 17, 18 - reverb
+
+        case 17:
+            pcm.ram1[31][1] = (uint32_t)addclip20((int32_t)pcm.ram1[31][1], rcadd[0] >> 1, rcadd[0] & 1);
+            break;
+        case 18:
+            pcm.ram1[31][3] = (uint32_t)addclip20((int32_t)pcm.ram1[31][3], rcadd[1] >> 1, rcadd[1] & 1);
+            break;
+        case 21:
+            pcm.ram1[31][1] = (uint32_t)addclip20((int32_t)pcm.ram1[31][1], rcadd[2] >> 1, rcadd[2] & 1);
+            break;
+        case 22:
+            pcm.ram1[31][3] = (uint32_t)addclip20((int32_t)pcm.ram1[31][3], rcadd[3] >> 1, rcadd[3] & 1);
+            break;
+        case 23:
+            pcm.ram1[31][1] = (uint32_t)addclip20((int32_t)pcm.ram1[31][1], rcadd[4] >> 1, rcadd[4] & 1);
+            break;
+        case 31:
+            pcm.ram1[31][3] = (uint32_t)addclip20((int32_t)pcm.ram1[31][3], rcadd[5] >> 1, rcadd[5] & 1);
+            break;
+    }
+
+    int32_t suml = addclip20((int32_t)pcm.ram1[31][1], sampl >> 6, (sampl >> 5) & 1);
+    int32_t sumr = addclip20((int32_t)pcm.ram1[31][3], sampr >> 6, (sampr >> 5) & 1);
+
+    switch (slot2)
+    {
+        case 17:
+            pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[0] >> 1, rcadd2[0] & 1);
+            break;
+        case 18:
+            pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[1] >> 1, rcadd2[1] & 1);
+            break;
+        case 21:
+            pcm.rcsum[0] = addclip20(pcm.rcsum[0], rcadd2[2] >> 1, rcadd2[2] & 1);
+            break;
+        case 22:
+            pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[3] >> 1, rcadd2[3] & 1);
+            break;
+        case 23:
+            pcm.rcsum[0] = addclip20(pcm.rcsum[0], rcadd2[4] >> 1, rcadd2[4] & 1);
+            break;
+        case 31:
+            pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[5] >> 1, rcadd2[5] & 1);
+            break;
+    }
+
+    pcm.rcsum[0] = addclip20(pcm.rcsum[0], rc0 >> 1, rc0 & 1);
+    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rc1 >> 1, rc1 & 1);
+
+    if (slot != pcm.config.reg_slots - 1)
+    {
+        pcm.ram1[31][1] = (uint32_t)suml;
+        pcm.ram1[31][3] = (uint32_t)sumr;
+    }
+    else
+    {
+        pcm.accum_l = suml;
+        pcm.accum_r = sumr;
+    }
+}
+
+// Once nfs is set, a slot that isn't keyed on has its sample state and envelopes 0 and 1 cleared and adds nothing to the
+// mix, so only its filter envelope and its place in the mix chain have visible effects. This does just that part.
+inline void PCM_UpdateIdleSlot(pcm_t& pcm, int slot, const int* rcadd, const int* rcadd2)
+{
+    uint32_t* ram1 = pcm.ram1[slot];
+    uint16_t* ram2 = pcm.ram2[slot];
+
+    ram1[1] = 0;
+    ram1[3] = 0;
+    ram1[5] = 0;
+
+    ram2[8] = 0;
+    ram2[9] = 0;
+    ram2[10] = 0;
+
+    calc_tv(pcm, 2, ram2[5], &ram2[11], 0, NULL);
+
+    PCM_MixSlot(pcm, slot, 0, 0, 0, 0, rcadd, rcadd2);
+}
+
+template <typename Traits>
+static void PCM_UpdateVoicesScalar(pcm_t& pcm, uint32_t voice_active, const int* rcadd, const int* rcadd2)
+{
+    const bool skip_idle = pcm.skip_idle_voices && pcm.nfs;
+    for (int slot = 0; slot < pcm.config.reg_slots; slot++)
+    {
+        // row 31 doubles as the mix accumulator, which the full update mixes into after overwriting it
+        if (skip_idle && slot != 31 && ((voice_active >> slot) & 1) == 0)
+        {
+            PCM_UpdateIdleSlot(pcm, slot, rcadd, rcadd2);
+            continue;
+        }
+
+        uint32_t *ram1 = pcm.ram1[slot];
+        uint16_t *ram2 = pcm.ram2[slot];
+        const bool okey = (ram2[7] & 0x20) != 0;
+        const bool key = (voice_active >> slot) & 1;
+
+        const bool active = okey && key;
+        const bool kon = key && !okey;
+
+        // address generator
+
+        bool b15 = (ram2[8] & 0x8000) != 0; // 0
+        const bool b6 = (ram2[7] & 0x40) != 0; // 1
+        const bool b7 = (ram2[7] & 0x80) != 0; // 1
+        int hiaddr = (ram2[7] >> 8) & 15; // 1
+        int old_nibble = (ram2[7] >> 12) & 15; // 1
+
+        int address = (int)ram1[4]; // 0
+        int address_end = (int)ram1[0]; // 1 or 2
+        int address_loop = (int)ram1[2]; // 2 or 1
+
+        int cmp1 = b15 ? address_loop : address_end;
+        int cmp2 = address;
+        const bool nibble_cmp1 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 2
+        bool irq_flag = 0;
+
+        // fixme:
+        if (kon)
+            irq_flag = ((cmp1 + address_loop) & 0x100000) != 0;
+        else
+            irq_flag = ((address + ((-address_loop) & 0xfffff)) & 0x100000) != 0;
+        irq_flag ^= b7;
+
+        int nibble_address = (!b6 && nibble_cmp1) ? address_loop : address; // 3
+        const bool address_b4 = (nibble_address & 0x10) != 0;
+        int wave_address = nibble_address >> 5;
+        const bool xor2 = (address_b4 ^ b7);
+        const bool check1 = xor2 && active;
+        const bool xor1 = (b15 ^ !nibble_cmp1);
+        const bool nibble_add = b6 ? check1 && xor1 : (!nibble_cmp1 && check1);
+        const bool nibble_subtract = b6 && !xor1 && active && !xor2;
+        if (b7)
+            wave_address -= nibble_add - nibble_subtract;
+        else
+            wave_address += nibble_add - nibble_subtract;
+        wave_address &= 0xfffff;
+
+        int newnibble = PCM_ReadROM<Traits>(pcm, (uint32_t)((hiaddr << 20) | wave_address));
+        const bool newnibble_sel = address_b4 ^ ((b6 || !nibble_cmp1) && okey);
+        if (newnibble_sel)
+            newnibble = (newnibble >> 4) & 15;
+        else
+            newnibble &= 15;
+
+        int sub_phase = (ram2[8] & 0x3fff); // 1
+        int interp_ratio = (sub_phase >> 7) & 127;
+        sub_phase += pcm.ram2[ram2[7] & 31][0]; // 5
+        int sub_phase_of = (sub_phase >> 14) & 7;
+        if (pcm.nfs)
+        {
+            ram2[8] &= ~0x3fff;
+            ram2[8] |= sub_phase & 0x3fff;
+        }
+
+
+        // address 0
+        int address_cnt = address;
+        int samp0 = (int8_t)PCM_ReadROM<Traits>(pcm, (uint32_t)((hiaddr << 20) | address_cnt)); // 18
+
+        cmp1 = address;
+        cmp2 = address_cnt;
+        const bool nibble_cmp2 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 8
+        cmp1 = b15 ? address_loop : address_end;
+        cmp2 = address_cnt;
+        bool address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 9
+
+        int next_address = address_cnt; // 11
+        bool usenew = !nibble_cmp2;
+        bool next_b15 = b15;
+
+        cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
+        cmp2 = address_cnt;
+        int address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
+
+        bool address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
+        bool address_sub = !address_cmp && b6 && b15;
+        if (b7)
+            address_cnt2 -= address_add - address_sub;
+        else
+            address_cnt2 += address_add - address_sub;
+        address_cnt = address_cnt2 & 0xfffff; // 11
+        b15 = b6 && (b15 ^ address_cmp); // 11
+
+        int samp1 = (int8_t)PCM_ReadROM<Traits>(pcm, (uint32_t)((hiaddr << 20) | address_cnt)); // 20
+
+        cmp1 = address;
+        cmp2 = address_cnt;
+        const bool nibble_cmp3 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 12
+        cmp1 = b15 ? address_loop : address_end;
+        cmp2 = address_cnt;
+        address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 13
+
+        if (sub_phase_of >= 1)
+        {
+            next_address = address_cnt; // 13
+            usenew = !nibble_cmp3;
+            next_b15 = b15;
+        }
+
+        cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
+        cmp2 = address_cnt;
+        address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
+
+        address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
+        address_sub = !address_cmp && b6 && b15;
+        if (b7)
+            address_cnt2 -= address_add - address_sub;
+        else
+            address_cnt2 += address_add - address_sub;
+        address_cnt = address_cnt2 & 0xfffff; // 15
+        b15 = b6 && (b15 ^ address_cmp); // 15
+
+        int samp2 = (int8_t)PCM_ReadROM<Traits>(pcm, (uint32_t)((hiaddr << 20) | address_cnt)); // 1
+
+        cmp1 = address;
+        cmp2 = address_cnt;
+        const bool nibble_cmp4 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 16
+        cmp1 = b15 ? address_loop : address_end;
+        cmp2 = address_cnt;
+        address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 17
+
+        if (sub_phase_of >= 2)
+        {
+            next_address = address_cnt; // 17
+            usenew = !nibble_cmp4;
+            next_b15 = b15;
+        }
+
+        cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
+        cmp2 = address_cnt;
+        address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
+
+        address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
+        address_sub = !address_cmp && b6 && b15;
+        if (b7)
+            address_cnt2 -= address_add - address_sub;
+        else
+            address_cnt2 += address_add - address_sub;
+        address_cnt = address_cnt2 & 0xfffff; // 19
+        b15 = b6 && (b15 ^ address_cmp); // 19
+
+        int samp3 = (int8_t)PCM_ReadROM<Traits>(pcm, (uint32_t)((hiaddr << 20) | address_cnt)); // 5
+
+        cmp1 = address;
+        cmp2 = address_cnt;
+        const bool nibble_cmp5 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 20
+        cmp1 = b15 ? address_loop : address_end;
+        cmp2 = address_cnt;
+        address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 21
+
+        if (sub_phase_of >= 3)
+        {
+            next_address = address_cnt; // 21
+            usenew = !nibble_cmp5;
+            next_b15 = b15;
+        }
+
+        cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
+        cmp2 = address_cnt;
+        address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
+
+        address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
+        address_sub = !address_cmp && b6 && b15;
+        if (b7)
+            address_cnt2 -= address_add - address_sub;
+        else
+            address_cnt2 += address_add - address_sub;
+        address_cnt = address_cnt2 & 0xfffff; // 23
+        // b15 = b6 && (b15 ^ address_cmp); // 23
+
+        cmp1 = address;
+        cmp2 = address_cnt;
+        const bool nibble_cmp6 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 24
+
+        if (sub_phase_of >= 4)
+        {
+            next_address = address_cnt; // 1
+            usenew = !nibble_cmp6;
+            // b15 is not updated?
+        }
+
+        if (active && pcm.nfs)
+            ram1[4] = (uint32_t)next_address;
+
+        if (pcm.nfs)
+        {
+            ram2[8] &= ~0x8000;
+            ram2[8] |= (uint16_t)(next_b15 << 15);
+        }
+
+        // dpcm
+
+        // 18
+        int reference = (int)ram1[5];
+
+        // 19
+        int preshift = samp0 << 10;
+        int select_nibble = nibble_cmp2 ? old_nibble : newnibble;
+        int shift = (10 - select_nibble) & 15;
+
+        int shifted = (preshift << 1) >> shift;
+
+        if (sub_phase_of >= 1)
+            reference = addclip20(reference, shifted >> 1, shifted & 1);
+
+        preshift = samp1 << 10;
+        select_nibble = nibble_cmp3 ? old_nibble : newnibble;
+        shift = (10 - select_nibble) & 15;
+
+        shifted = (preshift << 1) >> shift;
+
+        if (sub_phase_of >= 2)
+            reference = addclip20(reference, shifted >> 1, shifted & 1);
+
+        preshift = samp2 << 10;
+        select_nibble = nibble_cmp4 ? old_nibble : newnibble;
+        shift = (10 - select_nibble) & 15;
+
+        shifted = (preshift << 1) >> shift;
+
+        if (sub_phase_of >= 3)
+            reference = addclip20(reference, shifted >> 1, shifted & 1);
+
+        preshift = samp3 << 10;
+        select_nibble = nibble_cmp5 ? old_nibble : newnibble;
+        shift = (10 - select_nibble) & 15;
+
+        shifted = (preshift << 1) >> shift;
+
+        if (sub_phase_of >= 4)
+            reference = addclip20(reference, shifted >> 1, shifted & 1);
+
+        // interpolation
+
+        int test = (int)ram1[5];
+
+        int step0 = multi(interp_lut[0][interp_ratio] << 6, (int8_t)samp0) >> 8;
+        select_nibble = nibble_cmp2 ? old_nibble : newnibble;
+        shift = (10 - select_nibble) & 15;
+        step0 =  (step0 << 1) >> shift;
+
+        test = addclip20(test, step0 >> 1, step0 & 1);
+
+
+        int step1 = multi(interp_lut[1][interp_ratio] << 6, (int8_t)samp1) >> 8;
+        select_nibble = nibble_cmp3 ? old_nibble : newnibble;
+        shift = (10 - select_nibble) & 15;
+        step1 = (step1 << 1) >> shift;
+
+        test = addclip20(test, step1 >> 1, step1 & 1);
+
+        int step2 = multi(interp_lut[2][interp_ratio] << 6, (int8_t)samp2) >> 8;
+        select_nibble = nibble_cmp4 ? old_nibble : newnibble;
+        shift = (10 - select_nibble) & 15;
+        step2 = (step2 << 1) >> shift;
+
+        int reg1 = (int)ram1[1];
+        int reg3 = (int)ram1[3];
+        int reg2_6 = (ram2[6] >> 8) & 127;
+
+        test = addclip20(test, step2 >> 1, step2 & 1);
+
+        int filter = ram2[11];
+        int v3;
+
+        if (Traits::is_mk1)
+        {
+            int mult1 = multi(reg1, (int8_t)(filter >> 8)); // 8
+            int mult2 = multi(reg1, (int8_t)((filter >> 1) & 127)); // 9
+            int mult3 = multi(reg1, (int8_t)reg2_6); // 10
+
+            int v2 = addclip20(reg3, mult1 >> 6, (mult1 >> 5) & 1); // 9
+            int v1 = addclip20(v2, mult2 >> 13, (mult2 >> 12) & 1); // 10
+            int subvar = addclip20(v1, (mult3 >> 6), (mult3 >> 5) & 1); // 11
+
+            ram1[3] = (uint32_t)v1;
+
+            v3 = addclip20(test, subvar ^ 0xfffff, 1); // 12
+
+            int mult4 = multi(v3, (int8_t)(filter >> 8));
+            int mult5 = multi(v3, (int8_t)((filter >> 1) & 127));
+            int v4 = addclip20(reg1, mult4 >> 6, (mult4 >> 5) & 1); // 14
+            int v5 = addclip20(v4, mult5 >> 13, (mult5 >> 12) & 1); // 15
+
+            ram1[1] = (uint32_t)v5;
+        }
+        else
+        {
+            // hack: use 32-bit math to avoid overflow
+            int mult1 = reg1 * (int8_t)(filter >> 8); // 8
+            int mult2 = reg1 * (int8_t)((filter >> 1) & 127); // 9
+            int mult3 = reg1 * (int8_t)reg2_6; // 10
+
+            int v2 = reg3 + (mult1 >> 6) + ((mult1 >> 5) & 1); // 9
+            int v1 = v2 + (mult2 >> 13) + ((mult2 >> 12) & 1); // 10
+            int subvar = v1 + (mult3 >> 6) + ((mult3 >> 5) & 1); // 11
+
+            ram1[3] = (uint32_t)v1;
+
+            int tests = test;
+            tests <<= 12;
+            tests >>= 12;
+
+            v3 = tests - subvar; // 12
+
+            int mult4 = v3 * (int8_t)(filter >> 8);
+            int mult5 = v3 * (int8_t)((filter >> 1) & 127);
+            int v4 = reg1 + (mult4 >> 6) + ((mult4 >> 5) & 1); // 14
+            int v5 = v4 + (mult5 >> 13) + ((mult5 >> 12) & 1); // 15
+
+            ram1[1] = (uint32_t)v5;
+        }
+
+
+        ram1[5] = (uint32_t)reference;
+
+        PCM_CheckVoiceIrq<Traits>(pcm, slot, active, irq_flag);
+
+        int volmul1 = 0;
+        int volmul2 = 0;
+
+        calc_tv(pcm, 0, ram2[3], &ram2[9], active, &volmul1);
+        calc_tv(pcm, 1, ram2[4], &ram2[10], active, &volmul2);
+        calc_tv(pcm, 2, ram2[5], &ram2[11], active, NULL);
+
+        // if (volmul1 && volmul2)
+        //     volmul1 += 0;
+
+        int sample = (ram2[6] & 2) == 0 ? (int)ram1[3] : v3;
+        //sample = test;
+
+        int multiv1 = multi(sample, (int8_t)(volmul1 >> 8));
+        int multiv2 = multi(sample, (int8_t)((volmul1 >> 1) & 127));
+
+        int sample2 = addclip20(multiv1 >> 6, multiv2 >> 13, ((multiv2 >> 12) | (multiv1 >> 5)) & 1);
+
+        int multiv3 = multi(sample2, (int8_t)(volmul2 >> 8));
+        int multiv4 = multi(sample2, (int8_t)((volmul2 >> 1) & 127));
+
+        int sample3 = addclip20(multiv3 >> 6, multiv4 >> 13, ((multiv4 >> 12) | (multiv3 >> 5)) & 1);
+
+        int pan = active ? ram2[1] : 0;
+        int rc = active ? ram2[2] : 0;
+
+        int sampl = multi(sample3, (int8_t)((pan >> 8) & 255));
+        int sampr = multi(sample3, (int8_t)((pan >> 0) & 255));
+
+        int rc0 = multi(sample3, (int8_t)((rc >> 8) & 255)) >> 5; // reverb
+        int rc1 = multi(sample3, (int8_t)((rc >> 0) & 255)) >> 5; // chorus
+        
+        PCM_MixSlot(pcm, slot, sampl, sampr, rc0, rc1, rcadd, rcadd2);
+
+        if (key && pcm.nfs)
+        {
+            ram2[7] &= ~0xf020;
+            ram2[7] |= (uint16_t)(((usenew || kon) ? newnibble : old_nibble) << 12);
+
+            // update key
+            ram2[7] |= (uint16_t)(key << 5);
+        }
+
+        if (!active)
+        {
+            if (pcm.nfs)
+            {
+                ram1[1] = 0;
+                ram1[3] = 0;
+                ram1[5] = 0;
+            }
+
+            ram2[8] = 0;
+            ram2[9] = 0;
+            ram2[10] = 0;
+        }
+    }
+}
+
+// The vector engine keeps rows 28-31 out of its lanes since the reverb and chorus state lives there.
+constexpr int PCM_VECTOR_LANES     = 32;
+constexpr int PCM_VECTOR_MAX_SLOTS = 28;
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && (!defined(__clang__) || __clang_major__ >= 14)
+// The lane loops are plain C++ written so that the compiler can vectorize them. On x86-64 we additionally build AVX2
+// and AVX-512 versions of them and select one when the program is loaded.
+#define PCM_VECTOR_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define PCM_VECTOR_CLONES
+#endif
+
+// Per-lane helpers must be inlined into the lane loops or the loops won't vectorize.
+#if defined(__GNUC__)
+#define PCM_LANE_INLINE inline __attribute__((always_inline))
+#else
+#define PCM_LANE_INLINE inline
+#endif
+
+// Voice slot state in structure-of-arrays form. Every stage of the vector engine is a loop over all lanes; lanes at or
+// above reg_slots are zero-filled and their results are discarded.
+struct alignas(64) PCM_VoiceLanes
+{
+    // inputs, copied from ram1/ram2
+    int32_t key[PCM_VECTOR_LANES];
+    int32_t address_end[PCM_VECTOR_LANES];
+    int32_t reg1[PCM_VECTOR_LANES];
+    int32_t address_loop[PCM_VECTOR_LANES];
+    int32_t reg3[PCM_VECTOR_LANES];
+    int32_t address[PCM_VECTOR_LANES];
+    int32_t reference[PCM_VECTOR_LANES];
+    int32_t pitch[PCM_VECTOR_LANES];
+    int32_t pan[PCM_VECTOR_LANES];
+    int32_t rc[PCM_VECTOR_LANES];
+    int32_t tv_adjust[3][PCM_VECTOR_LANES];
+    int32_t ctrl6[PCM_VECTOR_LANES];
+    int32_t ctrl7[PCM_VECTOR_LANES];
+    int32_t phase[PCM_VECTOR_LANES];
+    int32_t level[3][PCM_VECTOR_LANES];
+
+    // address generator results
+    int32_t rom_nibble[PCM_VECTOR_LANES];
+    int32_t rom_sample[4][PCM_VECTOR_LANES];
+    int32_t nibble_high[PCM_VECTOR_LANES];
+    int32_t use_old_nibble[4][PCM_VECTOR_LANES]; // [0] is unused, the first sample always uses the old nibble
+    int32_t sub_phase_of[PCM_VECTOR_LANES];
+    int32_t interp_ratio[PCM_VECTOR_LANES];
+    int32_t irq_flag[PCM_VECTOR_LANES];
+    int32_t usenew[PCM_VECTOR_LANES];
+    int32_t next_address[PCM_VECTOR_LANES];
+    int32_t next_phase[PCM_VECTOR_LANES];
+
+    // fetched from wave rom
+    int32_t nibble_byte[PCM_VECTOR_LANES];
+    int32_t sample[4][PCM_VECTOR_LANES];
+
+    // sample results
+    int32_t newnibble[PCM_VECTOR_LANES];
+    int32_t next_reference[PCM_VECTOR_LANES];
+    int32_t next_reg1[PCM_VECTOR_LANES];
+    int32_t next_reg3[PCM_VECTOR_LANES];
+    int32_t sampl[PCM_VECTOR_LANES];
+    int32_t sampr[PCM_VECTOR_LANES];
+    int32_t rc0[PCM_VECTOR_LANES];
+    int32_t rc1[PCM_VECTOR_LANES];
+};
+
+// calc_tv inputs that only depend on tv_counter, indexed by envelope rate. Rate 4 is used by the slow envelope types.
+struct PCM_TvCounterBits
+{
+    int32_t addlow[5];
+    int32_t write[5];
+};
+
+static PCM_TvCounterBits PCM_GetTvCounterBits(uint16_t tv_counter)
+{
+    // addlow takes 4 bits of tv_counter in reverse order
+    auto reverse4 = [](int bits) { return ((bits & 1) << 3) | ((bits & 2) << 1) | ((bits & 4) >> 1) | ((bits & 8) >> 3); };
+
+    PCM_TvCounterBits bits;
+    bits.addlow[0] = reverse4((tv_counter >> 2) & 15);
+    bits.addlow[1] = reverse4((tv_counter >> 4) & 15);
+    bits.addlow[2] = reverse4((tv_counter >> 6) & 15);
+    bits.addlow[3] = reverse4((tv_counter >> 8) & 15);
+    bits.addlow[4] = reverse4(tv_counter & 15);
+    bits.write[0]  = (tv_counter & 3) == 0;
+    bits.write[1]  = (tv_counter & 15) == 0;
+    bits.write[2]  = (tv_counter & 63) == 0;
+    bits.write[3]  = (tv_counter & 127) == 0;
+    bits.write[4]  = 1;
+    return bits;
+}
+
+// Returns `a` where `mask` is all ones and `b` where it is zero. Used instead of selects on values that are tested
+// more than once, which compilers otherwise tend to turn back into branches.
+PCM_LANE_INLINE int32_t PCM_BlendLane(int32_t mask, int32_t a, int32_t b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+// Branch-free equivalent of calc_tv for a single lane. Returns volmul for envelopes 0 and 1.
+template <int E>
+PCM_LANE_INLINE int32_t PCM_CalcTvLane(const PCM_TvCounterBits& tv, int32_t nfs, int32_t adjust, int32_t& level,
+                                       int32_t active)
+{
+    const int32_t levelcur = level & 0x7fff;
+    const int32_t speed    = adjust & 0xff;
+    const int32_t target   = (adjust >> 8) & 0xff;
+
+    const int32_t s20 = (speed >> 5) & 1;
+    const int32_t s40 = (speed >> 6) & 1;
+    const int32_t s80 = (speed >> 7) & 1;
+    const int32_t w1  = (speed & 0xf0) == 0;
+    const int32_t w2  = w1 | ((speed >> 4) & 1);
+    const int32_t w3  = -(nfs & ((s80 ^ 1) | ((s40 ^ 1) & ((w2 ^ 1) | (s20 ^ 1)))));
+
+    const int32_t rate   = PCM_BlendLane(-(s80 & s40), w2 | (s20 << 1), 4);
+    const int32_t addlow = tv.addlow[rate];
+    const int32_t write  = -(((active ^ 1) | tv.write[rate]) & nfs);
+    const int32_t track  = -(int32_t)(E != 2 || active);
+
+    const int32_t target11 = target << 11;
+    const int32_t sum1     = target11 - ((levelcur << 4) & track);
+
+    // linear
+    const int32_t shift_lin = (10 - (speed & 15)) & 15;
+    const int32_t sum2_lin  = target11 + addlow + ((sum1 >> shift_lin) - sum1);
+
+    // exponential
+    const int32_t neg       = (sum1 >> 19) & 1;
+    const int32_t shift_exp = (10 - (((speed >> 4) & 14) | w2)) & 15;
+    const int32_t preshift  = (((speed & 15) << 9) | ((w1 ^ 1) << 13)) ^ (~0x3f & -neg);
+    const int32_t sum2_exp  = (preshift >> shift_exp) + (((levelcur << 4) | addlow) & track);
+    const int32_t sum2_l    = sum2_exp >> 4;
+    const int32_t sum3      = target11 - (sum2_l << 4);
+    const int32_t xnor      = -((((sum3 >> 19) & 1) ^ neg) ^ 1);
+
+    const int32_t level_exp = PCM_BlendLane(xnor, sum2_l & 0x7fff, target << 7);
+    level = PCM_BlendLane(write, PCM_BlendLane(w3, level_exp, (sum2_lin >> 4) & 0x7fff), levelcur);
+
+    const int32_t volmul_lin = (sum2_lin >> 4) & 0x7ffe;
+    if (E == 0)
+        return PCM_BlendLane(w3, sum2_l & 0x7ffe, volmul_lin);
+    else if (E == 1)
+        return PCM_BlendLane(w3, PCM_BlendLane(xnor, sum2_l & 0x7ffe, target << 7), volmul_lin);
+    else
+        return 0;
+}
+
+// One step of the voice address counter, see the address generator in PCM_UpdateVoicesScalar.
+PCM_LANE_INLINE void PCM_AddressStepLane(int32_t& cnt, int32_t& b15, int32_t& address_cmp, int32_t b6, int32_t b7,
+                                int32_t address_loop, int32_t address_end)
+{
+    const int32_t reload = (b6 ^ 1) & address_cmp;
+    const int32_t add    = (address_cmp ^ 1) & ((b6 ^ 1) | (b15 ^ 1));
+    const int32_t sub    = (address_cmp ^ 1) & b6 & b15;
+    const int32_t cnt2   = reload ? address_loop : cnt;
+    cnt         = (cnt2 + (b7 ? sub - add : add - sub)) & 0xfffff;
+    b15         = b6 & (b15 ^ address_cmp);
+    address_cmp = (((b15 ? address_loop : address_end) ^ cnt) & 0xfffff) == 0;
+}
+
+PCM_VECTOR_CLONES
+static void PCM_VectorAddress(PCM_VoiceLanes& v, int32_t nfs)
+{
+    for (int l = 0; l < PCM_VECTOR_LANES; ++l)
+    {
+        const int32_t ctrl7        = v.ctrl7[l];
+        const int32_t okey         = (ctrl7 >> 5) & 1;
+        const int32_t key          = v.key[l];
+        const int32_t active       = okey & key;
+        const int32_t kon          = key & (okey ^ 1);
+        const int32_t b6           = (ctrl7 >> 6) & 1;
+        const int32_t b7           = (ctrl7 >> 7) & 1;
+        const int32_t hiaddr       = ((ctrl7 >> 8) & 15) << 20;
+        const int32_t phase        = v.phase[l];
+        const int32_t address      = v.address[l];
+        const int32_t address_end  = v.address_end[l];
+        const int32_t address_loop = v.address_loop[l];
+        int32_t b15                = (phase >> 15) & 1;
+
+        // nibble fetch
+        const int32_t cmp1        = b15 ? address_loop : address_end;
+        const int32_t nibble_cmp1 = ((cmp1 ^ address) & 0xffff0) == 0;
+        const uint32_t irq_sum    = kon ? (uint32_t)cmp1 + (uint32_t)address_loop
+                                        : (uint32_t)address + ((uint32_t)-address_loop & 0xfffff);
+        v.irq_flag[l] = (int32_t)((irq_sum >> 20) & 1) ^ b7;
+
+        const int32_t nibble_address = ((b6 ^ 1) & nibble_cmp1) ? address_loop : address;
+        const int32_t address_b4     = (nibble_address >> 4) & 1;
+        const int32_t xor2           = address_b4 ^ b7;
+        const int32_t check1         = xor2 & active;
+        const int32_t xor1           = b15 ^ nibble_cmp1 ^ 1;
+        const int32_t nibble_add     = b6 ? check1 & xor1 : (nibble_cmp1 ^ 1) & check1;
+        const int32_t nibble_sub     = b6 & (xor1 ^ 1) & active & (xor2 ^ 1);
+        const int32_t nibble_delta   = nibble_add - nibble_sub;
+        v.rom_nibble[l]  = hiaddr | (((nibble_address >> 5) + (b7 ? -nibble_delta : nibble_delta)) & 0xfffff);
+        v.nibble_high[l] = address_b4 ^ ((b6 | (nibble_cmp1 ^ 1)) & okey);
+
+        const int32_t sub_phase    = (phase & 0x3fff) + v.pitch[l];
+        const int32_t sub_phase_of = (sub_phase >> 14) & 7;
+        v.interp_ratio[l]          = (phase >> 7) & 127;
+        v.sub_phase_of[l]          = sub_phase_of;
+
+        // sample fetches, the first one is always from the current address
+        int32_t cnt         = address;
+        int32_t address_cmp = ((cmp1 ^ cnt) & 0xfffff) == 0;
+        int32_t next_b15    = b15;
+        int32_t usenew      = 0;
+        v.rom_sample[0][l]  = hiaddr | cnt;
+
+        PCM_AddressStepLane(cnt, b15, address_cmp, b6, b7, address_loop, address_end);
+        int32_t same_nibble = ((address ^ cnt) & 0xffff0) == 0;
+        v.rom_sample[1][l]     = hiaddr | cnt;
+        v.use_old_nibble[1][l] = same_nibble;
+        int32_t next_address   = sub_phase_of >= 1 ? cnt : address;
+        usenew                 = sub_phase_of >= 1 ? same_nibble ^ 1 : usenew;
+        next_b15               = sub_phase_of >= 1 ? b15 : next_b15;
+
+        PCM_AddressStepLane(cnt, b15, address_cmp, b6, b7, address_loop, address_end);
+        same_nibble            = ((address ^ cnt) & 0xffff0) == 0;
+        v.rom_sample[2][l]     = hiaddr | cnt;
+        v.use_old_nibble[2][l] = same_nibble;
+        next_address           = sub_phase_of >= 2 ? cnt : next_address;
+        usenew                 = sub_phase_of >= 2 ? same_nibble ^ 1 : usenew;
+        next_b15               = sub_phase_of >= 2 ? b15 : next_b15;
+
+        PCM_AddressStepLane(cnt, b15, address_cmp, b6, b7, address_loop, address_end);
+        same_nibble            = ((address ^ cnt) & 0xffff0) == 0;
+        v.rom_sample[3][l]     = hiaddr | cnt;
+        v.use_old_nibble[3][l] = same_nibble;
+        next_address           = sub_phase_of >= 3 ? cnt : next_address;
+        usenew                 = sub_phase_of >= 3 ? same_nibble ^ 1 : usenew;
+        next_b15               = sub_phase_of >= 3 ? b15 : next_b15;
+
+        // the last step doesn't update b15
+        PCM_AddressStepLane(cnt, b15, address_cmp, b6, b7, address_loop, address_end);
+        same_nibble  = ((address ^ cnt) & 0xffff0) == 0;
+        next_address = sub_phase_of >= 4 ? cnt : next_address;
+        usenew       = sub_phase_of >= 4 ? same_nibble ^ 1 : usenew;
+
+        v.usenew[l]       = usenew;
+        v.next_address[l] = (active & nfs) ? next_address : address;
+        v.next_phase[l]   = nfs ? (phase & 0x4000) | (sub_phase & 0x3fff) | (next_b15 << 15) : phase;
+    }
+}
+
+// multi() with the second operand sign extended from its low byte, written with shifts so that it vectorizes.
+PCM_LANE_INLINE int32_t PCM_MultiLane(int32_t val1, int32_t val2)
+{
+    return sx20(val1) * ((val2 << 24) >> 24);
+}
+
+// Applies a dpcm step if sub_phase_of is at least `step`. The condition is turned into a mask rather than a select on
+// sub_phase_of, which compilers tend to turn back into a branch.
+PCM_LANE_INLINE int32_t PCM_DpcmStepLane(int32_t reference, int32_t sample, int32_t shift, int32_t sub_phase_of, int32_t step)
+{
+    const int32_t shifted = ((sample << 10) << 1) >> shift;
+    const int32_t mask    = -(((sub_phase_of + 8 - step) >> 3) & 1);
+    return (addclip20(reference, shifted >> 1, shifted & 1) & mask) | (reference & ~mask);
+}
+
+PCM_LANE_INLINE int32_t PCM_InterpStepLane(int32_t test, int32_t lut, int32_t sample, int32_t shift)
+{
+    int32_t step = PCM_MultiLane(lut << 6, sample) >> 8;
+    step         = (step << 1) >> shift;
+    return addclip20(test, step >> 1, step & 1);
+}
+
+template <bool IsMK1>
+PCM_VECTOR_CLONES
+static void PCM_VectorSample(PCM_VoiceLanes& v, PCM_TvCounterBits tv, int32_t nfs)
+{
+    for (int l = 0; l < PCM_VECTOR_LANES; ++l)
+    {
+        const int32_t ctrl6  = v.ctrl6[l];
+        const int32_t ctrl7  = v.ctrl7[l];
+        const int32_t active = ((ctrl7 >> 5) & 1) & v.key[l];
+
+        const int32_t byte       = v.nibble_byte[l];
+        const int32_t newnibble  = v.nibble_high[l] ? (byte >> 4) & 15 : byte & 15;
+        const int32_t old_nibble = (ctrl7 >> 12) & 15;
+        v.newnibble[l]           = newnibble;
+
+        const int32_t shift0 = (10 - old_nibble) & 15;
+        const int32_t shift1 = (10 - (v.use_old_nibble[1][l] ? old_nibble : newnibble)) & 15;
+        const int32_t shift2 = (10 - (v.use_old_nibble[2][l] ? old_nibble : newnibble)) & 15;
+        const int32_t shift3 = (10 - (v.use_old_nibble[3][l] ? old_nibble : newnibble)) & 15;
+        const int32_t samp0  = v.sample[0][l];
+        const int32_t samp1  = v.sample[1][l];
+        const int32_t samp2  = v.sample[2][l];
+        const int32_t samp3  = v.sample[3][l];
+
+        // dpcm
+        const int32_t sub_phase_of = v.sub_phase_of[l];
+        int32_t reference          = v.reference[l];
+        reference           = PCM_DpcmStepLane(reference, samp0, shift0, sub_phase_of, 1);
+        reference           = PCM_DpcmStepLane(reference, samp1, shift1, sub_phase_of, 2);
+        reference           = PCM_DpcmStepLane(reference, samp2, shift2, sub_phase_of, 3);
+        reference           = PCM_DpcmStepLane(reference, samp3, shift3, sub_phase_of, 4);
+        v.next_reference[l] = reference;
+
+        // interpolation
+        const int32_t interp_ratio = v.interp_ratio[l];
+        int32_t test               = v.reference[l];
+        test = PCM_InterpStepLane(test, interp_lut[0][interp_ratio], samp0, shift0);
+        test = PCM_InterpStepLane(test, interp_lut[1][interp_ratio], samp1, shift1);
+        test = PCM_InterpStepLane(test, interp_lut[2][interp_ratio], samp2, shift2);
+
+        // filter
+        const int32_t reg1   = v.reg1[l];
+        const int32_t reg3   = v.reg3[l];
+        const int32_t reg2_6 = (ctrl6 >> 8) & 127;
+        const int32_t filter = v.level[2][l];
+        const int32_t coef1  = ((filter >> 8) << 24) >> 24;
+        const int32_t coef2  = (filter >> 1) & 127;
+        int32_t v1, v3, v5;
+        if (IsMK1)
+        {
+            const int32_t mult1  = sx20(reg1) * coef1;
+            const int32_t mult2  = sx20(reg1) * coef2;
+            const int32_t mult3  = sx20(reg1) * reg2_6;
+            const int32_t v2     = addclip20(reg3, mult1 >> 6, (mult1 >> 5) & 1);
+            v1                   = addclip20(v2, mult2 >> 13, (mult2 >> 12) & 1);
+            const int32_t subvar = addclip20(v1, (mult3 >> 6), (mult3 >> 5) & 1);
+            v3                   = addclip20(test, subvar ^ 0xfffff, 1);
+            const int32_t mult4  = sx20(v3) * coef1;
+            const int32_t mult5  = sx20(v3) * coef2;
+            const int32_t v4     = addclip20(reg1, mult4 >> 6, (mult4 >> 5) & 1);
+            v5                   = addclip20(v4, mult5 >> 13, (mult5 >> 12) & 1);
+        }
+        else
+        {
+            const int32_t mult1  = reg1 * coef1;
+            const int32_t mult2  = reg1 * coef2;
+            const int32_t mult3  = reg1 * reg2_6;
+            const int32_t v2     = reg3 + (mult1 >> 6) + ((mult1 >> 5) & 1);
+            v1                   = v2 + (mult2 >> 13) + ((mult2 >> 12) & 1);
+            const int32_t subvar = v1 + (mult3 >> 6) + ((mult3 >> 5) & 1);
+            v3                   = sx20(test) - subvar;
+            const int32_t mult4  = v3 * coef1;
+            const int32_t mult5  = v3 * coef2;
+            const int32_t v4     = reg1 + (mult4 >> 6) + ((mult4 >> 5) & 1);
+            v5                   = v4 + (mult5 >> 13) + ((mult5 >> 12) & 1);
+        }
+        v.next_reg1[l] = v5;
+        v.next_reg3[l] = v1;
+
+        // envelopes
+        const int32_t volmul1 = PCM_CalcTvLane<0>(tv, nfs, v.tv_adjust[0][l], v.level[0][l], active);
+        const int32_t volmul2 = PCM_CalcTvLane<1>(tv, nfs, v.tv_adjust[1][l], v.level[1][l], active);
+        PCM_CalcTvLane<2>(tv, nfs, v.tv_adjust[2][l], v.level[2][l], active);
+
+        // volume and pan
+        const int32_t sample = (ctrl6 & 2) == 0 ? v1 : v3;
+
+        const int32_t multiv1 = PCM_MultiLane(sample, volmul1 >> 8);
+        const int32_t multiv2 = PCM_MultiLane(sample, (volmul1 >> 1) & 127);
+        const int32_t sample2 = addclip20(multiv1 >> 6, multiv2 >> 13, ((multiv2 >> 12) | (multiv1 >> 5)) & 1);
+
+        const int32_t multiv3 = PCM_MultiLane(sample2, volmul2 >> 8);
+        const int32_t multiv4 = PCM_MultiLane(sample2, (volmul2 >> 1) & 127);
+        const int32_t sample3 = addclip20(multiv3 >> 6, multiv4 >> 13, ((multiv4 >> 12) | (multiv3 >> 5)) & 1);
+
+        const int32_t pan = active ? v.pan[l] : 0;
+        const int32_t rc  = active ? v.rc[l] : 0;
+
+        v.sampl[l] = PCM_MultiLane(sample3, pan >> 8);
+        v.sampr[l] = PCM_MultiLane(sample3, pan);
+        v.rc0[l]   = PCM_MultiLane(sample3, rc >> 8) >> 5;
+        v.rc1[l]   = PCM_MultiLane(sample3, rc) >> 5;
+    }
+}
+
+// Same results as PCM_UpdateVoicesScalar, but processes each stage for all slots at once. Only the wave rom reads and
+// the parts that depend on earlier slots (irq and mixing) are done one slot at a time. Requires reg_slots to be at most
+// PCM_VECTOR_MAX_SLOTS.
+template <typename Traits>
+static void PCM_UpdateVoicesVector(pcm_t& pcm, uint32_t voice_active, const int* rcadd, const int* rcadd2)
+{
+    const int slots   = pcm.config.reg_slots;
+    const int32_t nfs = pcm.nfs;
+
+    PCM_VoiceLanes v;
+    for (int l = 0; l < PCM_VECTOR_LANES; ++l)
+    {
+        // lanes past the last slot read row 0 so that they are well defined, but they are never written back
+        const int slot        = l < slots ? l : 0;
+        const uint32_t* ram1  = pcm.ram1[slot];
+        const uint16_t* ram2  = pcm.ram2[slot];
+        v.key[l]              = l < slots ? (voice_active >> l) & 1 : 0;
+        v.address_end[l]      = (int32_t)ram1[0];
+        v.reg1[l]             = (int32_t)ram1[1];
+        v.address_loop[l]     = (int32_t)ram1[2];
+        v.reg3[l]             = (int32_t)ram1[3];
+        v.address[l]          = (int32_t)ram1[4];
+        v.reference[l]        = (int32_t)ram1[5];
+        v.pitch[l]            = pcm.ram2[ram2[7] & 31][0];
+        v.pan[l]              = ram2[1];
+        v.rc[l]               = ram2[2];
+        v.tv_adjust[0][l]     = ram2[3];
+        v.tv_adjust[1][l]     = ram2[4];
+        v.tv_adjust[2][l]     = ram2[5];
+        v.ctrl6[l]            = ram2[6];
+        v.ctrl7[l]            = ram2[7];
+        v.phase[l]            = ram2[8];
+        v.level[0][l]         = ram2[9];
+        v.level[1][l]         = ram2[10];
+        v.level[2][l]         = ram2[11];
+    }
+
+    PCM_VectorAddress(v, nfs);
+
+    // idle slots don't use their samples, see PCM_UpdateIdleSlot
+    const bool skip_idle = pcm.skip_idle_voices && pcm.nfs;
+    for (int l = 0; l < PCM_VECTOR_LANES; ++l)
+    {
+        if (l < slots && (v.key[l] || !skip_idle))
+        {
+            v.nibble_byte[l] = PCM_ReadROM<Traits>(pcm, (uint32_t)v.rom_nibble[l]);
+            for (int i = 0; i < 4; ++i)
+            {
+                v.sample[i][l] = (int8_t)PCM_ReadROM<Traits>(pcm, (uint32_t)v.rom_sample[i][l]);
+            }
+        }
+        else
+        {
+            v.nibble_byte[l] = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                v.sample[i][l] = 0;
+            }
+        }
+    }
+
+    PCM_VectorSample<Traits::is_mk1>(v, PCM_GetTvCounterBits(pcm.tv_counter), nfs);
+
+    for (int slot = 0; slot < slots; ++slot)
+    {
+        uint32_t* ram1    = pcm.ram1[slot];
+        uint16_t* ram2    = pcm.ram2[slot];
+        const bool key    = v.key[slot];
+        const bool okey   = (ram2[7] & 0x20) != 0;
+        const bool active = okey && key;
+        const bool kon    = key && !okey;
+
+        ram1[1]  = (uint32_t)v.next_reg1[slot];
+        ram1[3]  = (uint32_t)v.next_reg3[slot];
+        ram1[4]  = (uint32_t)v.next_address[slot];
+        ram1[5]  = (uint32_t)v.next_reference[slot];
+        ram2[8]  = (uint16_t)v.next_phase[slot];
+        ram2[9]  = (uint16_t)v.level[0][slot];
+        ram2[10] = (uint16_t)v.level[1][slot];
+        ram2[11] = (uint16_t)v.level[2][slot];
+
+        PCM_CheckVoiceIrq<Traits>(pcm, slot, active, v.irq_flag[slot]);
+
+        PCM_MixSlot(pcm, slot, v.sampl[slot], v.sampr[slot], v.rc0[slot], v.rc1[slot], rcadd, rcadd2);
+
+        if (key && pcm.nfs)
+        {
+            const int old_nibble = (ram2[7] >> 12) & 15;
+            ram2[7] &= ~0xf020;
+            ram2[7] |= (uint16_t)(((v.usenew[slot] || kon) ? v.newnibble[slot] : old_nibble) << 12);
+
+            // update key
+            ram2[7] |= (uint16_t)(key << 5);
+        }
+
+        if (!active)
+        {
+            if (pcm.nfs)
+            {
+                ram1[1] = 0;
+                ram1[3] = 0;
+                ram1[5] = 0;
+            }
+
+            ram2[8] = 0;
+            ram2[9] = 0;
+            ram2[10] = 0;
+        }
+    }
+}
+
+template <typename Traits>
 void PCM_Update(pcm_t& pcm, uint64_t cycles)
 {
     while (pcm.cycles < cycles)
@@ -1099,466 +2095,10 @@ void PCM_Update(pcm_t& pcm, uint64_t cycles)
         pcm.rcsum[0] = 0;
         pcm.rcsum[1] = 0;
 
-        for (int slot = 0; slot < pcm.config.reg_slots; slot++)
-        {
-            uint32_t *ram1 = pcm.ram1[slot];
-            uint16_t *ram2 = pcm.ram2[slot];
-            const bool okey = (ram2[7] & 0x20) != 0;
-            const bool key = (voice_active >> slot) & 1;
-
-            const bool active = okey && key;
-            const bool kon = key && !okey;
-
-            // address generator
-
-            bool b15 = (ram2[8] & 0x8000) != 0; // 0
-            const bool b6 = (ram2[7] & 0x40) != 0; // 1
-            const bool b7 = (ram2[7] & 0x80) != 0; // 1
-            int hiaddr = (ram2[7] >> 8) & 15; // 1
-            int old_nibble = (ram2[7] >> 12) & 15; // 1
-
-            int address = (int)ram1[4]; // 0
-            int address_end = (int)ram1[0]; // 1 or 2
-            int address_loop = (int)ram1[2]; // 2 or 1
-
-            int cmp1 = b15 ? address_loop : address_end;
-            int cmp2 = address;
-            const bool nibble_cmp1 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 2
-            bool irq_flag = 0;
-
-            // fixme:
-            if (kon)
-                irq_flag = ((cmp1 + address_loop) & 0x100000) != 0;
-            else
-                irq_flag = ((address + ((-address_loop) & 0xfffff)) & 0x100000) != 0;
-            irq_flag ^= b7;
-
-            int nibble_address = (!b6 && nibble_cmp1) ? address_loop : address; // 3
-            const bool address_b4 = (nibble_address & 0x10) != 0;
-            int wave_address = nibble_address >> 5;
-            const bool xor2 = (address_b4 ^ b7);
-            const bool check1 = xor2 && active;
-            const bool xor1 = (b15 ^ !nibble_cmp1);
-            const bool nibble_add = b6 ? check1 && xor1 : (!nibble_cmp1 && check1);
-            const bool nibble_subtract = b6 && !xor1 && active && !xor2;
-            if (b7)
-                wave_address -= nibble_add - nibble_subtract;
-            else
-                wave_address += nibble_add - nibble_subtract;
-            wave_address &= 0xfffff;
-
-            int newnibble = PCM_ReadROM(pcm, (uint32_t)((hiaddr << 20) | wave_address));
-            const bool newnibble_sel = address_b4 ^ ((b6 || !nibble_cmp1) && okey);
-            if (newnibble_sel)
-                newnibble = (newnibble >> 4) & 15;
-            else
-                newnibble &= 15;
-
-            int sub_phase = (ram2[8] & 0x3fff); // 1
-            int interp_ratio = (sub_phase >> 7) & 127;
-            sub_phase += pcm.ram2[ram2[7] & 31][0]; // 5
-            int sub_phase_of = (sub_phase >> 14) & 7;
-            if (pcm.nfs)
-            {
-                ram2[8] &= ~0x3fff;
-                ram2[8] |= sub_phase & 0x3fff;
-            }
-
-
-            // address 0
-            int address_cnt = address;
-            int samp0 = (int8_t)PCM_ReadROM(pcm, (uint32_t)((hiaddr << 20) | address_cnt)); // 18
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            const bool nibble_cmp2 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 8
-            cmp1 = b15 ? address_loop : address_end;
-            cmp2 = address_cnt;
-            bool address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 9
-
-            int next_address = address_cnt; // 11
-            bool usenew = !nibble_cmp2;
-            bool next_b15 = b15;
-
-            cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
-            cmp2 = address_cnt;
-            int address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
-
-            bool address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
-            bool address_sub = !address_cmp && b6 && b15;
-            if (b7)
-                address_cnt2 -= address_add - address_sub;
-            else
-                address_cnt2 += address_add - address_sub;
-            address_cnt = address_cnt2 & 0xfffff; // 11
-            b15 = b6 && (b15 ^ address_cmp); // 11
-
-            int samp1 = (int8_t)PCM_ReadROM(pcm, (uint32_t)((hiaddr << 20) | address_cnt)); // 20
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            const bool nibble_cmp3 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 12
-            cmp1 = b15 ? address_loop : address_end;
-            cmp2 = address_cnt;
-            address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 13
-
-            if (sub_phase_of >= 1)
-            {
-                next_address = address_cnt; // 13
-                usenew = !nibble_cmp3;
-                next_b15 = b15;
-            }
-
-            cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
-            cmp2 = address_cnt;
-            address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
-
-            address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
-            address_sub = !address_cmp && b6 && b15;
-            if (b7)
-                address_cnt2 -= address_add - address_sub;
-            else
-                address_cnt2 += address_add - address_sub;
-            address_cnt = address_cnt2 & 0xfffff; // 15
-            b15 = b6 && (b15 ^ address_cmp); // 15
-
-            int samp2 = (int8_t)PCM_ReadROM(pcm, (uint32_t)((hiaddr << 20) | address_cnt)); // 1
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            const bool nibble_cmp4 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 16
-            cmp1 = b15 ? address_loop : address_end;
-            cmp2 = address_cnt;
-            address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 17
-
-            if (sub_phase_of >= 2)
-            {
-                next_address = address_cnt; // 17
-                usenew = !nibble_cmp4;
-                next_b15 = b15;
-            }
-
-            cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
-            cmp2 = address_cnt;
-            address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
-
-            address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
-            address_sub = !address_cmp && b6 && b15;
-            if (b7)
-                address_cnt2 -= address_add - address_sub;
-            else
-                address_cnt2 += address_add - address_sub;
-            address_cnt = address_cnt2 & 0xfffff; // 19
-            b15 = b6 && (b15 ^ address_cmp); // 19
-
-            int samp3 = (int8_t)PCM_ReadROM(pcm, (uint32_t)((hiaddr << 20) | address_cnt)); // 5
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            const bool nibble_cmp5 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 20
-            cmp1 = b15 ? address_loop : address_end;
-            cmp2 = address_cnt;
-            address_cmp = (cmp1 & 0xfffff) == (cmp2 & 0xfffff); // 21
-
-            if (sub_phase_of >= 3)
-            {
-                next_address = address_cnt; // 21
-                usenew = !nibble_cmp5;
-                next_b15 = b15;
-            }
-
-            cmp1 = (!b6 && address_cmp) ? address_loop : address_cnt;
-            cmp2 = address_cnt;
-            address_cnt2 = (kon || (!b6 && address_cmp)) ? cmp1 : cmp2;
-
-            address_add = (!address_cmp && b6 && !b15) || (!address_cmp && !b6);
-            address_sub = !address_cmp && b6 && b15;
-            if (b7)
-                address_cnt2 -= address_add - address_sub;
-            else
-                address_cnt2 += address_add - address_sub;
-            address_cnt = address_cnt2 & 0xfffff; // 23
-            // b15 = b6 && (b15 ^ address_cmp); // 23
-
-            cmp1 = address;
-            cmp2 = address_cnt;
-            const bool nibble_cmp6 = (cmp1 & 0xffff0) == (cmp2 & 0xffff0); // 24
-
-            if (sub_phase_of >= 4)
-            {
-                next_address = address_cnt; // 1
-                usenew = !nibble_cmp6;
-                // b15 is not updated?
-            }
-
-            if (active && pcm.nfs)
-                ram1[4] = (uint32_t)next_address;
-
-            if (pcm.nfs)
-            {
-                ram2[8] &= ~0x8000;
-                ram2[8] |= (uint16_t)(next_b15 << 15);
-            }
-
-            // dpcm
-
-            // 18
-            int reference = (int)ram1[5];
-
-            // 19
-            int preshift = samp0 << 10;
-            int select_nibble = nibble_cmp2 ? old_nibble : newnibble;
-            int shift = (10 - select_nibble) & 15;
-
-            int shifted = (preshift << 1) >> shift;
-
-            if (sub_phase_of >= 1)
-                reference = addclip20(reference, shifted >> 1, shifted & 1);
-
-            preshift = samp1 << 10;
-            select_nibble = nibble_cmp3 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-
-            shifted = (preshift << 1) >> shift;
-
-            if (sub_phase_of >= 2)
-                reference = addclip20(reference, shifted >> 1, shifted & 1);
-
-            preshift = samp2 << 10;
-            select_nibble = nibble_cmp4 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-
-            shifted = (preshift << 1) >> shift;
-
-            if (sub_phase_of >= 3)
-                reference = addclip20(reference, shifted >> 1, shifted & 1);
-
-            preshift = samp3 << 10;
-            select_nibble = nibble_cmp5 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-
-            shifted = (preshift << 1) >> shift;
-
-            if (sub_phase_of >= 4)
-                reference = addclip20(reference, shifted >> 1, shifted & 1);
-
-            // interpolation
-
-            int test = (int)ram1[5];
-
-            int step0 = multi(interp_lut[0][interp_ratio] << 6, (int8_t)samp0) >> 8;
-            select_nibble = nibble_cmp2 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-            step0 =  (step0 << 1) >> shift;
-
-            test = addclip20(test, step0 >> 1, step0 & 1);
-
-
-            int step1 = multi(interp_lut[1][interp_ratio] << 6, (int8_t)samp1) >> 8;
-            select_nibble = nibble_cmp3 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-            step1 = (step1 << 1) >> shift;
-
-            test = addclip20(test, step1 >> 1, step1 & 1);
-
-            int step2 = multi(interp_lut[2][interp_ratio] << 6, (int8_t)samp2) >> 8;
-            select_nibble = nibble_cmp4 ? old_nibble : newnibble;
-            shift = (10 - select_nibble) & 15;
-            step2 = (step2 << 1) >> shift;
-
-            int reg1 = (int)ram1[1];
-            int reg3 = (int)ram1[3];
-            int reg2_6 = (ram2[6] >> 8) & 127;
-
-            test = addclip20(test, step2 >> 1, step2 & 1);
-
-            int filter = ram2[11];
-            int v3;
-
-            if (pcm.mcu->is_mk1)
-            {
-                int mult1 = multi(reg1, (int8_t)(filter >> 8)); // 8
-                int mult2 = multi(reg1, (int8_t)((filter >> 1) & 127)); // 9
-                int mult3 = multi(reg1, (int8_t)reg2_6); // 10
-
-                int v2 = addclip20(reg3, mult1 >> 6, (mult1 >> 5) & 1); // 9
-                int v1 = addclip20(v2, mult2 >> 13, (mult2 >> 12) & 1); // 10
-                int subvar = addclip20(v1, (mult3 >> 6), (mult3 >> 5) & 1); // 11
-
-                ram1[3] = (uint32_t)v1;
-
-                v3 = addclip20(test, subvar ^ 0xfffff, 1); // 12
-
-                int mult4 = multi(v3, (int8_t)(filter >> 8));
-                int mult5 = multi(v3, (int8_t)((filter >> 1) & 127));
-                int v4 = addclip20(reg1, mult4 >> 6, (mult4 >> 5) & 1); // 14
-                int v5 = addclip20(v4, mult5 >> 13, (mult5 >> 12) & 1); // 15
-
-                ram1[1] = (uint32_t)v5;
-            }
-            else
-            {
-                // hack: use 32-bit math to avoid overflow
-                int mult1 = reg1 * (int8_t)(filter >> 8); // 8
-                int mult2 = reg1 * (int8_t)((filter >> 1) & 127); // 9
-                int mult3 = reg1 * (int8_t)reg2_6; // 10
-
-                int v2 = reg3 + (mult1 >> 6) + ((mult1 >> 5) & 1); // 9
-                int v1 = v2 + (mult2 >> 13) + ((mult2 >> 12) & 1); // 10
-                int subvar = v1 + (mult3 >> 6) + ((mult3 >> 5) & 1); // 11
-
-                ram1[3] = (uint32_t)v1;
-
-                int tests = test;
-                tests <<= 12;
-                tests >>= 12;
-
-                v3 = tests - subvar; // 12
-
-                int mult4 = v3 * (int8_t)(filter >> 8);
-                int mult5 = v3 * (int8_t)((filter >> 1) & 127);
-                int v4 = reg1 + (mult4 >> 6) + ((mult4 >> 5) & 1); // 14
-                int v5 = v4 + (mult5 >> 13) + ((mult5 >> 12) & 1); // 15
-
-                ram1[1] = (uint32_t)v5;
-            }
-
-
-            ram1[5] = (uint32_t)reference;
-
-            if (active && (ram2[6] & 1) != 0 && (ram2[8] & 0x4000) == 0 && !pcm.irq_assert && irq_flag)
-            {
-                //fprintf(stderr, "irq voice %i\n", slot);
-                if (pcm.nfs)
-                    ram2[8] |= 0x4000;
-                pcm.irq_assert = true;
-                pcm.irq_channel = (uint8_t)slot;
-                if (pcm.mcu->is_jv880)
-                    MCU_GA_SetGAInt(*pcm.mcu, 5, 1);
-                else
-                    MCU_Interrupt_SetRequest(*pcm.mcu, INTERRUPT_SOURCE_IRQ0, 1);
-            }
-
-            int volmul1 = 0;
-            int volmul2 = 0;
-
-            calc_tv(pcm, 0, ram2[3], &ram2[9], active, &volmul1);
-            calc_tv(pcm, 1, ram2[4], &ram2[10], active, &volmul2);
-            calc_tv(pcm, 2, ram2[5], &ram2[11], active, NULL);
-
-            // if (volmul1 && volmul2)
-            //     volmul1 += 0;
-
-            int sample = (ram2[6] & 2) == 0 ? (int)ram1[3] : v3;
-            //sample = test;
-
-            int multiv1 = multi(sample, (int8_t)(volmul1 >> 8));
-            int multiv2 = multi(sample, (int8_t)((volmul1 >> 1) & 127));
-
-            int sample2 = addclip20(multiv1 >> 6, multiv2 >> 13, ((multiv2 >> 12) | (multiv1 >> 5)) & 1);
-
-            int multiv3 = multi(sample2, (int8_t)(volmul2 >> 8));
-            int multiv4 = multi(sample2, (int8_t)((volmul2 >> 1) & 127));
-
-            int sample3 = addclip20(multiv3 >> 6, multiv4 >> 13, ((multiv4 >> 12) | (multiv3 >> 5)) & 1);
-
-            int pan = active ? ram2[1] : 0;
-            int rc = active ? ram2[2] : 0;
-
-            int sampl = multi(sample3, (int8_t)((pan >> 8) & 255));
-            int sampr = multi(sample3, (int8_t)((pan >> 0) & 255));
-
-            int rc0 = multi(sample3, (int8_t)((rc >> 8) & 255)) >> 5; // reverb
-            int rc1 = multi(sample3, (int8_t)((rc >> 0) & 255)) >> 5; // chorus
-            
-            // mix reverb/chorus?
-            int slot2 = (slot == pcm.config.reg_slots - 1) ? 31 : slot + 1;
-            switch (slot2)
-            {
-                // 17, 18 - reverb
-
-                case 17:
-                    pcm.ram1[31][1] = (uint32_t)addclip20((int32_t)pcm.ram1[31][1], rcadd[0] >> 1, rcadd[0] & 1);
-                    break;
-                case 18:
-                    pcm.ram1[31][3] = (uint32_t)addclip20((int32_t)pcm.ram1[31][3], rcadd[1] >> 1, rcadd[1] & 1);
-                    break;
-                case 21:
-                    pcm.ram1[31][1] = (uint32_t)addclip20((int32_t)pcm.ram1[31][1], rcadd[2] >> 1, rcadd[2] & 1);
-                    break;
-                case 22:
-                    pcm.ram1[31][3] = (uint32_t)addclip20((int32_t)pcm.ram1[31][3], rcadd[3] >> 1, rcadd[3] & 1);
-                    break;
-                case 23:
-                    pcm.ram1[31][1] = (uint32_t)addclip20((int32_t)pcm.ram1[31][1], rcadd[4] >> 1, rcadd[4] & 1);
-                    break;
-                case 31:
-                    pcm.ram1[31][3] = (uint32_t)addclip20((int32_t)pcm.ram1[31][3], rcadd[5] >> 1, rcadd[5] & 1);
-                    break;
-            }
-
-            int32_t suml = addclip20((int32_t)pcm.ram1[31][1], sampl >> 6, (sampl >> 5) & 1);
-            int32_t sumr = addclip20((int32_t)pcm.ram1[31][3], sampr >> 6, (sampr >> 5) & 1);
-
-            switch (slot2)
-            {
-                case 17:
-                    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[0] >> 1, rcadd2[0] & 1);
-                    break;
-                case 18:
-                    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[1] >> 1, rcadd2[1] & 1);
-                    break;
-                case 21:
-                    pcm.rcsum[0] = addclip20(pcm.rcsum[0], rcadd2[2] >> 1, rcadd2[2] & 1);
-                    break;
-                case 22:
-                    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[3] >> 1, rcadd2[3] & 1);
-                    break;
-                case 23:
-                    pcm.rcsum[0] = addclip20(pcm.rcsum[0], rcadd2[4] >> 1, rcadd2[4] & 1);
-                    break;
-                case 31:
-                    pcm.rcsum[1] = addclip20(pcm.rcsum[1], rcadd2[5] >> 1, rcadd2[5] & 1);
-                    break;
-            }
-
-            pcm.rcsum[0] = addclip20(pcm.rcsum[0], rc0 >> 1, rc0 & 1);
-            pcm.rcsum[1] = addclip20(pcm.rcsum[1], rc1 >> 1, rc1 & 1);
-
-            if (slot != pcm.config.reg_slots - 1)
-            {
-                pcm.ram1[31][1] = (uint32_t)suml;
-                pcm.ram1[31][3] = (uint32_t)sumr;
-            }
-            else
-            {
-                pcm.accum_l = suml;
-                pcm.accum_r = sumr;
-            }
-
-            if (key && pcm.nfs)
-            {
-                ram2[7] &= ~0xf020;
-                ram2[7] |= (uint16_t)(((usenew || kon) ? newnibble : old_nibble) << 12);
-
-                // update key
-                ram2[7] |= (uint16_t)(key << 5);
-            }
-
-            if (!active)
-            {
-                if (pcm.nfs)
-                {
-                    ram1[1] = 0;
-                    ram1[3] = 0;
-                    ram1[5] = 0;
-                }
-
-                ram2[8] = 0;
-                ram2[9] = 0;
-                ram2[10] = 0;
-            }
-        }
+        if (pcm.engine == PCM_Engine::Vector && pcm.config.reg_slots <= PCM_VECTOR_MAX_SLOTS)
+            PCM_UpdateVoicesVector<Traits>(pcm, voice_active, rcadd, rcadd2);
+        else
+            PCM_UpdateVoicesScalar<Traits>(pcm, voice_active, rcadd, rcadd2);
 
         if (pcm.nfs)
         {
@@ -1569,10 +2109,16 @@ void PCM_Update(pcm_t& pcm, uint64_t cycles)
 
         uint64_t new_cycles = (uint64_t)(pcm.config.reg_slots + 1) * 25;
 
-        pcm.cycles += pcm.mcu->is_jv880 ? (new_cycles * 25) / 29 : new_cycles;
+        pcm.cycles += Traits::is_jv880 ? (new_cycles * 25) / 29 : new_cycles;
     }
 }
 
+template void PCM_Update<MCU_Traits_MK2>(pcm_t& pcm, uint64_t cycles);
+template void PCM_Update<MCU_Traits_MK1>(pcm_t& pcm, uint64_t cycles);
+template void PCM_Update<MCU_Traits_CM300>(pcm_t& pcm, uint64_t cycles);
+template void PCM_Update<MCU_Traits_JV880>(pcm_t& pcm, uint64_t cycles);
+template void PCM_Update<MCU_Traits_SCB55>(pcm_t& pcm, uint64_t cycles);
+
 uint32_t PCM_GetOutputFrequency(const pcm_t& pcm)
 {
     uint32_t freq = (pcm.mcu->is_mk1 || pcm.mcu->is_jv880) ? 64000 : 66207;
@@ -34,6 +34,8 @@
 #pragma once
 
 #include <cstdint>
+#include "rom.h"
+#include "romset_traits.h"
 
 struct mcu_t;
 
@@ -51,6 +53,15 @@ struct PCM_Config
     uint8_t reg_slots = 1;
 };
 
+enum class PCM_Engine : uint8_t
+{
+    // Processes one voice slot at a time. This is the reference implementation.
+    Scalar,
+    // Processes all voice slots of a sample together so that the compiler can use SIMD instructions. Produces the same
+    // results as `Scalar`.
+    Vector,
+};
+
 struct pcm_t
 {
     uint32_t ram1[32][8]{};
@@ -79,18 +90,26 @@ struct pcm_t
 
     uint16_t eram[0x4000]{};
 
-    uint8_t waverom1[0x200000]{};
-    uint8_t waverom2[0x200000]{};
-    uint8_t waverom3[0x100000]{};
-    uint8_t waverom_card[0x200000]{};
-    uint8_t waverom_exp[0x800000]{};
+    // Shared with other emulators, see EMU_RomImage.
+    const uint8_t* waverom1     = ROM_EMPTY;
+    const uint8_t* waverom2     = ROM_EMPTY;
+    const uint8_t* waverom3     = ROM_EMPTY;
+    const uint8_t* waverom_card = ROM_EMPTY;
+    const uint8_t* waverom_exp  = ROM_EMPTY;
 
     bool enable_oversampling = true;
+
+    PCM_Engine engine = PCM_Engine::Vector;
+
+    // If true, slots that aren't keyed on skip wave rom reads and sample processing. This has no effect on output.
+    bool skip_idle_voices = true;
 };
 
 void PCM_Write(pcm_t& pcm, uint32_t address, uint8_t data);
 uint8_t PCM_Read(pcm_t& pcm, uint32_t address);
 void PCM_Init(pcm_t& pcm, mcu_t& mcu);
+// Instantiated in pcm.cpp for each MCU_RomsetTraits specialization.
+template <typename Traits>
 void PCM_Update(pcm_t& pcm, uint64_t cycles);
 uint32_t PCM_GetOutputFrequency(const pcm_t& pcm);
 void PCM_GetConfig(PCM_Config& config, uint8_t config_byte);
@@ -1,5 +1,9 @@
 #include "rom.h"
 
+// Not const so that it's placed in bss instead of taking up space in the executable.
+static uint8_t rom_empty[ROM_MAX_SIZE];
+const uint8_t* const ROM_EMPTY = rom_empty;
+
 const char* rs_name[ROMSET_COUNT] = {
     "SC-55mk2",
     "SC-55st",
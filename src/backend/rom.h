@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <span>
 #include <string_view>
 
@@ -53,3 +55,10 @@ using RomLocationSet = std::array<bool, ROMLOCATION_COUNT>;
 bool IsWaverom(RomLocation location);
 
 bool IsOptionalRom(Romset romset, RomLocation location);
+
+// Size of the largest rom location, WAVEROM_EXP.
+constexpr size_t ROM_MAX_SIZE = 0x800000;
+
+// Zero filled stand-in for roms that aren't loaded, ROM_MAX_SIZE bytes long. Every rom pointer in the emulator points
+// here until roms are loaded.
+extern const uint8_t* const ROM_EMPTY;
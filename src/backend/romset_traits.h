@@ -0,0 +1,75 @@
+#pragma once
+
+#include "rom.h"
+
+// Romsets grouped by the hardware differences the emulator core cares about. The hot paths (memory access, the step
+// loop, PCM_Update and TIMER_Clock) are instantiated once per family so that these checks are resolved at compile
+// time instead of on every access.
+enum class MCU_RomsetFamily
+{
+    MK2,   // SC-55mk2, SC-55st, SC-155mk2
+    MK1,   // SC-55, SC-155
+    CM300, // CM-300/SCC-1
+    JV880,
+    SCB55, // SCB-55, RLP-3237
+};
+
+template <MCU_RomsetFamily Family>
+struct MCU_RomsetTraits
+{
+    static constexpr MCU_RomsetFamily family = Family;
+
+    static constexpr bool is_mk1   = Family == MCU_RomsetFamily::MK1 || Family == MCU_RomsetFamily::CM300;
+    static constexpr bool is_cm300 = Family == MCU_RomsetFamily::CM300;
+    static constexpr bool is_jv880 = Family == MCU_RomsetFamily::JV880;
+    static constexpr bool is_scb55 = Family == MCU_RomsetFamily::SCB55;
+};
+
+using MCU_Traits_MK2   = MCU_RomsetTraits<MCU_RomsetFamily::MK2>;
+using MCU_Traits_MK1   = MCU_RomsetTraits<MCU_RomsetFamily::MK1>;
+using MCU_Traits_CM300 = MCU_RomsetTraits<MCU_RomsetFamily::CM300>;
+using MCU_Traits_JV880 = MCU_RomsetTraits<MCU_RomsetFamily::JV880>;
+using MCU_Traits_SCB55 = MCU_RomsetTraits<MCU_RomsetFamily::SCB55>;
+
+constexpr MCU_RomsetFamily MCU_GetRomsetFamily(Romset romset)
+{
+    switch (romset)
+    {
+    case Romset::MK2:
+    case Romset::ST:
+    case Romset::SC155MK2:
+        return MCU_RomsetFamily::MK2;
+    case Romset::MK1:
+    case Romset::SC155:
+        return MCU_RomsetFamily::MK1;
+    case Romset::CM300:
+        return MCU_RomsetFamily::CM300;
+    case Romset::JV880:
+        return MCU_RomsetFamily::JV880;
+    case Romset::SCB55:
+    case Romset::RLP3237:
+        return MCU_RomsetFamily::SCB55;
+    }
+    return MCU_RomsetFamily::MK2;
+}
+
+// Calls `fn.template operator()<Traits>()` with the traits type for `family`. Used to pick a specialization once
+// outside of a hot loop.
+template <typename Fn>
+decltype(auto) MCU_DispatchRomsetFamily(MCU_RomsetFamily family, Fn&& fn)
+{
+    switch (family)
+    {
+    case MCU_RomsetFamily::MK1:
+        return fn.template operator()<MCU_Traits_MK1>();
+    case MCU_RomsetFamily::CM300:
+        return fn.template operator()<MCU_Traits_CM300>();
+    case MCU_RomsetFamily::JV880:
+        return fn.template operator()<MCU_Traits_JV880>();
+    case MCU_RomsetFamily::SCB55:
+        return fn.template operator()<MCU_Traits_SCB55>();
+    case MCU_RomsetFamily::MK2:
+        break;
+    }
+    return fn.template operator()<MCU_Traits_MK2>();
+}
@@ -36,6 +36,8 @@
 #include "diagnostics.h"
 #include "mcu.h"
 
+#include <algorithm>
+
 enum {
     SM_VECTOR_UART3_TX = 0,
     SM_VECTOR_UART2_TX,
@@ -1390,29 +1392,51 @@ void SM_HandleInterrupt(submcu_t& sm)
     }
 }
 
+static bool SM_IsTimerRunning(const submcu_t& sm)
+{
+    return (sm.device_mode[SM_DEV_TIMER_CTRL] & 0x20) == 0 && !sm.sleep;
+}
+
+// The timer ticks every 16 cycles. The prescaler counts down once per tick and the counter once per prescaler
+// underflow. Each underflow reloads from the corresponding device register, and counter underflows request the timer
+// interrupt. Any number of ticks is applied at once.
 void SM_UpdateTimer(submcu_t& sm)
 {
-    while (sm.timer_cycles < sm.cycles)
+    if (sm.timer_cycles >= sm.cycles)
+        return;
+
+    const uint64_t ticks = (sm.cycles - sm.timer_cycles + 15) / 16;
+    sm.timer_cycles += ticks * 16;
+
+    if (!SM_IsTimerRunning(sm))
+        return;
+
+    if (ticks <= sm.timer_prescaler)
     {
-        if ((sm.device_mode[SM_DEV_TIMER_CTRL] & 0x20) == 0 && !sm.sleep)
-        {
-            if (sm.timer_prescaler == 0)
-            {
-                sm.timer_prescaler = sm.device_mode[SM_DEV_PRESCALER];
-
-                if (sm.timer_counter == 0)
-                {
-                    sm.timer_counter = sm.device_mode[SM_DEV_TIMER];
-                    sm.device_mode[SM_DEV_INT_REQUEST] |= 0x8;
-                }
-                else
-                    sm.timer_counter--;
-            }
-            else
-                sm.timer_prescaler--;
-        }
-        sm.timer_cycles += 16;
+        sm.timer_prescaler -= (uint8_t)ticks;
+        return;
+    }
+    const uint64_t prescaler_period = (uint64_t)sm.device_mode[SM_DEV_PRESCALER] + 1;
+    const uint64_t after_prescaler  = ticks - sm.timer_prescaler - 1;
+    sm.timer_prescaler = (uint8_t)(prescaler_period - 1 - after_prescaler % prescaler_period);
+
+    const uint64_t steps = 1 + after_prescaler / prescaler_period;
+    if (steps <= sm.timer_counter)
+    {
+        sm.timer_counter -= (uint8_t)steps;
+        return;
     }
+    const uint64_t counter_period = (uint64_t)sm.device_mode[SM_DEV_TIMER] + 1;
+    const uint64_t after_counter  = steps - sm.timer_counter - 1;
+    sm.timer_counter = (uint8_t)(counter_period - 1 - after_counter % counter_period);
+    sm.device_mode[SM_DEV_INT_REQUEST] |= 0x8;
+}
+
+// Returns the number of timer ticks up to and including the one that next requests the timer interrupt.
+static uint64_t SM_TicksUntilTimerRequest(const submcu_t& sm)
+{
+    const uint64_t prescaler_period = (uint64_t)sm.device_mode[SM_DEV_PRESCALER] + 1;
+    return sm.timer_prescaler + 1 + sm.timer_counter * prescaler_period;
 }
 
 void SM_UpdateUART(submcu_t& sm)
@@ -1421,7 +1445,7 @@ void SM_UpdateUART(submcu_t& sm)
 
     if ((sm.device_mode[SM_DEV_UART1_CTRL] & 4) == 0) // RX disabled
         return;
-    if (mcu.uart_write_ptr == mcu.uart_read_ptr) // no byte
+    if (!MCU_HasUARTByte(mcu)) // no byte
         return;
 
     if (sm.uart_rx_gotbyte)
@@ -1430,18 +1454,144 @@ void SM_UpdateUART(submcu_t& sm)
     if (sm.cycles < mcu.uart_rx_delay)
         return;
 
-    mcu.uart_rx_byte = mcu.uart_buffer[mcu.uart_read_ptr];
-    mcu.uart_read_ptr = (mcu.uart_read_ptr + 1) % uart_buffer_size;
+    mcu.uart_rx_byte = MCU_ReadUARTByte(mcu);
     sm.uart_rx_gotbyte = 1;
     sm.device_mode[SM_DEV_INT_REQUEST] |= 0x40;
 
     mcu.uart_rx_delay = sm.cycles + 3000 * 4;
 }
 
+bool SM_IsIdle(const submcu_t& sm)
+{
+    const mcu_t& mcu = *sm.mcu;
+
+    if (!sm.sleep)
+        return false;
+
+    // every interrupt source except collisions needs both its enable and request bit set
+    if ((sm.sr & SM_STATUS_I) == 0
+        && ((sm.device_mode[SM_DEV_INT_ENABLE] & sm.device_mode[SM_DEV_INT_REQUEST]) != 0
+            || (sm.device_mode[SM_DEV_COLLISION] & 0xc0) == 0xc0))
+        return false;
+
+    if ((sm.device_mode[SM_DEV_UART1_CTRL] & 4) != 0 && MCU_HasUARTByte(mcu) && !sm.uart_rx_gotbyte)
+        return false;
+
+    return true;
+}
+
+// Returns true if the next instruction is a BBC/BBS that branches to itself and keeps doing so until an interrupt or
+// UART reception changes the bit it tests, i.e. a polling loop.
+static bool SM_IsPolling(const submcu_t& sm)
+{
+    const uint16_t pc = sm.pc & 0x1fff;
+    if (pc < 0x1000 || pc > 0x1ffd)
+        return false;
+
+    const uint8_t opcode = sm.rom[pc & 0xfff];
+    uint8_t val = 0;
+    if ((opcode & 0xf) == 0x3) // BBC/BBS A
+    {
+        if (sm.rom[(pc + 1) & 0xfff] != 0xfe)
+            return false;
+        val = sm.a;
+    }
+    else if ((opcode & 0xf) == 0x7) // BBC/BBS zp
+    {
+        if (sm.rom[(pc + 2) & 0xfff] != 0xfd)
+            return false;
+
+        // only locations whose reads have no side effects and that don't change on their own
+        const uint8_t address = sm.rom[(pc + 1) & 0xfff];
+        if (address < 0x80)
+        {
+            val = sm.ram[address];
+        }
+        else if (address >= 0xe0)
+        {
+            switch (address & 0x1f)
+            {
+                case SM_DEV_UART1_MODE_STATUS:
+                case SM_DEV_UART3_MODE_STATUS:
+                    val = 5;
+                    break;
+                case SM_DEV_UART2_MODE_STATUS:
+                    val = (uint8_t)((sm.uart_rx_gotbyte << 1) | 5);
+                    break;
+                case SM_DEV_P1_DIR:
+                    val = sm.p1_dir;
+                    break;
+                case SM_DEV_UART2_DATA:
+                case SM_DEV_P1_DATA:
+                case SM_DEV_PRESCALER:
+                case SM_DEV_TIMER:
+                    return false;
+                default:
+                    val = sm.device_mode[address & 0x1f];
+                    break;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    const int32_t bit = (opcode >> 5) & 7;
+    const int32_t type = (opcode >> 4) & 1;
+    return ((val >> bit) & 1) != type;
+}
+
+// While the sub-MCU is sleeping or polling, steps only advance the cycle counters and the timer. This skips ahead in
+// one go to the step before the first one where that can change: a timer interrupt request or a UART byte being
+// received. A byte posted while skipping is picked up on the next call, as if it had arrived then.
+static void SM_SkipIdleSteps(submcu_t& sm, uint64_t end_cycles)
+{
+    constexpr uint64_t cycles_per_step = 12 * 4;
+
+    if (sm.mcu->backend == MCU_Backend::Interpreter || sm.timer_cycles < sm.cycles)
+        return;
+
+    if ((sm.sr & SM_STATUS_I) == 0
+        && ((sm.device_mode[SM_DEV_INT_ENABLE] & sm.device_mode[SM_DEV_INT_REQUEST]) != 0
+            || (sm.device_mode[SM_DEV_COLLISION] & 0xc0) == 0xc0))
+        return;
+
+    if (!sm.sleep && !SM_IsPolling(sm))
+        return;
+
+    uint64_t steps = (end_cycles - sm.cycles + cycles_per_step - 1) / cycles_per_step;
+
+    if (SM_IsTimerRunning(sm))
+    {
+        // timer_cycles is less than one tick ahead of cycles here
+        const uint64_t ticks_allowed = SM_TicksUntilTimerRequest(sm) - 1;
+        steps = std::min(steps, (ticks_allowed * 16 + (sm.timer_cycles - sm.cycles)) / cycles_per_step);
+    }
+
+    const mcu_t& mcu = *sm.mcu;
+    if ((sm.device_mode[SM_DEV_UART1_CTRL] & 4) != 0 && MCU_HasUARTByte(mcu) && !sm.uart_rx_gotbyte)
+    {
+        const uint64_t delay = mcu.uart_rx_delay;
+        steps = std::min(steps, delay > sm.cycles ? (delay - sm.cycles - 1) / cycles_per_step : 0);
+    }
+
+    sm.cycles += steps * cycles_per_step;
+    SM_UpdateTimer(sm);
+}
+
 void SM_Update(submcu_t& sm, uint64_t cycles)
 {
     while (sm.cycles < cycles * 5)
     {
+        SM_SkipIdleSteps(sm, cycles * 5);
+        if (sm.cycles >= cycles * 5)
+            break;
+
         SM_HandleInterrupt(sm);
 
         if (!sm.sleep)
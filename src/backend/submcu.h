@@ -33,6 +33,7 @@
  */
 #pragma once
 
+#include "rom.h"
 #include <cstdint>
 
 struct mcu_t;
@@ -58,7 +59,8 @@ struct submcu_t {
     uint64_t cycles = 0;
     uint8_t sleep = 0;
     mcu_t* mcu = nullptr;
-    uint8_t rom[4096]{};
+    // Shared with other emulators, see EMU_RomImage.
+    const uint8_t* rom = ROM_EMPTY;
 
     uint8_t ram[128]{};
     uint8_t shared_ram[192]{};
@@ -80,6 +82,10 @@ struct submcu_t {
 void SM_Init(submcu_t& sm, mcu_t& mcu);
 void SM_Reset(submcu_t& sm);
 void SM_Update(submcu_t& sm, uint64_t cycles);
+// Advances the timer up to `sm.cycles`.
+void SM_UpdateTimer(submcu_t& sm);
+// Returns true if the sub-MCU is sleeping and SM_Update can't wake it, so it only advances its cycle counters.
+bool SM_IsIdle(const submcu_t& sm);
 void SM_SysWrite(submcu_t& sm, uint32_t address, uint8_t data);
 uint8_t SM_SysRead(submcu_t& sm, uint32_t address);
 void SM_PostUART(submcu_t& sm, uint8_t data);
@@ -0,0 +1,101 @@
+#include "audio_mix.h"
+
+#include "math_util.h"
+
+// SSE2 and NEON are part of the x86-64 and AArch64 baselines. AVX2 is only used when the compiler targets it, e.g. with
+// -march=native or /arch:AVX2.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIX_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIX_USE_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MIX_USE_NEON
+#endif
+
+void MixAccumulate(int64_t* acc, const int32_t* src, size_t count)
+{
+    size_t i = 0;
+#if defined(MIX_USE_AVX2)
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256i s = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(src + i)));
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+        _mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi64(a, s));
+    }
+#elif defined(MIX_USE_SSE2)
+    for (; i + 4 <= count; i += 4)
+    {
+        // sign extend by interleaving each sample with its sign
+        const __m128i s    = _mm_loadu_si128((const __m128i*)(src + i));
+        const __m128i sign = _mm_srai_epi32(s, 31);
+        const __m128i lo   = _mm_unpacklo_epi32(s, sign);
+        const __m128i hi   = _mm_unpackhi_epi32(s, sign);
+        const __m128i a0   = _mm_loadu_si128((const __m128i*)(acc + i));
+        const __m128i a1   = _mm_loadu_si128((const __m128i*)(acc + i + 2));
+        _mm_storeu_si128((__m128i*)(acc + i), _mm_add_epi64(a0, lo));
+        _mm_storeu_si128((__m128i*)(acc + i + 2), _mm_add_epi64(a1, hi));
+    }
+#elif defined(MIX_USE_NEON)
+    for (; i + 4 <= count; i += 4)
+    {
+        const int32x4_t s = vld1q_s32(src + i);
+        vst1q_s64(acc + i, vaddw_s32(vld1q_s64(acc + i), vget_low_s32(s)));
+        vst1q_s64(acc + i + 2, vaddw_s32(vld1q_s64(acc + i + 2), vget_high_s32(s)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        acc[i] += src[i];
+    }
+}
+
+// Gain is applied after converting to the output type and truncated the same way as Scale, so that a single instance
+// that doesn't clip renders exactly as if Normalize and Scale had been applied to it.
+
+void MixNormalize(int16_t* dest, const int64_t* acc, size_t count, float gain)
+{
+    if (gain == 1.0f)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            dest[i] = (int16_t)Clamp<int64_t>(acc[i] >> 15, INT16_MIN, INT16_MAX);
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float scaled = (float)(acc[i] >> 15) * gain;
+        dest[i]            = (int16_t)Clamp<float>(scaled, INT16_MIN, INT16_MAX);
+    }
+}
+
+void MixNormalize(int32_t* dest, const int64_t* acc, size_t count, float gain)
+{
+    if (gain == 1.0f)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            dest[i] = (int32_t)Clamp<int64_t>(acc[i] * 2, INT32_MIN, INT32_MAX);
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        // INT32_MAX isn't representable as a float
+        const double scaled = (double)((float)(acc[i] * 2) * gain);
+        dest[i]             = (int32_t)Clamp<double>(scaled, INT32_MIN, INT32_MAX);
+    }
+}
+
+void MixNormalize(float* dest, const int64_t* acc, size_t count, float gain)
+{
+    constexpr float DIV_REC = 1.0f / 536870912.0f;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        dest[i] = (float)acc[i] * DIV_REC * gain;
+    }
+}
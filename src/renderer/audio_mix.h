@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Mixing the raw output of several emulators. Streams are summed into 64-bit accumulators so that intermediate sums
+// can't overflow, and gain, normalization and clipping to the output type are applied once to the final sum.
+
+// Adds `count` raw samples from `src` to `acc`.
+void MixAccumulate(int64_t* acc, const int32_t* src, size_t count);
+
+// Writes `count` accumulated samples to `dest`. Each sum is converted to the output type the same way Normalize
+// converts a single raw sample, multiplied by `gain` and then saturated to the range of the output type. Float samples
+// are not clipped.
+void MixNormalize(int16_t* dest, const int64_t* acc, size_t count, float gain);
+void MixNormalize(int32_t* dest, const int64_t* acc, size_t count, float gain);
+void MixNormalize(float* dest, const int64_t* acc, size_t count, float gain);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "audio.h"
+#include <cstdint>
+#include <span>
+
+// Destination for rendered audio, e.g. a wave or FLAC file. Frames are written in blocks from the mix thread.
+class AudioSink
+{
+public:
+    virtual ~AudioSink() = default;
+
+    // Must be called before the first Write.
+    virtual void SetSampleRate(uint32_t sample_rate) = 0;
+
+    // Only the overload matching the format the sink was opened with may be called.
+    virtual void Write(std::span<const AudioFrame<int16_t>> frames) = 0;
+    virtual void Write(std::span<const AudioFrame<int32_t>> frames) = 0;
+    virtual void Write(std::span<const AudioFrame<float>> frames)   = 0;
+
+    // Completes the output after the last Write.
+    virtual void Finish() = 0;
+};
@@ -0,0 +1,153 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+constexpr std::string_view R_NAME_FIELD = "{name}";
+
+bool R_IsMidiFilename(const std::filesystem::path& path)
+{
+    std::string ext = path.extension().generic_string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return ext == ".mid" || ext == ".midi";
+}
+
+bool R_IsBatch(std::span<const std::filesystem::path> input_filenames,
+               const std::filesystem::path&           manifest_filename,
+               std::string_view                       output_template)
+{
+    std::error_code ec;
+    return input_filenames.size() > 1 || !manifest_filename.empty() ||
+           std::filesystem::is_directory(input_filenames[0], ec) ||
+           output_template.find(R_NAME_FIELD) != std::string_view::npos;
+}
+
+bool R_ReadManifest(const std::filesystem::path& path, std::vector<std::filesystem::path>& inputs)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        inputs.emplace_back(path.parent_path() / std::filesystem::path(line));
+    }
+
+    return true;
+}
+
+std::filesystem::path R_MakeOutputPath(std::string_view             output_template,
+                                       const std::filesystem::path& input,
+                                       bool                         flac)
+{
+    const std::string name = input.stem().generic_string();
+
+    if (output_template.find(R_NAME_FIELD) == std::string_view::npos)
+    {
+        return std::filesystem::path(output_template) / (name + (flac ? ".flac" : ".wav"));
+    }
+
+    std::string result;
+    size_t      pos  = 0;
+    size_t      next = output_template.find(R_NAME_FIELD);
+    while (next != std::string_view::npos)
+    {
+        result += output_template.substr(pos, next - pos);
+        result += name;
+        pos  = next + R_NAME_FIELD.size();
+        next = output_template.find(R_NAME_FIELD, pos);
+    }
+    result += output_template.substr(pos);
+
+    return result;
+}
+
+bool R_CollectBatchJobs(std::span<const std::filesystem::path> input_filenames,
+                        const std::filesystem::path&           manifest_filename,
+                        std::string_view                       output_template,
+                        bool                                   flac,
+                        std::vector<R_BatchJob>&               jobs)
+{
+    std::vector<std::filesystem::path> inputs;
+
+    for (const auto& input : input_filenames)
+    {
+        std::error_code ec;
+        if (std::filesystem::is_directory(input, ec))
+        {
+            // directory contents come in no particular order, so sort them to keep renders reproducible
+            std::vector<std::filesystem::path> found;
+            for (const auto& entry : std::filesystem::directory_iterator(input, ec))
+            {
+                if (entry.is_regular_file() && R_IsMidiFilename(entry.path()))
+                {
+                    found.emplace_back(entry.path());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            inputs.insert(inputs.end(), found.begin(), found.end());
+        }
+        else
+        {
+            inputs.emplace_back(input);
+        }
+    }
+
+    if (!manifest_filename.empty() && !R_ReadManifest(manifest_filename, inputs))
+    {
+        fprintf(stderr, "FATAL: Failed to read manifest %s\n", manifest_filename.generic_string().c_str());
+        return false;
+    }
+
+    if (inputs.empty())
+    {
+        fprintf(stderr, "FATAL: No midi files to render\n");
+        return false;
+    }
+
+    for (const auto& input : inputs)
+    {
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(input, ec))
+        {
+            fprintf(stderr, "FATAL: Input %s doesn't exist\n", input.generic_string().c_str());
+            return false;
+        }
+
+        jobs.push_back({
+            .input  = input,
+            .output = R_MakeOutputPath(output_template, input, flac),
+        });
+    }
+
+    // two jobs writing the same file would silently lose one of the renders
+    std::vector<std::filesystem::path> outputs;
+    for (const auto& job : jobs)
+    {
+        outputs.emplace_back(job.output.lexically_normal());
+    }
+    std::sort(outputs.begin(), outputs.end());
+    if (auto dup = std::adjacent_find(outputs.begin(), outputs.end()); dup != outputs.end())
+    {
+        fprintf(stderr, "FATAL: Multiple inputs render to %s\n", dup->generic_string().c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,41 @@
+// Turns the inputs of a batch render into a list of input/output file pairs.
+
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+struct R_BatchJob
+{
+    std::filesystem::path input;
+    std::filesystem::path output;
+};
+
+bool R_IsMidiFilename(const std::filesystem::path& path);
+
+// Returns true if the inputs need to go through R_CollectBatchJobs: there is more than one input, a manifest, a
+// directory, or an output template containing "{name}".
+bool R_IsBatch(std::span<const std::filesystem::path> input_filenames,
+               const std::filesystem::path&           manifest_filename,
+               std::string_view                       output_template);
+
+// Reads one input filename per line. Blank lines and lines starting with '#' are ignored, and relative paths are
+// relative to the manifest itself.
+bool R_ReadManifest(const std::filesystem::path& path, std::vector<std::filesystem::path>& inputs);
+
+// Every occurrence of "{name}" in `output_template` is replaced by the input filename without its extension. A
+// template without "{name}" names a directory to write `<name>.wav` (or `<name>.flac`) files into.
+std::filesystem::path R_MakeOutputPath(std::string_view             output_template,
+                                       const std::filesystem::path& input,
+                                       bool                         flac);
+
+// Expands directories in `input_filenames` to the midi files they contain, appends the files listed in
+// `manifest_filename` (if not empty) and pairs every input with its output path. Returns false and prints the reason
+// if an input is missing, there is nothing to render, or two inputs would render to the same file.
+bool R_CollectBatchJobs(std::span<const std::filesystem::path> input_filenames,
+                        const std::filesystem::path&           manifest_filename,
+                        std::string_view                       output_template,
+                        bool                                   flac,
+                        std::vector<R_BatchJob>&               jobs);
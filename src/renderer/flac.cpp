@@ -0,0 +1,992 @@
+// We use fopen()
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "flac.h"
+
+#include "math_util.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numbers>
+#include <span>
+
+// Number of blocks handed to a worker at once. Batches are large enough that workers rarely need to synchronize.
+constexpr size_t FLAC_BATCH_BLOCKS = 16;
+constexpr size_t FLAC_BATCH_FRAMES = FLAC_BATCH_BLOCKS * FLAC_Handle::BLOCK_SIZE;
+
+constexpr uint32_t FLAC_BITS_PER_SAMPLE = 16;
+
+// These match the limits of the FLAC streamable subset.
+constexpr uint32_t FLAC_MAX_LPC_ORDER       = 12;
+constexpr uint32_t FLAC_MAX_PARTITION_ORDER = 8;
+
+// Precision of the quantized LPC coefficients, including the sign bit. This is what libFLAC picks for 16-bit audio at
+// our block size.
+constexpr uint32_t FLAC_LPC_PRECISION = 12;
+
+constexpr std::array<uint8_t, 256> FLAC_MakeCrc8Table()
+{
+    std::array<uint8_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+        table[i] = (uint8_t)crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> FLAC_MakeCrc16Table()
+{
+    std::array<uint16_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i << 8;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1;
+        }
+        table[i] = (uint16_t)crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 256>  FLAC_CRC8_TABLE  = FLAC_MakeCrc8Table();
+constexpr std::array<uint16_t, 256> FLAC_CRC16_TABLE = FLAC_MakeCrc16Table();
+
+uint8_t FLAC_Crc8(std::span<const uint8_t> bytes)
+{
+    uint8_t crc = 0;
+    for (uint8_t byte : bytes)
+    {
+        crc = FLAC_CRC8_TABLE[crc ^ byte];
+    }
+    return crc;
+}
+
+uint16_t FLAC_Crc16(std::span<const uint8_t> bytes)
+{
+    uint16_t crc = 0;
+    for (uint8_t byte : bytes)
+    {
+        crc = (uint16_t)((crc << 8) ^ FLAC_CRC16_TABLE[(crc >> 8) ^ byte]);
+    }
+    return crc;
+}
+
+// Maps signed residuals to unsigned values for rice coding: 0, -1, 1, -2, 2...
+uint32_t FLAC_ZigZag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+// Appends bits to a byte buffer, most significant bit first.
+class FLAC_BitWriter
+{
+public:
+    explicit FLAC_BitWriter(std::vector<uint8_t>& bytes)
+        : m_bytes(bytes)
+    {
+    }
+
+    // Writes the low `count` bits of `value`.
+    // precondition: count <= 32
+    void Write(uint32_t value, uint32_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        const uint64_t mask = (uint64_t(1) << count) - 1;
+        m_acc               = (m_acc << count) | (value & mask);
+        m_bits += count;
+        while (m_bits >= 8)
+        {
+            m_bits -= 8;
+            m_bytes.push_back((uint8_t)(m_acc >> m_bits));
+        }
+    }
+
+    void WriteSigned(int32_t value, uint32_t count)
+    {
+        Write((uint32_t)value, count);
+    }
+
+    // Writes `zeroes` zero bits followed by a one.
+    void WriteUnary(uint32_t zeroes)
+    {
+        while (zeroes >= 32)
+        {
+            Write(0, 32);
+            zeroes -= 32;
+        }
+        Write(1, zeroes + 1);
+    }
+
+    void WriteRice(int32_t value, uint32_t param)
+    {
+        const uint32_t u = FLAC_ZigZag(value);
+        WriteUnary(u >> param);
+        Write(u, param);
+    }
+
+    // Writes `value` using the UTF-8 like coding FLAC uses for frame numbers.
+    void WriteUtf8(uint64_t value)
+    {
+        if (value < 0x80)
+        {
+            Write((uint32_t)value, 8);
+            return;
+        }
+
+        // Count the continuation bytes needed; each holds 6 bits and the first byte holds 6 - n bits.
+        uint32_t continuation = 1;
+        while (continuation < 6 && value >= (uint64_t(1) << (6 - continuation + 6 * continuation)))
+        {
+            ++continuation;
+        }
+
+        const uint32_t lead = (0xFF00u >> (continuation + 1)) & 0xFF;
+        Write(lead | (uint32_t)(value >> (6 * continuation)), 8);
+        for (uint32_t i = continuation; i-- > 0;)
+        {
+            Write(0x80 | (uint32_t)((value >> (6 * i)) & 0x3F), 8);
+        }
+    }
+
+    void AlignToByte()
+    {
+        if (m_bits != 0)
+        {
+            Write(0, 8 - m_bits);
+        }
+    }
+
+private:
+    std::vector<uint8_t>& m_bytes;
+    uint64_t              m_acc  = 0;
+    uint32_t              m_bits = 0;
+};
+
+// Rice coding parameters for a residual.
+struct FLAC_RicePlan
+{
+    uint32_t partition_order = 0;
+    // 4 or 5, depending on whether any parameter needs more than 4 bits
+    uint32_t param_bits = 4;
+    uint8_t  params[1 << FLAC_MAX_PARTITION_ORDER]{};
+};
+
+// Picks the rice parameter for a partition of `count` values that sum to `sum` once zigzag mapped. Returns the
+// approximate number of bits the partition takes.
+uint64_t FLAC_PickRiceParam(uint64_t sum, uint64_t count, uint8_t& param)
+{
+    param = 0;
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    uint32_t k = 0;
+    while (k < 30 && (count << (k + 1)) < sum)
+    {
+        ++k;
+    }
+
+    uint64_t best_bits = UINT64_MAX;
+    for (uint32_t candidate = k > 0 ? k - 1 : 0; candidate <= Min<uint32_t>(k + 1, 30); ++candidate)
+    {
+        const uint64_t bits = count * (candidate + 1) + (sum >> candidate);
+        if (bits < best_bits)
+        {
+            best_bits = bits;
+            param     = (uint8_t)candidate;
+        }
+    }
+    return best_bits;
+}
+
+// Chooses the partition order and rice parameters for the residual of a block of `block_size` samples predicted from
+// `order` warm-up samples. Returns the approximate size of the coded residual in bits.
+uint64_t FLAC_PlanResidual(std::span<const int32_t> residual, size_t block_size, uint32_t order, FLAC_RicePlan& plan)
+{
+    uint32_t max_order = 0;
+    while (max_order < FLAC_MAX_PARTITION_ORDER && block_size % (size_t(2) << max_order) == 0 &&
+           (block_size >> (max_order + 1)) > order)
+    {
+        ++max_order;
+    }
+
+    // Sums for the finest partitioning, merged pairwise for each coarser one.
+    uint64_t sums[1 << FLAC_MAX_PARTITION_ORDER];
+    size_t   pos = 0;
+    for (size_t p = 0; p < (size_t(1) << max_order); ++p)
+    {
+        const size_t count = (block_size >> max_order) - (p == 0 ? order : 0);
+        uint64_t     sum   = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            sum += FLAC_ZigZag(residual[pos++]);
+        }
+        sums[p] = sum;
+    }
+
+    uint64_t best_bits = UINT64_MAX;
+    for (uint32_t partition_order = max_order + 1; partition_order-- > 0;)
+    {
+        const size_t partitions = size_t(1) << partition_order;
+
+        FLAC_RicePlan candidate;
+        candidate.partition_order = partition_order;
+        uint64_t bits             = 2 + 4;
+        uint32_t max_param        = 0;
+        for (size_t p = 0; p < partitions; ++p)
+        {
+            const size_t count = (block_size >> partition_order) - (p == 0 ? order : 0);
+            bits += FLAC_PickRiceParam(sums[p], count, candidate.params[p]);
+            max_param = std::max<uint32_t>(max_param, candidate.params[p]);
+        }
+        // parameter 15 (or 31) is reserved for escaped partitions
+        candidate.param_bits = max_param >= 15 ? 5 : 4;
+        bits += partitions * candidate.param_bits;
+
+        if (bits < best_bits)
+        {
+            best_bits = bits;
+            plan      = candidate;
+        }
+
+        for (size_t p = 0; p < partitions / 2; ++p)
+        {
+            sums[p] = sums[2 * p] + sums[2 * p + 1];
+        }
+    }
+    return best_bits;
+}
+
+void FLAC_WriteResidual(FLAC_BitWriter&          writer,
+                        std::span<const int32_t> residual,
+                        size_t                   block_size,
+                        uint32_t                 order,
+                        const FLAC_RicePlan&     plan)
+{
+    writer.Write(plan.param_bits == 5 ? 1 : 0, 2);
+    writer.Write(plan.partition_order, 4);
+
+    size_t pos = 0;
+    for (size_t p = 0; p < (size_t(1) << plan.partition_order); ++p)
+    {
+        const size_t   count = (block_size >> plan.partition_order) - (p == 0 ? order : 0);
+        const uint32_t param = plan.params[p];
+        writer.Write(param, plan.param_bits);
+        for (size_t i = 0; i < count; ++i)
+        {
+            writer.WriteRice(residual[pos++], param);
+        }
+    }
+}
+
+enum class FLAC_SubframeType
+{
+    Constant,
+    Verbatim,
+    Fixed,
+    LPC,
+};
+
+// The best way found to code one channel of a block.
+struct FLAC_Subframe
+{
+    FLAC_SubframeType    type = FLAC_SubframeType::Verbatim;
+    uint32_t             order = 0;
+    int32_t              coeffs[FLAC_MAX_LPC_ORDER]{};
+    int32_t              shift = 0;
+    FLAC_RicePlan        rice;
+    std::vector<int32_t> residual;
+    uint64_t             bits = 0;
+};
+
+// Computes the residual of a fixed polynomial predictor. Returns false if it doesn't fit in 32 bits.
+bool FLAC_FixedResidual(std::span<const int32_t> x, uint32_t order, std::vector<int32_t>& residual)
+{
+    residual.resize(x.size() - order);
+    for (size_t i = order; i < x.size(); ++i)
+    {
+        int64_t r = 0;
+        switch (order)
+        {
+        case 0:
+            r = x[i];
+            break;
+        case 1:
+            r = (int64_t)x[i] - x[i - 1];
+            break;
+        case 2:
+            r = (int64_t)x[i] - 2 * (int64_t)x[i - 1] + x[i - 2];
+            break;
+        case 3:
+            r = (int64_t)x[i] - 3 * (int64_t)x[i - 1] + 3 * (int64_t)x[i - 2] - x[i - 3];
+            break;
+        case 4:
+            r = (int64_t)x[i] - 4 * (int64_t)x[i - 1] + 6 * (int64_t)x[i - 2] - 4 * (int64_t)x[i - 3] + x[i - 4];
+            break;
+        }
+        if (r < INT32_MIN || r > INT32_MAX)
+        {
+            return false;
+        }
+        residual[i - order] = (int32_t)r;
+    }
+    return true;
+}
+
+// Computes the residual of a quantized LPC predictor. Returns false if it doesn't fit in 32 bits.
+bool FLAC_LpcResidual(std::span<const int32_t> x,
+                      uint32_t                 order,
+                      const int32_t*           coeffs,
+                      int32_t                  shift,
+                      std::vector<int32_t>&    residual)
+{
+    residual.resize(x.size() - order);
+    for (size_t i = order; i < x.size(); ++i)
+    {
+        int64_t sum = 0;
+        for (uint32_t j = 0; j < order; ++j)
+        {
+            sum += (int64_t)coeffs[j] * x[i - 1 - j];
+        }
+        const int64_t r = x[i] - (sum >> shift);
+        if (r < INT32_MIN || r > INT32_MAX)
+        {
+            return false;
+        }
+        residual[i - order] = (int32_t)r;
+    }
+    return true;
+}
+
+// Quantizes LPC coefficients to FLAC_LPC_PRECISION bits, carrying the rounding error over to the next coefficient.
+// Returns false if they can't be represented with a non-negative shift.
+bool FLAC_QuantizeLpc(const double* lp, uint32_t order, int32_t* coeffs, int32_t& shift)
+{
+    constexpr int32_t QMAX = (1 << (FLAC_LPC_PRECISION - 1)) - 1;
+    constexpr int32_t QMIN = -(1 << (FLAC_LPC_PRECISION - 1));
+
+    double cmax = 0.0;
+    for (uint32_t i = 0; i < order; ++i)
+    {
+        cmax = std::max(cmax, std::fabs(lp[i]));
+    }
+    if (cmax <= 0.0)
+    {
+        return false;
+    }
+
+    int log2cmax;
+    (void)std::frexp(cmax, &log2cmax);
+    shift = (int32_t)FLAC_LPC_PRECISION - log2cmax - 1;
+    if (shift < 0)
+    {
+        return false;
+    }
+    // the shift is coded as a 5-bit signed value
+    shift = Min<int32_t>(shift, 15);
+
+    double error = 0.0;
+    for (uint32_t i = 0; i < order; ++i)
+    {
+        error += lp[i] * (double)(1 << shift);
+        const int32_t q = Clamp<int32_t>((int32_t)std::lround(error), QMIN, QMAX);
+        error -= q;
+        coeffs[i] = q;
+    }
+    return true;
+}
+
+// Per-thread scratch space for encoding blocks.
+class FLAC_Encoder
+{
+public:
+    FLAC_Encoder()
+    {
+        for (auto& channel : m_channels)
+        {
+            channel.resize(FLAC_Handle::BLOCK_SIZE);
+        }
+    }
+
+    // Appends one frame containing `frames` to `out`.
+    void EncodeBlock(std::span<const AudioFrame<int16_t>> frames,
+                     uint64_t                             frame_number,
+                     uint32_t                             sample_rate,
+                     std::vector<uint8_t>&                out)
+    {
+        const size_t n = frames.size();
+        for (auto& channel : m_channels)
+        {
+            channel.resize(n);
+        }
+
+        // left, right, mid, side
+        for (size_t i = 0; i < n; ++i)
+        {
+            const int32_t l  = frames[i].left;
+            const int32_t r  = frames[i].right;
+            m_channels[0][i] = l;
+            m_channels[1][i] = r;
+            m_channels[2][i] = (l + r) >> 1;
+            m_channels[3][i] = l - r;
+        }
+
+        for (size_t c = 0; c < 4; ++c)
+        {
+            AnalyzeSubframe(m_channels[c], c == 3 ? FLAC_BITS_PER_SAMPLE + 1 : FLAC_BITS_PER_SAMPLE, m_subframes[c]);
+        }
+
+        // Channel assignments and the subframes they use.
+        struct Assignment
+        {
+            uint32_t code;
+            size_t   first;
+            size_t   second;
+        };
+        constexpr Assignment ASSIGNMENTS[] = {
+            {0b0001, 0, 1}, // left, right
+            {0b1000, 0, 3}, // left, side
+            {0b1001, 3, 1}, // side, right
+            {0b1010, 2, 3}, // mid, side
+        };
+        const Assignment* best = &ASSIGNMENTS[0];
+        for (const Assignment& a : ASSIGNMENTS)
+        {
+            if (m_subframes[a.first].bits + m_subframes[a.second].bits <
+                m_subframes[best->first].bits + m_subframes[best->second].bits)
+            {
+                best = &a;
+            }
+        }
+
+        const size_t   start = out.size();
+        FLAC_BitWriter writer(out);
+
+        // Frame header
+        writer.Write(0xFFF8, 16);
+        uint32_t block_size_code;
+        if (n == FLAC_Handle::BLOCK_SIZE)
+        {
+            block_size_code = 0b1100;
+        }
+        else if (n <= 256)
+        {
+            block_size_code = 0b0110;
+        }
+        else
+        {
+            block_size_code = 0b0111;
+        }
+        uint32_t sample_rate_code, sample_rate_bits, sample_rate_value;
+        PickSampleRateCode(sample_rate, sample_rate_code, sample_rate_bits, sample_rate_value);
+        writer.Write(block_size_code, 4);
+        writer.Write(sample_rate_code, 4);
+        writer.Write(best->code, 4);
+        writer.Write(0b100, 3); // 16 bits per sample
+        writer.Write(0, 1);
+        writer.WriteUtf8(frame_number);
+        if (block_size_code == 0b0110)
+        {
+            writer.Write((uint32_t)(n - 1), 8);
+        }
+        else if (block_size_code == 0b0111)
+        {
+            writer.Write((uint32_t)(n - 1), 16);
+        }
+        writer.Write(sample_rate_value, sample_rate_bits);
+        writer.Write(FLAC_Crc8(std::span(out).subspan(start)), 8);
+
+        WriteSubframe(writer, m_channels[best->first], best->first == 3, m_subframes[best->first]);
+        WriteSubframe(writer, m_channels[best->second], best->second == 3, m_subframes[best->second]);
+
+        writer.AlignToByte();
+        writer.Write(FLAC_Crc16(std::span(out).subspan(start)), 16);
+    }
+
+private:
+    static void PickSampleRateCode(uint32_t rate, uint32_t& code, uint32_t& bits, uint32_t& value)
+    {
+        struct Common
+        {
+            uint32_t rate;
+            uint32_t code;
+        };
+        constexpr Common COMMON[] = {
+            {88200, 0b0001},
+            {176400, 0b0010},
+            {192000, 0b0011},
+            {8000, 0b0100},
+            {16000, 0b0101},
+            {22050, 0b0110},
+            {24000, 0b0111},
+            {32000, 0b1000},
+            {44100, 0b1001},
+            {48000, 0b1010},
+            {96000, 0b1011},
+        };
+
+        bits  = 0;
+        value = 0;
+        for (const Common& c : COMMON)
+        {
+            if (c.rate == rate)
+            {
+                code = c.code;
+                return;
+            }
+        }
+
+        if (rate <= 0xFFFF)
+        {
+            code  = 0b1101;
+            bits  = 16;
+            value = rate;
+        }
+        else if (rate % 10 == 0 && rate / 10 <= 0xFFFF)
+        {
+            code  = 0b1110;
+            bits  = 16;
+            value = rate / 10;
+        }
+        else
+        {
+            // e.g. 66207 Hz; decoders take it from the stream info
+            code = 0b0000;
+        }
+    }
+
+    void AnalyzeSubframe(std::span<const int32_t> x, uint32_t bps, FLAC_Subframe& out)
+    {
+        const size_t n = x.size();
+
+        if (std::all_of(x.begin(), x.end(), [&](int32_t v) { return v == x[0]; }))
+        {
+            out.type = FLAC_SubframeType::Constant;
+            out.bits = 8 + bps;
+            return;
+        }
+
+        out.type = FLAC_SubframeType::Verbatim;
+        out.bits = 8 + n * bps;
+
+        FLAC_RicePlan plan;
+        for (uint32_t order = 0; order <= 4 && order < n; ++order)
+        {
+            if (!FLAC_FixedResidual(x, order, m_residual))
+            {
+                continue;
+            }
+            const uint64_t bits = 8 + order * bps + FLAC_PlanResidual(m_residual, n, order, plan);
+            if (bits < out.bits)
+            {
+                out.type  = FLAC_SubframeType::Fixed;
+                out.order = order;
+                out.rice  = plan;
+                out.bits  = bits;
+                std::swap(out.residual, m_residual);
+            }
+        }
+
+        const uint32_t max_order = (uint32_t)Min<size_t>(FLAC_MAX_LPC_ORDER, n - 1);
+        double         lp[FLAC_MAX_LPC_ORDER][FLAC_MAX_LPC_ORDER];
+        const uint32_t lp_orders = ComputeLpc(x, max_order, lp);
+        for (uint32_t order = 1; order <= lp_orders; ++order)
+        {
+            int32_t coeffs[FLAC_MAX_LPC_ORDER];
+            int32_t shift;
+            if (!FLAC_QuantizeLpc(lp[order - 1], order, coeffs, shift) ||
+                !FLAC_LpcResidual(x, order, coeffs, shift, m_residual))
+            {
+                continue;
+            }
+            const uint64_t bits =
+                8 + order * bps + 4 + 5 + order * FLAC_LPC_PRECISION + FLAC_PlanResidual(m_residual, n, order, plan);
+            if (bits < out.bits)
+            {
+                out.type  = FLAC_SubframeType::LPC;
+                out.order = order;
+                std::copy(coeffs, coeffs + order, out.coeffs);
+                out.shift = shift;
+                out.rice  = plan;
+                out.bits  = bits;
+                std::swap(out.residual, m_residual);
+            }
+        }
+    }
+
+    // Computes LPC coefficients for every order up to `max_order` from the autocorrelation of the windowed signal.
+    // lp[k][j] is coefficient j of the order k+1 predictor. Returns the highest order computed.
+    uint32_t ComputeLpc(std::span<const int32_t> x, uint32_t max_order, double (*lp)[FLAC_MAX_LPC_ORDER])
+    {
+        const size_t n = x.size();
+        if (max_order == 0)
+        {
+            return 0;
+        }
+
+        // Tukey window with half of the block tapered, which is libFLAC's default
+        m_windowed.resize(n);
+        const double taper = 0.25 * (double)(n - 1);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const double edge = (double)Min(i, n - 1 - i);
+            double       w    = 1.0;
+            if (edge < taper)
+            {
+                w = 0.5 - 0.5 * std::cos(std::numbers::pi * edge / taper);
+            }
+            m_windowed[i] = w * x[i];
+        }
+
+        double autoc[FLAC_MAX_LPC_ORDER + 1];
+        for (uint32_t lag = 0; lag <= max_order; ++lag)
+        {
+            double sum = 0.0;
+            for (size_t i = lag; i < n; ++i)
+            {
+                sum += m_windowed[i] * m_windowed[i - lag];
+            }
+            autoc[lag] = sum;
+        }
+        if (autoc[0] <= 0.0)
+        {
+            return 0;
+        }
+
+        // Levinson-Durbin recursion
+        double a[FLAC_MAX_LPC_ORDER]{};
+        double error = autoc[0];
+        for (uint32_t m = 0; m < max_order; ++m)
+        {
+            double k = autoc[m + 1];
+            for (uint32_t j = 0; j < m; ++j)
+            {
+                k -= a[j] * autoc[m - j];
+            }
+            k /= error;
+
+            double prev[FLAC_MAX_LPC_ORDER];
+            std::copy(a, a + m, prev);
+            for (uint32_t j = 0; j < m; ++j)
+            {
+                a[j] = prev[j] - k * prev[m - 1 - j];
+            }
+            a[m] = k;
+            std::copy(a, a + m + 1, lp[m]);
+
+            error *= 1.0 - k * k;
+            if (error <= 0.0)
+            {
+                return m + 1;
+            }
+        }
+        return max_order;
+    }
+
+    static void WriteSubframe(FLAC_BitWriter&          writer,
+                              std::span<const int32_t> x,
+                              bool                     is_side,
+                              const FLAC_Subframe&     sub)
+    {
+        const uint32_t bps = is_side ? FLAC_BITS_PER_SAMPLE + 1 : FLAC_BITS_PER_SAMPLE;
+
+        writer.Write(0, 1);
+        switch (sub.type)
+        {
+        case FLAC_SubframeType::Constant:
+            writer.Write(0b000000, 6);
+            writer.Write(0, 1);
+            writer.WriteSigned(x[0], bps);
+            break;
+        case FLAC_SubframeType::Verbatim:
+            writer.Write(0b000001, 6);
+            writer.Write(0, 1);
+            for (int32_t v : x)
+            {
+                writer.WriteSigned(v, bps);
+            }
+            break;
+        case FLAC_SubframeType::Fixed:
+            writer.Write(0b001000 | sub.order, 6);
+            writer.Write(0, 1);
+            for (uint32_t i = 0; i < sub.order; ++i)
+            {
+                writer.WriteSigned(x[i], bps);
+            }
+            FLAC_WriteResidual(writer, sub.residual, x.size(), sub.order, sub.rice);
+            break;
+        case FLAC_SubframeType::LPC:
+            writer.Write(0b100000 | (sub.order - 1), 6);
+            writer.Write(0, 1);
+            for (uint32_t i = 0; i < sub.order; ++i)
+            {
+                writer.WriteSigned(x[i], bps);
+            }
+            writer.Write(FLAC_LPC_PRECISION - 1, 4);
+            writer.WriteSigned(sub.shift, 5);
+            for (uint32_t i = 0; i < sub.order; ++i)
+            {
+                writer.WriteSigned(sub.coeffs[i], FLAC_LPC_PRECISION);
+            }
+            FLAC_WriteResidual(writer, sub.residual, x.size(), sub.order, sub.rice);
+            break;
+        }
+    }
+
+private:
+    std::vector<int32_t> m_channels[4];
+    FLAC_Subframe        m_subframes[4];
+    std::vector<int32_t> m_residual;
+    std::vector<double>  m_windowed;
+};
+
+void FLAC_WriteStreamInfo(FILE*    output,
+                          uint32_t sample_rate,
+                          uint64_t total_frames,
+                          uint32_t min_frame_size,
+                          uint32_t max_frame_size)
+{
+    std::vector<uint8_t> bytes;
+    FLAC_BitWriter       writer(bytes);
+
+    writer.Write('f', 8);
+    writer.Write('L', 8);
+    writer.Write('a', 8);
+    writer.Write('C', 8);
+    // metadata block header: last block, type 0 (STREAMINFO), 34 bytes
+    writer.Write(1, 1);
+    writer.Write(0, 7);
+    writer.Write(34, 24);
+    writer.Write(FLAC_Handle::BLOCK_SIZE, 16);
+    writer.Write(FLAC_Handle::BLOCK_SIZE, 16);
+    writer.Write(min_frame_size, 24);
+    writer.Write(max_frame_size, 24);
+    writer.Write(sample_rate, 20);
+    writer.Write(AudioFrame<int16_t>::channel_count - 1, 3);
+    writer.Write(FLAC_BITS_PER_SAMPLE - 1, 5);
+    writer.Write((uint32_t)(total_frames >> 32), 4);
+    writer.Write((uint32_t)total_frames, 32);
+    // MD5 of the audio; all zeroes means it wasn't computed
+    for (int i = 0; i < 4; ++i)
+    {
+        writer.Write(0, 32);
+    }
+
+    fwrite(bytes.data(), 1, bytes.size(), output);
+}
+
+FLAC_Handle::~FLAC_Handle()
+{
+    if (!m_workers.empty())
+    {
+        {
+            std::scoped_lock lk(m_mutex);
+            m_stop = true;
+        }
+        m_job_cond.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+    Close();
+}
+
+bool FLAC_Handle::Open(const std::filesystem::path& filename, size_t thread_count)
+{
+    m_output = fopen(filename.generic_string().c_str(), "wb");
+    if (!m_output)
+    {
+        return false;
+    }
+    m_seekable    = true;
+    m_info_offset = 0;
+    Start(thread_count);
+    return true;
+}
+
+void FLAC_Handle::OpenStdout(size_t thread_count)
+{
+    m_output = stdout;
+
+    // When stdout is redirected to a file we can go back and fill in the stream info like any other file.
+    m_info_offset = ftell(m_output);
+    m_seekable    = m_info_offset >= 0 && fseek(m_output, m_info_offset, SEEK_SET) == 0;
+    Start(thread_count);
+}
+
+void FLAC_Handle::Start(size_t thread_count)
+{
+    m_pending.reserve(FLAC_BATCH_FRAMES);
+    for (size_t i = 0; i < std::max<size_t>(thread_count, 1); ++i)
+    {
+        m_workers.emplace_back(&FLAC_Handle::WorkerMain, this);
+    }
+}
+
+void FLAC_Handle::Close()
+{
+    if (m_output && m_output != stdout)
+    {
+        fclose(m_output);
+    }
+    m_output = nullptr;
+}
+
+void FLAC_Handle::SetSampleRate(uint32_t sample_rate)
+{
+    m_sample_rate = sample_rate;
+}
+
+void FLAC_Handle::Write(std::span<const AudioFrame<int16_t>> frames)
+{
+    while (!frames.empty())
+    {
+        const size_t count = Min(frames.size(), FLAC_BATCH_FRAMES - m_pending.size());
+        m_pending.insert(m_pending.end(), frames.begin(), frames.begin() + (ptrdiff_t)count);
+        m_frames_written += count;
+        frames = frames.subspan(count);
+        if (m_pending.size() == FLAC_BATCH_FRAMES)
+        {
+            Submit();
+        }
+    }
+}
+
+// The command line rejects FLAC with any other sample format, so getting here is a bug. Fail loudly rather than
+// writing a stream without any audio.
+void FLAC_Handle::Write(std::span<const AudioFrame<int32_t>> frames)
+{
+    (void)frames;
+    fprintf(stderr, "PANIC: FLAC_Handle::Write called with 32-bit samples; FLAC output is 16-bit\n");
+    std::abort();
+}
+
+void FLAC_Handle::Write(std::span<const AudioFrame<float>> frames)
+{
+    (void)frames;
+    fprintf(stderr, "PANIC: FLAC_Handle::Write called with float samples; FLAC output is 16-bit\n");
+    std::abort();
+}
+
+void FLAC_Handle::Submit()
+{
+    // Nothing has been handed to the workers yet, so nothing else is writing to the output.
+    if (m_batches_submitted == 0)
+    {
+        FLAC_WriteStreamInfo(m_output, m_sample_rate, 0, 0, 0);
+    }
+
+    Batch batch{m_batches_submitted++, std::move(m_pending)};
+    m_pending.clear();
+    {
+        std::unique_lock lk(m_mutex);
+        // Keep a bounded amount of audio in flight in case the workers fall behind.
+        m_done_cond.wait(lk, [this] { return m_jobs.size() < 2 * m_workers.size(); });
+        m_jobs.push_back(std::move(batch));
+        if (!m_free_buffers.empty())
+        {
+            m_pending = std::move(m_free_buffers.back());
+            m_free_buffers.pop_back();
+        }
+    }
+    m_job_cond.notify_one();
+    m_pending.clear();
+    m_pending.reserve(FLAC_BATCH_FRAMES);
+}
+
+void FLAC_Handle::WorkerMain()
+{
+    FLAC_Encoder         encoder;
+    std::vector<uint8_t> bytes;
+
+    while (true)
+    {
+        Batch batch;
+        {
+            std::unique_lock lk(m_mutex);
+            m_job_cond.wait(lk, [this] { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty())
+            {
+                return;
+            }
+            batch = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        m_done_cond.notify_all();
+
+        bytes.clear();
+        uint32_t             min_frame_size = UINT32_MAX;
+        uint32_t             max_frame_size = 0;
+        const uint64_t       first_block    = batch.index * FLAC_BATCH_BLOCKS;
+        std::span<const AudioFrame<int16_t>> frames = batch.frames;
+        for (uint64_t block = first_block; !frames.empty(); ++block)
+        {
+            const size_t count = Min(frames.size(), BLOCK_SIZE);
+            const size_t start = bytes.size();
+            encoder.EncodeBlock(frames.first(count), block, m_sample_rate, bytes);
+            min_frame_size = Min(min_frame_size, (uint32_t)(bytes.size() - start));
+            max_frame_size = std::max(max_frame_size, (uint32_t)(bytes.size() - start));
+            frames         = frames.subspan(count);
+        }
+
+        {
+            std::unique_lock lk(m_mutex);
+            m_done_cond.wait(lk, [&] { return m_next_write == batch.index; });
+        }
+
+        // Only the worker holding the next batch writes, so this doesn't need the lock.
+        fwrite(bytes.data(), 1, bytes.size(), m_output);
+
+        {
+            std::scoped_lock lk(m_mutex);
+            ++m_next_write;
+            m_min_frame_size = Min(m_min_frame_size, min_frame_size);
+            m_max_frame_size = std::max(m_max_frame_size, max_frame_size);
+            m_free_buffers.push_back(std::move(batch.frames));
+        }
+        m_done_cond.notify_all();
+    }
+}
+
+void FLAC_Handle::Finish()
+{
+    if (!m_pending.empty() || m_batches_submitted == 0)
+    {
+        Submit();
+    }
+
+    {
+        std::scoped_lock lk(m_mutex);
+        m_stop = true;
+    }
+    m_job_cond.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+
+    // go back and fill in the stream info
+    if (m_seekable)
+    {
+        const uint32_t min_frame_size = m_min_frame_size == UINT32_MAX ? 0 : m_min_frame_size;
+        fseek(m_output, m_info_offset, SEEK_SET);
+        FLAC_WriteStreamInfo(m_output, m_sample_rate, m_frames_written, min_frame_size, m_max_frame_size);
+    }
+
+    fflush(m_output);
+    Close();
+}
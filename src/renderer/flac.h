@@ -0,0 +1,79 @@
+// Minimal FLAC encoder for 16-bit stereo audio. Blocks are encoded on worker threads so that the mix thread only
+// copies frames.
+
+#pragma once
+
+#include "audio_sink.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class FLAC_Handle final : public AudioSink
+{
+public:
+    FLAC_Handle() = default;
+    ~FLAC_Handle();
+    // Not copyable or moveable, since the worker threads refer to the handle.
+    FLAC_Handle(const FLAC_Handle&)            = delete;
+    FLAC_Handle& operator=(const FLAC_Handle&) = delete;
+
+    // Returns false if the file couldn't be opened for writing. Blocks are encoded on `thread_count` threads.
+    bool Open(const std::filesystem::path& filename, size_t thread_count);
+    // Writes the stream to stdout. If stdout can't seek, the stream info is left without a total sample count.
+    void OpenStdout(size_t thread_count);
+
+    void SetSampleRate(uint32_t sample_rate) override;
+
+    void Write(std::span<const AudioFrame<int16_t>> frames) override;
+    // FLAC output is always 16-bit. The command line rejects other formats, so these abort if they are ever called.
+    void Write(std::span<const AudioFrame<int32_t>> frames) override;
+    void Write(std::span<const AudioFrame<float>> frames) override;
+
+    void Finish() override;
+
+    // Number of frames per FLAC block.
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+private:
+    // A run of consecutive blocks encoded by one worker.
+    struct Batch
+    {
+        uint64_t                         index = 0;
+        std::vector<AudioFrame<int16_t>> frames;
+    };
+
+    void Start(size_t thread_count);
+    void Submit();
+    void WorkerMain();
+    void Close();
+
+private:
+    FILE*    m_output      = nullptr;
+    bool     m_seekable    = false;
+    long     m_info_offset = 0;
+    uint32_t m_sample_rate = 0;
+
+    // Only touched by the thread calling Write.
+    std::vector<AudioFrame<int16_t>> m_pending;
+    uint64_t                         m_batches_submitted = 0;
+    uint64_t                         m_frames_written    = 0;
+
+    std::vector<std::thread> m_workers;
+
+    // Protects everything below.
+    std::mutex                                    m_mutex;
+    std::condition_variable                       m_job_cond;
+    std::condition_variable                       m_done_cond;
+    std::deque<Batch>                             m_jobs;
+    std::vector<std::vector<AudioFrame<int16_t>>> m_free_buffers;
+    bool                                          m_stop = false;
+    // Batches are written in order; a worker that finishes early waits for this to reach its batch.
+    uint64_t m_next_write     = 0;
+    uint32_t m_min_frame_size = UINT32_MAX;
+    uint32_t m_max_frame_size = 0;
+};
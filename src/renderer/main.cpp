@@ -1,22 +1,32 @@
 #include "audio.h"
+#include "audio_mix.h"
+#include "batch.h"
 #include "cast.h"
 #include "config.h"
 #include "emu.h"
+#include "flac.h"
 #include "math_util.h"
 #include "smf.h"
 #include "wav.h"
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cinttypes>
-#include <condition_variable>
 #include <cstddef>
 #include <cstdio>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <random>
 #include <source_location>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "common/command_line.h"
 #include "common/gain.h"
@@ -41,18 +51,27 @@ enum class R_EndBehavior
 struct R_AdvancedParameters
 {
     common::RomOverrides rom_overrides;
+    MCU_Backend mcu_backend = MCU_Backend::Cached;
+    bool mcu_lockstep = false;
+    PCM_Engine pcm_engine = PCM_Engine::Vector;
 };
 
 struct R_Parameters
 {
-    std::string_view input_filename;
+    std::vector<std::filesystem::path> input_filenames;
+    std::filesystem::path manifest_filename;
+    // In batch mode this is a template for the output filenames, see R_MakeOutputPath.
     std::string_view output_filename;
     bool help = false;
     bool version = false;
     size_t instances = 1;
+    // Number of files rendered at once in batch mode, or 0 to pick one based on the core count.
+    size_t jobs = 0;
     std::optional<EMU_SystemReset> reset;
     std::filesystem::path rom_directory;
     AudioFormat output_format = AudioFormat::S16;
+    // Encode FLAC instead of writing a wave file. Set by `-f flac` or an output filename ending in .flac.
+    bool output_flac = false;
     bool output_stdout = false;
     bool disable_oversampling = false;
     std::string_view romset_name;
@@ -62,6 +81,7 @@ struct R_Parameters
     bool legacy_romset_detection = false;
     bool dump_emidi_loop_points = false;
     float gain = 1.0f;
+    std::filesystem::path reset_cache_directory;
     R_AdvancedParameters adv;
 };
 
@@ -70,7 +90,6 @@ enum class R_ParseError
     Success,
     NoInput,
     NoOutput,
-    MultipleInputs,
     InstancesInvalid,
     InstancesOutOfRange,
     UnexpectedEnd,
@@ -79,6 +98,13 @@ enum class R_ParseError
     EndInvalid,
     ResetInvalid,
     GainInvalid,
+    McuBackendInvalid,
+    PcmEngineInvalid,
+    JobsInvalid,
+    ManifestNotFound,
+    BatchStdout,
+    BatchNvram,
+    FlacFormat,
 };
 
 const char* R_ParseErrorStr(R_ParseError err)
@@ -91,8 +117,6 @@ const char* R_ParseErrorStr(R_ParseError err)
             return "No input file specified";
         case R_ParseError::NoOutput:
             return "No output file specified (pass -o)";
-        case R_ParseError::MultipleInputs:
-            return "Multiple input files";
         case R_ParseError::InstancesInvalid:
             return "Instances couldn't be parsed (should be 1-16)";
         case R_ParseError::InstancesOutOfRange:
@@ -109,10 +133,42 @@ const char* R_ParseErrorStr(R_ParseError err)
             return "Reset invalid (should be none, gs, or gm)";
         case R_ParseError::GainInvalid:
             return "Gain invalid (should be a number optionally ending in 'db')";
+        case R_ParseError::McuBackendInvalid:
+            return "MCU backend invalid (should be cached, interpreter, or jit)";
+        case R_ParseError::PcmEngineInvalid:
+            return "PCM engine invalid (should be scalar or vector)";
+        case R_ParseError::JobsInvalid:
+            return "Jobs invalid (should be at least 1)";
+        case R_ParseError::ManifestNotFound:
+            return "Manifest file doesn't exist";
+        case R_ParseError::BatchStdout:
+            return "--stdout and -o - can't be used when rendering multiple files";
+        case R_ParseError::BatchNvram:
+            return "--nvram can't be used when rendering multiple files";
+        case R_ParseError::FlacFormat:
+            return "FLAC output only supports s16 samples";
     }
     return "Unknown error";
 }
 
+// Rendering more than one file, or a directory of files, renders them all on a pool of reusable emulators.
+bool R_IsBatch(const R_Parameters& params)
+{
+    return R_IsBatch(params.input_filenames, params.manifest_filename, params.output_filename);
+}
+
+bool R_HasFlacExtension(std::string_view filename)
+{
+    constexpr std::string_view EXTENSION = ".flac";
+    if (filename.size() < EXTENSION.size())
+    {
+        return false;
+    }
+    return std::equal(EXTENSION.begin(), EXTENSION.end(), filename.end() - EXTENSION.size(), [](char a, char b) {
+        return a == std::tolower((unsigned char)b);
+    });
+}
+
 R_ParseError R_ParseCommandLine(int argc, char* argv[], R_Parameters& result)
 {
     common::CommandLineReader reader(argc, argv);
@@ -159,6 +215,31 @@ R_ParseError R_ParseCommandLine(int argc, char* argv[], R_Parameters& result)
                 return R_ParseError::InstancesOutOfRange;
             }
         }
+        else if (reader.Any("-j", "--jobs"))
+        {
+            if (!reader.Next())
+            {
+                return R_ParseError::UnexpectedEnd;
+            }
+
+            if (!reader.TryParse(result.jobs) || result.jobs < 1)
+            {
+                return R_ParseError::JobsInvalid;
+            }
+        }
+        else if (reader.Any("--manifest"))
+        {
+            if (!reader.Next())
+            {
+                return R_ParseError::UnexpectedEnd;
+            }
+
+            result.manifest_filename = reader.Arg();
+            if (!std::filesystem::exists(result.manifest_filename))
+            {
+                return R_ParseError::ManifestNotFound;
+            }
+        }
         else if (reader.Any("-r", "--reset"))
         {
             if (!reader.Next())
@@ -221,6 +302,7 @@ R_ParseError R_ParseCommandLine(int argc, char* argv[], R_Parameters& result)
                 return R_ParseError::UnexpectedEnd;
             }
 
+            result.output_flac = false;
             if (reader.Arg() == "s16")
             {
                 result.output_format = AudioFormat::S16;
@@ -233,6 +315,11 @@ R_ParseError R_ParseCommandLine(int argc, char* argv[], R_Parameters& result)
             {
                 result.output_format = AudioFormat::F32;
             }
+            else if (reader.Arg() == "flac")
+            {
+                result.output_format = AudioFormat::S16;
+                result.output_flac   = true;
+            }
             else
             {
                 return R_ParseError::FormatInvalid;
@@ -354,21 +441,74 @@ R_ParseError R_ParseCommandLine(int argc, char* argv[], R_Parameters& result)
 
             result.adv.rom_overrides[(size_t)RomLocation::WAVEROM_EXP] = reader.Arg();
         }
+        else if (reader.Any("--mcu-backend"))
+        {
+            if (!reader.Next())
+            {
+                return R_ParseError::UnexpectedEnd;
+            }
+
+            if (reader.Arg() == "cached")
+            {
+                result.adv.mcu_backend = MCU_Backend::Cached;
+            }
+            else if (reader.Arg() == "interpreter")
+            {
+                result.adv.mcu_backend = MCU_Backend::Interpreter;
+            }
+            else if (reader.Arg() == "jit")
+            {
+                result.adv.mcu_backend = MCU_Backend::Jit;
+            }
+            else
+            {
+                return R_ParseError::McuBackendInvalid;
+            }
+        }
+        else if (reader.Any("--mcu-lockstep"))
+        {
+            result.adv.mcu_lockstep = true;
+        }
+        else if (reader.Any("--pcm-engine"))
+        {
+            if (!reader.Next())
+            {
+                return R_ParseError::UnexpectedEnd;
+            }
+
+            if (reader.Arg() == "scalar")
+            {
+                result.adv.pcm_engine = PCM_Engine::Scalar;
+            }
+            else if (reader.Arg() == "vector")
+            {
+                result.adv.pcm_engine = PCM_Engine::Vector;
+            }
+            else
+            {
+                return R_ParseError::PcmEngineInvalid;
+            }
+        }
         else if (reader.Any("--dump-emidi-loop-points"))
         {
             result.dump_emidi_loop_points = true;
         }
-        else
+        else if (reader.Any("--reset-cache"))
         {
-            if (result.input_filename.size())
+            if (!reader.Next())
             {
-                return R_ParseError::MultipleInputs;
+                return R_ParseError::UnexpectedEnd;
             }
-            result.input_filename = reader.Arg();
+
+            result.reset_cache_directory = reader.Arg();
+        }
+        else
+        {
+            result.input_filenames.emplace_back(reader.Arg());
         }
     }
 
-    if (result.input_filename.size() == 0)
+    if (result.input_filenames.empty() && result.manifest_filename.empty())
     {
         return R_ParseError::NoInput;
     }
@@ -378,6 +518,29 @@ R_ParseError R_ParseCommandLine(int argc, char* argv[], R_Parameters& result)
         return R_ParseError::NoOutput;
     }
 
+    if (R_HasFlacExtension(result.output_filename))
+    {
+        result.output_flac = true;
+    }
+
+    if (result.output_flac && result.output_format != AudioFormat::S16)
+    {
+        return R_ParseError::FlacFormat;
+    }
+
+    if (R_IsBatch(result))
+    {
+        if (result.output_stdout || result.output_filename == "-")
+        {
+            return R_ParseError::BatchStdout;
+        }
+
+        if (!result.nvram_filename.empty())
+        {
+            return R_ParseError::BatchNvram;
+        }
+    }
+
     return R_ParseError::Success;
 }
 
@@ -388,52 +551,60 @@ void R_Panic(const char* msg, const std::source_location where = std::source_loc
     exit(1);
 }
 
+class R_ChunkPool;
+
 // Audio frame chunk. Points to a header followed by a dynamically sized buffer containing audio data. The buffer
 // contains audio data. This type has reference semantics and represents unowned memory like a bare pointer, so take
 // care making copies of it.
 class R_FrameChunk
 {
 public:
+    // Chunks are allocated as one 64-byte aligned slab: the header, padding up to the next 64 bytes, then the buffer.
+    // This keeps the buffer 64-byte aligned for max SIMD compatibility.
     [[nodiscard]]
-    static R_FrameChunk Alloc(size_t size_bytes)
+    static R_FrameChunk Alloc(size_t size_bytes, R_ChunkPool* pool)
     {
         R_FrameChunk c;
 
-        // TODO: use a better allocator. We allocate a bit more space because malloc has weak alignment guarantees, and
-        // we want the buffer to be 64-byte aligned for max SIMD compatibility.
-        size_t alloc_size = 64 + sizeof(Header) + size_bytes;
-
-        void* ptr = malloc(alloc_size);
+        void* ptr = ::operator new(BUFFER_OFFSET + size_bytes, std::align_val_t(64), std::nothrow);
         if (!ptr)
         {
             return c;
         }
 
-        // This should never fail or adjust ptr so passing the aligned pointer back to free should be ok.
-        if (!std::align(alignof(Header), sizeof(Header), ptr, alloc_size))
-        {
-            R_Panic("failed to align header");
-        }
-
         Header* h = new (ptr) Header();
-        ptr = (uint8_t*)ptr + sizeof(Header);
+        h->buffer = (uint8_t*)ptr + BUFFER_OFFSET;
+        h->cap    = size_bytes;
+        h->pool   = pool;
+        c.m_alloc = h;
 
-        if (!std::align(64, size_bytes, ptr, alloc_size))
+        return c;
+    }
+
+    static void Free(R_FrameChunk c)
+    {
+        if (c.IsNull())
         {
-            R_Panic("failed to align buffer");
+            return;
         }
+        c.m_alloc->~Header();
+        ::operator delete(c.m_alloc, std::align_val_t(64));
+    }
 
-        h->buffer      = ptr;
-        c.m_alloc      = h;
-        c.m_alloc->cap = size_bytes;
+    // Returns the chunk to the pool it was allocated from, or frees it if there is none.
+    static void Release(R_FrameChunk c);
 
-        return c;
+    [[nodiscard]]
+    size_t GetBufferCapacity() const
+    {
+        return m_alloc->cap;
     }
 
-    static void Free(R_FrameChunk c)
+    // Empties the buffer and unlinks the chunk so that it can be reused.
+    void Clear()
     {
-        free(c.m_alloc);
-        c.m_alloc = nullptr;
+        m_alloc->next = nullptr;
+        m_alloc->len  = 0;
     }
 
     [[nodiscard]]
@@ -461,6 +632,18 @@ public:
         m_alloc->len += src_len;
     }
 
+    // Marks `len` bytes starting at DataLast() as written. Used after writing into the buffer directly.
+    void Commit(size_t len)
+    {
+        m_alloc->len += len;
+    }
+
+    [[nodiscard]]
+    size_t GetFreeLength() const
+    {
+        return m_alloc->cap - m_alloc->len;
+    }
+
     [[nodiscard]]
     bool IsNull() const
     {
@@ -489,16 +672,100 @@ public:
 private:
     struct Header
     {
-        Header* next = nullptr;
-        size_t  len  = 0;
-        size_t  cap  = 0;
-        void*   buffer;
+        Header*      next = nullptr;
+        size_t       len  = 0;
+        size_t       cap  = 0;
+        void*        buffer;
+        R_ChunkPool* pool = nullptr;
     };
 
+    static constexpr size_t BUFFER_OFFSET = 64;
+    static_assert(sizeof(Header) <= BUFFER_OFFSET);
+
 private:
     Header* m_alloc = nullptr;
 };
 
+// Recycles chunks so that steady state rendering doesn't allocate. Emulator threads take chunks from the pool and the mix
+// thread gives them back once they've been mixed, so a render only allocates as many chunks as are ever in flight at
+// once. The lock is taken about once per chunk per thread, which is rare enough not to matter.
+class R_ChunkPool
+{
+public:
+    R_ChunkPool() = default;
+
+    // Non-copyable, since chunks point back to their pool.
+    R_ChunkPool(const R_ChunkPool&)            = delete;
+    R_ChunkPool& operator=(const R_ChunkPool&) = delete;
+
+    // precondition: every chunk taken from the pool has been released
+    ~R_ChunkPool()
+    {
+        R_FrameChunk c = m_free;
+        while (!c.IsNull())
+        {
+            R_FrameChunk next = c.GetNext();
+            R_FrameChunk::Free(c);
+            c = next;
+        }
+    }
+
+    // Returns an empty chunk with a buffer of exactly `size_bytes`, reusing a released one if possible.
+    [[nodiscard]]
+    R_FrameChunk Acquire(size_t size_bytes)
+    {
+        R_FrameChunk c;
+        {
+            std::scoped_lock lk(m_mutex);
+            c = m_free;
+            if (!c.IsNull())
+            {
+                m_free = c.GetNext();
+            }
+        }
+
+        if (!c.IsNull())
+        {
+            if (c.GetBufferCapacity() == size_bytes)
+            {
+                c.Clear();
+                return c;
+            }
+            // All chunks in a render have the same size so this only happens when the output format changes.
+            R_FrameChunk::Free(c);
+        }
+
+        return R_FrameChunk::Alloc(size_bytes, this);
+    }
+
+    void Release(R_FrameChunk c)
+    {
+        std::scoped_lock lk(m_mutex);
+        c.SetNext(m_free);
+        m_free = c;
+    }
+
+private:
+    std::mutex   m_mutex;
+    R_FrameChunk m_free;
+};
+
+void R_FrameChunk::Release(R_FrameChunk c)
+{
+    if (c.IsNull())
+    {
+        return;
+    }
+    if (c.m_alloc->pool)
+    {
+        c.m_alloc->pool->Release(c);
+    }
+    else
+    {
+        Free(c);
+    }
+}
+
 // Manages a chunk and frees it when it goes out of scope, similar to unique_ptr. Code outside of the chunk queue should
 // only use this type.
 class R_OwnedChunk
@@ -535,7 +802,7 @@ public:
 
     void Free()
     {
-        R_FrameChunk::Free(m_chunk);
+        R_FrameChunk::Release(m_chunk);
         m_chunk = R_FrameChunk();
     }
 
@@ -558,6 +825,17 @@ public:
         m_chunk.Write(src, src_len);
     }
 
+    void Commit(size_t len)
+    {
+        m_chunk.Commit(len);
+    }
+
+    [[nodiscard]]
+    size_t GetFreeLength() const
+    {
+        return m_chunk.GetFreeLength();
+    }
+
     [[nodiscard]]
     bool IsBufferFull() const
     {
@@ -592,62 +870,103 @@ private:
     R_FrameChunk m_chunk;
 };
 
-// Threadsafe queue for chunks of audio. The intent is that emulators should be able to expand the queue as fast as
-// possible while it may drain at a different rate. Contention is kept low by creating chunks of data and enqueuing or
-// dequeuing chunks at a time. For a buffer size of ~64k, expect each thread to take a lock once per second.
-class R_ChunkQueue
+// Lets threads sleep until a condition made true by other threads holds, without a lock. A waiter calls PrepareWait,
+// checks the condition, then calls either CancelWait if it holds or Wait with the returned key if it doesn't. A notifier
+// makes the condition true before calling Notify, which only touches the futex when someone is actually waiting.
+class R_EventCount
 {
 public:
-    R_ChunkQueue() = default;
+    [[nodiscard]]
+    uint32_t PrepareWait()
+    {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        // Pairs with the fence in Notify: either the waiter sees the condition or the notifier sees the waiter.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return m_epoch.load(std::memory_order_seq_cst);
+    }
 
-    void Enqueue(R_OwnedChunk chunk)
+    void CancelWait()
     {
-        std::scoped_lock lk(m_mutex);
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // May return spuriously, so callers should check their condition again.
+    void Wait(uint32_t key)
+    {
+        m_epoch.wait(key, std::memory_order_seq_cst);
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
 
-        R_FrameChunk raw = chunk.Unmanage();
-        if (!m_last.IsNull())
+    void Notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) != 0)
         {
-            m_last.SetNext(raw);
-            m_last = raw;
+            m_epoch.fetch_add(1, std::memory_order_seq_cst);
+            m_epoch.notify_all();
         }
-        else
+    }
+
+private:
+    std::atomic<uint32_t> m_epoch   = 0;
+    std::atomic<uint32_t> m_waiters = 0;
+};
+
+// Single producer, single consumer queue for chunks of audio. Each emulator thread fills its own queue as fast as it can
+// while the mix thread drains all of them at a different rate. The queue holds a bounded number of chunks so that an
+// emulator running far ahead of the others can't use unbounded memory; TryEnqueue fails when it's full.
+class R_ChunkQueue
+{
+public:
+    R_ChunkQueue() = default;
+
+    // Producer side. Takes ownership of `chunk` and returns true, or leaves it alone and returns false if the queue is
+    // full.
+    [[nodiscard]]
+    bool TryEnqueue(R_OwnedChunk& chunk)
+    {
+        const size_t write_ptr = m_write_ptr.load(std::memory_order_relaxed);
+        if (write_ptr - m_read_ptr.load(std::memory_order_acquire) == CAPACITY)
         {
-            m_first = raw;
-            m_last  = raw;
+            return false;
         }
-        ++m_count;
+        m_ring[write_ptr % CAPACITY] = chunk.Unmanage();
+        m_write_ptr.store(write_ptr + 1, std::memory_order_release);
+        return true;
     }
 
+    // Consumer side.
+    // precondition: ChunkCount() > 0
     void Dequeue(R_OwnedChunk& chunk)
     {
-        std::scoped_lock lk(m_mutex);
-
-        if (!m_first.IsNull())
-        {
-            chunk.Manage(m_first);
-            m_first = m_first.GetNext();
-            if (m_first.IsNull())
-            {
-                m_last = m_first;
-            }
-        }
-        else
+        const size_t read_ptr = m_read_ptr.load(std::memory_order_relaxed);
+        if (m_write_ptr.load(std::memory_order_acquire) == read_ptr)
         {
             R_Panic("empty queue");
         }
-        --m_count;
+        chunk.Manage(m_ring[read_ptr % CAPACITY]);
+        m_read_ptr.store(read_ptr + 1, std::memory_order_release);
     }
 
     size_t ChunkCount() const
     {
-        return m_count;
+        return m_write_ptr.load(std::memory_order_acquire) - m_read_ptr.load(std::memory_order_acquire);
+    }
+
+    bool IsFull() const
+    {
+        return ChunkCount() == CAPACITY;
     }
 
 private:
-    std::mutex          m_mutex;
-    R_FrameChunk        m_first;
-    R_FrameChunk        m_last;
-    std::atomic<size_t> m_count = 0;
+    // With 64k frame chunks, this is a couple of minutes of audio.
+    static constexpr size_t CAPACITY = 128;
+
+    R_FrameChunk m_ring[CAPACITY];
+
+    // The two ends are written by different threads, so keep them on separate cache lines.
+    alignas(64) std::atomic<size_t> m_read_ptr = 0;
+    alignas(64) std::atomic<size_t> m_write_ptr = 0;
 };
 
 class R_Mixer
@@ -656,8 +975,16 @@ public:
     // Blocks the calling thread until there's enough data in queues to mix.
     void WaitForWork()
     {
-        std::unique_lock lk(m_mutex);
-        m_cond.wait(lk, [this]() { return GetReadyChunkCount() > 0; });
+        while (GetReadyChunkCount() == 0)
+        {
+            const uint32_t key = m_work_event.PrepareWait();
+            if (GetReadyChunkCount() > 0)
+            {
+                m_work_event.CancelWait();
+                break;
+            }
+            m_work_event.Wait(key);
+        }
     }
 
     // Returns chunk size in frame count.
@@ -671,40 +998,51 @@ public:
         return m_frames_written[queue_id];
     }
 
-    // Sets number of queues and prepares a chunk builder for each.
+    // Sets number of queues and prepares a chunk builder for each. Chunks are taken from and returned to `pool`, which
+    // must outlive the mixer.
     // precondition: 0 <= count <= QUEUE_COUNT
-    template <typename T>
-    void SetQueueCount(size_t count)
+    void SetQueueCount(size_t count, R_ChunkPool& pool)
     {
+        m_pool          = &pool;
         m_queues_in_use = count;
         for (size_t i = 0; i < count; ++i)
         {
-            m_chunks[i] = AllocChunk<T>();
+            m_chunks[i] = AllocChunk();
         }
     }
 
-    // Writes a frame to the chunk currently being built for queue_id. If the chunk becomes full, it is moved into its
-    // queue and a new chunk becomes available.
-    template <typename T>
-    void SubmitFrame(size_t queue_id, const AudioFrame<T>& frame)
+    // Returns space for at most `max_count` raw frames at the end of the chunk currently being built for queue_id. The
+    // returned span may be shorter than requested if the chunk is nearly full. Call FinishWrite once frames have been
+    // written into it.
+    std::span<AudioFrame<int32_t>> PrepareWrite(size_t queue_id, size_t max_count)
+    {
+        R_OwnedChunk& chunk = m_chunks[queue_id];
+        const size_t  count = Min(max_count, chunk.GetFreeLength() / sizeof(AudioFrame<int32_t>));
+        return {(AudioFrame<int32_t>*)chunk.DataLast(), count};
+    }
+
+    // Commits `count` frames written into the span returned by PrepareWrite. If the chunk becomes full, it is moved
+    // into its queue and a new chunk becomes available.
+    void FinishWrite(size_t queue_id, size_t count)
     {
-        m_chunks[queue_id].Write(&frame, sizeof(frame));
+        m_chunks[queue_id].Commit(count * sizeof(AudioFrame<int32_t>));
         if (m_chunks[queue_id].IsBufferFull())
         {
-            m_queues[queue_id].Enqueue(std::move(m_chunks[queue_id]));
-            m_cond.notify_one();
-            m_chunks[queue_id] = AllocChunk<T>();
+            Submit(queue_id);
+            m_chunks[queue_id] = AllocChunk();
         }
-        ++m_frames_written[queue_id];
+        m_frames_written[queue_id] += count;
     }
 
     // Enqueues whatever data is left in the chunk builder for queue_id and marks it as complete. After this call, no
     // more data may be submitted to queue_id.
     void MarkComplete(size_t queue_id)
     {
-        m_queue_complete[queue_id] = true;
-        m_queues[queue_id].Enqueue(std::move(m_chunks[queue_id]));
-        m_cond.notify_one();
+        // The last chunk must be queued first, otherwise the mixer could see a complete and empty queue and mix the
+        // other queues without it.
+        Submit(queue_id);
+        m_queue_complete[queue_id].store(true, std::memory_order_release);
+        NotifyIfReady();
     }
 
     // Returns the number N of chunks that can be dequeued from each queue to call MixFrames N times.
@@ -727,8 +1065,10 @@ public:
             // responsible for filling that queue will enqueue one eventually. In that case, MixFrames should still mix
             // samples from that queue without waiting for the complete queue.
 
-            size_t cc = m_queues[i].ChunkCount();
-            if (!(m_queue_complete[i] && cc == 0))
+            // Completion must be read before the count; the last chunk is queued before the queue is marked complete.
+            const bool complete = m_queue_complete[i].load(std::memory_order_acquire);
+            size_t     cc       = m_queues[i].ChunkCount();
+            if (!(complete && cc == 0))
             {
                 count = Min(count, cc);
             }
@@ -737,12 +1077,12 @@ public:
     }
 
     // Dequeues a chunk from each queue and mixes the corresponding audio frames from each chunk into a single buffer.
+    // Raw frames are summed into `accumulator`, which is wide enough that the sum can't overflow. Gain, normalization
+    // to T and clipping are applied once to the final sum.
     // precondition: GetReadyChunkCount() > 0
-    template <typename T, typename MixFn>
-    size_t MixFrames(std::vector<AudioFrame<T>>& output_buffer, MixFn mix)
+    template <typename T>
+    size_t MixFrames(std::vector<AudioFrame<T>>& output_buffer, std::vector<int64_t>& accumulator, float gain)
     {
-        output_buffer.clear();
-
         R_OwnedChunk chunks[QUEUE_COUNT];
 
         // precalcluate the output buffer size so that we don't need to bounds check or reallocate in the mix loop
@@ -750,8 +1090,9 @@ public:
 
         for (size_t queue_id = 0; queue_id < m_queues_in_use; ++queue_id)
         {
-            size_t cc = m_queues[queue_id].ChunkCount();
-            if (m_queue_complete[queue_id] && cc == 0)
+            const bool complete = m_queue_complete[queue_id].load(std::memory_order_acquire);
+            size_t     cc       = m_queues[queue_id].ChunkCount();
+            if (complete && cc == 0)
             {
                 // See comment in GetReadyChunkCount.
                 continue;
@@ -759,8 +1100,11 @@ public:
             m_queues[queue_id].Dequeue(chunks[queue_id]);
             size_requested = std::max(size_requested, chunks[queue_id].GetBufferLength());
         }
+        m_space_event.Notify();
 
-        output_buffer.resize(size_requested / sizeof(AudioFrame<T>));
+        const size_t frame_count  = size_requested / sizeof(AudioFrame<int32_t>);
+        const size_t sample_count = frame_count * AudioFrame<int32_t>::channel_count;
+        accumulator.assign(sample_count, 0);
         for (size_t queue_id = 0; queue_id < m_queues_in_use; ++queue_id)
         {
             if (chunks[queue_id].IsNull())
@@ -768,10 +1112,15 @@ public:
                 // Attempt to deal with errors from the prior loop
                 continue;
             }
-            mix(output_buffer.data(), chunks[queue_id].DataFirst(), chunks[queue_id].DataLast());
+            MixAccumulate(accumulator.data(),
+                          (const int32_t*)chunks[queue_id].DataFirst(),
+                          chunks[queue_id].GetBufferLength() / sizeof(int32_t));
         }
 
-        return size_requested / sizeof(AudioFrame<T>);
+        output_buffer.resize(frame_count);
+        MixNormalize((T*)output_buffer.data(), accumulator.data(), sample_count, gain);
+
+        return frame_count;
     }
 
     // Returns true when all queues are marked as complete and are empty.
@@ -789,10 +1138,42 @@ public:
     }
 
 private:
-    template <typename T>
+    // Moves the chunk being built for queue_id into its queue, waiting for the mixer to make room if necessary.
+    void Submit(size_t queue_id)
+    {
+        R_ChunkQueue& queue = m_queues[queue_id];
+        while (!queue.TryEnqueue(m_chunks[queue_id]))
+        {
+            const uint32_t key = m_space_event.PrepareWait();
+            if (!queue.IsFull())
+            {
+                m_space_event.CancelWait();
+                continue;
+            }
+            m_space_event.Wait(key);
+        }
+        NotifyIfReady();
+    }
+
+    // Wakes the mixer only once every queue it's waiting on has data, rather than on every chunk.
+    void NotifyIfReady()
+    {
+        // Two emulators can finish a chunk at the same time, each checking the other's queue. The fence makes sure at
+        // least one of them sees both chunks.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (GetReadyChunkCount() > 0)
+        {
+            m_work_event.Notify();
+        }
+    }
+
     R_OwnedChunk AllocChunk()
     {
-        R_FrameChunk raw = R_FrameChunk::Alloc(m_chunk_size * sizeof(AudioFrame<T>));
+        R_FrameChunk raw = m_pool->Acquire(m_chunk_size * sizeof(AudioFrame<int32_t>));
+        if (raw.IsNull())
+        {
+            R_Panic("failed to allocate chunk");
+        }
         return R_OwnedChunk(raw);
     }
 
@@ -810,19 +1191,21 @@ private:
     // one queue per emulator
     static constexpr size_t QUEUE_COUNT = 16;
 
-    R_ChunkQueue m_queues[QUEUE_COUNT];
-    R_OwnedChunk m_chunks[QUEUE_COUNT];
-    bool         m_queue_complete[QUEUE_COUNT]{};
-    size_t       m_frames_written[QUEUE_COUNT]{};
+    R_ChunkPool*      m_pool = nullptr;
+    R_ChunkQueue      m_queues[QUEUE_COUNT];
+    R_OwnedChunk      m_chunks[QUEUE_COUNT];
+    std::atomic<bool> m_queue_complete[QUEUE_COUNT]{};
+    size_t            m_frames_written[QUEUE_COUNT]{};
 
     size_t m_queues_in_use = 0;
 
     // Size of chunks in bytes.
     size_t m_chunk_size = DEFAULT_CHUNK_SIZE;
 
-    // Synchronization between producers/consumer.
-    std::mutex              m_mutex;
-    std::condition_variable m_cond;
+    // Synchronization between producers/consumer. The mixer waits on m_work_event for data, and emulators wait on
+    // m_space_event when their queue is full.
+    R_EventCount m_work_event;
+    R_EventCount m_space_event;
 };
 
 enum R_LoopPointType
@@ -880,14 +1263,24 @@ struct R_TrackRenderState
     size_t num_silent_frames = 0;
     R_EndBehavior end_behavior;
     R_LoopPointRecorder* loop_recorder;
-    AudioFormat output_format;
-    float gain = 1.0f;
+
+    // the emulator writes raw frames here
+    std::vector<AudioFrame<int32_t>> sample_buffer;
+
+    // scratch space for assembling a MIDI message before it is posted
+    std::vector<uint8_t> midi_message;
+    // MIDI events and bytes the emulator dropped during the last render because its input queue was full
+    size_t   midi_events_dropped = 0;
+    uint64_t midi_bytes_dropped  = 0;
 
     // these fields are accessed from main thread during render process
     std::atomic<size_t> events_processed = 0;
     std::atomic<bool> done;
 };
 
+// Number of frames the emulator produces before handing them to R_ReceiveSamples.
+constexpr size_t R_SAMPLE_BLOCK_SIZE = 4096;
+
 struct R_SilenceModelNone
 {
     static constexpr bool IsSilence(const AudioFrame<int32_t>& in_raw)
@@ -919,61 +1312,176 @@ struct R_SilenceModelMK1
     }
 };
 
-template <typename SampleT, typename SilenceModel, bool ApplyGain>
-void R_ReceiveSample(void* userdata, const AudioFrame<int32_t>& in)
+// Updates the length of the run of silent frames at the end of the output. Only the frames after the last non-silent
+// frame in `in` matter, so this scans backwards and usually stops early.
+template <typename SilenceModel>
+void R_UpdateSilence(R_TrackRenderState& state, std::span<const AudioFrame<int32_t>> in)
 {
-    R_TrackRenderState* state = (R_TrackRenderState*)userdata;
+    auto last_sound = std::find_if_not(in.rbegin(), in.rend(), SilenceModel::IsSilence);
+    if (last_sound == in.rend())
+    {
+        state.num_silent_frames += in.size();
+    }
+    else
+    {
+        state.num_silent_frames = (size_t)(last_sound - in.rbegin());
+    }
+}
 
-    AudioFrame<SampleT> out;
-    Normalize(in, out);
+template <typename SilenceModel>
+void R_ReceiveSamples(void* userdata, std::span<const AudioFrame<int32_t>> in)
+{
+    R_TrackRenderState* state = (R_TrackRenderState*)userdata;
 
     // Skip silence processing until end of track
     if constexpr (!std::is_same_v<SilenceModel, R_SilenceModelNone>)
     {
-        if (SilenceModel::IsSilence(in))
-        {
-            ++state->num_silent_frames;
-        }
-        else
-        {
-            state->num_silent_frames = 0;
-        }
+        R_UpdateSilence<SilenceModel>(*state, in);
     }
 
-    if constexpr (ApplyGain)
+    // The mixer wants raw frames so that gain and normalization happen once, on the sum of all instances. A block can
+    // straddle two chunks, hence the loop.
+    while (!in.empty())
     {
-        Scale(out, state->gain);
+        std::span<AudioFrame<int32_t>> out = state->mixer->PrepareWrite(state->queue_id, in.size());
+        std::copy_n(in.begin(), out.size(), out.begin());
+        state->mixer->FinishWrite(state->queue_id, out.size());
+        in = in.subspan(out.size());
     }
-
-    state->mixer->SubmitFrame(state->queue_id, out);
 }
 
 void R_RunReset(Emulator& emu, EMU_SystemReset reset)
 {
     emu.PostSystemReset(reset);
+    emu.RunFor(24'000'000 * MCU_CYCLES_PER_STEP);
+}
 
-    for (size_t i = 0; i < 24'000'000; ++i)
+// FNV-1a over every rom in the romset. Used to key the reset cache so that swapping or overriding roms doesn't restore
+// a state produced by different firmware.
+uint64_t R_HashRomset(const RomsetInfo& info)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < ROMLOCATION_COUNT; ++i)
     {
-        emu.Step();
+        hash = (hash ^ i) * 0x100000001b3;
+        for (uint8_t byte : info.rom_data[i])
+        {
+            hash = (hash ^ byte) * 0x100000001b3;
+        }
     }
+    return hash;
 }
 
-void R_PostEvent(Emulator& emu, const SMF_Data& data, const SMF_Event& ev)
+const char* R_ResetName(EMU_SystemReset reset)
 {
-    emu.PostMIDI(ev.status);
-    emu.PostMIDI(ev.GetData(data.bytes));
+    switch (reset)
+    {
+    case EMU_SystemReset::NONE:
+        return "none";
+    case EMU_SystemReset::GS_RESET:
+        return "gs";
+    case EMU_SystemReset::GM_RESET:
+        return "gm";
+    }
+    return "unknown";
 }
 
-struct R_TrackList
+std::filesystem::path R_GetResetCachePath(const R_Parameters& params,
+                                          Romset              romset,
+                                          EMU_SystemReset     reset,
+                                          uint64_t            rom_hash)
 {
-    std::vector<SMF_Track> tracks;
-};
+    char name[128];
+    snprintf(name,
+             sizeof(name),
+             "%s-%s-%s-%016" PRIx64 ".state",
+             GetParsableRomsetNames()[(size_t)romset],
+             R_ResetName(reset),
+             params.disable_oversampling ? "noos" : "os",
+             rom_hash);
+    return params.reset_cache_directory / name;
+}
 
-// Splits a track into `n` tracks, each track can be processed by a single
-// emulator instance.
-R_TrackList R_SplitTrackModulo(const SMF_Track& merged_track, size_t n)
+bool R_ReadResetCache(const std::filesystem::path& path, std::vector<uint8_t>& state)
 {
-    R_TrackList result;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+
+    const std::streamsize size = file.tellg();
+    if (size <= 0)
+    {
+        return false;
+    }
+
+    state.resize((size_t)size);
+    file.seekg(0);
+    if (!file.read((char*)state.data(), size))
+    {
+        state.clear();
+        return false;
+    }
+
+    return true;
+}
+
+// Writes to a temporary file and renames it over `path`, so readers see either the old cache or the complete new one.
+// Each call uses its own temporary name because other renderer processes may be writing the same cache at once.
+bool R_WriteResetCache(const std::filesystem::path& path, std::span<const uint8_t> state)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    std::random_device rng;
+    char               suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", rng(), rng());
+
+    std::filesystem::path temp_path = path;
+    temp_path += suffix;
+
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        if (!file.write((const char*)state.data(), (std::streamsize)state.size()))
+        {
+            file.close();
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec)
+    {
+        std::error_code remove_ec;
+        std::filesystem::remove(temp_path, remove_ec);
+        return false;
+    }
+    return true;
+}
+
+// Posts the status and data bytes of `ev` as one message so that a full queue can't split them. Returns false if the
+// emulator dropped the message.
+bool R_PostEvent(Emulator& emu, const SMF_Data& data, const SMF_Event& ev, std::vector<uint8_t>& message)
+{
+    const SMF_ByteSpan event_data = ev.GetData(data.bytes);
+    message.clear();
+    message.push_back(ev.status);
+    message.insert(message.end(), event_data.begin(), event_data.end());
+    return emu.PostMIDI(message);
+}
+
+struct R_TrackList
+{
+    std::vector<SMF_Track> tracks;
+};
+
+// Splits a track into `n` tracks, each track can be processed by a single
+// emulator instance.
+R_TrackList R_SplitTrackModulo(const SMF_Track& merged_track, size_t n)
+{
+    R_TrackList result;
     result.tracks.resize(n);
 
     for (auto& event : merged_track.events)
@@ -1063,41 +1571,17 @@ bool R_IsEMIDIGlobalLoopEnd(const SMF_Data& data, const SMF_Event& ev)
     return ev.IsControlChange() && ev.GetData(data.bytes)[0] == 119;
 }
 
-template <typename SilenceModel>
-constexpr mcu_sample_callback R_PickCallback(const R_TrackRenderState& state)
+void R_HandleLoopPoint(R_TrackRenderState& state, const SMF_Data& data, const SMF_Event& event)
 {
-    if (state.gain != 1.0f)
+    if (!R_IsEMIDITrackLoopStart(data, event) && !R_IsEMIDITrackLoopEnd(data, event) &&
+        !R_IsEMIDIGlobalLoopStart(data, event) && !R_IsEMIDIGlobalLoopEnd(data, event))
     {
-        switch (state.output_format)
-        {
-        case AudioFormat::S16:
-            return R_ReceiveSample<int16_t, SilenceModel, true>;
-        case AudioFormat::S32:
-            return R_ReceiveSample<int32_t, SilenceModel, true>;
-        case AudioFormat::F32:
-            return R_ReceiveSample<float, SilenceModel, true>;
-        }
-    }
-    else
-    {
-        switch (state.output_format)
-        {
-        case AudioFormat::S16:
-            return R_ReceiveSample<int16_t, SilenceModel, false>;
-        case AudioFormat::S32:
-            return R_ReceiveSample<int32_t, SilenceModel, false>;
-        case AudioFormat::F32:
-            return R_ReceiveSample<float, SilenceModel, false>;
-        }
+        return;
     }
 
-    fprintf(stderr, "output_format = %d\n", (int)state.output_format);
-    fprintf(stderr, "gain = %f\n", state.gain);
-    R_Panic("no valid callback for state");
-}
+    // Frames still sitting in the emulator's sample buffer haven't been counted by the mixer yet.
+    state.emu.FlushSamples();
 
-void R_HandleLoopPoint(R_TrackRenderState& state, const SMF_Data& data, const SMF_Event& event)
-{
     // Save loop points - they will be processed on the main thread later
     if (R_IsEMIDITrackLoopStart(data, event))
     {
@@ -1150,16 +1634,22 @@ void R_RenderOne(const SMF_Data& data, R_TrackRenderState& state)
 
     const uint64_t ns_per_step = R_NSPerStep(state.emu);
 
+    // Batch workers reuse emulators, so only count what is dropped during this render.
+    const uint64_t midi_bytes_dropped_before = state.emu.GetDroppedMIDIBytes();
+    state.midi_events_dropped                = 0;
+
     auto t_start = std::chrono::high_resolution_clock::now();
     for (const SMF_Event& event : track.events)
     {
         const uint64_t this_event_time_ns =
             state.ns_simulated + 1000 * SMF_TicksToUS(event.delta_time, us_per_qn, division);
 
-        while (state.ns_simulated < this_event_time_ns)
+        if (state.ns_simulated < this_event_time_ns)
         {
-            state.emu.Step();
-            state.ns_simulated += ns_per_step;
+            // Round up so that the event lands on the same step it would have if we were stepping one at a time.
+            const uint64_t steps = (this_event_time_ns - state.ns_simulated + ns_per_step - 1) / ns_per_step;
+            state.emu.RunFor(steps * MCU_CYCLES_PER_STEP);
+            state.ns_simulated += steps * ns_per_step;
         }
 
         if (event.IsTempo(data.bytes))
@@ -1168,9 +1658,11 @@ void R_RenderOne(const SMF_Data& data, R_TrackRenderState& state)
         }
 
         // Fire the event.
-        if (!event.IsMetaEvent())
+        // Waiting for the queue to drain would delay every later event in the track, so a dropped event is only
+        // counted and reported once the render finishes.
+        if (!event.IsMetaEvent() && !R_PostEvent(state.emu, data, event, state.midi_message))
         {
-            R_PostEvent(state.emu, data, event);
+            ++state.midi_events_dropped;
         }
 
         R_HandleLoopPoint(state, data, event);
@@ -1181,13 +1673,14 @@ void R_RenderOne(const SMF_Data& data, R_TrackRenderState& state)
     if (state.end_behavior == R_EndBehavior::Release)
     {
         // Enable silence processing callback
+        state.emu.FlushSamples();
         if (state.emu.GetMCU().is_mk1)
         {
-            state.emu.SetSampleCallback(R_PickCallback<R_SilenceModelMK1>(state), &state);
+            state.emu.SetSampleSink(state.sample_buffer, R_ReceiveSamples<R_SilenceModelMK1>, &state);
         }
         else
         {
-            state.emu.SetSampleCallback(R_PickCallback<R_SilenceModelGeneric>(state), &state);
+            state.emu.SetSampleSink(state.sample_buffer, R_ReceiveSamples<R_SilenceModelGeneric>, &state);
         }
 
         const uint32_t frequency = PCM_GetOutputFrequency(state.emu.GetPCM());
@@ -1195,10 +1688,15 @@ void R_RenderOne(const SMF_Data& data, R_TrackRenderState& state)
         const size_t silence_time = frequency / 10;
         while (state.num_silent_frames < silence_time)
         {
-            state.emu.Step();
+            // Flushing after each run keeps num_silent_frames exact so we stop on the same step as we would when
+            // checking after every frame.
+            state.emu.RunUntilFrames(silence_time - state.num_silent_frames);
+            state.emu.FlushSamples();
         }
     }
-    state.elapsed = std::chrono::high_resolution_clock::now() - t_start;
+    state.emu.FlushSamples();
+    state.elapsed            = std::chrono::high_resolution_clock::now() - t_start;
+    state.midi_bytes_dropped = state.emu.GetDroppedMIDIBytes() - midi_bytes_dropped_before;
 
     state.mixer->MarkComplete(state.queue_id);
 
@@ -1213,168 +1711,206 @@ void R_CursorUpLines(int n)
 struct R_MixOutState
 {
     R_Mixer* mixer = nullptr;
+    float    gain  = 1.0f;
 
     // Written by mix thread, read by main thread
     std::atomic<size_t> frames_mixed = 0;
 
-    // Eventually we need to abstract over this to stream to other outputs.
-    WAV_Handle* output = nullptr;
+    AudioSink* output = nullptr;
 };
 
-void R_Mix(int16_t* dest, int16_t* src_first, int16_t* src_last)
-{
-    // TODO more correct to clip *after* summation? we need an intermediate buffer of a larger type?
-    HorizontalSatAddI16(dest, src_first, src_last);
-}
-
-void R_Mix(int32_t* dest, int32_t* src_first, int32_t* src_last)
-{
-    HorizontalSatAddI32(dest, src_first, src_last);
-}
-
-void R_Mix(float* dest, float* src_first, float* src_last)
-{
-    HorizontalAddF32(dest, src_first, src_last);
-}
-
 template <typename T>
 void R_MixOut(R_MixOutState& state)
 {
     std::vector<AudioFrame<T>> mix_buffer;
     mix_buffer.reserve(state.mixer->GetChunkSize());
+    std::vector<int64_t> accumulator;
+    accumulator.reserve(state.mixer->GetChunkSize() * AudioFrame<T>::channel_count);
 
     while (!state.mixer->IsFinished())
     {
         state.mixer->WaitForWork();
 
-        state.frames_mixed += state.mixer->MixFrames(mix_buffer, [](void* dest, void* src_first, void* src_last) {
-            R_Mix((T*)dest, (T*)src_first, (T*)src_last);
-        });
+        state.frames_mixed += state.mixer->MixFrames(mix_buffer, accumulator, state.gain);
 
-        for (auto& frame : mix_buffer)
-        {
-            state.output->Write(frame);
-        }
+        state.output->Write(std::span<const AudioFrame<T>>(mix_buffer));
     }
 
     state.output->Finish();
 }
 
-bool R_RenderTrack(const SMF_Data& data, const R_Parameters& params)
+// Roms and reset state shared by every file rendered in one run.
+struct R_RenderSetup
 {
-    const size_t instances = params.instances;
-    auto t_start = std::chrono::high_resolution_clock::now();
-
-    // First combine all of the events so it's easier to process
-    const SMF_Track merged_track = SMF_MergeTracks(data);
-    // Then create a track specifically for each emulator instance
-    const R_TrackList split_tracks = R_SplitTrackModulo(merged_track, instances);
-
-    AllRomsetInfo romset_info;
+    AllRomsetInfo                       romset_info;
+    std::shared_ptr<const EMU_RomImage> rom_image;
+    Romset                              romset = Romset::MK2;
+    EMU_SystemReset       reset  = EMU_SystemReset::NONE;
+    std::filesystem::path reset_cache_path;
+
+    // State after reset. Once an instance has run the reset sequence, the rest restore this instead.
+    std::vector<uint8_t> reset_state;
+    // When false, every instance runs the reset sequence itself. Instances with their own nvram need this.
+    bool share_reset_state = true;
+};
 
+bool R_LoadRenderSetup(const R_Parameters& params, R_RenderSetup& setup)
+{
     common::LoadRomsetResult load_result;
 
-    common::LoadRomsetError err = common::LoadRomset(romset_info,
+    common::LoadRomsetError err = common::LoadRomset(setup.romset_info,
                                                      params.rom_directory,
                                                      params.romset_name,
                                                      params.legacy_romset_detection,
                                                      params.adv.rom_overrides,
                                                      load_result);
 
-    common::PrintLoadRomsetDiagnostics(stderr, err, load_result, romset_info);
+    common::PrintLoadRomsetDiagnostics(stderr, err, load_result, setup.romset_info);
 
     if (err != common::LoadRomsetError{})
     {
         return false;
     }
 
-    EMU_SystemReset reset = EMU_SystemReset::NONE;
+    setup.romset = load_result.romset;
+
     if (params.reset)
     {
-        reset = *params.reset;
+        setup.reset = *params.reset;
     }
     else if (!params.reset && load_result.romset == Romset::MK2)
     {
         // user didn't explicitly pass a reset and we're using a buggy romset
         fprintf(stderr, "WARNING: No reset specified with mk2 romset; using gs\n");
-        reset = EMU_SystemReset::GS_RESET;
+        setup.reset = EMU_SystemReset::GS_RESET;
     }
 
     fprintf(stderr, "Gain set to %.2fdb\n", common::ScalarToDb(params.gain));
 
-    R_Mixer mixer;
-    switch (params.output_format)
+    setup.share_reset_state = params.nvram_filename.empty();
+
+    if (!params.reset_cache_directory.empty())
     {
-    case AudioFormat::S16:
-        mixer.SetQueueCount<int16_t>(instances);
-        break;
-    case AudioFormat::S32:
-        mixer.SetQueueCount<int32_t>(instances);
-        break;
-    case AudioFormat::F32:
-        mixer.SetQueueCount<float>(instances);
-        break;
+        if (!params.nvram_filename.empty())
+        {
+            fprintf(stderr, "WARNING: --reset-cache has no effect when --nvram is used\n");
+        }
+        else
+        {
+            setup.reset_cache_path = R_GetResetCachePath(
+                params, setup.romset, setup.reset, R_HashRomset(setup.romset_info.romsets[(size_t)setup.romset]));
+            R_ReadResetCache(setup.reset_cache_path, setup.reset_state);
+        }
     }
 
-    R_LoopPointRecorder loop_recorder;
+    // Shared by every instance, and by every worker in batch mode.
+    setup.rom_image = EMU_CreateRomImage(setup.romset, setup.romset_info);
+    setup.romset_info.PurgeRomData();
 
-    R_TrackRenderState render_states[SMF_CHANNEL_COUNT];
-    for (size_t i = 0; i < instances; ++i)
+    return setup.rom_image != nullptr;
+}
+
+// Initializes the emulator in `state` and brings it to the state after reset. `instance_id` is only used for nvram
+// filenames and messages.
+bool R_InitInstance(const R_Parameters& params, R_RenderSetup& setup, R_TrackRenderState& state, size_t instance_id)
+{
+    std::filesystem::path this_nvram = params.nvram_filename;
+    if (!this_nvram.empty())
     {
-        std::filesystem::path this_nvram = params.nvram_filename;
-        if (!this_nvram.empty())
+        // append instance number so that multiple instances don't clobber each other's nvram
+        this_nvram += std::to_string(instance_id);
+    }
+
+    state.emu.Init({
+        .lcd_backend    = nullptr,
+        .nvram_filename = this_nvram,
+        .mcu_backend    = params.adv.mcu_backend,
+        .mcu_lockstep   = params.adv.mcu_lockstep,
+        .pcm_engine     = params.adv.pcm_engine,
+    });
+
+    if (!state.emu.LoadRoms(setup.rom_image))
+    {
+        fprintf(stderr, "FATAL: Failed to load roms for instance #%02zu\n", instance_id);
+        return false;
+    }
+
+    state.emu.Reset();
+    state.emu.GetPCM().enable_oversampling = !params.disable_oversampling;
+
+    if (!setup.reset_state.empty() && state.emu.LoadState(setup.reset_state))
+    {
+        if (!setup.reset_cache_path.empty())
         {
-            // append instance number so that multiple instances don't clobber each other's nvram
-            this_nvram += std::to_string(i);
+            fprintf(stderr, "Restored emulator #%02zu from reset cache\n", instance_id);
         }
+    }
+    else
+    {
+        fprintf(stderr, "Initializing emulator #%02zu...\n", instance_id);
+        R_RunReset(state.emu, setup.reset);
 
-        render_states[i].emu.Init({.lcd_backend = nullptr, .nvram_filename = this_nvram});
-
-        RomLocationSet loaded{};
-        if (!render_states[i].emu.LoadRoms(load_result.romset, romset_info, &loaded))
+        if (setup.share_reset_state)
         {
-            fprintf(stderr, "FATAL: Failed to load roms for instance #%02zu\n", i);
-            return false;
+            state.emu.SaveState(setup.reset_state);
+            if (!setup.reset_cache_path.empty() && !R_WriteResetCache(setup.reset_cache_path, setup.reset_state))
+            {
+                fprintf(stderr,
+                        "WARNING: Failed to write reset cache to %s\n",
+                        setup.reset_cache_path.generic_string().c_str());
+            }
         }
+    }
 
-        render_states[i].emu.Reset();
-        render_states[i].emu.GetPCM().enable_oversampling = !params.disable_oversampling;
+    state.sample_buffer.resize(R_SAMPLE_BLOCK_SIZE);
 
-        fprintf(stderr, "Initializing emulator #%02zu...\n", i);
-        R_RunReset(render_states[i].emu, reset);
+    return true;
+}
+
+// Renders `data` into `render_output` with one thread per instance in `render_states`. The instances must be in the
+// state they should start rendering from. Audio chunks come from `chunk_pool`, which can be shared between renders.
+// Returns false if an instance diverged from the lockstep reference.
+bool R_RenderFile(const SMF_Data&               data,
+                  const R_Parameters&           params,
+                  std::span<R_TrackRenderState> render_states,
+                  AudioSink&                    render_output,
+                  R_LoopPointRecorder&          loop_recorder,
+                  R_ChunkPool&                  chunk_pool,
+                  bool                          show_progress)
+{
+    const size_t instances = render_states.size();
 
+    // First combine all of the events so it's easier to process
+    const SMF_Track merged_track = SMF_MergeTracks(data);
+    // Then create a track specifically for each emulator instance
+    const R_TrackList split_tracks = R_SplitTrackModulo(merged_track, instances);
+
+    R_Mixer mixer;
+    mixer.SetQueueCount(instances, chunk_pool);
+
+    for (size_t i = 0; i < instances; ++i)
+    {
         render_states[i].track = &split_tracks.tracks[i];
         render_states[i].mixer = &mixer;
         render_states[i].queue_id = i;
         render_states[i].end_behavior = params.end_behavior;
         render_states[i].loop_recorder = &loop_recorder;
-        render_states[i].output_format = params.output_format;
-        render_states[i].gain = params.gain;
+        render_states[i].ns_simulated = 0;
+        render_states[i].num_silent_frames = 0;
+        render_states[i].events_processed = 0;
+        render_states[i].done = false;
 
-        render_states[i].emu.SetSampleCallback(R_PickCallback<R_SilenceModelNone>(render_states[i]), &render_states[i]);
+        render_states[i].emu.SetSampleSink(
+            render_states[i].sample_buffer, R_ReceiveSamples<R_SilenceModelNone>, &render_states[i]);
 
         render_states[i].thread = std::thread(R_RenderOne, std::cref(data), std::ref(render_states[i]));
     }
 
-    romset_info.PurgeRomData();
-
-    WAV_Handle render_output;
-    if (params.output_stdout)
-    {
-#ifdef _WIN32
-        // On Windows, stdout is opened in text mode, which causes newline translation to occur.
-        _setmode(_fileno(stdout), O_BINARY);
-#endif
-        render_output.OpenStdout(params.output_format);
-    }
-    else
-    {
-        render_output.Open(params.output_filename, params.output_format);
-    }
     render_output.SetSampleRate(PCM_GetOutputFrequency(render_states[0].emu.GetPCM()));
 
     R_MixOutState mix_out_state;
     mix_out_state.mixer = &mixer;
+    mix_out_state.gain = params.gain;
     mix_out_state.output = &render_output;
     std::thread mix_out_thread;
 
@@ -1392,7 +1928,7 @@ bool R_RenderTrack(const SMF_Data& data, const R_Parameters& params)
     }
 
     // Now we wait.
-    bool all_done = false;
+    bool all_done = !show_progress;
     while (!all_done)
     {
         all_done = true;
@@ -1428,6 +1964,36 @@ bool R_RenderTrack(const SMF_Data& data, const R_Parameters& params)
 
     mix_out_thread.join();
 
+    bool lockstep_failed = false;
+    for (size_t i = 0; i < instances; ++i)
+    {
+        if (render_states[i].emu.LockstepFailed())
+        {
+            fprintf(stderr, "ERROR: #%02zu diverged from the reference interpreter\n", i);
+            lockstep_failed = true;
+        }
+    }
+
+    return !lockstep_failed;
+}
+
+// Prints any dropped MIDI input, and the loop points and timings requested by --dump-emidi-loop-points and --debug.
+void R_PrintRenderStats(const R_Parameters&           params,
+                        R_LoopPointRecorder&          loop_recorder,
+                        std::span<R_TrackRenderState> render_states)
+{
+    for (size_t i = 0; i < render_states.size(); ++i)
+    {
+        if (render_states[i].midi_events_dropped != 0)
+        {
+            fprintf(stderr,
+                    "WARNING: #%02zu dropped %zu MIDI events (%" PRIu64 " bytes) because its input queue was full\n",
+                    i,
+                    render_states[i].midi_events_dropped,
+                    render_states[i].midi_bytes_dropped);
+        }
+    }
+
     if (params.dump_emidi_loop_points)
     {
         loop_recorder.SortByTrack();
@@ -1468,12 +2034,106 @@ bool R_RenderTrack(const SMF_Data& data, const R_Parameters& params)
 
     if (params.debug)
     {
-        for (size_t i = 0; i < instances; ++i)
+        for (size_t i = 0; i < render_states.size(); ++i)
         {
             auto t_instance_sec = (double)render_states[i].elapsed.count() / 1e9;
             fprintf(stderr, "#%02zu took %.2fs\n", i, t_instance_sec);
         }
     }
+}
+
+// Opens a FLAC or wave file depending on `params`. FLAC blocks are encoded on `flac_threads` threads. Returns nullptr if
+// the file couldn't be opened.
+std::unique_ptr<AudioSink> R_OpenOutputFile(const R_Parameters&          params,
+                                            const std::filesystem::path& path,
+                                            size_t                       flac_threads)
+{
+    if (params.output_flac)
+    {
+        auto flac_output = std::make_unique<FLAC_Handle>();
+        if (!flac_output->Open(path, flac_threads))
+        {
+            return nullptr;
+        }
+        return flac_output;
+    }
+
+    auto wav_output = std::make_unique<WAV_Handle>();
+    if (!wav_output->Open(path, params.output_format))
+    {
+        return nullptr;
+    }
+    return wav_output;
+}
+
+bool R_RenderTrack(const SMF_Data& data, const R_Parameters& params)
+{
+    const size_t instances = params.instances;
+    auto t_start = std::chrono::high_resolution_clock::now();
+
+    R_RenderSetup setup;
+    if (!R_LoadRenderSetup(params, setup))
+    {
+        return false;
+    }
+
+    R_TrackRenderState render_states[SMF_CHANNEL_COUNT];
+    for (size_t i = 0; i < instances; ++i)
+    {
+        if (!R_InitInstance(params, setup, render_states[i], i))
+        {
+            return false;
+        }
+    }
+
+    // FLAC encoding gets whatever cores the emulators leave free. It takes much less time than emulation, so a few
+    // threads are enough to keep up.
+    const size_t cores        = std::thread::hardware_concurrency();
+    const size_t flac_threads = Clamp<size_t>(cores > instances ? cores - instances : 1, 1, 4);
+
+    std::unique_ptr<AudioSink> render_output;
+    if (params.output_stdout || params.output_filename == "-")
+    {
+#ifdef _WIN32
+        // On Windows, stdout is opened in text mode, which causes newline translation to occur.
+        _setmode(_fileno(stdout), O_BINARY);
+#endif
+        if (params.output_flac)
+        {
+            auto flac_output = std::make_unique<FLAC_Handle>();
+            flac_output->OpenStdout(flac_threads);
+            render_output = std::move(flac_output);
+        }
+        else
+        {
+            auto wav_output = std::make_unique<WAV_Handle>();
+            if (params.output_stdout)
+            {
+                wav_output->OpenStdout(params.output_format);
+            }
+            else
+            {
+                wav_output->OpenStdoutWave(params.output_format);
+            }
+            render_output = std::move(wav_output);
+        }
+    }
+    else
+    {
+        render_output = R_OpenOutputFile(params, params.output_filename, flac_threads);
+        if (!render_output)
+        {
+            fprintf(stderr, "FATAL: Failed to open %s for writing\n", std::string(params.output_filename).c_str());
+            return false;
+        }
+    }
+
+    R_LoopPointRecorder loop_recorder;
+    R_ChunkPool         chunk_pool;
+    const bool          success = R_RenderFile(
+        data, params, std::span(render_states, instances), *render_output, loop_recorder, chunk_pool, true);
+
+    R_PrintRenderStats(params, loop_recorder, std::span(render_states, instances));
 
     auto t_finish = std::chrono::high_resolution_clock::now();
     auto t_diff   = std::chrono::duration_cast<std::chrono::nanoseconds>(t_finish - t_start);
@@ -1481,23 +2141,180 @@ bool R_RenderTrack(const SMF_Data& data, const R_Parameters& params)
 
     fprintf(stderr, "Done in %.2fs!\n", t_sec);
 
-    return true;
+    return success;
+}
+
+// Emulators owned by one batch worker thread. They're initialized once and restored to the reset state before each
+// file instead of being recreated.
+struct R_BatchWorker
+{
+    R_TrackRenderState render_states[SMF_CHANNEL_COUNT];
+    std::thread        thread;
+};
+
+bool R_RenderBatchJob(const R_Parameters&           params,
+                      const R_RenderSetup&          setup,
+                      std::span<R_TrackRenderState> render_states,
+                      const R_BatchJob&             job,
+                      R_ChunkPool&                  chunk_pool,
+                      std::mutex&                   print_mutex)
+{
+    auto t_start = std::chrono::high_resolution_clock::now();
+
+    // A malformed file only fails its own job; the rest of the batch keeps going.
+    SMF_Data data;
+    if (!SMF_LoadEvents(job.input, data))
+    {
+        std::scoped_lock lk(print_mutex);
+        fprintf(stderr, "ERROR: Failed to load %s\n", job.input.generic_string().c_str());
+        return false;
+    }
+
+    // The first file rendered by a worker doesn't strictly need this, but restoring is cheap compared to rendering.
+    for (auto& state : render_states)
+    {
+        if (!state.emu.LoadState(setup.reset_state))
+        {
+            R_Panic("failed to restore reset state");
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(job.output.parent_path(), ec);
+
+    // Other jobs are keeping the remaining cores busy, so each file gets a single encoder thread.
+    const std::unique_ptr<AudioSink> render_output = R_OpenOutputFile(params, job.output, 1);
+    if (!render_output)
+    {
+        std::scoped_lock lk(print_mutex);
+        fprintf(stderr, "ERROR: Failed to open %s for writing\n", job.output.generic_string().c_str());
+        return false;
+    }
+
+    R_LoopPointRecorder loop_recorder;
+    const bool          success =
+        R_RenderFile(data, params, render_states, *render_output, loop_recorder, chunk_pool, false);
+
+    auto t_finish = std::chrono::high_resolution_clock::now();
+    auto t_diff   = std::chrono::duration_cast<std::chrono::nanoseconds>(t_finish - t_start);
+    auto t_sec    = (double)t_diff.count() / 1e9;
+
+    std::scoped_lock lk(print_mutex);
+    fprintf(stderr,
+            "Rendered %s to %s in %.2fs\n",
+            job.input.generic_string().c_str(),
+            job.output.generic_string().c_str(),
+            t_sec);
+    R_PrintRenderStats(params, loop_recorder, render_states);
+
+    return success;
+}
+
+// Renders every input on a pool of workers. Roms are loaded and the reset sequence runs once for the whole batch.
+bool R_RenderBatch(const R_Parameters& params)
+{
+    const size_t instances = params.instances;
+    auto t_start = std::chrono::high_resolution_clock::now();
+
+    std::vector<R_BatchJob> jobs;
+    if (!R_CollectBatchJobs(
+            params.input_filenames, params.manifest_filename, params.output_filename, params.output_flac, jobs))
+    {
+        return false;
+    }
+
+    R_RenderSetup setup;
+    if (!R_LoadRenderSetup(params, setup))
+    {
+        return false;
+    }
+
+    // Each job already runs one thread per instance.
+    size_t worker_count = params.jobs;
+    if (worker_count == 0)
+    {
+        worker_count = std::max<size_t>(1, std::thread::hardware_concurrency() / instances);
+    }
+    worker_count = Min(worker_count, jobs.size());
+
+    fprintf(stderr, "Rendering %zu files using %zu workers\n", jobs.size(), worker_count);
+
+    std::vector<std::unique_ptr<R_BatchWorker>> workers(worker_count);
+    for (size_t w = 0; w < worker_count; ++w)
+    {
+        workers[w] = std::make_unique<R_BatchWorker>();
+        for (size_t i = 0; i < instances; ++i)
+        {
+            if (!R_InitInstance(params, setup, workers[w]->render_states[i], w * instances + i))
+            {
+                return false;
+            }
+        }
+    }
+
+    std::atomic<size_t> next_job = 0;
+    std::atomic<size_t> failed_jobs = 0;
+    std::mutex          print_mutex;
+    // Shared by every worker so that memory use stays flat over the whole batch.
+    R_ChunkPool chunk_pool;
+
+    for (auto& worker : workers)
+    {
+        worker->thread = std::thread([&, render_states = std::span(worker->render_states, instances)]() {
+            for (size_t job_id = next_job++; job_id < jobs.size(); job_id = next_job++)
+            {
+                if (!R_RenderBatchJob(params, setup, render_states, jobs[job_id], chunk_pool, print_mutex))
+                {
+                    ++failed_jobs;
+                }
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker->thread.join();
+    }
+
+    auto t_finish = std::chrono::high_resolution_clock::now();
+    auto t_diff   = std::chrono::duration_cast<std::chrono::nanoseconds>(t_finish - t_start);
+    auto t_sec    = (double)t_diff.count() / 1e9;
+
+    if (failed_jobs != 0)
+    {
+        fprintf(stderr, "%zu of %zu files failed to render\n", failed_jobs.load(), jobs.size());
+    }
+
+    fprintf(stderr, "Done in %.2fs!\n", t_sec);
+
+    return failed_jobs == 0;
 }
 
 void R_Usage()
 {
     constexpr const char* USAGE_STR = R"(Renders a standard MIDI file to a WAVE file using nuked-sc55.
 
-Usage: %s [options] -o <output> <input>
+Usage: %s [options] -o <output> <input>...
 
 General options:
   -? -h, --help                Display this information.
   -v, --version                Display version information.
-  -o <filename>                Render WAVE file to filename.
-  --stdout                     Render raw sample data to stdout. No header
+  -o <filename>                Render WAVE file to filename. Use "-" to write it to stdout. A filename
+                               ending in .flac renders a FLAC file instead.
+  --stdout                     Render raw sample data to stdout. No header. With -f flac, writes a
+                               FLAC stream instead.
+
+Batch options:
+  Passing more than one input, a directory of MIDI files, or a manifest renders every file in one run.
+  -o <template>                "{name}" is replaced by each input's filename without extension. Without
+                               "{name}", <template> is a directory to write <name>.wav (or .flac) files
+                               into.
+  --manifest <filename>        Render the files listed in filename, one per line.
+  -j, --jobs <count>           Number of files to render at once (default: core count / instances).
 
 Audio options:
-  -f, --format s16|s32|f32     Set output format.
+  -f, --format s16|s32|f32|flac
+                               Set output format. flac encodes 16-bit FLAC.
   --disable-oversampling       Halves output frequency.
   --gain <amount>              Apply gain to the output.
   --end cut|release            Choose how the end of the track is handled:
@@ -1509,6 +2326,7 @@ Emulator options:
   -n, --instances <count>      Number of emulators to use (increases effective polyphony, but
                                takes longer to render)
   --nvram <filename>           Saves and loads NVRAM to/from disk. JV-880 only.
+  --reset-cache <dir>          Cache emulator state after reset in dir to speed up later renders.
 
 ROM management options:
   -d, --rom-directory <dir>    Sets the directory to load roms from. Romset will be autodetected when
@@ -1566,8 +2384,23 @@ int main(int argc, char* argv[])
 	}
     fprintf(stderr, "ROM directory is: %s\n", params.rom_directory.generic_string().c_str());
 
+    if (R_IsBatch(params))
+    {
+        if (!R_RenderBatch(params))
+        {
+            fprintf(stderr, "Failed to render batch\n");
+            return 1;
+        }
+
+        return 0;
+    }
+
     SMF_Data data;
-    data = SMF_LoadEvents(params.input_filename);
+    if (!SMF_LoadEvents(params.input_filenames[0], data))
+    {
+        fprintf(stderr, "Failed to load %s\n", params.input_filenames[0].generic_string().c_str());
+        return 1;
+    }
 
     if (!R_RenderTrack(data, params))
     {
@@ -118,7 +118,7 @@ public:
     [[nodiscard]]
     bool Seek(size_t new_offset)
     {
-        if (m_offset <= m_bytes.size())
+        if (new_offset <= m_bytes.size())
         {
             m_offset = new_offset;
             return true;
@@ -139,24 +139,33 @@ private:
     size_t       m_offset = 0;
 };
 
-inline void Check(bool stat, const char* msg)
+inline bool Check(bool stat, const char* msg)
 {
     if (!stat)
     {
-        fprintf(stderr, "Panic: %s\n", msg);
-        exit(1);
+        fprintf(stderr, "Malformed MIDI file: %s\n", msg);
     }
+    return stat;
 }
 
 #define STR1(x) #x
 #define STR2(x) STR1(x)
-#define CHECK(expr) Check((expr), __FILE__ ":" STR2(__LINE__) ": " #expr)
+// Returns false from the calling function if `expr` is false.
+#define CHECK(expr)                                                                                                    \
+    if (!Check((expr), __FILE__ ":" STR2(__LINE__) ": " #expr))                                                        \
+    {                                                                                                                  \
+        return false;                                                                                                  \
+    }
 
-static void SMF_ReadHeader(SMF_Reader& reader, SMF_Header& header)
+[[nodiscard]]
+static bool SMF_ReadHeader(SMF_Reader& reader, SMF_Header& header)
 {
     CHECK(reader.ReadU16BE(header.format));
     CHECK(reader.ReadU16BE(header.ntrks));
     CHECK(reader.ReadU16BE(header.division));
+    // Timestamps are divided by this.
+    CHECK(header.division != 0);
+    return true;
 }
 
 [[nodiscard]]
@@ -221,7 +230,8 @@ inline bool SMF_IsStatusByte(uint8_t byte)
     return (byte & 0x80) != 0;
 }
 
-bool SMF_ReadTrack(SMF_Reader& reader, SMF_Data& result, uint64_t expected_end)
+[[nodiscard]]
+static bool SMF_ReadTrack(SMF_Reader& reader, SMF_Data& result, uint64_t expected_end)
 {
     uint8_t running_status = 0;
     uint64_t total_time = 0;
@@ -249,6 +259,8 @@ bool SMF_ReadTrack(SMF_Reader& reader, SMF_Data& result, uint64_t expected_end)
             // op is valid because we only got here if we already read a status
             // byte.
             (void)reader.PutBack();
+            // ...unless there was no status byte yet to run with.
+            CHECK(running_status != 0);
         }
 
         total_time += delta_time;
@@ -303,6 +315,12 @@ bool SMF_ReadTrack(SMF_Reader& reader, SMF_Data& result, uint64_t expected_end)
                         CHECK(reader.Skip(meta_len));
                         new_event.data_last = reader.GetOffset();
 
+                        // GetTempoUS reads three bytes of data
+                        if (meta_type == 0x51)
+                        {
+                            CHECK(meta_len == 3);
+                        }
+
                         // End of track: stop reading events and skip to where the next track would be
                         if (meta_type == 0x2F)
                         {
@@ -312,8 +330,8 @@ bool SMF_ReadTrack(SMF_Reader& reader, SMF_Data& result, uint64_t expected_end)
                     }
                     else
                     {
-                        fprintf(stderr, "Panic: unhandled Fx message: %x\n", new_event.status);
-                        exit(1);
+                        fprintf(stderr, "Malformed MIDI file: unhandled Fx message: %x\n", new_event.status);
+                        return false;
                     }
                 }
                 break;
@@ -322,7 +340,7 @@ bool SMF_ReadTrack(SMF_Reader& reader, SMF_Data& result, uint64_t expected_end)
 
     if (reader.GetOffset() > expected_end)
     {
-        fprintf(stderr, "Read past expected track end\n");
+        fprintf(stderr, "Malformed MIDI file: read past expected track end\n");
         return false;
     }
 
@@ -337,7 +355,8 @@ void SMF_PrintStats(const SMF_Data& data)
     }
 }
 
-bool SMF_ReadAllBytes(const std::filesystem::path& filename, std::vector<uint8_t>& buffer)
+[[nodiscard]]
+static bool SMF_ReadAllBytes(const std::filesystem::path& filename, std::vector<uint8_t>& buffer)
 {
     std::ifstream input(filename, std::ios::binary);
 
@@ -357,7 +376,8 @@ bool SMF_ReadAllBytes(const std::filesystem::path& filename, std::vector<uint8_t
     return input.good();
 }
 
-bool SMF_ReadChunk(SMF_Reader& reader, SMF_Data& data)
+[[nodiscard]]
+static bool SMF_ReadChunk(SMF_Reader& reader, SMF_Data& data, bool& has_header)
 {
     uint64_t chunk_start = reader.GetOffset();
 
@@ -369,41 +389,69 @@ bool SMF_ReadChunk(SMF_Reader& reader, SMF_Data& data)
 
     uint64_t chunk_end = reader.GetOffset() + chunk_size;
 
+    CHECK(chunk_end <= data.bytes.size());
+
     if (memcmp(chunk_type, "MThd", 4) == 0)
     {
-        SMF_ReadHeader(reader, data.header);
+        SMF_Reader header_reader(SMF_ByteSpan(data.bytes).first(chunk_end));
+        CHECK(header_reader.Seek(reader.GetOffset()));
+        if (!SMF_ReadHeader(header_reader, data.header))
+        {
+            return false;
+        }
+        CHECK(reader.Seek(chunk_end));
+        has_header = true;
     }
     else if (memcmp(chunk_type, "MTrk", 4) == 0)
     {
-        SMF_ReadTrack(reader, data, chunk_end);
+        if (!SMF_ReadTrack(reader, data, chunk_end))
+        {
+            return false;
+        }
     }
     else
     {
-        fprintf(stderr, "Unexpected chunk type at %zu\n", (size_t)chunk_start);
+        fprintf(stderr, "Malformed MIDI file: unexpected chunk type at %zu\n", (size_t)chunk_start);
         return false;
     }
 
     return true;
 }
 
-SMF_Data SMF_LoadEvents(const char* filename)
+bool SMF_LoadEvents(const char* filename, SMF_Data& data)
 {
-    return SMF_LoadEvents(std::filesystem::path(filename));
+    return SMF_LoadEvents(std::filesystem::path(filename), data);
 }
 
-SMF_Data SMF_LoadEvents(const std::filesystem::path& filename)
+bool SMF_LoadEvents(const std::filesystem::path& filename, SMF_Data& data)
 {
-    SMF_Data data;
+    data = SMF_Data{};
 
-    CHECK(SMF_ReadAllBytes(filename, data.bytes));
+    if (!SMF_ReadAllBytes(filename, data.bytes))
+    {
+        fprintf(stderr, "Failed to read %s\n", filename.generic_string().c_str());
+        return false;
+    }
+
+    return SMF_ParseEvents(data);
+}
+
+bool SMF_ParseEvents(SMF_Data& data)
+{
+    data.tracks.clear();
 
     SMF_Reader reader(data.bytes);
 
+    bool has_header = false;
     while (!reader.AtEnd())
     {
-        CHECK(SMF_ReadChunk(reader, data));
+        if (!SMF_ReadChunk(reader, data, has_header))
+        {
+            return false;
+        }
     }
+    CHECK(has_header);
 
-    return data;
+    return true;
 }
 
@@ -92,8 +92,12 @@ const size_t SMF_CHANNEL_COUNT = 16;
 void SMF_SetDeltasFromTimestamps(SMF_Track& track);
 SMF_Track SMF_MergeTracks(const SMF_Data& data);
 void SMF_PrintStats(const SMF_Data& data);
-SMF_Data SMF_LoadEvents(const char* filename);
-SMF_Data SMF_LoadEvents(const std::filesystem::path& filename);
+// Reads and parses a MIDI file into `data`. Returns false and prints the reason if the file can't be read or is
+// malformed.
+bool SMF_LoadEvents(const char* filename, SMF_Data& data);
+bool SMF_LoadEvents(const std::filesystem::path& filename, SMF_Data& data);
+// Parses `data.bytes` into `data.header` and `data.tracks`. Returns false and prints the reason if it is malformed.
+bool SMF_ParseEvents(SMF_Data& data);
 
 inline uint64_t SMF_TicksToUS(uint64_t ticks, uint64_t us_per_qn, uint64_t division)
 {
@@ -1,5 +1,7 @@
 // We use fopen()
 #define _CRT_SECURE_NO_WARNINGS
+// 64-bit off_t for ftello/fseeko on 32-bit platforms
+#define _FILE_OFFSET_BITS 64
 
 #include "wav.h"
 #include "cast.h"
@@ -7,6 +9,8 @@
 #include <bit>
 #include <cassert>
 #include <cstring>
+#include <type_traits>
+#include <utility>
 
 // Constants from rfc2361
 enum class WaveFormat : uint16_t
@@ -43,6 +47,15 @@ void WAV_WriteU32LE(FILE* output, uint32_t value)
     WAV_WriteBytes(output, (const char*)&value, sizeof(uint32_t));
 }
 
+void WAV_WriteU64LE(FILE* output, uint64_t value)
+{
+    if constexpr (std::endian::native == std::endian::big)
+    {
+        value = std::byteswap(value);
+    }
+    WAV_WriteBytes(output, (const char*)&value, sizeof(uint64_t));
+}
+
 void WAV_WriteF32LE(FILE* output, float value)
 {
     // byteswap is only implemented for integral types, so forward the call to
@@ -50,6 +63,159 @@ void WAV_WriteF32LE(FILE* output, float value)
     WAV_WriteU32LE(output, std::bit_cast<uint32_t>(value));
 }
 
+// ftell and fseek take a long, which is only 32 bits on Windows and can't reach the end of an RF64 file.
+int64_t WAV_Tell(FILE* output)
+{
+#ifdef _WIN32
+    return _ftelli64(output);
+#else
+    return (int64_t)ftello(output);
+#endif
+}
+
+bool WAV_Seek(FILE* output, int64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(output, offset, SEEK_SET) == 0;
+#else
+    return fseeko(output, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Writes frames as little endian samples. On little endian hosts this is a single write straight from `frames`;
+// otherwise samples are swapped a block at a time into a staging buffer.
+template <typename T>
+void WAV_WriteFramesLE(FILE* output, std::span<const AudioFrame<T>> frames)
+{
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        WAV_WriteBytes(output, (const char*)frames.data(), frames.size_bytes());
+    }
+    else
+    {
+        using U = std::conditional_t<sizeof(T) == sizeof(uint16_t), uint16_t, uint32_t>;
+
+        constexpr size_t BLOCK_FRAMES = 1024;
+        U                block[BLOCK_FRAMES * AudioFrame<T>::channel_count];
+        while (!frames.empty())
+        {
+            const size_t count = Min(frames.size(), BLOCK_FRAMES);
+            for (size_t i = 0; i < count; ++i)
+            {
+                block[2 * i + 0] = std::byteswap(std::bit_cast<U>(frames[i].left));
+                block[2 * i + 1] = std::byteswap(std::bit_cast<U>(frames[i].right));
+            }
+            WAV_WriteBytes(output, (const char*)block, count * sizeof(AudioFrame<T>));
+            frames = frames.subspan(count);
+        }
+    }
+}
+
+// Size fields that don't fit in 32 bits are set to this. In an RF64 file, the real value is in the ds64 chunk. In a
+// streamed file, it means the size is unknown and readers should read until the end of the stream.
+constexpr uint32_t WAV_SIZE_UNKNOWN = 0xFFFFFFFF;
+
+// Every file reserves space for a ds64 chunk after the RIFF header. Files that fit in the 4 GiB RIFF limit leave it as a
+// JUNK chunk, which readers skip. Larger files turn it into a ds64 chunk and become RF64 files (EBU Tech 3306), which
+// is possible without moving any sample data.
+constexpr uint32_t WAV_DS64_SIZE = 28;
+
+enum class WAV_HeaderType
+{
+    // Plain RIFF file; sizes are known and fit in 32 bits.
+    Riff,
+    // RF64 file; sizes are known and are stored in the ds64 chunk.
+    RF64,
+    // Plain RIFF file written in one pass without seeking; sizes are unknown. This is never RF64 because the ds64 sizes
+    // would have to be known up front, so readers that take WAV_SIZE_UNKNOWN literally stop after 4 GiB.
+    Streaming,
+};
+
+size_t WAV_GetHeaderSize(AudioFormat format)
+{
+    // RIFF header, JUNK/ds64, fmt, data header
+    size_t size = 12 + (8 + WAV_DS64_SIZE) + (8 + 16) + 8;
+    if (format == AudioFormat::F32)
+    {
+        // cbSize in fmt, fact
+        size += 2 + 12;
+    }
+    return size;
+}
+
+size_t WAV_GetFrameSize(AudioFormat format)
+{
+    switch (format)
+    {
+    case AudioFormat::S16:
+        return sizeof(AudioFrame<int16_t>);
+    case AudioFormat::S32:
+        return sizeof(AudioFrame<int32_t>);
+    case AudioFormat::F32:
+        return sizeof(AudioFrame<float>);
+    }
+    return 0;
+}
+
+void WAV_WriteHeader(FILE* output, AudioFormat format, uint32_t sample_rate, uint64_t frames, WAV_HeaderType type)
+{
+    const size_t   frame_size  = WAV_GetFrameSize(format);
+    const uint64_t data_size   = frames * frame_size;
+    const uint64_t riff_size   = WAV_GetHeaderSize(format) - 8 + data_size;
+    const bool     known_sizes = type == WAV_HeaderType::Riff;
+
+    // RIFF header
+    WAV_WriteCString(output, type == WAV_HeaderType::RF64 ? "RF64" : "RIFF");
+    WAV_WriteU32LE(output, known_sizes ? (uint32_t)riff_size : WAV_SIZE_UNKNOWN);
+    WAV_WriteCString(output, "WAVE");
+    // ds64, or JUNK reserving space for it
+    if (type == WAV_HeaderType::RF64)
+    {
+        WAV_WriteCString(output, "ds64");
+        WAV_WriteU32LE(output, WAV_DS64_SIZE);
+        WAV_WriteU64LE(output, riff_size);
+        WAV_WriteU64LE(output, data_size);
+        WAV_WriteU64LE(output, frames);
+        // no table entries
+        WAV_WriteU32LE(output, 0);
+    }
+    else
+    {
+        WAV_WriteCString(output, "JUNK");
+        WAV_WriteU32LE(output, WAV_DS64_SIZE);
+        const char zeroes[WAV_DS64_SIZE]{};
+        WAV_WriteBytes(output, zeroes, sizeof(zeroes));
+    }
+    // fmt
+    WAV_WriteCString(output, "fmt ");
+    if (format == AudioFormat::F32)
+    {
+        WAV_WriteU32LE(output, 18);
+        WAV_WriteU16LE(output, (uint16_t)WaveFormat::IEEE_FLOAT);
+    }
+    else
+    {
+        WAV_WriteU32LE(output, 16);
+        WAV_WriteU16LE(output, (uint16_t)WaveFormat::PCM);
+    }
+    WAV_WriteU16LE(output, AudioFrame<int16_t>::channel_count);
+    WAV_WriteU32LE(output, sample_rate);
+    WAV_WriteU32LE(output, RangeCast<uint32_t>(sample_rate * frame_size));
+    WAV_WriteU16LE(output, (uint16_t)frame_size);
+    WAV_WriteU16LE(output, (uint16_t)(8 * frame_size / AudioFrame<int16_t>::channel_count));
+    if (format == AudioFormat::F32)
+    {
+        WAV_WriteU16LE(output, 0);
+        // fact
+        WAV_WriteCString(output, "fact");
+        WAV_WriteU32LE(output, 4);
+        WAV_WriteU32LE(output, known_sizes ? (uint32_t)frames : WAV_SIZE_UNKNOWN);
+    }
+    // data
+    WAV_WriteCString(output, "data");
+    WAV_WriteU32LE(output, known_sizes ? (uint32_t)data_size : WAV_SIZE_UNKNOWN);
+}
+
 WAV_Handle::~WAV_Handle()
 {
     Close();
@@ -57,11 +223,7 @@ WAV_Handle::~WAV_Handle()
 
 WAV_Handle::WAV_Handle(WAV_Handle&& rhs) noexcept
 {
-    m_output         = rhs.m_output;
-    rhs.m_output     = nullptr;
-    m_format         = rhs.m_format;
-    m_sample_rate    = rhs.m_sample_rate;
-    m_frames_written = rhs.m_frames_written;
+    *this = std::move(rhs);
 }
 
 WAV_Handle& WAV_Handle::operator=(WAV_Handle&& rhs) noexcept
@@ -72,6 +234,9 @@ WAV_Handle& WAV_Handle::operator=(WAV_Handle&& rhs) noexcept
     m_format         = rhs.m_format;
     m_sample_rate    = rhs.m_sample_rate;
     m_frames_written = rhs.m_frames_written;
+    m_mode           = rhs.m_mode;
+    m_header_offset  = rhs.m_header_offset;
+    m_header_written = rhs.m_header_written;
     return *this;
 }
 
@@ -84,18 +249,44 @@ void WAV_Handle::OpenStdout(AudioFormat format)
 {
     m_format = format;
     m_output = stdout;
+    m_mode   = Mode::Raw;
+}
+
+void WAV_Handle::OpenStdoutWave(AudioFormat format)
+{
+    m_format = format;
+    m_output = stdout;
+
+    // When stdout is redirected to a file we can go back and fill in the header like any other file.
+    const int64_t offset = WAV_Tell(m_output);
+    if (offset >= 0 && WAV_Seek(m_output, offset + (int64_t)WAV_GetHeaderSize(format)))
+    {
+        m_mode          = Mode::Seekable;
+        m_header_offset = offset;
+    }
+    else
+    {
+        m_mode = Mode::Streaming;
+    }
 }
 
-void WAV_Handle::Open(const char* filename, AudioFormat format)
+bool WAV_Handle::Open(const char* filename, AudioFormat format)
 {
-    Open(std::filesystem::path(filename), format);
+    return Open(std::filesystem::path(filename), format);
 }
 
-void WAV_Handle::Open(const std::filesystem::path& filename, AudioFormat format)
+bool WAV_Handle::Open(const std::filesystem::path& filename, AudioFormat format)
 {
     m_format = format;
     m_output = fopen(filename.generic_string().c_str(), "wb");
-    fseek(m_output, format == AudioFormat::F32 ? 58 : 44, SEEK_SET);
+    if (!m_output)
+    {
+        return false;
+    }
+    m_mode          = Mode::Seekable;
+    m_header_offset = 0;
+    WAV_Seek(m_output, (int64_t)WAV_GetHeaderSize(format));
+    return true;
 }
 
 void WAV_Handle::Close()
@@ -107,117 +298,83 @@ void WAV_Handle::Close()
     m_output = nullptr;
 }
 
+void WAV_Handle::BeginWrite()
+{
+    // A streamed header can only be written once the sample rate is known, so it's deferred until the first write.
+    if (m_mode == Mode::Streaming && !m_header_written)
+    {
+        WAV_WriteHeader(m_output, m_format, m_sample_rate, 0, WAV_HeaderType::Streaming);
+        m_header_written = true;
+    }
+}
+
 void WAV_Handle::Write(const AudioFrame<int16_t>& frame)
 {
-    WAV_WriteU16LE(m_output, std::bit_cast<uint16_t>(frame.left));
-    WAV_WriteU16LE(m_output, std::bit_cast<uint16_t>(frame.right));
-    ++m_frames_written;
+    Write(std::span(&frame, 1));
 }
 
 void WAV_Handle::Write(const AudioFrame<int32_t>& frame)
 {
-    WAV_WriteU32LE(m_output, std::bit_cast<uint32_t>(frame.left));
-    WAV_WriteU32LE(m_output, std::bit_cast<uint32_t>(frame.right));
-    ++m_frames_written;
+    Write(std::span(&frame, 1));
 }
 
 void WAV_Handle::Write(const AudioFrame<float>& frame)
 {
-    WAV_WriteF32LE(m_output, frame.left);
-    WAV_WriteF32LE(m_output, frame.right);
-    ++m_frames_written;
+    Write(std::span(&frame, 1));
+}
+
+void WAV_Handle::Write(std::span<const AudioFrame<int16_t>> frames)
+{
+    BeginWrite();
+    WAV_WriteFramesLE(m_output, frames);
+    m_frames_written += frames.size();
+}
+
+void WAV_Handle::Write(std::span<const AudioFrame<int32_t>> frames)
+{
+    BeginWrite();
+    WAV_WriteFramesLE(m_output, frames);
+    m_frames_written += frames.size();
+}
+
+void WAV_Handle::Write(std::span<const AudioFrame<float>> frames)
+{
+    BeginWrite();
+    WAV_WriteFramesLE(m_output, frames);
+    m_frames_written += frames.size();
 }
 
 void WAV_Handle::Finish()
 {
-    // we wrote raw samples, nothing to do
-    if (m_output == stdout)
+    switch (m_mode)
     {
+    case Mode::Raw:
+        // we wrote raw samples, nothing to do
         return;
-    }
-
-    // go back and fill in the header
-    fseek(m_output, 0, SEEK_SET);
-
-    switch (m_format)
-    {
-    case AudioFormat::S16: {
-        const uint32_t data_size = RangeCast<uint32_t>(m_frames_written * sizeof(AudioFrame<int16_t>));
-
-        // RIFF header
-        WAV_WriteCString(m_output, "RIFF");
-        WAV_WriteU32LE(m_output, 36 + data_size);
-        WAV_WriteCString(m_output, "WAVE");
-        // fmt
-        WAV_WriteCString(m_output, "fmt ");
-        WAV_WriteU32LE(m_output, 16);
-        WAV_WriteU16LE(m_output, (uint16_t)WaveFormat::PCM);
-        WAV_WriteU16LE(m_output, AudioFrame<int16_t>::channel_count);
-        WAV_WriteU32LE(m_output, m_sample_rate);
-        WAV_WriteU32LE(m_output, m_sample_rate * sizeof(AudioFrame<int16_t>));
-        WAV_WriteU16LE(m_output, sizeof(AudioFrame<int16_t>));
-        WAV_WriteU16LE(m_output, 8 * sizeof(int16_t));
-        // data
-        WAV_WriteCString(m_output, "data");
-        WAV_WriteU32LE(m_output, data_size);
-
-        assert(ftell(m_output) == 44);
-
+    case Mode::Streaming:
+        // the header is all we can write without seeking
+        BeginWrite();
+        fflush(m_output);
+        return;
+    case Mode::Seekable:
         break;
     }
-    case AudioFormat::S32: {
-        const uint32_t data_size = RangeCast<uint32_t>(m_frames_written * sizeof(AudioFrame<int32_t>));
-
-        // RIFF header
-        WAV_WriteCString(m_output, "RIFF");
-        WAV_WriteU32LE(m_output, 36 + data_size);
-        WAV_WriteCString(m_output, "WAVE");
-        // fmt
-        WAV_WriteCString(m_output, "fmt ");
-        WAV_WriteU32LE(m_output, 16);
-        WAV_WriteU16LE(m_output, (uint16_t)WaveFormat::PCM);
-        WAV_WriteU16LE(m_output, AudioFrame<int32_t>::channel_count);
-        WAV_WriteU32LE(m_output, m_sample_rate);
-        WAV_WriteU32LE(m_output, m_sample_rate * sizeof(AudioFrame<int32_t>));
-        WAV_WriteU16LE(m_output, sizeof(AudioFrame<int32_t>));
-        WAV_WriteU16LE(m_output, 8 * sizeof(int32_t));
-        // data
-        WAV_WriteCString(m_output, "data");
-        WAV_WriteU32LE(m_output, data_size);
-
-        assert(ftell(m_output) == 44);
 
-        break;
-    }
-    case AudioFormat::F32: {
-        const uint32_t data_size = RangeCast<uint32_t>(m_frames_written * sizeof(AudioFrame<float>));
-
-        // RIFF header
-        WAV_WriteCString(m_output, "RIFF");
-        WAV_WriteU32LE(m_output, 50 + data_size);
-        WAV_WriteCString(m_output, "WAVE");
-        // fmt
-        WAV_WriteCString(m_output, "fmt ");
-        WAV_WriteU32LE(m_output, 18);
-        WAV_WriteU16LE(m_output, (uint16_t)WaveFormat::IEEE_FLOAT);
-        WAV_WriteU16LE(m_output, AudioFrame<float>::channel_count);
-        WAV_WriteU32LE(m_output, m_sample_rate);
-        WAV_WriteU32LE(m_output, m_sample_rate * sizeof(AudioFrame<float>));
-        WAV_WriteU16LE(m_output, sizeof(AudioFrame<float>));
-        WAV_WriteU16LE(m_output, 8 * sizeof(float));
-        WAV_WriteU16LE(m_output, 0);
-        // fact
-        WAV_WriteCString(m_output, "fact");
-        WAV_WriteU32LE(m_output, 4);
-        WAV_WriteU32LE(m_output, RangeCast<uint32_t>(m_frames_written));
-        // data
-        WAV_WriteCString(m_output, "data");
-        WAV_WriteU32LE(m_output, data_size);
+    // go back and fill in the header
+    const uint64_t riff_size = WAV_GetHeaderSize(m_format) - 8 + m_frames_written * WAV_GetFrameSize(m_format);
+    const WAV_HeaderType type = riff_size > UINT32_MAX ? WAV_HeaderType::RF64 : WAV_HeaderType::Riff;
+    const int64_t data_end = WAV_Tell(m_output);
+    WAV_Seek(m_output, m_header_offset);
+    WAV_WriteHeader(m_output, m_format, m_sample_rate, m_frames_written, type);
 
-        assert(ftell(m_output) == 58);
+    assert(WAV_Tell(m_output) == m_header_offset + (int64_t)WAV_GetHeaderSize(m_format));
 
-        break;
-    }
+    if (m_output == stdout)
+    {
+        // stdout stays open, so leave it where the data ends rather than just past the header
+        WAV_Seek(m_output, data_end);
+        fflush(m_output);
+        return;
     }
 
     Close();
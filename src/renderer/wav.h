@@ -1,14 +1,16 @@
 // This is a very minimal WAVE writer. It only exists to output something other
-// than raw sample data.
+// than raw sample data. Files too large for RIFF are written as RF64.
 
 #pragma once
 
 #include "audio.h"
+#include "audio_sink.h"
 #include <cstdint>
 #include <cstdio>
 #include <filesystem>
+#include <span>
 
-class WAV_Handle
+class WAV_Handle final : public AudioSink
 {
 public:
     WAV_Handle() = default;
@@ -20,20 +22,45 @@ public:
     WAV_Handle(const WAV_Handle&) = delete;
     WAV_Handle& operator=(const WAV_Handle&) = delete;
 
-    void SetSampleRate(uint32_t sample_rate);
+    void SetSampleRate(uint32_t sample_rate) override;
 
+    // Writes raw samples to stdout without a header.
     void OpenStdout(AudioFormat format);
-    void Open(const char* filename, AudioFormat format);
-    void Open(const std::filesystem::path& filename, AudioFormat format);
+    // Writes a wave file to stdout. If stdout can't seek, the header is written up front with unknown sizes and readers
+    // have to read until the end of the stream.
+    void OpenStdoutWave(AudioFormat format);
+    // Returns false if the file couldn't be opened for writing.
+    bool Open(const char* filename, AudioFormat format);
+    bool Open(const std::filesystem::path& filename, AudioFormat format);
     void Close();
     void Write(const AudioFrame<int16_t>& frame);
     void Write(const AudioFrame<int32_t>& frame);
     void Write(const AudioFrame<float>& frame);
-    void Finish();
+    // Writes a block of frames at once. Prefer these over the single frame versions.
+    void Write(std::span<const AudioFrame<int16_t>> frames) override;
+    void Write(std::span<const AudioFrame<int32_t>> frames) override;
+    void Write(std::span<const AudioFrame<float>> frames) override;
+    void Finish() override;
+
+private:
+    enum class Mode
+    {
+        // Raw samples, no header.
+        Raw,
+        // The header is filled in by Finish.
+        Seekable,
+        // The header is written before the first frame.
+        Streaming,
+    };
+
+    void BeginWrite();
 
 private:
     FILE*       m_output = nullptr;
     uint64_t    m_frames_written = 0;
     AudioFormat m_format;
     uint32_t    m_sample_rate;
+    Mode        m_mode           = Mode::Raw;
+    int64_t     m_header_offset  = 0;
+    bool        m_header_written = false;
 };
@@ -66,6 +66,13 @@ bool Application::Initialize(const CliParameters& params)
 
     m_romset = load_result.romset;
 
+    m_rom_image = EMU_CreateRomImage(m_romset, m_romset_info);
+    m_romset_info.PurgeRomData();
+    if (!m_rom_image)
+    {
+        return false;
+    }
+
     EMU_SystemReset reset = EMU_SystemReset::NONE;
     if (params.reset)
     {
@@ -89,8 +96,6 @@ bool Application::Initialize(const CliParameters& params)
         }
     }
 
-    m_romset_info.PurgeRomData();
-
     for (Instance& inst : m_instances)
     {
         inst.GetEmulator().PostSystemReset(reset);
@@ -129,20 +134,20 @@ bool Application::AllocateInstance(Instance** result)
     return true;
 }
 
-void Application::SendMIDI(size_t instance_id, std::span<const uint8_t> bytes)
+void Application::SendMIDI(size_t instance_id, std::span<const uint8_t> bytes, MIDI_Clock::time_point time)
 {
-    m_instances[instance_id].GetEmulator().PostMIDI(bytes);
+    m_instances[instance_id].PostMIDI(bytes, time);
 }
 
-void Application::BroadcastMIDI(std::span<const uint8_t> bytes)
+void Application::BroadcastMIDI(std::span<const uint8_t> bytes, MIDI_Clock::time_point time)
 {
     for (size_t i = 0; i < m_instances.Count(); ++i)
     {
-        SendMIDI(i, bytes);
+        SendMIDI(i, bytes, time);
     }
 }
 
-void Application::RouteMIDI(std::span<const uint8_t> bytes)
+void Application::RouteMIDI(std::span<const uint8_t> bytes, MIDI_Clock::time_point time)
 {
     if (bytes.size() == 0)
     {
@@ -162,11 +167,11 @@ void Application::RouteMIDI(std::span<const uint8_t> bytes)
 
     if (is_sysex)
     {
-        BroadcastMIDI(bytes);
+        BroadcastMIDI(bytes, time);
     }
     else
     {
-        SendMIDI(channel % m_instances.Count(), bytes);
+        SendMIDI(channel % m_instances.Count(), bytes, time);
     }
 }
 
@@ -380,9 +385,9 @@ bool Application::CreateInstance(const CliParameters& app_params)
         .gain                = app_params.gain,
         .enable_lcd          = !app_params.no_lcd,
         .enable_oversampling = !app_params.disable_oversampling,
+        .midi_latency_ms     = app_params.midi_latency_ms,
         .nvram_filename      = app_params.nvram_filename,
-        .romset_info         = &m_romset_info,
-        .romset              = m_romset,
+        .rom_image           = m_rom_image,
     };
 
     if (!inst->Initialize(inst_params))
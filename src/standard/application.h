@@ -34,6 +34,8 @@ struct CliParameters
     bool        disable_oversampling = false;
     float       gain                 = 1.0f;
 
+    std::optional<uint32_t> midi_latency_ms;
+
     // Emulator options
     std::optional<EMU_SystemReset> reset;
     size_t                         instances = 1;
@@ -69,6 +71,7 @@ enum class CliParseError
     ASIOChannelInvalid,
     ResetInvalid,
     GainInvalid,
+    MidiLatencyInvalid,
 };
 
 CliParseError ParseCommandLine(int argc, char* argv[], CliParameters& result);
@@ -91,9 +94,10 @@ public:
 
     void Run();
 
-    void SendMIDI(size_t n, std::span<const uint8_t> bytes);
-    void BroadcastMIDI(std::span<const uint8_t> bytes);
-    void RouteMIDI(std::span<const uint8_t> bytes);
+    // `time` is when the message was received.
+    void SendMIDI(size_t n, std::span<const uint8_t> bytes, MIDI_Clock::time_point time);
+    void BroadcastMIDI(std::span<const uint8_t> bytes, MIDI_Clock::time_point time);
+    void RouteMIDI(std::span<const uint8_t> bytes, MIDI_Clock::time_point time);
 
 private:
     bool AllocateInstance(Instance** result);
@@ -111,7 +115,7 @@ private:
     // MIDI_Output interface
     void Write(std::span<const uint8_t> bytes) override
     {
-        RouteMIDI(bytes);
+        RouteMIDI(bytes, MIDI_Clock::now());
     }
 
 private:
@@ -119,8 +123,9 @@ private:
 
     BoundedVector<Instance, MAX_INSTANCES> m_instances;
 
-    AllRomsetInfo m_romset_info;
-    Romset        m_romset;
+    AllRomsetInfo                       m_romset_info;
+    std::shared_ptr<const EMU_RomImage> m_rom_image;
+    Romset                              m_romset;
 
     AudioOutput m_audio_output{};
 
@@ -33,6 +33,8 @@ const char* ParseErrorStr(CliParseError err)
         return "Reset invalid (should be none, gs, or gm)";
     case CliParseError::GainInvalid:
         return "Gain invalid (should be a number optionally ending in 'db')";
+    case CliParseError::MidiLatencyInvalid:
+        return "MIDI latency invalid (should be a number of milliseconds)";
     }
     return "Unknown error";
 }
@@ -189,6 +191,21 @@ CliParseError ParseCommandLine(int argc, char* argv[], CliParameters& result)
                 return CliParseError::GainInvalid;
             }
         }
+        else if (reader.Any("--midi-latency"))
+        {
+            if (!reader.Next())
+            {
+                return CliParseError::UnexpectedEnd;
+            }
+
+            uint32_t midi_latency_ms = 0;
+            if (!reader.TryParse(midi_latency_ms))
+            {
+                return CliParseError::MidiLatencyInvalid;
+            }
+
+            result.midi_latency_ms = midi_latency_ms;
+        }
         else if (reader.Any("-d", "--rom-directory"))
         {
             if (!reader.Next())
@@ -1,11 +1,15 @@
 #include "instance.h"
 
 #include <bit>
+#include <cinttypes>
 
 #include "audio_sdl.h"
 #include "output_asio.h"
 #include "output_sdl.h"
 
+// Room for a few seconds of dense MIDI input or a large SysEx dump.
+constexpr size_t MIDI_QUEUE_SIZE = 64 * 1024;
+
 template <typename ElemT>
 size_t CalcRingbufferSizeBytes(uint32_t buffer_size, uint32_t buffer_count)
 {
@@ -25,9 +29,9 @@ Instance::~Instance()
 
 bool Instance::Initialize(const InstanceParameters& params)
 {
-    if (!params.romset_info)
+    if (!params.rom_image)
     {
-        fprintf(stderr, "FATAL: romset_info not provided to instance %02zu\n", params.instance_id);
+        fprintf(stderr, "FATAL: rom_image not provided to instance %02zu\n", params.instance_id);
         return false;
     }
 
@@ -36,6 +40,7 @@ bool Instance::Initialize(const InstanceParameters& params)
     m_buffer_size  = params.buffer_size;
     m_buffer_count = params.buffer_count;
     m_gain         = params.gain;
+    m_midi_latency_ms = params.midi_latency_ms;
 
     if (params.enable_lcd)
     {
@@ -55,7 +60,7 @@ bool Instance::Initialize(const InstanceParameters& params)
         return false;
     }
 
-    if (!m_emu.LoadRoms(params.romset, *params.romset_info))
+    if (!m_emu.LoadRoms(params.rom_image))
     {
         fprintf(stderr, "ERROR: Failed to load roms for instance %02zu\n", params.instance_id);
         return false;
@@ -74,25 +79,29 @@ bool Instance::Initialize(const InstanceParameters& params)
 }
 
 template <typename SampleT>
-void Instance::Prepare()
+void Instance::CreateBuffer()
 {
-    auto span     = m_view.UncheckedPrepareWrite<AudioFrame<SampleT>>(m_buffer_size);
-    m_chunk_first = span.data();
-    m_chunk_last  = span.data() + span.size();
-}
+    m_sample_buffer.Init(CalcRingbufferSizeBytes<AudioFrame<SampleT>>(m_buffer_size, m_buffer_count));
+    m_view = RingbufferView(m_sample_buffer);
 
-template <typename SampleT>
-void Instance::Finish()
-{
-    m_view.UncheckedFinishWrite<AudioFrame<SampleT>>(m_buffer_size);
+    // The raw buffer is exactly one ringbuffer slot long, so each callback fills one slot.
+    m_raw_buffer.resize(m_buffer_size);
 }
 
-template <typename SampleT>
-void Instance::CreateAndPrepareBuffer()
+template <typename SampleT, bool ApplyGain>
+void Instance::WriteSamples(std::span<const AudioFrame<int32_t>> in)
 {
-    m_sample_buffer.Init(CalcRingbufferSizeBytes<AudioFrame<SampleT>>(m_buffer_size, m_buffer_count));
-    m_view = RingbufferView(m_sample_buffer);
-    Prepare<SampleT>();
+    auto out = m_view.UncheckedPrepareWrite<AudioFrame<SampleT>>(in.size());
+
+    NormalizeBlock(in, out);
+
+    if constexpr (ApplyGain)
+    {
+        ScaleBlock(out, m_gain);
+    }
+
+    m_view.UncheckedFinishWrite<AudioFrame<SampleT>>(in.size());
+    m_frames_written += in.size();
 }
 
 #if NUKED_ENABLE_ASIO
@@ -112,34 +121,20 @@ void Instance::RunInstanceASIO(Instance& self)
             SDL_Delay(1);
         }
 
-        self.m_emu.Step();
+        self.m_emu.RunUntilFrames(buffer_size);
     }
 }
 
 template <typename SampleT, bool ApplyGain>
-void Instance::ReceiveSampleASIO(void* userdata, const AudioFrame<int32_t>& in)
+void Instance::ReceiveSamplesASIO(void* userdata, std::span<const AudioFrame<int32_t>> in)
 {
     Instance& inst = *(Instance*)userdata;
 
-    AudioFrame<SampleT>* out = (AudioFrame<SampleT>*)inst.m_chunk_first;
-    Normalize(in, *out);
-
-    if constexpr (ApplyGain)
-    {
-        Scale(*out, inst.m_gain);
-    }
-
-    inst.m_chunk_first = out + 1;
-
-    if (inst.m_chunk_first == inst.m_chunk_last)
-    {
-        inst.Finish<SampleT>();
-        inst.Prepare<SampleT>();
+    inst.WriteSamples<SampleT, ApplyGain>(in);
 
-        auto span = inst.m_view.UncheckedPrepareRead<AudioFrame<SampleT>>(inst.m_buffer_size);
-        SDL_AudioStreamPut(inst.m_stream, span.data(), (int)(span.size() * sizeof(AudioFrame<SampleT>)));
-        inst.m_view.UncheckedFinishRead<AudioFrame<SampleT>>(inst.m_buffer_size);
-    }
+    auto span = inst.m_view.UncheckedPrepareRead<AudioFrame<SampleT>>(inst.m_buffer_size);
+    SDL_AudioStreamPut(inst.m_stream, span.data(), (int)(span.size() * sizeof(AudioFrame<SampleT>)));
+    inst.m_view.UncheckedFinishRead<AudioFrame<SampleT>>(inst.m_buffer_size);
 }
 #endif
 
@@ -155,32 +150,59 @@ void Instance::RunInstanceSDL(Instance& self)
             SDL_Delay(1);
         }
 
-        self.m_emu.Step();
+        // Run in blocks of one buffer instead of checking the ringbuffer after every step.
+        if (self.m_schedule_midi)
+        {
+            self.RunScheduledBuffer<SampleT>();
+        }
+        else
+        {
+            self.m_emu.RunUntilFrames(self.m_buffer_size);
+        }
     }
 }
 
-template <typename SampleT, bool ApplyGain>
-void Instance::ReceiveSampleSDL(void* userdata, const AudioFrame<int32_t>& in)
+template <typename SampleT>
+void Instance::RunScheduledBuffer()
 {
-    Instance& fe = *(Instance*)userdata;
+    const uint64_t played = m_frames_written - m_view.GetReadableElements<AudioFrame<SampleT>>();
+    m_midi_clock.Update(MIDI_Clock::now(), played);
 
-    AudioFrame<SampleT>* out = (AudioFrame<SampleT>*)fe.m_chunk_first;
-    Normalize(in, *out);
-
-    if constexpr (ApplyGain)
+    const uint64_t& produced = m_emu.GetMCU().frames_produced;
+    const uint64_t  end      = produced + m_buffer_size;
+    while (produced < end)
     {
-        Scale(*out, fe.m_gain);
-    }
+        uint64_t next = end;
 
-    fe.m_chunk_first = out + 1;
+        MIDI_Clock::time_point time;
+        while (m_midi_queue.PeekTime(time))
+        {
+            // messages that map to frames already produced are late and go out immediately
+            const int64_t frame = m_midi_clock.FrameAt(time) + (int64_t)m_midi_latency_frames;
+            if (frame > (int64_t)produced)
+            {
+                next = std::min(next, (uint64_t)frame);
+                break;
+            }
+            m_midi_queue.Pop(m_midi_message);
+            if (!m_emu.PostMIDI(m_midi_message))
+            {
+                WarnDroppedMIDI();
+            }
+        }
 
-    if (fe.m_chunk_first == fe.m_chunk_last)
-    {
-        fe.Finish<SampleT>();
-        fe.Prepare<SampleT>();
+        m_emu.RunUntilFrames(next - produced);
     }
 }
 
+template <typename SampleT, bool ApplyGain>
+void Instance::ReceiveSamplesSDL(void* userdata, std::span<const AudioFrame<int32_t>> in)
+{
+    Instance& fe = *(Instance*)userdata;
+
+    fe.WriteSamples<SampleT, ApplyGain>(in);
+}
+
 mcu_sample_callback Instance::PickSampleCallback(AudioOutputKind kind) const
 {
     if (kind == AudioOutputKind::SDL)
@@ -190,11 +212,11 @@ mcu_sample_callback Instance::PickSampleCallback(AudioOutputKind kind) const
             switch (m_format)
             {
             case AudioFormat::S16:
-                return ReceiveSampleSDL<int16_t, true>;
+                return ReceiveSamplesSDL<int16_t, true>;
             case AudioFormat::S32:
-                return ReceiveSampleSDL<int32_t, true>;
+                return ReceiveSamplesSDL<int32_t, true>;
             case AudioFormat::F32:
-                return ReceiveSampleSDL<float, true>;
+                return ReceiveSamplesSDL<float, true>;
             }
         }
         else
@@ -202,11 +224,11 @@ mcu_sample_callback Instance::PickSampleCallback(AudioOutputKind kind) const
             switch (m_format)
             {
             case AudioFormat::S16:
-                return ReceiveSampleSDL<int16_t, false>;
+                return ReceiveSamplesSDL<int16_t, false>;
             case AudioFormat::S32:
-                return ReceiveSampleSDL<int32_t, false>;
+                return ReceiveSamplesSDL<int32_t, false>;
             case AudioFormat::F32:
-                return ReceiveSampleSDL<float, false>;
+                return ReceiveSamplesSDL<float, false>;
             }
         }
     }
@@ -218,11 +240,11 @@ mcu_sample_callback Instance::PickSampleCallback(AudioOutputKind kind) const
             switch (m_format)
             {
             case AudioFormat::S16:
-                return ReceiveSampleASIO<int16_t, true>;
+                return ReceiveSamplesASIO<int16_t, true>;
             case AudioFormat::S32:
-                return ReceiveSampleASIO<int32_t, true>;
+                return ReceiveSamplesASIO<int32_t, true>;
             case AudioFormat::F32:
-                return ReceiveSampleASIO<float, true>;
+                return ReceiveSamplesASIO<float, true>;
             }
         }
         else
@@ -230,11 +252,11 @@ mcu_sample_callback Instance::PickSampleCallback(AudioOutputKind kind) const
             switch (m_format)
             {
             case AudioFormat::S16:
-                return ReceiveSampleASIO<int16_t, false>;
+                return ReceiveSamplesASIO<int16_t, false>;
             case AudioFormat::S32:
-                return ReceiveSampleASIO<int32_t, false>;
+                return ReceiveSamplesASIO<int32_t, false>;
             case AudioFormat::F32:
-                return ReceiveSampleASIO<float, false>;
+                return ReceiveSamplesASIO<float, false>;
             }
         }
 #else
@@ -249,24 +271,67 @@ mcu_sample_callback Instance::PickSampleCallback(AudioOutputKind kind) const
     return nullptr;
 }
 
+void Instance::PostMIDI(std::span<const uint8_t> bytes, MIDI_Clock::time_point time)
+{
+    const bool queued = m_schedule_midi ? m_midi_queue.Push(time, bytes) : m_emu.PostMIDI(bytes);
+    if (!queued)
+    {
+        WarnDroppedMIDI();
+    }
+}
+
+void Instance::WarnDroppedMIDI()
+{
+    // Once is enough; the totals are printed when the instance stops.
+    if (!m_midi_drop_warned.exchange(true, std::memory_order_relaxed))
+    {
+        fprintf(stderr, "#%02zu: WARNING: MIDI input queue is full; dropping messages\n", m_instance_id);
+    }
+}
+
+uint64_t Instance::GetDroppedMIDIBytes() const
+{
+    return m_emu.GetDroppedMIDIBytes() + m_midi_queue.GetDroppedBytes();
+}
+
 void Instance::OpenSDLAudio()
 {
     m_output_kind = AudioOutputKind::SDL;
-    m_emu.SetSampleCallback(PickSampleCallback(m_output_kind), this);
     switch (m_format)
     {
     case AudioFormat::S16:
-        CreateAndPrepareBuffer<int16_t>();
+        CreateBuffer<int16_t>();
         break;
     case AudioFormat::S32:
-        CreateAndPrepareBuffer<int32_t>();
+        CreateBuffer<int32_t>();
         break;
     case AudioFormat::F32:
-        CreateAndPrepareBuffer<float>();
+        CreateBuffer<float>();
         break;
     }
+    m_emu.SetSampleSink(m_raw_buffer, PickSampleCallback(m_output_kind), this);
+    m_frames_written = m_emu.GetMCU().frames_produced;
     Out_SDL_AddSource(m_view);
     fprintf(stderr, "#%02zu: allocated %zu bytes for audio\n", m_instance_id, m_sample_buffer.GetByteLength());
+
+    if (m_midi_latency_ms)
+    {
+        const uint32_t frequency = PCM_GetOutputFrequency(m_emu.GetPCM());
+        m_midi_latency_frames    = (uint64_t)*m_midi_latency_ms * frequency / 1000;
+        m_midi_queue.Init(MIDI_QUEUE_SIZE);
+        // the output consumes whole buffers at a time, so measurements are only accurate to about one buffer
+        m_midi_clock.Init(frequency, 2 * m_buffer_size);
+        m_schedule_midi = true;
+
+        const uint64_t queued_frames = (uint64_t)m_buffer_size * m_buffer_count;
+        if (m_midi_latency_frames < queued_frames)
+        {
+            fprintf(stderr,
+                    "WARNING: MIDI latency of %ums is less than the %llums of queued audio; events may be late\n",
+                    *m_midi_latency_ms,
+                    (unsigned long long)(queued_frames * 1000 / frequency));
+        }
+    }
 }
 
 #if NUKED_ENABLE_ASIO
@@ -281,20 +346,25 @@ void Instance::OpenASIOAudio()
     Out_ASIO_AddSource(m_stream);
 
     m_output_kind = AudioOutputKind::ASIO;
-    m_emu.SetSampleCallback(PickSampleCallback(m_output_kind), this);
+
+    if (m_midi_latency_ms)
+    {
+        fprintf(stderr, "WARNING: MIDI latency is not supported with ASIO output; playing MIDI as it arrives\n");
+    }
 
     switch (m_format)
     {
     case AudioFormat::S16:
-        CreateAndPrepareBuffer<int16_t>();
+        CreateBuffer<int16_t>();
         break;
     case AudioFormat::S32:
-        CreateAndPrepareBuffer<int32_t>();
+        CreateBuffer<int32_t>();
         break;
     case AudioFormat::F32:
-        CreateAndPrepareBuffer<float>();
+        CreateBuffer<float>();
         break;
     }
+    m_emu.SetSampleSink(m_raw_buffer, PickSampleCallback(m_output_kind), this);
     fprintf(stderr, "#%02zu: allocated %zu bytes for audio\n", m_instance_id, m_sample_buffer.GetByteLength());
 }
 #endif
@@ -331,6 +401,14 @@ void Instance::JoinThread()
 {
     m_running = false;
     m_thread.join();
+
+    if (const uint64_t dropped = GetDroppedMIDIBytes())
+    {
+        fprintf(stderr,
+                "#%02zu: dropped %" PRIu64 " MIDI bytes because the input queue was full\n",
+                m_instance_id,
+                dropped);
+    }
 }
 
 bool Instance::IsQuitRequested() const
@@ -2,10 +2,14 @@
 
 #include <cstddef>
 #include <filesystem>
+#include <optional>
+#include <span>
 #include <thread>
+#include <vector>
 
 #include "emu.h"
 #include "lcd_sdl.h"
+#include "midi_queue.h"
 #include "output_common.h"
 #include "ringbuffer.h"
 
@@ -21,10 +25,13 @@ struct InstanceParameters
     bool            enable_lcd;
     bool            enable_oversampling;
 
+    // If set, MIDI input is played this long after it was received instead of as soon as possible.
+    std::optional<uint32_t> midi_latency_ms;
+
     std::filesystem::path nvram_filename;
 
-    const AllRomsetInfo* romset_info;
-    Romset               romset;
+    // Shared by every instance.
+    std::shared_ptr<const EMU_RomImage> rom_image;
 };
 
 class Instance
@@ -45,6 +52,12 @@ public:
         return m_emu;
     }
 
+    // Called from the MIDI input thread. `time` is when the message was received.
+    void PostMIDI(std::span<const uint8_t> bytes, MIDI_Clock::time_point time);
+
+    // Returns the number of MIDI bytes dropped so far because the latency queue or the emulator's queue was full.
+    uint64_t GetDroppedMIDIBytes() const;
+
     void OpenSDLAudio();
 
 #if NUKED_ENABLE_ASIO
@@ -60,27 +73,32 @@ public:
 
 private:
     template <typename SampleT>
-    void Prepare();
+    void CreateBuffer();
 
-    template <typename SampleT>
-    void Finish();
-
-    template <typename SampleT>
-    void CreateAndPrepareBuffer();
+    // Normalizes a block of raw frames into the next ringbuffer slot.
+    template <typename SampleT, bool ApplyGain>
+    void WriteSamples(std::span<const AudioFrame<int32_t>> in);
 
     mcu_sample_callback PickSampleCallback(AudioOutputKind kind) const;
 
+    // Prints a warning the first time MIDI input is dropped. Called from either the MIDI input or the instance thread.
+    void WarnDroppedMIDI();
+
     template <typename SampleT>
     static void RunInstanceSDL(Instance& self);
 
+    // Runs one buffer worth of frames, posting scheduled MIDI messages at the frames they map to.
+    template <typename SampleT>
+    void RunScheduledBuffer();
+
     template <typename SampleT, bool ApplyGain>
-    static void ReceiveSampleSDL(void* userdata, const AudioFrame<int32_t>& in);
+    static void ReceiveSamplesSDL(void* userdata, std::span<const AudioFrame<int32_t>> in);
 
 #if NUKED_ENABLE_ASIO
     static void RunInstanceASIO(Instance& self);
 
     template <typename SampleT, bool ApplyGain>
-    static void ReceiveSampleASIO(void* userdata, const AudioFrame<int32_t>& in);
+    static void ReceiveSamplesASIO(void* userdata, std::span<const AudioFrame<int32_t>> in);
 #endif
 
 private:
@@ -92,8 +110,9 @@ private:
 
     GenericBuffer  m_sample_buffer;
     RingbufferView m_view;
-    void*          m_chunk_first = nullptr;
-    void*          m_chunk_last  = nullptr;
+
+    // The emulator writes raw frames here before they're normalized into m_sample_buffer.
+    std::vector<AudioFrame<int32_t>> m_raw_buffer;
 
     std::thread m_thread;
     AudioFormat m_format;
@@ -106,6 +125,21 @@ private:
 
     float m_gain = 1.0f;
 
+    std::optional<uint32_t> m_midi_latency_ms;
+
+    // Only used with SDL output when a MIDI latency is set. The queue is written by the MIDI input thread; everything
+    // else is owned by the instance thread.
+    bool                 m_schedule_midi = false;
+    MIDI_ScheduleQueue   m_midi_queue;
+    MIDI_SampleClock     m_midi_clock;
+    uint64_t             m_midi_latency_frames = 0;
+    std::vector<uint8_t> m_midi_message;
+    // Frames written to m_view so far.
+    uint64_t m_frames_written = 0;
+
+    // Set once WarnDroppedMIDI has printed its warning.
+    std::atomic<bool> m_midi_drop_warned = false;
+
 #if NUKED_ENABLE_ASIO
     // ASIO uses an SDL_AudioStream because it needs resampling to a more conventional frequency, but putting data into
     // the stream one frame at a time is *slow* so we buffer audio in `sample_buffer` and add it all at once.
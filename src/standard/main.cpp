@@ -89,6 +89,7 @@ Audio options:
   -f, --format       s16|s32|f32                Set output format.
   --disable-oversampling                        Halves output frequency.
   --gain <amount>                               Apply gain to the output.
+  --midi-latency <ms>                           Play MIDI input at a fixed delay after it's received.
 
 Emulator options:
   -r, --reset     none|gs|gm                    Reset system in GS or GM mode.
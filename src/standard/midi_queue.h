@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+using MIDI_Clock = std::chrono::steady_clock;
+
+// Single producer, single consumer queue of timestamped MIDI messages. The MIDI input thread pushes messages as they
+// arrive and the emulator thread pops them once the emulated sample clock reaches their time.
+class MIDI_ScheduleQueue
+{
+public:
+    // `size_bytes` must be a power of two. Each message occupies its size plus a small header.
+    void Init(size_t size_bytes)
+    {
+        m_buffer.assign(size_bytes, 0);
+        m_read_ptr  = 0;
+        m_write_ptr = 0;
+    }
+
+    // Producer side. Queues `bytes` as a single message; if there isn't enough room for all of it, nothing is queued
+    // and the bytes are counted in GetDroppedBytes. Returns false in the latter case.
+    bool Push(MIDI_Clock::time_point time, std::span<const uint8_t> bytes)
+    {
+        const uint64_t write_ptr = m_write_ptr.load(std::memory_order_relaxed);
+        const uint64_t read_ptr  = m_read_ptr.load(std::memory_order_acquire);
+        if (sizeof(Header) + bytes.size() > m_buffer.size() - (write_ptr - read_ptr))
+        {
+            m_dropped_bytes.fetch_add(bytes.size(), std::memory_order_relaxed);
+            return false;
+        }
+
+        const Header header{time.time_since_epoch().count(), (uint32_t)bytes.size()};
+        CopyIn(write_ptr, &header, sizeof(Header));
+        CopyIn(write_ptr + sizeof(Header), bytes.data(), bytes.size());
+        m_write_ptr.store(write_ptr + sizeof(Header) + bytes.size(), std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Reads the time of the first message without removing it. Returns false if the queue is empty.
+    bool PeekTime(MIDI_Clock::time_point& time) const
+    {
+        const uint64_t read_ptr = m_read_ptr.load(std::memory_order_relaxed);
+        if (m_write_ptr.load(std::memory_order_acquire) == read_ptr)
+        {
+            return false;
+        }
+
+        Header header;
+        CopyOut(read_ptr, &header, sizeof(Header));
+        time = MIDI_Clock::time_point(MIDI_Clock::duration(header.time));
+        return true;
+    }
+
+    // Consumer side. Removes the first message and replaces the contents of `out` with its bytes.
+    // Precondition: PeekTime returned true.
+    void Pop(std::vector<uint8_t>& out)
+    {
+        const uint64_t read_ptr = m_read_ptr.load(std::memory_order_relaxed);
+
+        Header header;
+        CopyOut(read_ptr, &header, sizeof(Header));
+        out.resize(header.size);
+        CopyOut(read_ptr + sizeof(Header), out.data(), header.size);
+        m_read_ptr.store(read_ptr + sizeof(Header) + header.size, std::memory_order_release);
+    }
+
+    uint64_t GetDroppedBytes() const
+    {
+        return m_dropped_bytes.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Header
+    {
+        MIDI_Clock::rep time;
+        uint32_t        size;
+    };
+
+    // Copies in up to two parts around the end of the buffer.
+    void CopyIn(uint64_t ptr, const void* src, size_t size)
+    {
+        const size_t offset = (size_t)ptr & (m_buffer.size() - 1);
+        const size_t first  = std::min(size, m_buffer.size() - offset);
+        memcpy(m_buffer.data() + offset, src, first);
+        memcpy(m_buffer.data(), (const uint8_t*)src + first, size - first);
+    }
+
+    void CopyOut(uint64_t ptr, void* dest, size_t size) const
+    {
+        const size_t offset = (size_t)ptr & (m_buffer.size() - 1);
+        const size_t first  = std::min(size, m_buffer.size() - offset);
+        memcpy(dest, m_buffer.data() + offset, first);
+        memcpy((uint8_t*)dest + first, m_buffer.data(), size - first);
+    }
+
+private:
+    std::vector<uint8_t>  m_buffer;
+    std::atomic<uint64_t> m_read_ptr      = 0;
+    std::atomic<uint64_t> m_write_ptr     = 0;
+    std::atomic<uint64_t> m_dropped_bytes = 0;
+};
+
+// Maps host time to emulated frames, following the position the audio device has played up to. The device consumes
+// frames in whole buffers, so the position only advances in steps; the mapping extrapolates linearly from an anchor
+// and is only pulled towards measurements slowly so that it doesn't inherit that jitter. It's re-anchored outright if
+// the two drift apart by more than `max_error` frames, e.g. after an underrun.
+class MIDI_SampleClock
+{
+public:
+    void Init(uint32_t frequency, uint32_t max_error)
+    {
+        m_frequency = frequency;
+        m_max_error = max_error;
+        m_anchored  = false;
+    }
+
+    // `played` is the number of frames the audio device had consumed at `now`.
+    void Update(MIDI_Clock::time_point now, uint64_t played)
+    {
+        const int64_t error = (int64_t)played - FrameAt(now);
+        if (!m_anchored || error > (int64_t)m_max_error || error < -(int64_t)m_max_error)
+        {
+            m_anchor_time  = now;
+            m_anchor_frame = (int64_t)played;
+            m_anchored     = true;
+            return;
+        }
+        m_anchor_frame += error / 16;
+    }
+
+    // Returns the frame being played at `time`. May be negative or earlier than frames already played.
+    int64_t FrameAt(MIDI_Clock::time_point time) const
+    {
+        // split into whole seconds first so that long running sessions don't overflow
+        const int64_t ns      = std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_anchor_time).count();
+        const int64_t seconds = ns / 1000000000;
+        const int64_t rest    = ns % 1000000000;
+        return m_anchor_frame + seconds * m_frequency + rest * m_frequency / 1000000000;
+    }
+
+private:
+    MIDI_Clock::time_point m_anchor_time{};
+    int64_t                m_anchor_frame = 0;
+    uint32_t               m_frequency    = 0;
+    uint32_t               m_max_error    = 0;
+    bool                   m_anchored     = false;
+};
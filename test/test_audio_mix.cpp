@@ -0,0 +1,184 @@
+#include "backend/audio.h"
+#include "renderer/audio_mix.h"
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <vector>
+
+// Sums `streams` into a fresh accumulator with MixAccumulate.
+static std::vector<int64_t> Accumulate(const std::vector<std::vector<int32_t>>& streams)
+{
+    std::vector<int64_t> acc(streams[0].size(), 0);
+    for (const auto& stream : streams)
+    {
+        MixAccumulate(acc.data(), stream.data(), acc.size());
+    }
+    return acc;
+}
+
+TEST_CASE("Mixing sums in a wide accumulator")
+{
+    // Lengths that aren't a multiple of any vector width exercise the scalar tails.
+    std::mt19937 rng(1234);
+    for (size_t count : {0, 1, 3, 7, 8, 15, 16, 17, 31, 33, 100, 4099})
+    {
+        for (size_t stream_count : {1, 2, 5, 16})
+        {
+            std::vector<std::vector<int32_t>> streams(stream_count, std::vector<int32_t>(count));
+            for (auto& stream : streams)
+            {
+                for (auto& sample : stream)
+                {
+                    // full scale so that sums leave the range of int32
+                    sample = (int32_t)rng();
+                }
+            }
+
+            const std::vector<int64_t> acc = Accumulate(streams);
+            for (size_t i = 0; i < count; ++i)
+            {
+                int64_t sum = 0;
+                for (const auto& stream : streams)
+                {
+                    sum += stream[i];
+                }
+                REQUIRE(acc[i] == sum);
+            }
+        }
+    }
+}
+
+// A single instance that doesn't clip during normalization must come out exactly as Normalize followed by Scale. The
+// renderer only ever scaled when gain != 1.
+template <typename T>
+static void CheckSingleInstance(float gain)
+{
+    std::mt19937                           rng(5678);
+    std::uniform_int_distribution<int32_t> dist(-(1 << 30), (1 << 30) - 1);
+
+    std::vector<AudioFrame<int32_t>> raw(1001);
+    for (auto& frame : raw)
+    {
+        frame.left  = dist(rng);
+        frame.right = dist(rng);
+    }
+
+    std::vector<AudioFrame<T>> expected(raw.size());
+    NormalizeBlock(std::span<const AudioFrame<int32_t>>(raw), std::span<AudioFrame<T>>(expected));
+    if (gain != 1.0f)
+    {
+        ScaleBlock(std::span<AudioFrame<T>>(expected), gain);
+    }
+
+    std::vector<int64_t> acc(raw.size() * 2, 0);
+    MixAccumulate(acc.data(), (const int32_t*)raw.data(), acc.size());
+    std::vector<AudioFrame<T>> out(raw.size());
+    MixNormalize((T*)out.data(), acc.data(), acc.size(), gain);
+
+    for (size_t i = 0; i < raw.size(); ++i)
+    {
+        REQUIRE(out[i].left == expected[i].left);
+        REQUIRE(out[i].right == expected[i].right);
+    }
+}
+
+TEST_CASE("Mixing one instance matches Normalize and Scale")
+{
+    for (float gain : {1.0f, 0.5f, 0.3f, 2.0f, 8.0f})
+    {
+        CheckSingleInstance<int16_t>(gain);
+        CheckSingleInstance<int32_t>(gain);
+        CheckSingleInstance<float>(gain);
+    }
+}
+
+TEST_CASE("Mixing one instance that clips differs from Normalize and Scale")
+{
+    // Normalize used to clamp each instance before Scale applied the gain. The mix now applies the gain to the
+    // unclamped value, so a loud instance turned down by the gain keeps its level instead of clipping first.
+    const std::vector<int64_t> acc = Accumulate({std::vector<int32_t>(5, 40000 << 15)});
+
+    std::vector<AudioFrame<int32_t>> raw(1, AudioFrame<int32_t>{40000 << 15, 40000 << 15});
+    std::vector<AudioFrame<int16_t>> old_path(1);
+    NormalizeBlock(std::span<const AudioFrame<int32_t>>(raw), std::span<AudioFrame<int16_t>>(old_path));
+    ScaleBlock(std::span<AudioFrame<int16_t>>(old_path), 0.5f);
+    REQUIRE(old_path[0].left == INT16_MAX / 2);
+
+    std::vector<int16_t> s16(5);
+    MixNormalize(s16.data(), acc.data(), acc.size(), 0.5f);
+    REQUIRE(s16 == std::vector<int16_t>(5, 20000));
+
+    // 3 << 29 normalizes to 3 << 30, which is out of range for int32
+    const std::vector<int64_t> loud = Accumulate({std::vector<int32_t>(5, 3 << 29)});
+    std::vector<int32_t>       s32(5);
+    MixNormalize(s32.data(), loud.data(), loud.size(), 0.5f);
+    REQUIRE(s32 == std::vector<int32_t>(5, 3 << 29));
+}
+
+TEST_CASE("Mixing only clips the final sum")
+{
+    // Normalizing or saturating each instance would clip the first two streams before the third brings the sum back
+    // in range.
+    const std::vector<std::vector<int32_t>> streams = {
+        std::vector<int32_t>(19, 30000 << 15),
+        std::vector<int32_t>(19, 30000 << 15),
+        std::vector<int32_t>(19, -30000 << 15),
+    };
+    const std::vector<int64_t> acc = Accumulate(streams);
+
+    std::vector<int16_t> s16(19);
+    MixNormalize(s16.data(), acc.data(), acc.size(), 1.0f);
+    REQUIRE(s16 == std::vector<int16_t>(19, 30000));
+
+    std::vector<int32_t> s32(19);
+    MixNormalize(s32.data(), acc.data(), acc.size(), 1.0f);
+    REQUIRE(s32 == std::vector<int32_t>(19, 30000 << 16));
+
+    // ...and the final sum is clipped
+    const std::vector<int64_t> loud = Accumulate({streams[0], streams[1]});
+    MixNormalize(s16.data(), loud.data(), loud.size(), 1.0f);
+    REQUIRE(s16 == std::vector<int16_t>(19, INT16_MAX));
+    MixNormalize(s32.data(), loud.data(), loud.size(), 1.0f);
+    REQUIRE(s32 == std::vector<int32_t>(19, INT32_MAX));
+}
+
+TEST_CASE("Mixing applies gain before clipping")
+{
+    // Two instances that would clip together are brought back in range by the gain.
+    const std::vector<std::vector<int32_t>> streams = {
+        std::vector<int32_t>(9, 30000 << 15),
+        std::vector<int32_t>(9, 30000 << 15),
+    };
+    const std::vector<int64_t> acc = Accumulate(streams);
+
+    std::vector<int16_t> s16(9);
+    MixNormalize(s16.data(), acc.data(), acc.size(), 0.5f);
+    REQUIRE(s16 == std::vector<int16_t>(9, 30000));
+
+    std::vector<int32_t> s32(9);
+    MixNormalize(s32.data(), acc.data(), acc.size(), 0.5f);
+    REQUIRE(s32 == std::vector<int32_t>(9, 30000 << 16));
+
+    // A negative sum clips to the minimum
+    const std::vector<int64_t> quiet = Accumulate({std::vector<int32_t>(9, -20000 << 15)});
+    MixNormalize(s16.data(), quiet.data(), quiet.size(), 4.0f);
+    REQUIRE(s16 == std::vector<int16_t>(9, INT16_MIN));
+    MixNormalize(s32.data(), quiet.data(), quiet.size(), 4.0f);
+    REQUIRE(s32 == std::vector<int32_t>(9, INT32_MIN));
+}
+
+TEST_CASE("Mixing floats")
+{
+    const std::vector<std::vector<int32_t>> streams = {
+        std::vector<int32_t>(37, 1 << 29),
+        std::vector<int32_t>(37, 1 << 29),
+        std::vector<int32_t>(37, 1 << 28),
+    };
+    const std::vector<int64_t> acc = Accumulate(streams);
+
+    // float output is left unclipped
+    std::vector<float> out(37);
+    MixNormalize(out.data(), acc.data(), acc.size(), 1.0f);
+    REQUIRE(out == std::vector<float>(37, 2.5f));
+    MixNormalize(out.data(), acc.data(), acc.size(), 0.5f);
+    REQUIRE(out == std::vector<float>(37, 1.25f));
+}
@@ -0,0 +1,192 @@
+#include "renderer/batch.h"
+#include <catch2/catch_test_macros.hpp>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+// Scratch directory that is removed again at the end of the test.
+class TempDir
+{
+public:
+    TempDir()
+    {
+        std::random_device rd;
+        m_path = fs::temp_directory_path() / ("nuked-sc55-test-" + std::to_string(rd()));
+        fs::create_directories(m_path);
+    }
+
+    ~TempDir()
+    {
+        std::error_code ec;
+        fs::remove_all(m_path, ec);
+    }
+
+    const fs::path& Path() const
+    {
+        return m_path;
+    }
+
+    fs::path Touch(const fs::path& relative, std::string_view contents = {}) const
+    {
+        const fs::path path = m_path / relative;
+        fs::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << contents;
+        return path;
+    }
+
+private:
+    fs::path m_path;
+};
+
+TEST_CASE("Batch output paths")
+{
+    // A template without {name} is a directory
+    REQUIRE(R_MakeOutputPath("out", "in/song.mid", false) == fs::path("out") / "song.wav");
+    REQUIRE(R_MakeOutputPath("out", "in/song.mid", true) == fs::path("out") / "song.flac");
+    REQUIRE(R_MakeOutputPath("out", "in/song.tar.mid", false) == fs::path("out") / "song.tar.wav");
+
+    // Every {name} is replaced, and the extension comes from the template
+    REQUIRE(R_MakeOutputPath("out/{name}.wav", "in/song.mid", false) == fs::path("out/song.wav"));
+    REQUIRE(R_MakeOutputPath("{name}/{name}-sc55.flac", "song.midi", true) == fs::path("song/song-sc55.flac"));
+    REQUIRE(R_MakeOutputPath("{name}", "a/b/c.mid", false) == fs::path("c"));
+    REQUIRE(R_MakeOutputPath("x{name", "c.mid", false) == fs::path("x{name") / "c.wav");
+}
+
+TEST_CASE("Batch midi filenames")
+{
+    REQUIRE(R_IsMidiFilename("a.mid"));
+    REQUIRE(R_IsMidiFilename("a.MID"));
+    REQUIRE(R_IsMidiFilename("a.Midi"));
+    REQUIRE(!R_IsMidiFilename("a.wav"));
+    REQUIRE(!R_IsMidiFilename("mid"));
+    REQUIRE(!R_IsMidiFilename("a.mid.txt"));
+}
+
+TEST_CASE("Batch mode detection")
+{
+    TempDir dir;
+
+    const fs::path a = dir.Touch("in/a.mid");
+    const fs::path b = dir.Touch("in/b.mid");
+
+    // A single file with a plain output filename is rendered directly
+    REQUIRE(!R_IsBatch(std::vector<fs::path>{a}, {}, "out.wav"));
+    REQUIRE(!R_IsBatch(std::vector<fs::path>{a}, {}, "-"));
+
+    REQUIRE(R_IsBatch(std::vector<fs::path>{a, b}, {}, "out"));
+    REQUIRE(R_IsBatch(std::vector<fs::path>{dir.Path() / "in"}, {}, "out"));
+    REQUIRE(R_IsBatch(std::vector<fs::path>{a}, dir.Path() / "list.txt", "out"));
+
+    // A template needs expanding even for a single input
+    REQUIRE(R_IsBatch(std::vector<fs::path>{a}, {}, "out/{name}.wav"));
+
+    std::vector<R_BatchJob> jobs;
+    const std::string out_template = (dir.Path() / "out/{name}.wav").generic_string();
+    REQUIRE(R_CollectBatchJobs(std::vector<fs::path>{a}, {}, out_template, false, jobs));
+    REQUIRE(jobs.size() == 1);
+    REQUIRE(jobs[0].input == a);
+    REQUIRE(jobs[0].output == dir.Path() / "out/a.wav");
+}
+
+TEST_CASE("Batch manifest parsing")
+{
+    TempDir dir;
+
+    const fs::path manifest = dir.Touch("list/manifest.txt",
+                                        "# comment\n"
+                                        "\n"
+                                        "one.mid\n"
+                                        "sub/two.mid\r\n"
+                                        "#skipped.mid\n"
+                                        "three.mid");
+
+    std::vector<fs::path> inputs;
+    REQUIRE(R_ReadManifest(manifest, inputs));
+
+    // Relative to the manifest, in file order
+    REQUIRE(inputs.size() == 3);
+    REQUIRE(inputs[0] == manifest.parent_path() / "one.mid");
+    REQUIRE(inputs[1] == manifest.parent_path() / "sub/two.mid");
+    REQUIRE(inputs[2] == manifest.parent_path() / "three.mid");
+
+    // Appends to what's already there
+    REQUIRE(R_ReadManifest(manifest, inputs));
+    REQUIRE(inputs.size() == 6);
+
+    REQUIRE(!R_ReadManifest(dir.Path() / "missing.txt", inputs));
+}
+
+TEST_CASE("Batch job collection")
+{
+    TempDir dir;
+
+    const fs::path a   = dir.Touch("in/a.mid");
+    const fs::path b   = dir.Touch("in/b.MIDI");
+    const fs::path c   = dir.Touch("other/c.mid");
+    const fs::path out = dir.Path() / "out";
+    dir.Touch("in/notes.txt");
+
+    SECTION("Directories expand to their midi files in sorted order")
+    {
+        const std::vector<fs::path> inputs = {c, dir.Path() / "in"};
+
+        std::vector<R_BatchJob> jobs;
+        REQUIRE(R_CollectBatchJobs(inputs, {}, out.generic_string(), false, jobs));
+        REQUIRE(jobs.size() == 3);
+        REQUIRE(jobs[0].input == c);
+        REQUIRE(jobs[0].output == out / "c.wav");
+        REQUIRE(jobs[1].input == a);
+        REQUIRE(jobs[1].output == out / "a.wav");
+        REQUIRE(jobs[2].input == b);
+        REQUIRE(jobs[2].output == out / "b.wav");
+    }
+
+    SECTION("Manifest entries follow the command line inputs")
+    {
+        const fs::path manifest = dir.Touch("list.txt", "other/c.mid\n");
+        const std::vector<fs::path> inputs = {a};
+
+        std::vector<R_BatchJob> jobs;
+        REQUIRE(R_CollectBatchJobs(inputs, manifest, (out / "{name}.flac").generic_string(), true, jobs));
+        REQUIRE(jobs.size() == 2);
+        REQUIRE(jobs[0].input == a);
+        REQUIRE(jobs[0].output == out / "a.flac");
+        REQUIRE(jobs[1].input == dir.Path() / "other/c.mid");
+        REQUIRE(jobs[1].output == out / "c.flac");
+    }
+
+    SECTION("Missing inputs fail")
+    {
+        const std::vector<fs::path> inputs = {a, dir.Path() / "missing.mid"};
+
+        std::vector<R_BatchJob> jobs;
+        REQUIRE(!R_CollectBatchJobs(inputs, {}, out.generic_string(), false, jobs));
+    }
+
+    SECTION("A missing manifest fails")
+    {
+        const std::vector<fs::path> inputs = {a};
+
+        std::vector<R_BatchJob> jobs;
+        REQUIRE(!R_CollectBatchJobs(inputs, dir.Path() / "missing.txt", out.generic_string(), false, jobs));
+    }
+
+    SECTION("Nothing to render fails")
+    {
+        const std::vector<fs::path> inputs = {dir.Path() / "other" / "empty"};
+        fs::create_directories(inputs[0]);
+
+        std::vector<R_BatchJob> jobs;
+        REQUIRE(!R_CollectBatchJobs(inputs, {}, out.generic_string(), false, jobs));
+    }
+
+    SECTION("Two inputs rendering to the same file fail")
+    {
+        const fs::path other_a = dir.Touch("other/a.mid");
+        const std::vector<fs::path> inputs = {a, other_a};
+
+        std::vector<R_BatchJob> jobs;
+        REQUIRE(!R_CollectBatchJobs(inputs, {}, out.generic_string(), false, jobs));
+    }
+}
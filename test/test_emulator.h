@@ -0,0 +1,20 @@
+// Emulator setup shared by tests that drive the backend directly.
+
+#pragma once
+
+#include "backend/emu.h"
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+
+// Creates an emulator and brings it to the state after reset. Roms that `info` doesn't provide read as zeroes, which is
+// enough for tests that poke at the state directly or run a small program from one rom.
+inline std::unique_ptr<Emulator> CreateTestEmulator(Romset               romset  = Romset::MK2,
+                                                    const EMU_Options&   options = {},
+                                                    const AllRomsetInfo& info    = AllRomsetInfo())
+{
+    auto emu = std::make_unique<Emulator>();
+    REQUIRE(emu->Init(options));
+    REQUIRE(emu->LoadRoms(romset, info));
+    emu->Reset();
+    return emu;
+}
@@ -0,0 +1,537 @@
+#include "renderer/flac.h"
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <fstream>
+#include <random>
+
+// Minimal FLAC decoder covering what FLAC_Handle produces: 16-bit stereo, every subframe type and rice partitioned
+// residuals. Every frame's CRC-8 and CRC-16 is checked.
+
+static uint8_t Crc8(const uint8_t* bytes, size_t count)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (uint8_t)((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t Crc16(const uint8_t* bytes, size_t count)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        crc ^= (uint16_t)(bytes[i] << 8);
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+class BitReader
+{
+public:
+    explicit BitReader(const std::vector<uint8_t>& bytes)
+        : m_bytes(bytes)
+    {
+    }
+
+    uint32_t Read(uint32_t count)
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (m_pos / 8 >= m_bytes.size())
+            {
+                FAIL("read past the end of the stream");
+            }
+            value = (value << 1) | ((m_bytes[m_pos / 8] >> (7 - m_pos % 8)) & 1);
+            ++m_pos;
+        }
+        return value;
+    }
+
+    int32_t ReadSigned(uint32_t count)
+    {
+        const uint32_t value = Read(count);
+        const uint32_t sign  = 1u << (count - 1);
+        return (int32_t)((value ^ sign) - sign);
+    }
+
+    uint32_t ReadUnary()
+    {
+        uint32_t zeroes = 0;
+        while (Read(1) == 0)
+        {
+            ++zeroes;
+        }
+        return zeroes;
+    }
+
+    int32_t ReadRice(uint32_t param)
+    {
+        const uint32_t u = (ReadUnary() << param) | Read(param);
+        return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+    }
+
+    uint64_t ReadUtf8()
+    {
+        const uint32_t lead = Read(8);
+        if ((lead & 0x80) == 0)
+        {
+            return lead;
+        }
+        uint32_t continuation = 0;
+        while (lead & (0x40 >> continuation))
+        {
+            ++continuation;
+        }
+        uint64_t value = lead & (0x3f >> continuation);
+        for (uint32_t i = 0; i < continuation; ++i)
+        {
+            const uint32_t byte = Read(8);
+            REQUIRE((byte & 0xc0) == 0x80);
+            value = (value << 6) | (byte & 0x3f);
+        }
+        return value;
+    }
+
+    void AlignToByte()
+    {
+        m_pos = (m_pos + 7) & ~(size_t)7;
+    }
+
+    size_t BytePos() const
+    {
+        REQUIRE(m_pos % 8 == 0);
+        return m_pos / 8;
+    }
+
+    bool AtEnd() const
+    {
+        return m_pos == m_bytes.size() * 8;
+    }
+
+private:
+    const std::vector<uint8_t>& m_bytes;
+    size_t                      m_pos = 0;
+};
+
+struct DecodedFlac
+{
+    uint32_t                         sample_rate  = 0;
+    uint64_t                         total_frames = 0;
+    std::vector<AudioFrame<int16_t>> frames;
+    // Number of subframes of each type: constant, verbatim, fixed, lpc
+    size_t subframe_types[4]{};
+    std::vector<size_t> block_sizes;
+};
+
+static void DecodeResidual(BitReader& reader, uint32_t block_size, uint32_t order, int32_t* out)
+{
+    const uint32_t method = reader.Read(2);
+    REQUIRE(method <= 1);
+    const uint32_t param_bits      = method == 0 ? 4 : 5;
+    const uint32_t partition_order = reader.Read(4);
+    REQUIRE(block_size % (1u << partition_order) == 0);
+
+    size_t pos = order;
+    for (uint32_t p = 0; p < (1u << partition_order); ++p)
+    {
+        const uint32_t param = reader.Read(param_bits);
+        REQUIRE(param != (1u << param_bits) - 1); // escape code, never written
+        const uint32_t count = (block_size >> partition_order) - (p == 0 ? order : 0);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            out[pos++] = reader.ReadRice(param);
+        }
+    }
+    REQUIRE(pos == block_size);
+}
+
+static void DecodeSubframe(BitReader& reader, uint32_t block_size, uint32_t bps, DecodedFlac& result, int32_t* out)
+{
+    REQUIRE(reader.Read(1) == 0);
+    const uint32_t type = reader.Read(6);
+    REQUIRE(reader.Read(1) == 0); // wasted bits
+
+    if (type == 0)
+    {
+        ++result.subframe_types[0];
+        const int32_t value = reader.ReadSigned(bps);
+        std::fill(out, out + block_size, value);
+    }
+    else if (type == 1)
+    {
+        ++result.subframe_types[1];
+        for (uint32_t i = 0; i < block_size; ++i)
+        {
+            out[i] = reader.ReadSigned(bps);
+        }
+    }
+    else if ((type & 0b111000) == 0b001000)
+    {
+        ++result.subframe_types[2];
+        const uint32_t order = type & 0b111;
+        REQUIRE(order <= 4);
+        for (uint32_t i = 0; i < order; ++i)
+        {
+            out[i] = reader.ReadSigned(bps);
+        }
+        DecodeResidual(reader, block_size, order, out);
+        for (uint32_t i = order; i < block_size; ++i)
+        {
+            int64_t prediction = 0;
+            switch (order)
+            {
+            case 1:
+                prediction = out[i - 1];
+                break;
+            case 2:
+                prediction = 2 * (int64_t)out[i - 1] - out[i - 2];
+                break;
+            case 3:
+                prediction = 3 * (int64_t)out[i - 1] - 3 * (int64_t)out[i - 2] + out[i - 3];
+                break;
+            case 4:
+                prediction = 4 * (int64_t)out[i - 1] - 6 * (int64_t)out[i - 2] + 4 * (int64_t)out[i - 3] - out[i - 4];
+                break;
+            }
+            out[i] = (int32_t)(out[i] + prediction);
+        }
+    }
+    else if (type & 0b100000)
+    {
+        ++result.subframe_types[3];
+        const uint32_t order = (type & 0b11111) + 1;
+        for (uint32_t i = 0; i < order; ++i)
+        {
+            out[i] = reader.ReadSigned(bps);
+        }
+        const uint32_t precision = reader.Read(4) + 1;
+        const int32_t  shift     = reader.ReadSigned(5);
+        REQUIRE(shift >= 0);
+        int32_t coeffs[32];
+        for (uint32_t i = 0; i < order; ++i)
+        {
+            coeffs[i] = reader.ReadSigned(precision);
+        }
+        DecodeResidual(reader, block_size, order, out);
+        for (uint32_t i = order; i < block_size; ++i)
+        {
+            int64_t sum = 0;
+            for (uint32_t j = 0; j < order; ++j)
+            {
+                sum += (int64_t)coeffs[j] * out[i - 1 - j];
+            }
+            out[i] = (int32_t)(out[i] + (sum >> shift));
+        }
+    }
+    else
+    {
+        FAIL("reserved subframe type " << type);
+    }
+}
+
+static DecodedFlac DecodeFlac(const std::vector<uint8_t>& bytes)
+{
+    DecodedFlac result;
+    BitReader   reader(bytes);
+
+    REQUIRE(reader.Read(32) == 0x664c6143); // fLaC
+    REQUIRE(reader.Read(1) == 1);           // last metadata block
+    REQUIRE(reader.Read(7) == 0);           // STREAMINFO
+    REQUIRE(reader.Read(24) == 34);
+    REQUIRE(reader.Read(16) == FLAC_Handle::BLOCK_SIZE);
+    REQUIRE(reader.Read(16) == FLAC_Handle::BLOCK_SIZE);
+    const uint32_t min_frame_size = reader.Read(24);
+    const uint32_t max_frame_size = reader.Read(24);
+    result.sample_rate            = reader.Read(20);
+    REQUIRE(reader.Read(3) == 1); // stereo
+    REQUIRE(reader.Read(5) == 15); // 16 bits
+    result.total_frames = (uint64_t)reader.Read(4) << 32;
+    result.total_frames |= reader.Read(32);
+    reader.Read(32);
+    reader.Read(32);
+    reader.Read(32);
+    reader.Read(32);
+
+    std::vector<int32_t> channels[2];
+    for (uint64_t frame_number = 0; !reader.AtEnd(); ++frame_number)
+    {
+        const size_t start = reader.BytePos();
+
+        REQUIRE(reader.Read(16) == 0xfff8);
+        const uint32_t block_size_code  = reader.Read(4);
+        const uint32_t sample_rate_code = reader.Read(4);
+        const uint32_t assignment       = reader.Read(4);
+        REQUIRE(reader.Read(3) == 0b100); // 16 bits
+        REQUIRE(reader.Read(1) == 0);
+        REQUIRE(reader.ReadUtf8() == frame_number);
+
+        uint32_t block_size = 0;
+        if (block_size_code == 0b1100)
+        {
+            block_size = 4096;
+        }
+        else if (block_size_code == 0b0110)
+        {
+            block_size = reader.Read(8) + 1;
+        }
+        else if (block_size_code == 0b0111)
+        {
+            block_size = reader.Read(16) + 1;
+        }
+        else
+        {
+            FAIL("unexpected block size code " << block_size_code);
+        }
+
+        uint32_t sample_rate = 0;
+        switch (sample_rate_code)
+        {
+        case 0b0000:
+            sample_rate = result.sample_rate;
+            break;
+        case 0b1000:
+            sample_rate = 32000;
+            break;
+        case 0b1001:
+            sample_rate = 44100;
+            break;
+        case 0b1010:
+            sample_rate = 48000;
+            break;
+        case 0b1101:
+            sample_rate = reader.Read(16);
+            break;
+        case 0b1110:
+            sample_rate = reader.Read(16) * 10;
+            break;
+        default:
+            FAIL("unexpected sample rate code " << sample_rate_code);
+        }
+        REQUIRE(sample_rate == result.sample_rate);
+
+        const size_t header_end = reader.BytePos();
+        REQUIRE(reader.Read(8) == Crc8(&bytes[start], header_end - start));
+
+        const bool first_is_side  = assignment == 0b1001;
+        const bool second_is_side = assignment == 0b1000 || assignment == 0b1010;
+        REQUIRE((assignment == 0b0001 || first_is_side || second_is_side));
+
+        channels[0].resize(block_size);
+        channels[1].resize(block_size);
+        DecodeSubframe(reader, block_size, first_is_side ? 17 : 16, result, channels[0].data());
+        DecodeSubframe(reader, block_size, second_is_side ? 17 : 16, result, channels[1].data());
+
+        reader.AlignToByte();
+        const size_t frame_end = reader.BytePos();
+        REQUIRE(reader.Read(16) == Crc16(&bytes[start], frame_end - start));
+
+        const uint32_t frame_size = (uint32_t)(frame_end + 2 - start);
+        REQUIRE(frame_size >= min_frame_size);
+        REQUIRE(frame_size <= max_frame_size);
+
+        for (uint32_t i = 0; i < block_size; ++i)
+        {
+            int32_t a = channels[0][i];
+            int32_t b = channels[1][i];
+            int32_t left, right;
+            switch (assignment)
+            {
+            case 0b1000: // left, side
+                left  = a;
+                right = a - b;
+                break;
+            case 0b1001: // side, right
+                left  = a + b;
+                right = b;
+                break;
+            case 0b1010: { // mid, side
+                const int32_t mid = (a << 1) | (b & 1);
+                left              = (mid + b) >> 1;
+                right             = (mid - b) >> 1;
+                break;
+            }
+            default:
+                left  = a;
+                right = b;
+                break;
+            }
+            REQUIRE(left >= INT16_MIN);
+            REQUIRE(left <= INT16_MAX);
+            REQUIRE(right >= INT16_MIN);
+            REQUIRE(right <= INT16_MAX);
+            result.frames.push_back({(int16_t)left, (int16_t)right});
+        }
+        result.block_sizes.push_back(block_size);
+    }
+
+    return result;
+}
+
+// Encodes `frames` into a temporary file, passing them to FLAC_Handle::Write `write_size` frames at a time, and returns
+// the file contents.
+static std::vector<uint8_t> EncodeFlac(const std::vector<AudioFrame<int16_t>>& frames,
+                                       uint32_t                                sample_rate,
+                                       size_t                                  thread_count,
+                                       size_t                                  write_size = 1000)
+{
+    std::random_device    rd;
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path() / ("nuked-sc55-test-" + std::to_string(rd()) + ".flac");
+
+    {
+        FLAC_Handle flac;
+        REQUIRE(flac.Open(path, thread_count));
+        flac.SetSampleRate(sample_rate);
+        std::span<const AudioFrame<int16_t>> rest = frames;
+        while (!rest.empty())
+        {
+            const size_t count = std::min(rest.size(), write_size);
+            flac.Write(rest.first(count));
+            rest = rest.subspan(count);
+        }
+        flac.Finish();
+    }
+
+    std::ifstream        file(path, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::filesystem::remove(path);
+    return bytes;
+}
+
+static void RequireRoundTrip(const std::vector<AudioFrame<int16_t>>& frames,
+                             uint32_t                                sample_rate = 32000,
+                             size_t                                  thread_count = 1)
+{
+    const DecodedFlac decoded = DecodeFlac(EncodeFlac(frames, sample_rate, thread_count));
+    REQUIRE(decoded.sample_rate == sample_rate);
+    REQUIRE(decoded.total_frames == frames.size());
+    REQUIRE(decoded.frames.size() == frames.size());
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        if (decoded.frames[i].left != frames[i].left || decoded.frames[i].right != frames[i].right)
+        {
+            FAIL("frame " << i << " differs");
+        }
+    }
+}
+
+// A mix of tones, noise, a hard pan and full scale clipping so that every predictor gets picked somewhere.
+static std::vector<AudioFrame<int16_t>> MakeTestSignal(size_t count, uint32_t seed)
+{
+    std::mt19937                     rng(seed);
+    std::vector<AudioFrame<int16_t>> frames(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double t     = (double)i;
+        double       left  = 9000.0 * std::sin(t * 0.031) + 4000.0 * std::sin(t * 0.173);
+        double       right = 9000.0 * std::sin(t * 0.029 + 1.0);
+        switch ((i / 3000) % 4)
+        {
+        case 1:
+            left += (double)(int16_t)rng() * 0.5;
+            right += (double)(int16_t)rng() * 0.5;
+            break;
+        case 2:
+            right = 0.0;
+            break;
+        case 3:
+            left *= 8.0;
+            right *= 8.0;
+            break;
+        }
+        frames[i].left  = (int16_t)std::clamp(left, -32768.0, 32767.0);
+        frames[i].right = (int16_t)std::clamp(right, -32768.0, 32767.0);
+    }
+    return frames;
+}
+
+TEST_CASE("FLAC round trip")
+{
+    // sizes on either side of the 8 bit and 16 bit block size fields and the fixed 4096
+    for (size_t count : {1, 2, 255, 256, 257, 4095, 4096, 4097, 3 * 4096})
+    {
+        RequireRoundTrip(MakeTestSignal(count, (uint32_t)count));
+    }
+
+    const DecodedFlac single = DecodeFlac(EncodeFlac(MakeTestSignal(1, 1), 32000, 1));
+    REQUIRE(single.block_sizes == std::vector<size_t>{1});
+    const DecodedFlac full = DecodeFlac(EncodeFlac(MakeTestSignal(4096, 1), 32000, 1));
+    REQUIRE(full.block_sizes == std::vector<size_t>{4096});
+    const DecodedFlac partial = DecodeFlac(EncodeFlac(MakeTestSignal(4095, 1), 32000, 1));
+    REQUIRE(partial.block_sizes == std::vector<size_t>{4095});
+}
+
+TEST_CASE("FLAC round trip with several batches")
+{
+    // Batches are 16 blocks. These end on a partial batch, one that ends in a partial block, and a full batch, using
+    // write sizes that don't line up with either.
+    const size_t batch = 16 * FLAC_Handle::BLOCK_SIZE;
+    for (size_t count : {batch + 1, 2 * batch + 4095, 3 * batch})
+    {
+        const std::vector<AudioFrame<int16_t>> frames = MakeTestSignal(count, 7);
+        for (size_t threads : {1, 3})
+        {
+            const DecodedFlac decoded = DecodeFlac(EncodeFlac(frames, 32000, threads, 777));
+            REQUIRE(decoded.frames.size() == count);
+            // the test signal makes the encoder use both fixed and LPC predictors
+            REQUIRE(decoded.subframe_types[2] > 0);
+            REQUIRE(decoded.subframe_types[3] > 0);
+            REQUIRE(decoded.block_sizes.size() == (count + FLAC_Handle::BLOCK_SIZE - 1) / FLAC_Handle::BLOCK_SIZE);
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (decoded.frames[i].left != frames[i].left || decoded.frames[i].right != frames[i].right)
+                {
+                    FAIL("frame " << i << " differs");
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("FLAC silence uses constant subframes")
+{
+    const std::vector<AudioFrame<int16_t>> silence(2 * FLAC_Handle::BLOCK_SIZE + 10);
+    const std::vector<uint8_t>             bytes   = EncodeFlac(silence, 32000, 1);
+    const DecodedFlac                      decoded = DecodeFlac(bytes);
+    REQUIRE(decoded.frames.size() == silence.size());
+    REQUIRE(decoded.subframe_types[0] == 2 * decoded.block_sizes.size());
+    for (const AudioFrame<int16_t>& frame : decoded.frames)
+    {
+        REQUIRE(frame.left == 0);
+        REQUIRE(frame.right == 0);
+    }
+
+    // DC offset and full scale are constant too
+    std::vector<AudioFrame<int16_t>> dc(FLAC_Handle::BLOCK_SIZE, AudioFrame<int16_t>{INT16_MIN, INT16_MAX});
+    RequireRoundTrip(dc);
+    REQUIRE(DecodeFlac(EncodeFlac(dc, 32000, 1)).subframe_types[0] == 2);
+}
+
+TEST_CASE("FLAC sample rates")
+{
+    // common rates have a code, others are written in the frame header or only in the stream info
+    for (uint32_t rate : {32000, 44100, 48000, 32768, 66207, 200000})
+    {
+        RequireRoundTrip(MakeTestSignal(5000, rate), rate);
+    }
+}
+
+TEST_CASE("FLAC empty stream")
+{
+    const DecodedFlac decoded = DecodeFlac(EncodeFlac({}, 32000, 1));
+    REQUIRE(decoded.total_frames == 0);
+    REQUIRE(decoded.frames.empty());
+}
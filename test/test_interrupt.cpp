@@ -0,0 +1,90 @@
+#include "test_emulator.h"
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+
+struct HandleResult
+{
+    uint16_t pc;
+    uint16_t sr;
+    uint8_t  sleep;
+
+    bool operator==(const HandleResult&) const = default;
+};
+
+static HandleResult RunHandle(mcu_t& mcu, MCU_Backend backend, uint32_t mask)
+{
+    mcu.backend = backend;
+    mcu.cp      = 0;
+    mcu.pc      = 0x1234;
+    mcu.r[7]    = 0xfe00;
+    mcu.sr      = (uint16_t)(mask << 8);
+    mcu.sleep   = 1;
+    MCU_Interrupt_Handle(mcu);
+    return {mcu.pc, mcu.sr, mcu.sleep};
+}
+
+TEST_CASE("Cached interrupt arbitration delivers the same interrupt as a full scan")
+{
+    // vector n points at address n, so the pc after MCU_Interrupt_Handle identifies the vector taken
+    std::vector<uint8_t> rom1(ROM1_SIZE);
+    for (size_t vector = 0; vector < 64; ++vector)
+    {
+        rom1[vector * 4 + 3] = (uint8_t)vector;
+    }
+
+    AllRomsetInfo info;
+    info.romsets[(size_t)Romset::MK2].rom_data[(size_t)RomLocation::ROM1] = rom1;
+
+    auto   emu = CreateTestEmulator(Romset::MK2, {}, info);
+    mcu_t& mcu = emu->GetMCU();
+
+    std::mt19937 rng(1234);
+    for (int trial = 0; trial < 5000; ++trial)
+    {
+        for (uint32_t reg : {DEV_IPRA, DEV_IPRB, DEV_IPRC, DEV_IPRD, DEV_P1CR})
+        {
+            MCU_Write(mcu, 0xff80 | reg, (uint8_t)rng());
+        }
+        for (uint8_t source = 0; source < INTERRUPT_SOURCE_MAX; ++source)
+        {
+            const uint32_t odds = source == INTERRUPT_SOURCE_NMI ? 32 : 6;
+            MCU_Interrupt_SetRequest(mcu, (MCU_Interrupt_Source)source, rng() % odds == 0);
+        }
+        const uint32_t mask = rng() % 8;
+
+        const HandleResult cached      = RunHandle(mcu, MCU_Backend::Cached, mask);
+        const HandleResult interpreter = RunHandle(mcu, MCU_Backend::Interpreter, mask);
+        REQUIRE(cached == interpreter);
+
+        mcu.sr = (uint16_t)(mask << 8);
+        REQUIRE(MCU_Interrupt_WouldStart(mcu) == (interpreter.pc != 0x1234));
+    }
+}
+
+TEST_CASE("Interrupt arbitration follows priority register writes")
+{
+    auto   emu = CreateTestEmulator();
+    mcu_t& mcu = emu->GetMCU();
+
+    MCU_Interrupt_SetRequest(mcu, INTERRUPT_SOURCE_TIMER_CMIA, 1);
+    REQUIRE(mcu.interrupt_max_level == 0);
+
+    MCU_Write(mcu, 0xff80 | DEV_IPRC, 0x05);
+    REQUIRE(mcu.interrupt_max_level == 5);
+
+    MCU_Interrupt_SetRequest(mcu, INTERRUPT_SOURCE_FRT2_OCIA, 1);
+    REQUIRE(mcu.interrupt_max_level == 5);
+    MCU_Write(mcu, 0xff80 | DEV_IPRC, 0x65);
+    REQUIRE(mcu.interrupt_max_level == 6);
+
+    MCU_Interrupt_SetRequest(mcu, INTERRUPT_SOURCE_FRT2_OCIA, 0);
+    REQUIRE(mcu.interrupt_max_level == 5);
+
+    // the cached level is derived state and must be rebuilt on load
+    std::vector<uint8_t> state;
+    emu->SaveState(state);
+    MCU_Interrupt_SetRequest(mcu, INTERRUPT_SOURCE_TIMER_CMIA, 0);
+    REQUIRE(mcu.interrupt_max_level == 0);
+    REQUIRE(emu->LoadState(state));
+    REQUIRE(mcu.interrupt_max_level == 5);
+}
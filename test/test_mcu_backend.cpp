@@ -0,0 +1,83 @@
+#include "test_emulator.h"
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+
+static std::unique_ptr<Emulator> CreateLockstepEmulator(MCU_Backend                 backend,
+                                                        const std::vector<uint8_t>& rom1,
+                                                        const std::vector<uint8_t>& rom2 = {})
+{
+    AllRomsetInfo info;
+    info.romsets[(size_t)Romset::MK2].rom_data[(size_t)RomLocation::ROM1] = rom1;
+    info.romsets[(size_t)Romset::MK2].rom_data[(size_t)RomLocation::ROM2] = rom2;
+
+    EMU_Options options;
+    options.mcu_backend  = backend;
+    options.mcu_lockstep = true;
+
+    return CreateTestEmulator(Romset::MK2, options, info);
+}
+
+static void CheckLockstep(MCU_Backend backend)
+{
+    // reset vector -> 0:0100, then loop over a few general format instructions
+    std::vector<uint8_t> rom1(ROM1_SIZE);
+    const uint8_t vector[] = {0x00, 0x00, 0x01, 0x00};
+    std::copy(std::begin(vector), std::end(vector), rom1.begin());
+    const uint8_t program[] = {0x0c, 0x12, 0x34, 0x80, 0xa8, 0x21, 0xca, 0x83, 0x20, 0xf6};
+    std::copy(std::begin(program), std::end(program), rom1.begin() + 0x100);
+
+    auto emu = CreateLockstepEmulator(backend, rom1);
+
+    emu->RunFor(1000 * MCU_CYCLES_PER_STEP);
+    REQUIRE_FALSE(emu->LockstepFailed());
+    REQUIRE(emu->GetMCU().r[0] == 0x1234);
+    REQUIRE(emu->GetMCU().r[2] != 0);
+
+    // a divergence is reported once and then lockstep stops
+    emu->GetMCU().r[5] ^= 1;
+    emu->RunFor(MCU_CYCLES_PER_STEP);
+    REQUIRE(emu->LockstepFailed());
+}
+
+TEST_CASE("MCU backends agree in lockstep")
+{
+    CheckLockstep(MCU_Backend::Cached);
+    CheckLockstep(MCU_Backend::Jit);
+}
+
+TEST_CASE("MCU JIT agrees with the interpreter on random code")
+{
+    // Random bytes decode to a mix of every instruction format, including invalid ones, and accesses to the I/O
+    // window. Code runs from rom2 on page 1, which is rom at every pc, and all vectors point there as well. Sleep and
+    // the page jumps are left out so that most of the time is spent in compiled code.
+    std::vector<uint8_t> rom1(ROM1_SIZE);
+    std::vector<uint8_t> rom2(ROM2_SIZE);
+    uint32_t seed = 1;
+    auto random = [&]() {
+        seed = seed * 1664525 + 1013904223;
+        return (uint8_t)(seed >> 24);
+    };
+
+    for (int program = 0; program < 32; program++)
+    {
+        for (uint8_t& byte : rom2)
+        {
+            byte = random();
+            if (byte == 0x1a || byte == 0x03 || byte == 0x13)
+            {
+                byte = 0x00;
+            }
+        }
+        for (size_t vector = 0; vector < 0x100; vector += 4)
+        {
+            rom1[vector + 0] = 0x00;
+            rom1[vector + 1] = 0x01;
+            rom1[vector + 2] = random();
+            rom1[vector + 3] = random();
+        }
+
+        auto emu = CreateLockstepEmulator(MCU_Backend::Jit, rom1, rom2);
+        emu->RunFor(5000 * MCU_CYCLES_PER_STEP);
+        REQUIRE_FALSE(emu->LockstepFailed());
+    }
+}
@@ -0,0 +1,159 @@
+#include "test_emulator.h"
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+
+// Roms that tests can modify in place. Emulators never write to roms, so the MCU can point straight at these.
+struct TestRoms
+{
+    std::vector<uint8_t> rom1 = std::vector<uint8_t>(ROM1_SIZE);
+    std::vector<uint8_t> rom2 = std::vector<uint8_t>(ROM2_SIZE);
+};
+
+static void UseTestRoms(mcu_t& mcu, TestRoms& roms)
+{
+    mcu.rom1 = roms.rom1.data();
+    mcu.rom2 = roms.rom2.data();
+    MCU_BuildPageTable(mcu);
+}
+
+TEST_CASE("MCU page table maps roms and ram")
+{
+    auto emu = CreateTestEmulator(Romset::MK2);
+    mcu_t& mcu = emu->GetMCU();
+    TestRoms roms;
+    UseTestRoms(mcu, roms);
+
+    roms.rom1[0x1234] = 0x11;
+    roms.rom2[0x21234] = 0x22;
+    roms.rom2[0x51234] = 0x33;
+    REQUIRE(MCU_Read(mcu, 0x01234) == 0x11);
+    REQUIRE(MCU_Read(mcu, 0x21234) == 0x22);
+    REQUIRE(MCU_Read(mcu, 0x91234) == 0x33);
+    REQUIRE(MCU_Read(mcu, 0x61234) == 0x00);
+    REQUIRE(MCU_Read(mcu, 0x51234) == 0xff);
+
+    // sram is reachable both through the page 0 I/O window and page 10
+    MCU_Write(mcu, 0x08010, 0x44);
+    REQUIRE(mcu.sram[0x10] == 0x44);
+    REQUIRE(MCU_Read(mcu, 0xa0010) == 0x44);
+    MCU_Write(mcu, 0xa0020, 0x55);
+    REQUIRE(MCU_Read(mcu, 0x08020) == 0x55);
+
+    // roms are read only
+    MCU_Write(mcu, 0x21234, 0x99);
+    REQUIRE(mcu.rom2[0x21234] == 0x22);
+}
+
+TEST_CASE("MCU page table follows rom2 size")
+{
+    auto emu = CreateTestEmulator(Romset::MK2);
+    mcu_t& mcu = emu->GetMCU();
+    TestRoms roms;
+    UseTestRoms(mcu, roms);
+
+    roms.rom2[0x01234] = 0x66;
+    mcu.rom2_mask = 0x1ffff;
+    MCU_BuildPageTable(mcu);
+    REQUIRE(MCU_Read(mcu, 0x21234) == 0x66);
+    REQUIRE(MCU_Read(mcu, 0x41234) == 0x66);
+}
+
+TEST_CASE("MCU page table for mk1 and jv880")
+{
+    auto mk1 = CreateTestEmulator(Romset::MK1);
+    MCU_Write(mk1->GetMCU(), 0x50030, 0x77);
+    REQUIRE(mk1->GetMCU().sram[0x30] == 0x77);
+    REQUIRE(MCU_Read(mk1->GetMCU(), 0xa0030) == 0xff);
+
+    auto jv880 = CreateTestEmulator(Romset::JV880);
+    mcu_t& mcu = jv880->GetMCU();
+    MCU_Write(mcu, 0xc0040, 0x88);
+    MCU_Write(mcu, 0xe0050, 0x99);
+    REQUIRE(mcu.nvram[0x40] == 0x88);
+    REQUIRE(mcu.cardram[0x50] == 0x99);
+    REQUIRE(MCU_Read(mcu, 0xd0040) == 0x88);
+    REQUIRE(MCU_Read(mcu, 0xf0050) == 0x99);
+    REQUIRE(MCU_Read(mcu, 0x80000) == 0xff);
+}
+
+TEST_CASE("MCU code fetch follows cp")
+{
+    auto emu = CreateTestEmulator(Romset::MK2);
+    mcu_t& mcu = emu->GetMCU();
+    TestRoms roms;
+    UseTestRoms(mcu, roms);
+
+    roms.rom1[0x0100] = 0x12;
+    roms.rom2[0x10100] = 0x34;
+    mcu.sram[0x0100] = 0x56;
+
+    mcu.cp = 0;
+    mcu.pc = 0x0100;
+    REQUIRE(MCU_ReadCodeAdvance(mcu) == 0x12);
+    REQUIRE(mcu.pc == 0x0101);
+
+    mcu.cp = 1;
+    mcu.pc = 0x0100;
+    REQUIRE(MCU_ReadCode(mcu) == 0x34);
+
+    // the upper half of page 0 is not cached
+    mcu.cp = 0;
+    mcu.pc = 0x8100;
+    REQUIRE(MCU_ReadCode(mcu) == 0x56);
+
+    // a rebuilt page table must not leave a stale code page behind
+    mcu.cp = 1;
+    mcu.pc = 0x0100;
+    REQUIRE(MCU_ReadCode(mcu) == 0x34);
+    roms.rom2[0x00100] = 0x78;
+    mcu.rom2_mask = 0xffff;
+    MCU_BuildPageTable(mcu);
+    REQUIRE(MCU_ReadCode(mcu) == 0x78);
+}
+
+// MOV:G.W #imm, R0 followed by ADD:G.W R0, R1
+static void WriteProgram(uint8_t* code, uint16_t imm)
+{
+    const uint8_t program[] = {0x0c, (uint8_t)(imm >> 8), (uint8_t)imm, 0x80, 0xa8, 0x21};
+    std::copy(std::begin(program), std::end(program), code);
+}
+
+static void RunProgram(mcu_t& mcu, uint8_t cp, uint16_t pc)
+{
+    mcu.cp   = cp;
+    mcu.pc   = pc;
+    mcu.r[1] = 1;
+    MCU_Step(mcu);
+    MCU_Step(mcu);
+    REQUIRE(mcu.pc == pc + 6);
+}
+
+TEST_CASE("MCU decode cache")
+{
+    auto emu = CreateTestEmulator(Romset::MK2);
+    mcu_t& mcu = emu->GetMCU();
+    TestRoms roms;
+    UseTestRoms(mcu, roms);
+
+    WriteProgram(&roms.rom1[0x0100], 0x1234);
+    RunProgram(mcu, 0, 0x0100);
+    REQUIRE(mcu.r[0] == 0x1234);
+    REQUIRE(mcu.r[1] == 0x1235);
+
+    // second run is served from the cache
+    RunProgram(mcu, 0, 0x0100);
+    REQUIRE(mcu.r[1] == 0x1235);
+
+    WriteProgram(&roms.rom1[0x0100], 0x0010);
+    MCU_InvalidateDecodeCache(mcu);
+    RunProgram(mcu, 0, 0x0100);
+    REQUIRE(mcu.r[1] == 0x0011);
+
+    // code running from sram is never cached
+    WriteProgram(&mcu.sram[0x0200], 0x0020);
+    RunProgram(mcu, 10, 0x0200);
+    REQUIRE(mcu.r[1] == 0x0021);
+    MCU_Write(mcu, 0xa0202, 0x30);
+    RunProgram(mcu, 10, 0x0200);
+    REQUIRE(mcu.r[1] == 0x0031);
+}
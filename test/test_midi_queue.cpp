@@ -0,0 +1,61 @@
+#include "standard/midi_queue.h"
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("MIDI_ScheduleQueue")
+{
+    MIDI_ScheduleQueue queue;
+    queue.Init(64);
+
+    const MIDI_Clock::time_point t0;
+    MIDI_Clock::time_point       time;
+    std::vector<uint8_t>         message;
+    REQUIRE(!queue.PeekTime(time));
+
+    // messages come out in order with their timestamps, including ones that wrap around the end of the buffer
+    for (uint8_t i = 0; i < 20; ++i)
+    {
+        const uint8_t note_on[] = {0x90, i, 0x7F};
+        REQUIRE(queue.Push(t0 + i * 1ms, note_on));
+        REQUIRE(queue.PeekTime(time));
+        REQUIRE(time == t0 + i * 1ms);
+        queue.Pop(message);
+        REQUIRE(message == std::vector<uint8_t>(std::begin(note_on), std::end(note_on)));
+        REQUIRE(!queue.PeekTime(time));
+    }
+
+    // a message that doesn't fit is dropped whole and the queue is otherwise unaffected
+    const std::vector<uint8_t> sysex(40, 0x7F);
+    REQUIRE(queue.Push(t0, sysex));
+    REQUIRE(!queue.Push(t0 + 1ms, sysex));
+    REQUIRE(queue.GetDroppedBytes() == sysex.size());
+    REQUIRE(queue.PeekTime(time));
+    REQUIRE(time == t0);
+    queue.Pop(message);
+    REQUIRE(message == sysex);
+    REQUIRE(!queue.PeekTime(time));
+}
+
+TEST_CASE("MIDI_SampleClock")
+{
+    MIDI_SampleClock clock;
+    clock.Init(1000, 100);
+
+    const MIDI_Clock::time_point t0 = MIDI_Clock::now();
+    clock.Update(t0, 5000);
+    REQUIRE(clock.FrameAt(t0) == 5000);
+    REQUIRE(clock.FrameAt(t0 + 250ms) == 5250);
+    REQUIRE(clock.FrameAt(t0 - 1s) == 4000);
+
+    // measurements within the error bound only nudge the mapping
+    clock.Update(t0 + 1s, 6064);
+    REQUIRE(clock.FrameAt(t0 + 1s) == 6004);
+
+    // larger ones replace it
+    clock.Update(t0 + 2s, 9000);
+    REQUIRE(clock.FrameAt(t0 + 2s) == 9000);
+
+    // long sessions don't overflow
+    REQUIRE(clock.FrameAt(t0 + 2s + 1000h) == 9000 + 3600000000ll);
+}
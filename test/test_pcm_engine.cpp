@@ -0,0 +1,160 @@
+#include "test_emulator.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <random>
+
+struct PcmEngineHarness
+{
+    std::unique_ptr<Emulator>        emu;
+    // random waverom contents, owned here because the emulator only maps roms
+    std::vector<uint8_t>             waverom[4];
+    AudioFrame<int32_t>              buffer[1];
+    std::vector<AudioFrame<int32_t>> frames;
+};
+
+static void InitHarness(PcmEngineHarness& harness, Romset romset, PCM_Engine engine)
+{
+    EMU_Options options;
+    options.pcm_engine = engine;
+
+    harness.emu = CreateTestEmulator(romset, options);
+
+    harness.emu->SetSampleSink(harness.buffer, [](void* userdata, std::span<const AudioFrame<int32_t>> frames) {
+        auto& out = *(std::vector<AudioFrame<int32_t>>*)userdata;
+        out.insert(out.end(), frames.begin(), frames.end());
+    }, &harness.frames);
+}
+
+// Random but plausible chip state: 20 bit ram1 values, keyed voices and a mix of voice enables.
+static void RandomizePcm(PcmEngineHarness& harness, std::mt19937& rng)
+{
+    pcm_t& pcm = harness.emu->GetPCM();
+    for (auto& rom : harness.waverom)
+    {
+        rom.resize(0x200000);
+        for (size_t i = 0; i < 0x100000; ++i)
+        {
+            rom[i] = (uint8_t)rng();
+        }
+    }
+    pcm.waverom1     = harness.waverom[0].data();
+    pcm.waverom2     = harness.waverom[1].data();
+    pcm.waverom3     = harness.waverom[2].data();
+    pcm.waverom_card = harness.waverom[3].data();
+    for (auto& row : pcm.ram1)
+    {
+        for (uint32_t& value : row)
+        {
+            value = rng() & 0xfffff;
+        }
+    }
+    for (auto& row : pcm.ram2)
+    {
+        for (uint16_t& value : row)
+        {
+            value = (uint16_t)rng();
+        }
+    }
+    for (uint16_t& value : pcm.eram)
+    {
+        value = (uint16_t)rng();
+    }
+    pcm.tv_counter         = (uint16_t)(rng() & 0x3fff);
+    pcm.voice_mask         = rng();
+    pcm.voice_mask_pending = rng() | pcm.voice_mask;
+}
+
+static void RequireSamePcm(PcmEngineHarness& a, PcmEngineHarness& b)
+{
+    const pcm_t& pcm_a = a.emu->GetPCM();
+    const pcm_t& pcm_b = b.emu->GetPCM();
+    REQUIRE(memcmp(pcm_a.ram1, pcm_b.ram1, sizeof(pcm_a.ram1)) == 0);
+    REQUIRE(memcmp(pcm_a.ram2, pcm_b.ram2, sizeof(pcm_a.ram2)) == 0);
+    REQUIRE(memcmp(pcm_a.eram, pcm_b.eram, sizeof(pcm_a.eram)) == 0);
+    REQUIRE(pcm_a.accum_l == pcm_b.accum_l);
+    REQUIRE(pcm_a.accum_r == pcm_b.accum_r);
+    REQUIRE(pcm_a.rcsum[0] == pcm_b.rcsum[0]);
+    REQUIRE(pcm_a.rcsum[1] == pcm_b.rcsum[1]);
+    REQUIRE(pcm_a.irq_assert == pcm_b.irq_assert);
+    REQUIRE(pcm_a.irq_channel == pcm_b.irq_channel);
+    REQUIRE(pcm_a.cycles == pcm_b.cycles);
+    REQUIRE(a.emu->GetMCU().interrupt_pending.Contains(INTERRUPT_SOURCE_IRQ0) ==
+            b.emu->GetMCU().interrupt_pending.Contains(INTERRUPT_SOURCE_IRQ0));
+    REQUIRE(a.emu->GetMCU().ga_int[5] == b.emu->GetMCU().ga_int[5]);
+    REQUIRE(a.frames.size() == b.frames.size());
+    for (size_t i = 0; i < a.frames.size(); ++i)
+    {
+        REQUIRE(a.frames[i].left == b.frames[i].left);
+        REQUIRE(a.frames[i].right == b.frames[i].right);
+    }
+    a.frames.clear();
+    b.frames.clear();
+}
+
+// Runs the same random chip state and register trace through two differently configured PCM instances.
+static void CompareEngines(PCM_Engine engine_a, bool skip_idle_a, PCM_Engine engine_b, bool skip_idle_b)
+{
+    for (Romset romset : {Romset::MK2, Romset::MK1, Romset::JV880})
+    {
+        PcmEngineHarness a, b;
+        InitHarness(a, romset, engine_a);
+        InitHarness(b, romset, engine_b);
+        a.emu->GetPCM().skip_idle_voices = skip_idle_a;
+        b.emu->GetPCM().skip_idle_voices = skip_idle_b;
+
+        for (uint32_t seed = 0; seed < 8; ++seed)
+        {
+            std::mt19937 rng(seed);
+            RandomizePcm(a, rng);
+            rng.seed(seed);
+            RandomizePcm(b, rng);
+
+            for (int sample = 0; sample < 2000; ++sample)
+            {
+                // register trace: a few writes per sample, occasionally acknowledging the voice irq and changing the
+                // number of slots, including counts only the scalar engine handles
+                const int writes = (int)(rng() % 4);
+                for (int i = 0; i < writes; ++i)
+                {
+                    uint32_t address = rng() % 0x3e;
+                    if (address == 0x3c)
+                        address = 0x3e;
+                    if (address == 0x3d && rng() % 4 != 0)
+                        address = 0x0f;
+                    const uint8_t data = (uint8_t)rng();
+                    PCM_Write(a.emu->GetPCM(), address, data);
+                    PCM_Write(b.emu->GetPCM(), address, data);
+                }
+                if (rng() % 16 == 0)
+                {
+                    PCM_Read(a.emu->GetPCM(), 0x3e);
+                    PCM_Read(b.emu->GetPCM(), 0x3e);
+                }
+                if (rng() % 64 == 0)
+                {
+                    PCM_Read(a.emu->GetPCM(), 0x00);
+                    PCM_Read(b.emu->GetPCM(), 0x00);
+                }
+
+                MCU_DispatchRomsetFamily(MCU_GetRomsetFamily(romset), [&]<typename Traits>() {
+                    PCM_Update<Traits>(a.emu->GetPCM(), a.emu->GetPCM().cycles + 1);
+                    PCM_Update<Traits>(b.emu->GetPCM(), b.emu->GetPCM().cycles + 1);
+                });
+                a.emu->FlushSamples();
+                b.emu->FlushSamples();
+                RequireSamePcm(a, b);
+            }
+        }
+    }
+}
+
+TEST_CASE("Vector PCM engine matches the scalar engine")
+{
+    CompareEngines(PCM_Engine::Scalar, false, PCM_Engine::Vector, false);
+}
+
+TEST_CASE("Skipping idle PCM voices doesn't change results")
+{
+    CompareEngines(PCM_Engine::Scalar, false, PCM_Engine::Scalar, true);
+    CompareEngines(PCM_Engine::Scalar, false, PCM_Engine::Vector, true);
+}
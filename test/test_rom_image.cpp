@@ -0,0 +1,63 @@
+#include "backend/emu.h"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("Emulators share rom images")
+{
+    std::vector<uint8_t> rom2(0x20000);
+    rom2[0x01234] = 0x66;
+    std::vector<uint8_t> waverom1(0x100000, 0x77);
+
+    AllRomsetInfo info;
+    info.romsets[(size_t)Romset::MK2].rom_data[(size_t)RomLocation::ROM2]     = rom2;
+    info.romsets[(size_t)Romset::MK2].rom_data[(size_t)RomLocation::WAVEROM1] = waverom1;
+
+    RomLocationSet loaded{};
+    auto           image = EMU_CreateRomImage(Romset::MK2, info, &loaded);
+    REQUIRE(image);
+    REQUIRE(loaded[(size_t)RomLocation::ROM2]);
+    REQUIRE(!loaded[(size_t)RomLocation::ROM1]);
+    REQUIRE(image->rom2_mask == 0x1ffff);
+    // roms are padded to the size of their location
+    REQUIRE(image->data[(size_t)RomLocation::WAVEROM1].size() == 0x200000);
+    REQUIRE(image->data[(size_t)RomLocation::WAVEROM1][0x1fffff] == 0x00);
+
+    // the source data isn't needed once the image exists
+    info.PurgeRomData();
+
+    auto a = std::make_unique<Emulator>();
+    auto b = std::make_unique<Emulator>();
+    REQUIRE(a->Init({}));
+    REQUIRE(b->Init({}));
+    REQUIRE(a->LoadRoms(image));
+    REQUIRE(b->LoadRoms(image));
+    a->Reset();
+    b->Reset();
+
+    REQUIRE(a->GetMCU().rom2 == b->GetMCU().rom2);
+    REQUIRE(a->GetPCM().waverom1 == b->GetPCM().waverom1);
+    REQUIRE(a->GetPCM().waverom1[0x1234] == 0x77);
+    REQUIRE(MCU_Read(a->GetMCU(), 0x21234) == 0x66);
+    REQUIRE(MCU_Read(b->GetMCU(), 0x41234) == 0x66);
+
+    // locations without a rom read as zeroes
+    REQUIRE(a->GetMCU().rom1 == ROM_EMPTY);
+    REQUIRE(MCU_Read(a->GetMCU(), 0x01234) == 0x00);
+
+    // the image outlives the caller's reference
+    image.reset();
+    REQUIRE(MCU_Read(b->GetMCU(), 0x21234) == 0x66);
+}
+
+TEST_CASE("Rom images reject roms that don't fit")
+{
+    AllRomsetInfo info;
+    info.romsets[(size_t)Romset::MK2].rom_data[(size_t)RomLocation::ROM2] = std::vector<uint8_t>(0x30000);
+    REQUIRE(!EMU_CreateRomImage(Romset::MK2, info));
+
+    info.romsets[(size_t)Romset::MK2].rom_data[(size_t)RomLocation::ROM2] = std::vector<uint8_t>(ROM2_SIZE * 2);
+    REQUIRE(!EMU_CreateRomImage(Romset::MK2, info));
+
+    Emulator emu;
+    REQUIRE(emu.Init({}));
+    REQUIRE(!emu.LoadRoms(Romset::MK2, info));
+}
@@ -0,0 +1,102 @@
+#include "backend/mcu_timer.h"
+#include "backend/pcm.h"
+#include "backend/submcu.h"
+#include "test_emulator.h"
+#include <catch2/catch_test_macros.hpp>
+
+// The interpreter backend never skips idle steps, so it serves as a reference for the cached backend.
+static std::unique_ptr<Emulator> MakeSleepingEmulator(Romset romset, MCU_Backend backend)
+{
+    EMU_Options options;
+    options.mcu_backend = backend;
+
+    auto emu = CreateTestEmulator(romset, options);
+
+    mcu_t& mcu = emu->GetMCU();
+    mcu.sleep  = 1;
+    if (mcu.sm)
+    {
+        mcu.sm->sleep = 1;
+        mcu.sm->sr    = SM_STATUS_I;
+    }
+
+    // FRT0: OCIEA, clear on match A
+    MCU_Write(mcu, 0xff90, 0x20);
+    MCU_Write(mcu, 0xff91, 0x01);
+    MCU_Write(mcu, 0xff94, 0x01);
+    MCU_Write(mcu, 0xff95, 0x00);
+    return emu;
+}
+
+static void RequireSameState(Emulator& a, Emulator& b)
+{
+    mcu_t& mcu_a = a.GetMCU();
+    mcu_t& mcu_b = b.GetMCU();
+    TIMER_Sync(*mcu_a.timer);
+    TIMER_Sync(*mcu_b.timer);
+
+    REQUIRE(mcu_a.cycles == mcu_b.cycles);
+    REQUIRE(mcu_a.pc == mcu_b.pc);
+    REQUIRE(mcu_a.sleep == mcu_b.sleep);
+    REQUIRE(mcu_a.frames_produced == mcu_b.frames_produced);
+    REQUIRE(mcu_a.ga_lcd_counter == mcu_b.ga_lcd_counter);
+    REQUIRE(a.GetPCM().cycles == b.GetPCM().cycles);
+    REQUIRE(mcu_a.timer->cycles == mcu_b.timer->cycles);
+    REQUIRE(mcu_a.timer->frt[0].frc == mcu_b.timer->frt[0].frc);
+    REQUIRE(mcu_a.timer->frt[0].tcsr == mcu_b.timer->frt[0].tcsr);
+    for (MCU_Interrupt_Source source : mcu_a.interrupt_pending)
+    {
+        REQUIRE(mcu_b.interrupt_pending.Contains(source));
+    }
+    for (MCU_Interrupt_Source source : mcu_b.interrupt_pending)
+    {
+        REQUIRE(mcu_a.interrupt_pending.Contains(source));
+    }
+    if (mcu_a.sm)
+    {
+        REQUIRE(mcu_a.sm->cycles == mcu_b.sm->cycles);
+        REQUIRE(mcu_a.sm->timer_cycles == mcu_b.sm->timer_cycles);
+    }
+}
+
+TEST_CASE("Sleeping MCU skips idle steps without changing results")
+{
+    for (Romset romset : {Romset::MK2, Romset::MK1, Romset::JV880})
+    {
+        auto cached      = MakeSleepingEmulator(romset, MCU_Backend::Cached);
+        auto interpreter = MakeSleepingEmulator(romset, MCU_Backend::Interpreter);
+        cached->GetMCU().ga_lcd_counter      = 400;
+        interpreter->GetMCU().ga_lcd_counter = 400;
+
+        // odd lengths so that runs end between events
+        for (uint64_t cycles : {1ull, 12ull, 1000ull, 100003ull, 2000000ull})
+        {
+            cached->RunFor(cycles);
+            interpreter->RunFor(cycles);
+            RequireSameState(*cached, *interpreter);
+        }
+
+        cached->RunUntilFrames(1000);
+        interpreter->RunUntilFrames(1000);
+        RequireSameState(*cached, *interpreter);
+    }
+}
+
+TEST_CASE("Sleeping MCU wakes on the same cycle when an interrupt is taken")
+{
+    auto cached      = MakeSleepingEmulator(Romset::JV880, MCU_Backend::Cached);
+    auto interpreter = MakeSleepingEmulator(Romset::JV880, MCU_Backend::Interpreter);
+
+    // raise the FRT0 OCIA priority above the interrupt mask
+    for (Emulator* emu : {cached.get(), interpreter.get()})
+    {
+        mcu_t& mcu = emu->GetMCU();
+        mcu.sr &= ~STATUS_INT_MASK;
+        MCU_Write(mcu, 0xff80 | DEV_IPRB, 0x70);
+    }
+
+    cached->RunFor(3000000);
+    interpreter->RunFor(3000000);
+    REQUIRE(!interpreter->GetMCU().sleep);
+    RequireSameState(*cached, *interpreter);
+}
@@ -0,0 +1,153 @@
+#include "renderer/smf.h"
+#include <catch2/catch_test_macros.hpp>
+
+static void AppendU32BE(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back((uint8_t)(value >> 24));
+    out.push_back((uint8_t)(value >> 16));
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+static void AppendChunk(std::vector<uint8_t>& out, const char* type, std::initializer_list<uint8_t> body)
+{
+    out.insert(out.end(), type, type + 4);
+    AppendU32BE(out, (uint32_t)body.size());
+    out.insert(out.end(), body);
+}
+
+static void AppendHeader(std::vector<uint8_t>& out, uint16_t division = 96)
+{
+    AppendChunk(out, "MThd", {0, 0, 0, 1, (uint8_t)(division >> 8), (uint8_t)division});
+}
+
+static bool Parse(std::vector<uint8_t> bytes, SMF_Data& data)
+{
+    data       = SMF_Data{};
+    data.bytes = std::move(bytes);
+    return SMF_ParseEvents(data);
+}
+
+TEST_CASE("SMF parsing")
+{
+    std::vector<uint8_t> bytes;
+    AppendHeader(bytes);
+    AppendChunk(bytes,
+                "MTrk",
+                {
+                    0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20, // tempo 500000
+                    0x00, 0x90, 0x3c, 0x40,                   // note on
+                    0x60, 0x3c, 0x00,                         // running status
+                    0x00, 0xf0, 0x02, 0x7e, 0xf7,             // sysex
+                    0x00, 0xff, 0x2f, 0x00,                   // end of track
+                });
+
+    SMF_Data data;
+    REQUIRE(Parse(bytes, data));
+    REQUIRE(data.header.division == 96);
+    REQUIRE(data.tracks.size() == 1);
+
+    const std::vector<SMF_Event>& events = data.tracks[0].events;
+    REQUIRE(events.size() == 5);
+    REQUIRE(events[0].IsTempo(data.bytes));
+    REQUIRE(events[0].GetTempoUS(data.bytes) == 500000);
+    REQUIRE(events[1].status == 0x90);
+    REQUIRE(events[2].status == 0x90);
+    REQUIRE(events[2].timestamp == 0x60);
+    REQUIRE(events[2].GetData(data.bytes).size() == 2);
+    REQUIRE(events[3].IsSystemExclusive());
+    REQUIRE(events[3].GetData(data.bytes).size() == 2);
+}
+
+TEST_CASE("SMF rejects malformed files")
+{
+    SMF_Data data;
+
+    SECTION("Empty file")
+    {
+        REQUIRE(!Parse({}, data));
+    }
+
+    SECTION("No header")
+    {
+        std::vector<uint8_t> bytes;
+        AppendChunk(bytes, "MTrk", {0x00, 0xff, 0x2f, 0x00});
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Truncated header")
+    {
+        std::vector<uint8_t> bytes;
+        AppendChunk(bytes, "MThd", {0, 0, 0, 1});
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Zero division")
+    {
+        std::vector<uint8_t> bytes;
+        AppendHeader(bytes, 0);
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Unknown chunk")
+    {
+        std::vector<uint8_t> bytes;
+        AppendHeader(bytes);
+        AppendChunk(bytes, "XXXX", {});
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Chunk longer than the file")
+    {
+        std::vector<uint8_t> bytes;
+        AppendHeader(bytes);
+        AppendChunk(bytes, "MTrk", {0x00, 0xff, 0x2f, 0x00});
+        bytes.resize(bytes.size() - 1);
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Truncated event")
+    {
+        std::vector<uint8_t> bytes;
+        AppendHeader(bytes);
+        AppendChunk(bytes, "MTrk", {0x00, 0x90, 0x3c});
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Sysex longer than the track")
+    {
+        std::vector<uint8_t> bytes;
+        AppendHeader(bytes);
+        AppendChunk(bytes, "MTrk", {0x00, 0xf0, 0x7f, 0x7e, 0xf7});
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Data byte without running status")
+    {
+        std::vector<uint8_t> bytes;
+        AppendHeader(bytes);
+        AppendChunk(bytes, "MTrk", {0x00, 0x3c, 0x40});
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Short tempo event")
+    {
+        std::vector<uint8_t> bytes;
+        AppendHeader(bytes);
+        AppendChunk(bytes, "MTrk", {0x00, 0xff, 0x51, 0x01, 0x07, 0x00, 0xff, 0x2f, 0x00});
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Unhandled system message")
+    {
+        std::vector<uint8_t> bytes;
+        AppendHeader(bytes);
+        AppendChunk(bytes, "MTrk", {0x00, 0xf2, 0x00, 0x00});
+        REQUIRE(!Parse(bytes, data));
+    }
+
+    SECTION("Missing file")
+    {
+        REQUIRE(!SMF_LoadEvents(std::filesystem::path("this file does not exist.mid"), data));
+    }
+}
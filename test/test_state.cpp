@@ -0,0 +1,65 @@
+#include "test_emulator.h"
+#include <catch2/catch_test_macros.hpp>
+
+// Roms are not part of the state, so these tests use an empty romset and poke at the state directly.
+
+TEST_CASE("Emulator state round trip")
+{
+    auto src = CreateTestEmulator(Romset::MK2);
+    auto dst = CreateTestEmulator(Romset::MK2);
+
+    mcu_t& mcu = src->GetMCU();
+    mcu.r[3] = 0x1234;
+    mcu.pc = 0x4321;
+    mcu.cycles = 123456789;
+    mcu.sram[10] = 0x55;
+    mcu.interrupt_pending.Include(INTERRUPT_SOURCE_FRT0_OCIA);
+    mcu.sm->ram[5] = 0x66;
+    mcu.timer->frt[1].frc = 0xbeef;
+    src->GetPCM().eram[100] = 0x7777;
+    src->GetPCM().ram2[31][15] = 0x8888;
+    src->GetLCD().LCD_Data[2] = 'A';
+
+    std::vector<uint8_t> state;
+    src->SaveState(state);
+    REQUIRE(dst->LoadState(state));
+
+    mcu_t& restored = dst->GetMCU();
+    REQUIRE(restored.r[3] == 0x1234);
+    REQUIRE(restored.pc == 0x4321);
+    REQUIRE(restored.cycles == 123456789);
+    REQUIRE(restored.sram[10] == 0x55);
+    REQUIRE(restored.interrupt_pending.Contains(INTERRUPT_SOURCE_FRT0_OCIA));
+    REQUIRE(restored.sm->ram[5] == 0x66);
+    REQUIRE(restored.timer->frt[1].frc == 0xbeef);
+    REQUIRE(dst->GetPCM().eram[100] == 0x7777);
+    REQUIRE(dst->GetPCM().ram2[31][15] == 0x8888);
+    REQUIRE(dst->GetLCD().LCD_Data[2] == 'A');
+
+    // pointers between components must not be clobbered
+    REQUIRE(restored.sm != mcu.sm);
+    REQUIRE(restored.sm->mcu == &restored);
+
+    std::vector<uint8_t> resaved;
+    dst->SaveState(resaved);
+    REQUIRE(resaved == state);
+}
+
+TEST_CASE("Emulator state rejects bad input")
+{
+    auto src = CreateTestEmulator(Romset::MK2);
+    auto dst = CreateTestEmulator(Romset::JV880);
+
+    std::vector<uint8_t> state;
+    src->SaveState(state);
+
+    // different romset
+    REQUIRE(!dst->LoadState(state));
+
+    // truncated
+    REQUIRE(!src->LoadState(std::span(state).first(state.size() - 1)));
+
+    // bad magic
+    state[0] ^= 0xff;
+    REQUIRE(!src->LoadState(state));
+}
@@ -0,0 +1,167 @@
+#include "backend/submcu.h"
+#include "test_emulator.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <random>
+
+// Device register indices, see submcu.cpp.
+constexpr size_t SM_DEV_UART1_CTRL  = 0x06;
+constexpr size_t SM_DEV_INT_ENABLE  = 0x1b;
+constexpr size_t SM_DEV_INT_REQUEST = 0x1c;
+constexpr size_t SM_DEV_PRESCALER   = 0x1d;
+constexpr size_t SM_DEV_TIMER       = 0x1e;
+constexpr size_t SM_DEV_TIMER_CTRL  = 0x1f;
+
+// The timer as it was stepped before SM_UpdateTimer advanced it in bulk.
+static void ReferenceUpdateTimer(submcu_t& sm)
+{
+    while (sm.timer_cycles < sm.cycles)
+    {
+        if ((sm.device_mode[SM_DEV_TIMER_CTRL] & 0x20) == 0 && !sm.sleep)
+        {
+            if (sm.timer_prescaler == 0)
+            {
+                sm.timer_prescaler = sm.device_mode[SM_DEV_PRESCALER];
+
+                if (sm.timer_counter == 0)
+                {
+                    sm.timer_counter = sm.device_mode[SM_DEV_TIMER];
+                    sm.device_mode[SM_DEV_INT_REQUEST] |= 0x8;
+                }
+                else
+                    sm.timer_counter--;
+            }
+            else
+                sm.timer_prescaler--;
+        }
+        sm.timer_cycles += 16;
+    }
+}
+
+TEST_CASE("Sub-MCU timer advances in bulk like it does tick by tick")
+{
+    std::mt19937 rng(55);
+    for (int trial = 0; trial < 20000; ++trial)
+    {
+        submcu_t a;
+        a.device_mode[SM_DEV_PRESCALER]  = (uint8_t)(rng() % 4 == 0 ? 0 : rng());
+        a.device_mode[SM_DEV_TIMER]      = (uint8_t)(rng() % 4 == 0 ? 0 : rng());
+        a.device_mode[SM_DEV_TIMER_CTRL] = rng() % 8 == 0 ? 0x20 : 0;
+        a.sleep                          = rng() % 8 == 0;
+        a.timer_prescaler                = (uint8_t)rng();
+        a.timer_counter                  = (uint8_t)rng();
+        a.timer_cycles                   = rng() % 1000;
+        a.cycles                         = a.timer_cycles + rng() % (rng() % 2 ? 100 : 2000000);
+
+        submcu_t b = a;
+        SM_UpdateTimer(a);
+        ReferenceUpdateTimer(b);
+        REQUIRE(a.timer_cycles == b.timer_cycles);
+        REQUIRE(a.timer_prescaler == b.timer_prescaler);
+        REQUIRE(a.timer_counter == b.timer_counter);
+        REQUIRE(a.device_mode[SM_DEV_INT_REQUEST] == b.device_mode[SM_DEV_INT_REQUEST]);
+    }
+}
+
+// The interpreter backend never skips sub-MCU steps, so it serves as a reference for the cached backend.
+static std::unique_ptr<Emulator> MakePollingEmulator(MCU_Backend backend)
+{
+    EMU_Options options;
+    options.mcu_backend = backend;
+
+    std::vector<uint8_t> smrom(0x1000);
+    // clang-format off
+    const uint8_t program[] = {
+        0x58,             // 1000: CLI
+        0x17, 0x10, 0xfd, // 1001: BBC 0,$10,1001  wait for the timer handler
+        0x37, 0xe9, 0xfd, // 1004: BBC 1,$e9,1004  wait for a UART byte
+        0xa5, 0xe8,       // 1007: LDA $e8
+        0x85, 0x11,       // 1009: STA $11
+        0xa5, 0xfe,       // 100b: LDA $fe       record when the byte arrived
+        0x85, 0x12,       // 100d: STA $12
+        0x42,             // 100f: STP
+    };
+    const uint8_t handler[] = {
+        0xa5, 0xfe,       // 1100: LDA $fe       record when the interrupt was taken
+        0x85, 0x13,       // 1102: STA $13
+        0x0f, 0x10,       // 1104: SEB 0,$10
+        0x40,             // 1106: RTI
+    };
+    // clang-format on
+    memcpy(smrom.data(), program, sizeof(program));
+    memcpy(smrom.data() + 0x100, handler, sizeof(handler));
+    smrom[0xff4] = 0x00; // timer X vector
+    smrom[0xff5] = 0x11;
+
+    AllRomsetInfo info;
+    info.romsets[(size_t)Romset::MK2].rom_data[(size_t)RomLocation::SMROM] = smrom;
+
+    auto emu = CreateTestEmulator(Romset::MK2, options, info);
+
+    submcu_t& sm = *emu->GetMCU().sm;
+
+    sm.pc                             = 0x1000;
+    sm.s                              = 0x7f;
+    sm.sr                             = SM_STATUS_I;
+    sm.sleep                          = 0;
+    sm.ram[0x10]                      = 0;
+    sm.device_mode[SM_DEV_UART1_CTRL] = 0x04;
+    sm.device_mode[SM_DEV_INT_ENABLE] = 0x08;
+    sm.device_mode[SM_DEV_PRESCALER]  = 0;
+    sm.device_mode[SM_DEV_TIMER]      = 250;
+    sm.device_mode[SM_DEV_TIMER_CTRL] = 0x40;
+    sm.timer_prescaler                = 0;
+    sm.timer_counter                  = 250;
+    return emu;
+}
+
+static void RequireSameSubMcu(const submcu_t& a, const submcu_t& b)
+{
+    REQUIRE(a.pc == b.pc);
+    REQUIRE(a.a == b.a);
+    REQUIRE(a.s == b.s);
+    REQUIRE(a.sr == b.sr);
+    REQUIRE(a.sleep == b.sleep);
+    REQUIRE(a.cycles == b.cycles);
+    REQUIRE(a.timer_cycles == b.timer_cycles);
+    REQUIRE(a.timer_prescaler == b.timer_prescaler);
+    REQUIRE(a.timer_counter == b.timer_counter);
+    REQUIRE(a.uart_rx_gotbyte == b.uart_rx_gotbyte);
+    REQUIRE(memcmp(a.ram, b.ram, sizeof(a.ram)) == 0);
+    REQUIRE(memcmp(a.device_mode, b.device_mode, sizeof(a.device_mode)) == 0);
+}
+
+TEST_CASE("Polling sub-MCU skips idle steps without changing results")
+{
+    auto cached      = MakePollingEmulator(MCU_Backend::Cached);
+    auto interpreter = MakePollingEmulator(MCU_Backend::Interpreter);
+
+    // odd lengths so that calls end between events
+    uint64_t cycles = 0;
+    for (uint64_t length : {1ull, 7ull, 1000ull, 9999ull, 33333ull, 50000ull})
+    {
+        cycles += length;
+        SM_Update(*cached->GetMCU().sm, cycles);
+        SM_Update(*interpreter->GetMCU().sm, cycles);
+        RequireSameSubMcu(*cached->GetMCU().sm, *interpreter->GetMCU().sm);
+    }
+    // the timer interrupt ends the first loop, but the second one is still waiting
+    REQUIRE(cached->GetMCU().sm->ram[0x10] == 1);
+    REQUIRE(cached->GetMCU().sm->pc == 0x1004);
+
+    // a byte becomes available, but can't be received before the previous byte's delay has passed
+    for (Emulator* emu : {cached.get(), interpreter.get()})
+    {
+        emu->GetMCU().uart_rx_delay = emu->GetMCU().sm->cycles + 5000;
+        REQUIRE(emu->PostMIDI(0x90));
+    }
+    for (int i = 0; i < 200; ++i)
+    {
+        cycles += 37;
+        SM_Update(*cached->GetMCU().sm, cycles);
+        SM_Update(*interpreter->GetMCU().sm, cycles);
+        RequireSameSubMcu(*cached->GetMCU().sm, *interpreter->GetMCU().sm);
+    }
+    REQUIRE(cached->GetMCU().sm->ram[0x11] == 0x90);
+    REQUIRE(cached->GetMCU().sm->sleep);
+}
@@ -0,0 +1,173 @@
+#include "backend/mcu_timer.h"
+#include "test_emulator.h"
+#include <catch2/catch_test_macros.hpp>
+
+// FRT0 registers live at 0x10-0x1f of the device register window.
+constexpr uint32_t FRT0_TCR   = 0x10;
+constexpr uint32_t FRT0_TCSR  = 0x11;
+constexpr uint32_t FRT0_FRCH  = 0x12;
+constexpr uint32_t FRT0_FRCL  = 0x13;
+constexpr uint32_t FRT0_OCRAH = 0x14;
+constexpr uint32_t FRT0_OCRAL = 0x15;
+
+static void WriteFrt16(mcu_timer_t& timer, uint32_t high, uint16_t value)
+{
+    TIMER_Write(timer, high, (uint8_t)(value >> 8));
+    TIMER_Write(timer, high + 1, (uint8_t)value);
+}
+
+static uint16_t ReadFrc(mcu_timer_t& timer)
+{
+    const uint8_t high = TIMER_Read(timer, FRT0_FRCH);
+    return (uint16_t)((high << 8) | TIMER_Read(timer, FRT0_FRCL));
+}
+
+static void ClockTo(mcu_t& mcu, uint64_t cycles)
+{
+    mcu.cycles = cycles;
+    TIMER_Clock<MCU_Traits_MK2>(*mcu.timer, cycles);
+}
+
+// Programs all timers so that they hit matches, counter clears and overflows within a few thousand ticks.
+static void ProgramTimers(mcu_t& mcu)
+{
+    mcu_timer_t& timer = *mcu.timer;
+
+    // FRT0: OCIEA, clear on match A every 10 steps
+    TIMER_Write(timer, FRT0_TCR, 0x20);
+    TIMER_Write(timer, FRT0_TCSR, 0x01);
+    WriteFrt16(timer, FRT0_OCRAH, 10);
+
+    // FRT1: OVIE, overflows after 0x20 steps
+    TIMER_Write(timer, 0x20, 0x11);
+    WriteFrt16(timer, 0x22, 0xffe0);
+
+    // FRT2: no interrupts, only flags
+    TIMER_Write(timer, 0x30, 0x02);
+    WriteFrt16(timer, 0x36, 0x0100);
+
+    // TMR: CMIEA, clear on match A
+    TIMER2_Write(timer, DEV_TMR_TCORA, 3);
+    TIMER2_Write(timer, DEV_TMR_TCR, 0x40 | 0x08 | 0x05);
+}
+
+TEST_CASE("FRT compare match raises interrupt on the matching tick")
+{
+    auto emu = CreateTestEmulator();
+    mcu_t& mcu          = emu->GetMCU();
+    mcu_timer_t& timer  = *mcu.timer;
+
+    // OCIEA, step every 4 ticks; frc reaches ocra on tick 40 which is due once cycles > 80
+    TIMER_Write(timer, FRT0_TCR, 0x20);
+    WriteFrt16(timer, FRT0_OCRAH, 10);
+
+    ClockTo(mcu, 80);
+    REQUIRE(ReadFrc(timer) == 10);
+    REQUIRE((TIMER_Read(timer, FRT0_TCSR) & 0x20) == 0);
+    REQUIRE(!mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_FRT0_OCIA));
+
+    ClockTo(mcu, 81);
+    REQUIRE(ReadFrc(timer) == 11);
+    REQUIRE((TIMER_Read(timer, FRT0_TCSR) & 0x20) != 0);
+    REQUIRE(mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_FRT0_OCIA));
+
+    // counters keep running between events
+    ClockTo(mcu, 81 + 8 * 100);
+    REQUIRE(ReadFrc(timer) == 111);
+}
+
+// Straightforward per-tick model of the MK2 timers, used as a reference for the scheduled implementation.
+struct RefTimer
+{
+    struct Frt
+    {
+        uint8_t tcr, tcsr;
+        uint16_t frc, ocra, ocrb;
+    };
+    Frt frt[3];
+    uint8_t tmr_tcr, tmr_tcsr, tcnt, tcora, tcorb;
+
+    void Tick(uint64_t tick)
+    {
+        constexpr uint64_t frt_steps[4] = {3, 7, 31, 1};
+        for (Frt& f : frt)
+        {
+            if (tick & frt_steps[f.tcr & 3])
+                continue;
+            const bool matcha = f.frc == f.ocra;
+            const bool matchb = f.frc == f.ocrb;
+            if ((f.tcsr & 0x01) && matcha)
+                f.frc = 0;
+            else if (++f.frc == 0)
+                f.tcsr |= 0x10;
+            if (matcha)
+                f.tcsr |= 0x20;
+            if (matchb)
+                f.tcsr |= 0x40;
+        }
+
+        constexpr uint64_t tmr_steps[8] = {0, 7, 63, 1023, 0, 1, 1, 1};
+        const uint64_t step = tmr_steps[tmr_tcr & 7];
+        if (step == 0 || (tick & step))
+            return;
+        const bool matcha = tcnt == tcora;
+        const bool matchb = tcnt == tcorb;
+        if ((tmr_tcr & 0x18) == 0x08 && matcha)
+            tcnt = 0;
+        else if ((tmr_tcr & 0x18) == 0x10 && matchb)
+            tcnt = 0;
+        else if (++tcnt == 0)
+            tmr_tcsr |= 0x20;
+        if (matcha)
+            tmr_tcsr |= 0x40;
+        if (matchb)
+            tmr_tcsr |= 0x80;
+    }
+};
+
+TEST_CASE("Scheduled timer matches per-tick evaluation")
+{
+    auto emu = CreateTestEmulator();
+    mcu_t& mcu         = emu->GetMCU();
+    mcu_timer_t& timer = *mcu.timer;
+
+    ProgramTimers(mcu);
+
+    RefTimer ref{};
+    for (int i = 0; i < 3; ++i)
+    {
+        ref.frt[i] = {timer.frt[i].tcr, timer.frt[i].tcsr, timer.frt[i].frc, timer.frt[i].ocra, timer.frt[i].ocrb};
+    }
+    ref.tmr_tcr  = timer.tmr.tcr;
+    ref.tmr_tcsr = timer.tmr.tcsr;
+    ref.tcnt     = timer.tmr.tcnt;
+    ref.tcora    = timer.tmr.tcora;
+    ref.tcorb    = timer.tmr.tcorb;
+
+    // check at a mix of instruction boundaries, including some that land mid-interval
+    uint64_t tick = 0;
+    for (uint64_t cycles = 12; cycles <= 12 * 20000; cycles += 12 * (1 + cycles % 7))
+    {
+        ClockTo(mcu, cycles);
+        TIMER_Sync(timer);
+        for (; tick * 2 < cycles; ++tick)
+        {
+            ref.Tick(tick);
+        }
+
+        REQUIRE(timer.cycles == tick);
+        for (int i = 0; i < 3; ++i)
+        {
+            REQUIRE(timer.frt[i].frc == ref.frt[i].frc);
+            REQUIRE(timer.frt[i].tcsr == ref.frt[i].tcsr);
+        }
+        REQUIRE(timer.tmr.tcnt == ref.tcnt);
+        REQUIRE(timer.tmr.tcsr == ref.tmr_tcsr);
+        REQUIRE(mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_FRT0_OCIA) == ((ref.frt[0].tcsr & 0x20) != 0));
+        REQUIRE(mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_FRT1_FOVI) == ((ref.frt[1].tcsr & 0x10) != 0));
+        REQUIRE(mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_TIMER_CMIA) == ((ref.tmr_tcsr & 0x40) != 0));
+    }
+    REQUIRE(mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_FRT1_FOVI));
+    REQUIRE((ref.frt[2].tcsr & 0x40) != 0);
+    REQUIRE(!mcu.interrupt_pending.Contains(INTERRUPT_SOURCE_FRT2_OCIB));
+}
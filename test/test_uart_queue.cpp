@@ -0,0 +1,113 @@
+#include "test_emulator.h"
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static std::vector<uint8_t> DrainUART(mcu_t& mcu)
+{
+    std::vector<uint8_t> bytes;
+    while (MCU_HasUARTByte(mcu))
+    {
+        bytes.push_back(MCU_ReadUARTByte(mcu));
+    }
+    return bytes;
+}
+
+TEST_CASE("UART queue posts whole messages or nothing")
+{
+    auto   emu = CreateTestEmulator();
+    mcu_t& mcu = emu->GetMCU();
+
+    // move the pointers close to the end of the buffer so that the next message wraps around
+    std::vector<uint8_t> filler(uart_buffer_size - 3, 0x55);
+    REQUIRE(emu->PostMIDI(filler));
+    REQUIRE(DrainUART(mcu) == filler);
+
+    const std::vector<uint8_t> message = {0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41, 0xF7};
+    REQUIRE(emu->PostMIDI(message));
+    REQUIRE(DrainUART(mcu) == message);
+
+    // fill all but 4 bytes; a 5 byte message must be dropped entirely and a 4 byte one must fit
+    std::vector<uint8_t> almost_full(uart_buffer_size - 4, 0x33);
+    REQUIRE(emu->PostMIDI(almost_full));
+    REQUIRE(!emu->PostMIDI(std::span(message).first(5)));
+    REQUIRE(emu->GetDroppedMIDIBytes() == 5);
+    REQUIRE(emu->PostMIDI(std::span(message).first(4)));
+    REQUIRE(!emu->PostMIDI(0xF8));
+    REQUIRE(emu->GetDroppedMIDIBytes() == 6);
+
+    std::vector<uint8_t> expected = almost_full;
+    expected.insert(expected.end(), message.begin(), message.begin() + 4);
+    REQUIRE(DrainUART(mcu) == expected);
+}
+
+TEST_CASE("UART queue survives a state round trip")
+{
+    auto   emu = CreateTestEmulator();
+    mcu_t& mcu = emu->GetMCU();
+
+    const uint8_t note_on[] = {0x90, 0x3C, 0x7F};
+    REQUIRE(emu->PostMIDI(note_on));
+    std::vector<uint8_t> state;
+    emu->SaveState(state);
+    REQUIRE(DrainUART(mcu).size() == 3);
+
+    REQUIRE(emu->LoadState(state));
+    REQUIRE(DrainUART(mcu) == std::vector<uint8_t>(std::begin(note_on), std::end(note_on)));
+}
+
+TEST_CASE("UART queue delivers messages intact across threads")
+{
+    auto   emu = CreateTestEmulator();
+    mcu_t& mcu = emu->GetMCU();
+
+    // each message is a length byte followed by that many copies of a running sequence number
+    constexpr int     message_count = 200000;
+    std::atomic<bool> producer_done = false;
+    std::thread       producer([&] {
+        uint8_t message[64];
+        for (int i = 0; i < message_count; ++i)
+        {
+            const uint8_t length = (uint8_t)(1 + i % 63);
+            message[0]           = length;
+            memset(message + 1, (uint8_t)i, length);
+            while (!emu->PostMIDI(std::span(message, length + 1u)))
+            {
+                std::this_thread::yield();
+            }
+        }
+        producer_done = true;
+    });
+
+    int  received = 0;
+    bool intact   = true;
+    while (received < message_count)
+    {
+        if (!MCU_HasUARTByte(mcu))
+        {
+            if (producer_done && !MCU_HasUARTByte(mcu))
+                break;
+            std::this_thread::yield();
+            continue;
+        }
+        // a message is published as a whole, so its payload must be readable as soon as its length is
+        const uint8_t length = MCU_ReadUARTByte(mcu);
+        intact               = intact && length == (uint8_t)(1 + received % 63);
+        for (uint8_t i = 0; i < length; ++i)
+        {
+            if (!MCU_HasUARTByte(mcu))
+            {
+                intact = false;
+                break;
+            }
+            intact = MCU_ReadUARTByte(mcu) == (uint8_t)received && intact;
+        }
+        ++received;
+    }
+
+    producer.join();
+    REQUIRE(intact);
+    REQUIRE(received == message_count);
+}